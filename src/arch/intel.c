@@ -17,6 +17,7 @@
 
 /* flags we export */
 int ceph_arch_intel_avx512_vpclmul = 0;
+int ceph_arch_intel_avx2 = 0;
 int ceph_arch_intel_pclmul = 0;
 int ceph_arch_intel_sse42 = 0;
 int ceph_arch_intel_sse41 = 0;
@@ -40,6 +41,12 @@ int ceph_arch_intel_aesni = 0;
 #define CPUID_AESNI 	(1 << 25)
 #define CPUID_OSXSAVE	(1 << 27)
 
+/* SSE:[1] AVX:[2] */
+#define XCR0_AVX		(0x00000006ULL)
+
+/* AVX2:[5] */
+#define CPUID7_0_AVX2_EBX	(1 << 5)
+
 /* SSE:[1] AVX:[2] Opmask:[5] ZMM_HI256:[6] ZMM16-31:[7]*/
 #define XCR0_AVX512		(0x000000E6ULL)
 
@@ -83,6 +90,18 @@ int ceph_arch_intel_probe(void)
 	        ceph_arch_intel_aesni = 1;
 	}
 
+	/*
+	 * AVX2 feature: the OS has to save the YMM state (XCR0) on top of
+	 * the CPUID bit, same as for AVX512 below.
+	 */
+	unsigned int eax_7 = 0, ebx_7 = 0, ecx_7 = 0, edx_7 = 0;
+	if ((ecx & CPUID_OSXSAVE) &&
+	    ((ceph_xgetbv(0) & XCR0_AVX) == XCR0_AVX) &&
+	    (__get_cpuid_count(7, 0, &eax_7, &ebx_7, &ecx_7, &edx_7)) &&
+	    ((ebx_7 & CPUID7_0_AVX2_EBX) != 0)) {
+		ceph_arch_intel_avx2 = 1;
+	}
+
 	/*
 	 * AVX512 feature: check these conditions IN ORDER
 	 *     a. OSXSAVE/XGETBV is available
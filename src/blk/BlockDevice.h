@@ -307,6 +307,7 @@ public:
   virtual void close() = 0;
 
   struct hugepaged_raw_marker_t {};
+  struct ioring_registered_raw_marker_t {};
 
   std::atomic<size_t> discard_queue_bytes = 0;
   std::atomic<uint64_t> discard_queue_length = 0;
@@ -104,6 +104,11 @@ struct io_queue_t {
   virtual int submit_batch(aio_iter begin, aio_iter end,
 			   void *priv, int *retries, int submit_retries, int initial_delay_us) = 0;
   virtual int get_next_completed(int timeout_ms, aio_t **paio, int max) = 0;
+  /// a buffer the queue can do I/O on without mapping it per request,
+  /// or nullptr if there is none to spare
+  virtual ceph::unique_leakable_ptr<ceph::buffer::raw> create_registered(size_t len) {
+    return nullptr;
+  }
 };
 
 struct aio_queue_t final : public io_queue_t {
@@ -91,7 +91,10 @@ KernelDevice::KernelDevice(CephContext* cct, aio_callback_t cb, void *cbpriv, ai
   if (use_ioring && ioring_queue_t::supported()) {
     bool use_ioring_hipri = cct->_conf.get_val<bool>("bdev_ioring_hipri");
     bool use_ioring_sqthread_poll = cct->_conf.get_val<bool>("bdev_ioring_sqthread_poll");
-    io_queue = std::make_unique<ioring_queue_t>(iodepth, use_ioring_hipri, use_ioring_sqthread_poll);
+    unsigned fixed_buffers = cct->_conf.get_val<uint64_t>("bdev_ioring_fixed_buffers");
+    uint64_t fixed_buffer_size = cct->_conf.get_val<Option::size_t>("bdev_ioring_fixed_buffer_size");
+    io_queue = std::make_unique<ioring_queue_t>(iodepth, use_ioring_hipri, use_ioring_sqthread_poll,
+                                                fixed_buffers, fixed_buffer_size);
   } else {
     static bool once;
     if (use_ioring && !once) {
@@ -111,6 +114,10 @@ KernelDevice::KernelDevice(CephContext* cct, aio_callback_t cb, void *cbpriv, ai
             "Number of discard ops issued to kernel device");
   b.add_u64_counter(l_blk_kernel_discard_threads, "discard_threads",
             "Number of discard threads running");
+  b.add_u64_avg(l_blk_kernel_device_aio_submit_batch, "aio_submit_batch",
+            "Number of aios handed to the kernel per submission");
+  b.add_u64_avg(l_blk_kernel_device_aio_complete_batch, "aio_complete_batch",
+            "Number of aios reaped per completion poll");
 
   logger.reset(b.create_perf_counters());
   cct->get_perfcounters_collection()->add(logger.get());
@@ -702,6 +709,7 @@ void KernelDevice::_aio_thread()
     }
     if (r > 0) {
       dout(30) << __func__ << " got " << r << " completed aios" << dendl;
+      logger->inc(l_blk_kernel_device_aio_complete_batch, r);
       for (int i = 0; i < r; ++i) {
 	IOContext *ioc = static_cast<IOContext*>(aio[i]->priv);
 	_aio_log_finish(ioc, aio[i]->offset, aio[i]->length);
@@ -1032,6 +1040,7 @@ void KernelDevice::aio_submit(IOContext *ioc)
   ioc->running_aios.splice(e, ioc->pending_aios);
 
   int pending = ioc->num_pending.load();
+  logger->inc(l_blk_kernel_device_aio_submit_batch, pending);
   ioc->num_running += pending;
   ioc->num_pending -= pending;
   ceph_assert(ioc->num_pending.load() == 0);  // we should be only thread doing this
@@ -1506,8 +1515,15 @@ int KernelDevice::aio_read(
     ioc->pending_aios.push_back(aio_t(ioc, fd_directs[WRITE_LIFE_NOT_SET]));
     ++ioc->num_pending;
     aio_t& aio = ioc->pending_aios.back();
-    aio.bl.push_back(
-      ceph::buffer::ptr_node::create(create_custom_aligned(len, ioc)));
+    auto raw = io_queue->create_registered(len);
+    if (raw) {
+      // as with the huge page pool, keep these out of the buffer cache
+      // so that cached data does not hold on to the registered slots
+      ioc->flags |= IOContext::FLAG_DONT_CACHE;
+    } else {
+      raw = create_custom_aligned(len, ioc);
+    }
+    aio.bl.push_back(ceph::buffer::ptr_node::create(std::move(raw)));
     aio.bl.prepare_iov(&aio.iov);
     aio.preadv(off, len);
     dout(30) << aio << dendl;
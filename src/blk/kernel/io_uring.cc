@@ -9,15 +9,69 @@
 #include <sys/epoll.h>
 #include <map>
 
+#include "blk/BlockDevice.h"
+#include "common/buffer_instrumentation.h"
+#include "common/ceph_mutex.h"
+#include "include/intarith.h"
+
 using std::list;
 using std::make_unique;
 
+/*
+ * Registered (fixed) buffers.  A pool of page-aligned slots is registered
+ * with the ring once and KernelDevice hands slots out directly as read
+ * buffers (create_registered()).  Any read or write whose payload is a
+ * single slot is then issued with read_fixed/write_fixed, so the kernel
+ * does not pin and map user pages per request; everything else goes
+ * through readv/writev as before.  Nothing is copied.  The pool memory
+ * stays valid for as long as any buffer handed out from it is alive, even
+ * after the ring itself is gone.
+ */
+struct ioring_buf_pool {
+  char *base = nullptr;
+  size_t buf_size = 0;
+  unsigned nr = 0;
+  ceph::mutex lock = ceph::make_mutex("ioring_buf_pool::lock");
+  std::vector<unsigned> free_slots;
+
+  ~ioring_buf_pool() {
+    free(base);
+  }
+
+  /// registered buffer index holding [p, p + len), or -1
+  int find(const void *p, size_t len) const {
+    const char *c = (const char *) p;
+    if (c < base || c >= base + nr * buf_size)
+      return -1;
+    unsigned slot = (c - base) / buf_size;
+    if (c + len > base + (slot + 1) * buf_size)
+      return -1;
+    return slot;
+  }
+};
+
+struct ioring_buf_raw : public ceph::buffer_instrumentation::instrumented_raw<
+  BlockDevice::ioring_registered_raw_marker_t> {
+  std::shared_ptr<ioring_buf_pool> pool;
+  unsigned slot;
+
+  ioring_buf_raw(std::shared_ptr<ioring_buf_pool> p, unsigned s, unsigned l)
+    : instrumented_raw(p->base + s * p->buf_size, l),
+      pool(std::move(p)), slot(s) {}
+  ~ioring_buf_raw() override {
+    // recycle the slot, don't free it
+    std::lock_guard l(pool->lock);
+    pool->free_slots.push_back(slot);
+  }
+};
+
 struct ioring_data {
   struct io_uring io_uring;
   pthread_mutex_t cq_mutex;
   pthread_mutex_t sq_mutex;
   int epoll_fd = -1;
   std::map<int, int> fixed_fds_map;
+  std::shared_ptr<ioring_buf_pool> bufs;  ///< registered with io_uring, if any
 };
 
 static int ioring_get_cqe(struct ioring_data *d, unsigned int max,
@@ -58,14 +112,27 @@ static void init_sqe(struct ioring_data *d, struct io_uring_sqe *sqe,
 
   ceph_assert(fixed_fd != -1);
 
-  if (io->iocb.aio_lio_opcode == IO_CMD_PWRITEV)
-    io_uring_prep_writev(sqe, fixed_fd, &io->iov[0],
-			 io->iov.size(), io->offset);
-  else if (io->iocb.aio_lio_opcode == IO_CMD_PREADV)
-    io_uring_prep_readv(sqe, fixed_fd, &io->iov[0],
-			io->iov.size(), io->offset);
-  else
+  int buf_index = -1;
+  if (d->bufs && io->iov.size() == 1)
+    buf_index = d->bufs->find(io->iov[0].iov_base, io->iov[0].iov_len);
+
+  if (io->iocb.aio_lio_opcode == IO_CMD_PWRITEV) {
+    if (buf_index >= 0)
+      io_uring_prep_write_fixed(sqe, fixed_fd, io->iov[0].iov_base,
+				io->iov[0].iov_len, io->offset, buf_index);
+    else
+      io_uring_prep_writev(sqe, fixed_fd, &io->iov[0],
+			   io->iov.size(), io->offset);
+  } else if (io->iocb.aio_lio_opcode == IO_CMD_PREADV) {
+    if (buf_index >= 0)
+      io_uring_prep_read_fixed(sqe, fixed_fd, io->iov[0].iov_base,
+			       io->iov[0].iov_len, io->offset, buf_index);
+    else
+      io_uring_prep_readv(sqe, fixed_fd, &io->iov[0],
+			  io->iov.size(), io->offset);
+  } else {
     ceph_assert(0);
+  }
 
   io_uring_sqe_set_data(sqe, io);
   io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE);
@@ -75,27 +142,55 @@ static int ioring_queue(struct ioring_data *d, void *priv,
 			list<aio_t>::iterator beg, list<aio_t>::iterator end)
 {
   struct io_uring *ring = &d->io_uring;
-  struct aio_t *io = nullptr;
+  int submitted = 0;
 
   ceph_assert(beg != end);
 
-  do {
-    struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
-    if (!sqe)
-      break;
-
-    io = &*beg;
-    io->priv = priv;
-
-    init_sqe(d, sqe, io);
-
-  } while (++beg != end);
-
-  if (!io)
-    /* Queue is full, go and reap something first */
-    return 0;
+  /*
+   * Fill as many SQEs as the ring has room for and submit them with a
+   * single io_uring_enter() (or none at all with SQPOLL).  If the batch
+   * is larger than the submission ring, keep going until every aio has
+   * been handed to the kernel: the caller treats a successful return as
+   * "all queued" and would otherwise never see the remainder complete.
+   */
+  while (beg != end) {
+    unsigned queued = 0;
+    do {
+      struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
+      if (!sqe)
+	break;
+
+      struct aio_t *io = &*beg;
+      io->priv = priv;
+
+      init_sqe(d, sqe, io);
+      ++queued;
+    } while (++beg != end);
+
+    int ret = io_uring_submit(ring);
+    if (ret < 0)
+      return ret;
+    submitted += ret;
+    if (!queued) {
+      /*
+       * The SQ ring is full.  With SQPOLL the kernel thread has not
+       * consumed our entries yet, so sleep until it frees a slot.
+       * Otherwise the kernel refused them because too many completions
+       * are outstanding: wait for one, _aio_thread will reap it.
+       */
+      if (ring->flags & IORING_SETUP_SQPOLL) {
+	ret = io_uring_sqring_wait(ring);
+      } else {
+	ret = io_uring_submit_and_wait(ring, 1);
+	if (ret > 0)
+	  submitted += ret;
+      }
+      if (ret < 0)
+	return ret;
+    }
+  }
 
-  return io_uring_submit(ring);
+  return submitted;
 }
 
 static void build_fixed_fds_map(struct ioring_data *d,
@@ -107,11 +202,46 @@ static void build_fixed_fds_map(struct ioring_data *d,
   }
 }
 
-ioring_queue_t::ioring_queue_t(unsigned iodepth_, bool hipri_, bool sq_thread_) :
+static int register_fixed_bufs(struct ioring_data *d, unsigned nr,
+			       uint64_t size)
+{
+  auto pool = std::make_shared<ioring_buf_pool>();
+  pool->buf_size = p2roundup<uint64_t>(size, CEPH_PAGE_SIZE);
+  pool->nr = nr;
+  pool->base = (char *) aligned_alloc(CEPH_PAGE_SIZE, nr * pool->buf_size);
+  if (!pool->base)
+    return -ENOMEM;
+
+  std::vector<struct iovec> iovs;
+  for (unsigned i = 0; i < nr; i++)
+    iovs.push_back({pool->base + i * pool->buf_size, pool->buf_size});
+  int ret = io_uring_register_buffers(&d->io_uring, &iovs[0], nr);
+  if (ret < 0)
+    return ret;
+
+  for (unsigned i = nr; i > 0; i--)
+    pool->free_slots.push_back(i - 1);
+  d->bufs = std::move(pool);
+  return 0;
+}
+
+static void unregister_fixed_bufs(struct ioring_data *d)
+{
+  if (!d->bufs)
+    return;
+  io_uring_unregister_buffers(&d->io_uring);
+  // buffers still handed out keep the pool alive
+  d->bufs.reset();
+}
+
+ioring_queue_t::ioring_queue_t(unsigned iodepth_, bool hipri_, bool sq_thread_,
+                               unsigned fixed_buffers_, uint64_t fixed_buffer_size_) :
   d(make_unique<ioring_data>()),
   iodepth(iodepth_),
   hipri(hipri_),
-  sq_thread(sq_thread_)
+  sq_thread(sq_thread_),
+  fixed_buffers(fixed_buffers_),
+  fixed_buffer_size(fixed_buffer_size_)
 {
 }
 
@@ -144,6 +274,14 @@ int ioring_queue_t::init(std::vector<int> &fds)
 
   build_fixed_fds_map(d.get(), fds);
 
+  if (fixed_buffers && fixed_buffer_size) {
+    /*
+     * Registration is an optimization only: on failure (typically
+     * RLIMIT_MEMLOCK) keep going with plain readv/writev.
+     */
+    register_fixed_bufs(d.get(), fixed_buffers, fixed_buffer_size);
+  }
+
   d->epoll_fd = epoll_create1(0);
   if (d->epoll_fd < 0) {
     ret = -errno;
@@ -163,6 +301,7 @@ int ioring_queue_t::init(std::vector<int> &fds)
 close_epoll_fd:
   close(d->epoll_fd);
 unregister_files:
+  unregister_fixed_bufs(d.get());
   io_uring_unregister_files(&d->io_uring);
 close_ring_fd:
   io_uring_queue_exit(&d->io_uring);
@@ -175,6 +314,7 @@ void ioring_queue_t::shutdown()
   d->fixed_fds_map.clear();
   close(d->epoll_fd);
   d->epoll_fd = -1;
+  unregister_fixed_bufs(d.get());
   io_uring_unregister_files(&d->io_uring);
   io_uring_queue_exit(&d->io_uring);
 }
@@ -212,6 +352,25 @@ get_cqe:
   return events;
 }
 
+ceph::unique_leakable_ptr<ceph::buffer::raw>
+ioring_queue_t::create_registered(size_t len)
+{
+  auto pool = d->bufs;
+  if (!pool || len > pool->buf_size)
+    return nullptr;
+
+  unsigned slot;
+  {
+    std::lock_guard l(pool->lock);
+    if (pool->free_slots.empty())
+      return nullptr;
+    slot = pool->free_slots.back();
+    pool->free_slots.pop_back();
+  }
+  return ceph::unique_leakable_ptr<ceph::buffer::raw>(
+    new ioring_buf_raw(std::move(pool), slot, len));
+}
+
 bool ioring_queue_t::supported()
 {
   struct io_uring ring;
@@ -227,7 +386,8 @@ bool ioring_queue_t::supported()
 
 struct ioring_data {};
 
-ioring_queue_t::ioring_queue_t(unsigned iodepth_, bool hipri_, bool sq_thread_)
+ioring_queue_t::ioring_queue_t(unsigned iodepth_, bool hipri_, bool sq_thread_,
+                               unsigned fixed_buffers_, uint64_t fixed_buffer_size_)
 {
   ceph_assert(0);
 }
@@ -259,6 +419,12 @@ int ioring_queue_t::get_next_completed(int timeout_ms, aio_t **paio, int max)
   ceph_assert(0);
 }
 
+ceph::unique_leakable_ptr<ceph::buffer::raw>
+ioring_queue_t::create_registered(size_t len)
+{
+  ceph_assert(0);
+}
+
 bool ioring_queue_t::supported()
 {
   return false;
@@ -4,9 +4,13 @@
 #ifndef CEPH_OS_BLUESTORE_CHECKSUMMER
 #define CEPH_OS_BLUESTORE_CHECKSUMMER
 
+#include <algorithm>
+
 #include "include/buffer.h"
 #include "include/byteorder.h"
 #include "include/ceph_assert.h"
+#include "include/crc32c.h"
+#include "common/xxhash_mb.h"
 
 #include "xxHash/xxhash.h"
 
@@ -90,6 +94,18 @@ public:
       ) {
       return p.crc32c(len, init_value);
     }
+
+    static void calc_contiguous(
+      init_value_t init_value,
+      size_t len,
+      size_t blocks,
+      const char *data,
+      init_value_t *out
+      ) {
+      for (size_t i = 0; i < blocks; ++i, data += len) {
+	out[i] = ceph_crc32c(init_value, (const unsigned char*)data, len);
+      }
+    }
   };
 
   struct crc32c_16 {
@@ -111,6 +127,18 @@ public:
       ) {
       return p.crc32c(len, init_value) & 0xffff;
     }
+
+    static void calc_contiguous(
+      init_value_t init_value,
+      size_t len,
+      size_t blocks,
+      const char *data,
+      init_value_t *out
+      ) {
+      for (size_t i = 0; i < blocks; ++i, data += len) {
+	out[i] = ceph_crc32c(init_value, (const unsigned char*)data, len) & 0xffff;
+      }
+    }
   };
 
   struct crc32c_8 {
@@ -132,6 +160,18 @@ public:
       ) {
       return p.crc32c(len, init_value) & 0xff;
     }
+
+    static void calc_contiguous(
+      init_value_t init_value,
+      size_t len,
+      size_t blocks,
+      const char *data,
+      init_value_t *out
+      ) {
+      for (size_t i = 0; i < blocks; ++i, data += len) {
+	out[i] = ceph_crc32c(init_value, (const unsigned char*)data, len) & 0xff;
+      }
+    }
   };
 
   struct xxhash32 {
@@ -161,6 +201,16 @@ public:
       }
       return XXH32_digest(state);
     }
+
+    static void calc_contiguous(
+      init_value_t init_value,
+      size_t len,
+      size_t blocks,
+      const char *data,
+      init_value_t *out
+      ) {
+      ceph_xxh32_mb(init_value, (const unsigned char*)data, len, blocks, out);
+    }
   };
 
   struct xxhash64 {
@@ -190,8 +240,52 @@ public:
       }
       return XXH64_digest(state);
     }
+
+    static void calc_contiguous(
+      init_value_t init_value,
+      size_t len,
+      size_t blocks,
+      const char *data,
+      init_value_t *out
+      ) {
+      for (size_t i = 0; i < blocks; ++i, data += len) {
+	out[i] = XXH64(data, len, init_value);
+      }
+    }
   };
 
+  // max number of blocks handed to Alg::calc_contiguous() at once
+  static constexpr size_t csum_batch_blocks = 64;
+
+  /// checksum up to @blocks blocks starting at @p, returns the number done
+  ///
+  /// Whole blocks that sit in the current buffer segment are hashed in a
+  /// single calc_contiguous() call, which lets the multi-buffer xxhash32
+  /// kernel work on several blocks in parallel and avoids per-block
+  /// iterator overhead; a block that straddles segments takes the
+  /// iterator-based calc() path.
+  template<class Alg>
+  static size_t calc_batch(
+    typename Alg::state_t state,
+    typename Alg::init_value_t init_value,
+    size_t csum_block_size,
+    size_t blocks,
+    ceph::buffer::list::const_iterator& p,
+    typename Alg::init_value_t *out) {
+    size_t n = std::min(
+      {blocks, csum_batch_blocks,
+       p.get_current_ptr().length() / csum_block_size});
+    if (n == 0) {
+      out[0] = Alg::calc(state, init_value, csum_block_size, p);
+      return 1;
+    }
+    const char *data;
+    size_t l = p.get_ptr_and_advance(n * csum_block_size, &data);
+    ceph_assert(l == n * csum_block_size);
+    Alg::calc_contiguous(init_value, csum_block_size, n, data, out);
+    return n;
+  }
+
   template<class Alg>
   static int calculate(
     size_t csum_block_size,
@@ -225,9 +319,15 @@ public:
     typename Alg::value_t *pv =
       reinterpret_cast<typename Alg::value_t*>(csum_data->c_str());
     pv += offset / csum_block_size;
-    while (blocks--) {
-      *pv = Alg::calc(state, init_value, csum_block_size, p);
-      ++pv;
+    typename Alg::init_value_t v[csum_batch_blocks];
+    while (blocks > 0) {
+      size_t n = calc_batch<Alg>(state, init_value, csum_block_size, blocks,
+				 p, v);
+      for (size_t i = 0; i < n; ++i) {
+	*pv = v[i];
+	++pv;
+      }
+      blocks -= n;
     }
     Alg::fini(&state);
     return 0;
@@ -253,18 +353,22 @@ public:
       reinterpret_cast<const typename Alg::value_t*>(csum_data.c_str());
     pv += offset / csum_block_size;
     size_t pos = offset;
+    typename Alg::init_value_t v[csum_batch_blocks];
     while (length > 0) {
-      typename Alg::init_value_t v = Alg::calc(state, -1, csum_block_size, p);
-      if (*pv != v) {
-	if (bad_csum) {
-	  *bad_csum = v;
+      size_t n = calc_batch<Alg>(state, -1, csum_block_size,
+				 length / csum_block_size, p, v);
+      for (size_t i = 0; i < n; ++i) {
+	if (*pv != v[i]) {
+	  if (bad_csum) {
+	    *bad_csum = v[i];
+	  }
+	  Alg::fini(&state);
+	  return pos;
 	}
-	Alg::fini(&state);
-	return pos;
+	++pv;
+	pos += csum_block_size;
       }
-      ++pv;
-      pos += csum_block_size;
-      length -= csum_block_size;
+      length -= n * csum_block_size;
     }
     Alg::fini(&state);
     return -1;  // no errors
@@ -0,0 +1,225 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+#include "common/xxhash_mb.h"
+#include "arch/probe.h"
+#include "arch/intel.h"
+#include "arch/arm.h"
+
+#include "xxHash/xxhash.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+[[maybe_unused]] constexpr uint32_t PRIME32_1 = 2654435761U;
+[[maybe_unused]] constexpr uint32_t PRIME32_2 = 2246822519U;
+[[maybe_unused]] constexpr uint32_t PRIME32_3 = 3266489917U;
+
+[[maybe_unused]] inline uint32_t rotl32(uint32_t x, int r)
+{
+  return (x << r) | (x >> (32 - r));
+}
+
+// Merge the four accumulators of a block whose length is a multiple of
+// the 16 byte stripe, i.e. there is no tail to mix in.
+[[maybe_unused]] inline uint32_t xxh32_finish(
+  uint32_t v1, uint32_t v2, uint32_t v3, uint32_t v4, size_t len)
+{
+  uint32_t h = rotl32(v1, 1) + rotl32(v2, 7) + rotl32(v3, 12) + rotl32(v4, 18);
+  h += static_cast<uint32_t>(len);
+  h ^= h >> 15;
+  h *= PRIME32_2;
+  h ^= h >> 13;
+  h *= PRIME32_3;
+  h ^= h >> 16;
+  return h;
+}
+
+#if defined(__x86_64__)
+
+__attribute__((target("avx2")))
+inline __m256i xxh32_round_avx2(__m256i acc, __m256i in)
+{
+  acc = _mm256_add_epi32(acc,
+    _mm256_mullo_epi32(in, _mm256_set1_epi32(PRIME32_2)));
+  acc = _mm256_or_si256(_mm256_slli_epi32(acc, 13), _mm256_srli_epi32(acc, 19));
+  return _mm256_mullo_epi32(acc, _mm256_set1_epi32(PRIME32_1));
+}
+
+// 8 blocks per pass, one per 32-bit lane.  Each pass loads 32 bytes (two
+// stripes) of every block and transposes the 8x8 word matrix so that
+// vector k holds word k of all eight blocks.
+__attribute__((target("avx2")))
+void xxh32_mb_avx2(uint32_t seed, const unsigned char *data,
+                   size_t block_len, size_t nblocks, uint32_t *out)
+{
+  if (block_len < 32 || (block_len % 32) != 0) {
+    ceph_xxh32_mb_scalar(seed, data, block_len, nblocks, out);
+    return;
+  }
+  size_t i = 0;
+  for (; i + 8 <= nblocks; i += 8) {
+    const unsigned char *base = data + i * block_len;
+    __m256i v1 = _mm256_set1_epi32(seed + PRIME32_1 + PRIME32_2);
+    __m256i v2 = _mm256_set1_epi32(seed + PRIME32_2);
+    __m256i v3 = _mm256_set1_epi32(seed);
+    __m256i v4 = _mm256_set1_epi32(seed - PRIME32_1);
+    for (size_t off = 0; off < block_len; off += 32) {
+      const unsigned char *q = base + off;
+      __m256i r0 = _mm256_loadu_si256((const __m256i*)(q));
+      __m256i r1 = _mm256_loadu_si256((const __m256i*)(q + block_len));
+      __m256i r2 = _mm256_loadu_si256((const __m256i*)(q + 2 * block_len));
+      __m256i r3 = _mm256_loadu_si256((const __m256i*)(q + 3 * block_len));
+      __m256i r4 = _mm256_loadu_si256((const __m256i*)(q + 4 * block_len));
+      __m256i r5 = _mm256_loadu_si256((const __m256i*)(q + 5 * block_len));
+      __m256i r6 = _mm256_loadu_si256((const __m256i*)(q + 6 * block_len));
+      __m256i r7 = _mm256_loadu_si256((const __m256i*)(q + 7 * block_len));
+
+      __m256i t0 = _mm256_unpacklo_epi32(r0, r1);
+      __m256i t1 = _mm256_unpackhi_epi32(r0, r1);
+      __m256i t2 = _mm256_unpacklo_epi32(r2, r3);
+      __m256i t3 = _mm256_unpackhi_epi32(r2, r3);
+      __m256i t4 = _mm256_unpacklo_epi32(r4, r5);
+      __m256i t5 = _mm256_unpackhi_epi32(r4, r5);
+      __m256i t6 = _mm256_unpacklo_epi32(r6, r7);
+      __m256i t7 = _mm256_unpackhi_epi32(r6, r7);
+
+      __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+      __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+      __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+      __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+      __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+      __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+      __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+      __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+
+      // first stripe: words 0..3, second stripe: words 4..7
+      v1 = xxh32_round_avx2(v1, _mm256_permute2x128_si256(u0, u4, 0x20));
+      v2 = xxh32_round_avx2(v2, _mm256_permute2x128_si256(u1, u5, 0x20));
+      v3 = xxh32_round_avx2(v3, _mm256_permute2x128_si256(u2, u6, 0x20));
+      v4 = xxh32_round_avx2(v4, _mm256_permute2x128_si256(u3, u7, 0x20));
+      v1 = xxh32_round_avx2(v1, _mm256_permute2x128_si256(u0, u4, 0x31));
+      v2 = xxh32_round_avx2(v2, _mm256_permute2x128_si256(u1, u5, 0x31));
+      v3 = xxh32_round_avx2(v3, _mm256_permute2x128_si256(u2, u6, 0x31));
+      v4 = xxh32_round_avx2(v4, _mm256_permute2x128_si256(u3, u7, 0x31));
+    }
+    alignas(32) uint32_t a1[8], a2[8], a3[8], a4[8];
+    _mm256_store_si256((__m256i*)a1, v1);
+    _mm256_store_si256((__m256i*)a2, v2);
+    _mm256_store_si256((__m256i*)a3, v3);
+    _mm256_store_si256((__m256i*)a4, v4);
+    for (size_t j = 0; j < 8; ++j) {
+      out[i + j] = xxh32_finish(a1[j], a2[j], a3[j], a4[j], block_len);
+    }
+  }
+  if (i < nblocks) {
+    ceph_xxh32_mb_scalar(seed, data + i * block_len, block_len,
+                         nblocks - i, out + i);
+  }
+}
+
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+
+inline uint32x4_t xxh32_round_neon(uint32x4_t acc, uint32x4_t in)
+{
+  acc = vmlaq_u32(acc, in, vdupq_n_u32(PRIME32_2));
+  acc = vorrq_u32(vshlq_n_u32(acc, 13), vshrq_n_u32(acc, 19));
+  return vmulq_u32(acc, vdupq_n_u32(PRIME32_1));
+}
+
+// 4 blocks per pass, one per lane; each step transposes one stripe of
+// all four blocks.
+void xxh32_mb_neon(uint32_t seed, const unsigned char *data,
+                   size_t block_len, size_t nblocks, uint32_t *out)
+{
+  if (block_len < 16 || (block_len % 16) != 0) {
+    ceph_xxh32_mb_scalar(seed, data, block_len, nblocks, out);
+    return;
+  }
+  size_t i = 0;
+  for (; i + 4 <= nblocks; i += 4) {
+    const unsigned char *base = data + i * block_len;
+    uint32x4_t v1 = vdupq_n_u32(seed + PRIME32_1 + PRIME32_2);
+    uint32x4_t v2 = vdupq_n_u32(seed + PRIME32_2);
+    uint32x4_t v3 = vdupq_n_u32(seed);
+    uint32x4_t v4 = vdupq_n_u32(seed - PRIME32_1);
+    for (size_t off = 0; off < block_len; off += 16) {
+      const unsigned char *q = base + off;
+      uint32x4_t r0 = vreinterpretq_u32_u8(vld1q_u8(q));
+      uint32x4_t r1 = vreinterpretq_u32_u8(vld1q_u8(q + block_len));
+      uint32x4_t r2 = vreinterpretq_u32_u8(vld1q_u8(q + 2 * block_len));
+      uint32x4_t r3 = vreinterpretq_u32_u8(vld1q_u8(q + 3 * block_len));
+      uint32x4x2_t a = vtrnq_u32(r0, r1);
+      uint32x4x2_t b = vtrnq_u32(r2, r3);
+      v1 = xxh32_round_neon(v1, vcombine_u32(vget_low_u32(a.val[0]),
+                                             vget_low_u32(b.val[0])));
+      v2 = xxh32_round_neon(v2, vcombine_u32(vget_low_u32(a.val[1]),
+                                             vget_low_u32(b.val[1])));
+      v3 = xxh32_round_neon(v3, vcombine_u32(vget_high_u32(a.val[0]),
+                                             vget_high_u32(b.val[0])));
+      v4 = xxh32_round_neon(v4, vcombine_u32(vget_high_u32(a.val[1]),
+                                             vget_high_u32(b.val[1])));
+    }
+    uint32_t a1[4], a2[4], a3[4], a4[4];
+    vst1q_u32(a1, v1);
+    vst1q_u32(a2, v2);
+    vst1q_u32(a3, v3);
+    vst1q_u32(a4, v4);
+    for (size_t j = 0; j < 4; ++j) {
+      out[i + j] = xxh32_finish(a1[j], a2[j], a3[j], a4[j], block_len);
+    }
+  }
+  if (i < nblocks) {
+    ceph_xxh32_mb_scalar(seed, data + i * block_len, block_len,
+                         nblocks - i, out + i);
+  }
+}
+
+#endif
+
+} // anonymous namespace
+
+void ceph_xxh32_mb_scalar(uint32_t seed, const unsigned char *data,
+                          size_t block_len, size_t nblocks, uint32_t *out)
+{
+  for (size_t i = 0; i < nblocks; ++i) {
+    out[i] = XXH32(data + i * block_len, block_len, seed);
+  }
+}
+
+/*
+ * choose best implementation based on the CPU architecture.
+ */
+ceph_xxh32_mb_func_t ceph_choose_xxh32_mb(void)
+{
+  // make sure we've probed cpu features; this might depend on the
+  // link order of this file relative to arch/probe.cc.
+  ceph_arch_probe();
+
+#if defined(__x86_64__)
+  if (ceph_arch_intel_avx2) {
+    return xxh32_mb_avx2;
+  }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+  if (ceph_arch_neon) {
+    return xxh32_mb_neon;
+  }
+#endif
+  return ceph_xxh32_mb_scalar;
+}
+
+/*
+ * static global
+ *
+ * This is a bit of a no-no for shared libraries, but we don't care.
+ * It is effectively constant for the executing process as the value
+ * depends on the CPU architecture.
+ *
+ * We initialize it during program init using the magic of C++.
+ */
+ceph_xxh32_mb_func_t ceph_xxh32_mb_func = ceph_choose_xxh32_mb();
@@ -0,0 +1,43 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+#ifndef CEPH_COMMON_XXHASH_MB_H
+#define CEPH_COMMON_XXHASH_MB_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Multi-buffer xxhash32: hash @nblocks consecutive blocks of @block_len
+ * bytes each, starting at @data, writing one digest per block to @out.
+ *
+ * The result for every block is identical to XXH32(block, block_len, seed);
+ * SIMD implementations run one block per vector lane so that several
+ * independent hashes progress in parallel.
+ */
+typedef void (*ceph_xxh32_mb_func_t)(uint32_t seed,
+                                     const unsigned char *data,
+                                     size_t block_len,
+                                     size_t nblocks,
+                                     uint32_t *out);
+
+/*
+ * this is a static global with the chosen implementation for the given
+ * architecture.
+ */
+extern ceph_xxh32_mb_func_t ceph_xxh32_mb_func;
+
+extern ceph_xxh32_mb_func_t ceph_choose_xxh32_mb(void);
+
+/// portable implementation, one XXH32() call per block
+void ceph_xxh32_mb_scalar(uint32_t seed, const unsigned char *data,
+                          size_t block_len, size_t nblocks, uint32_t *out);
+
+static inline void ceph_xxh32_mb(uint32_t seed, const unsigned char *data,
+                                 size_t block_len, size_t nblocks,
+                                 uint32_t *out)
+{
+  ceph_xxh32_mb_func(seed, data, block_len, nblocks, out);
+}
+
+#endif
@@ -18,6 +18,7 @@
 
 #include <algorithm>
 #include <cerrno>
+#include <cstring>
 
 #include "ErasureCode.h"
 
@@ -594,4 +595,23 @@ int ErasureCode::decode_concat(const map<int, bufferlist> &chunks,
   return decode_concat(want_to_read, chunks, decoded);
 }
 END_IGNORE_DEPRECATED
+
+void ErasureCode::region_xor(const bufferptr &in, bufferptr &out)
+{
+  ceph_assert(in.length() == out.length());
+  const char *src = in.c_str();
+  char *dst = out.c_str();
+  unsigned len = out.length();
+  unsigned i = 0;
+  for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+    uint64_t a, b;
+    memcpy(&a, src + i, sizeof(a));
+    memcpy(&b, dst + i, sizeof(b));
+    b ^= a;
+    memcpy(dst + i, &b, sizeof(b));
+  }
+  for (; i < len; i++) {
+    dst[i] ^= src[i];
+  }
+}
 }
@@ -174,6 +174,9 @@ class ErasureCode : public ErasureCodeInterface {
  protected:
   int parse(const ErasureCodeProfile &profile, std::ostream *ss);
 
+  /// out ^= in; both buffers must have the same length
+  static void region_xor(const bufferptr &in, bufferptr &out);
+
  private:
   [[deprecated]]
   unsigned int chunk_index(unsigned int i) const;
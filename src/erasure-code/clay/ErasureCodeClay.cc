@@ -17,6 +17,7 @@
 
 #include <errno.h>
 #include <algorithm>
+#include <cstring>
 
 #include "ErasureCodeClay.h"
 
@@ -169,6 +170,66 @@ int ErasureCodeClay::encode_chunks(const set<int> &want_to_encode,
   return res;
 }
 
+void ErasureCodeClay::encode_delta(const bufferptr &old_data,
+                                   const bufferptr &new_data,
+                                   bufferptr *delta_maybe_in_place)
+{
+  if (&old_data != delta_maybe_in_place) {
+    memcpy(delta_maybe_in_place->c_str(), old_data.c_str(),
+           delta_maybe_in_place->length());
+  }
+  region_xor(new_data, *delta_maybe_in_place);
+}
+
+//
+// The code is linear, so the parity delta is the encoding of the data
+// deltas with every other data chunk set to zero. The layered encode
+// couples all chunks, hence a full encode rather than a per-shard update.
+//
+void ErasureCodeClay::apply_delta(const shard_id_map<bufferptr> &in,
+                                  shard_id_map<bufferptr> &out)
+{
+  auto& nonconst_in = const_cast<shard_id_map<bufferptr>&>(in);
+  unsigned int chunk_size = 0;
+  for (const auto& [shard, ptr] : in) {
+    if (shard < k) {
+      chunk_size = ptr.length();
+      break;
+    }
+  }
+  if (chunk_size == 0) {
+    return;
+  }
+  ceph_assert(chunk_size % sub_chunk_no == 0);
+
+  map<int, bufferlist> encoded;
+  for (int i = 0; i < k + m; i++) {
+    shard_id_t shard(i);
+    if (i < k && nonconst_in.contains(shard)) {
+      ceph_assert(nonconst_in[shard].length() == chunk_size);
+      encoded[i].append(nonconst_in[shard]);
+    } else {
+      bufferptr buf(buffer::create_aligned(chunk_size, SIMD_ALIGN));
+      buf.zero();
+      encoded[i].push_back(std::move(buf));
+    }
+  }
+  set<int> want_to_encode;
+  for (int i = k; i < k + m; i++) {
+    want_to_encode.insert(i);
+  }
+  int r = encode_chunks(want_to_encode, &encoded);
+  ceph_assert(r == 0);
+
+  for (auto &&[shard, ptr] : out) {
+    if (shard < k) {
+      continue;
+    }
+    ceph_assert(ptr.length() == chunk_size);
+    region_xor(encoded[int(shard)].front(), ptr);
+  }
+}
+
 #if 0 \
 /* This code was partially tested, so keeping code, but we need more
  * refactoring and testing before it is ready for production.
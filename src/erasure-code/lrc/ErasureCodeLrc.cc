@@ -16,6 +16,7 @@
  *
  */
 #include <cerrno>
+#include <cstring>
 #include <algorithm>
 
 #include "include/str_map.h"
@@ -533,6 +534,20 @@ int ErasureCodeLrc::init(ErasureCodeProfile &profile,
   if (r)
     return r;
 
+  // The optimized backend and parity delta writes can only be used when
+  // every layer supports them: a delta is pushed through the layers one
+  // at a time, see apply_delta().
+  flags = FLAG_EC_PLUGIN_PARTIAL_READ_OPTIMIZATION |
+    FLAG_EC_PLUGIN_PARTIAL_WRITE_OPTIMIZATION |
+    FLAG_EC_PLUGIN_ZERO_INPUT_ZERO_OUTPUT_OPTIMIZATION |
+    FLAG_EC_PLUGIN_DIRECT_READS;
+  uint64_t layer_flags = FLAG_EC_PLUGIN_OPTIMIZED_SUPPORTED |
+    FLAG_EC_PLUGIN_PARITY_DELTA_OPTIMIZATION;
+  for (const auto &layer : layers) {
+    layer_flags &= layer.erasure_code->get_supported_optimizations();
+  }
+  flags |= layer_flags;
+
   //
   // When initialized with kml, the profile parameters
   // that were generated should not be stored because
@@ -1002,6 +1017,76 @@ int ErasureCodeLrc::encode_chunks(const shard_id_map<bufferptr> &in,
   return 0;
 }
 
+void ErasureCodeLrc::encode_delta(const bufferptr &old_data,
+                                  const bufferptr &new_data,
+                                  bufferptr *delta_maybe_in_place)
+{
+  if (&old_data != delta_maybe_in_place) {
+    memcpy(delta_maybe_in_place->c_str(), old_data.c_str(),
+           delta_maybe_in_place->length());
+  }
+  region_xor(new_data, *delta_maybe_in_place);
+}
+
+//
+// Every layer is linear, so the delta of a coding chunk is the encoding
+// of the deltas of the layer's data chunks. Layers are walked in the
+// order they are encoded so that the delta of a coding chunk computed by
+// one layer is available when a later layer uses that chunk as data.
+//
+void ErasureCodeLrc::apply_delta(const shard_id_map<bufferptr> &in,
+                                 shard_id_map<bufferptr> &out)
+{
+  const std::vector<shard_id_t> &mapping = get_chunk_mapping();
+  shard_id_set data_shards;
+  for (unsigned int i = 0; i < data_chunk_count; i++) {
+    data_shards.insert(mapping.empty() ? shard_id_t(i) : mapping[i]);
+  }
+
+  shard_id_map<bufferptr> deltas(get_chunk_count());
+  unsigned int blocksize = 0;
+  for (const auto& [shard, ptr] : in) {
+    if (data_shards.contains(shard)) {
+      deltas[shard] = ptr;
+      blocksize = ptr.length();
+    }
+  }
+  if (blocksize == 0) {
+    return;
+  }
+
+  for (const Layer &layer : layers) {
+    shard_id_map<bufferptr> layer_in(get_chunk_count());
+    shard_id_map<bufferptr> layer_out(get_chunk_count());
+    shard_id_t j;
+    for (const auto& c : layer.data) {
+      if (deltas.contains(shard_id_t(c))) {
+        layer_in[j] = deltas[shard_id_t(c)];
+      }
+      ++j;
+    }
+    if (layer_in.empty()) {
+      continue;
+    }
+    for (const auto& c : layer.coding) {
+      bufferptr delta(buffer::create_aligned(blocksize, SIMD_ALIGN));
+      delta.zero();
+      layer_out[j] = delta;
+      deltas[shard_id_t(c)] = delta;
+      ++j;
+    }
+    layer.erasure_code->apply_delta(layer_in, layer_out);
+  }
+
+  for (auto&& [shard, ptr] : out) {
+    if (data_shards.contains(shard) || !deltas.contains(shard)) {
+      continue;
+    }
+    ceph_assert(ptr.length() == blocksize);
+    region_xor(deltas[shard], ptr);
+  }
+}
+
 IGNORE_DEPRECATED
 [[deprecated]]
 int ErasureCodeLrc::decode_chunks(const set<int> &want_to_read,
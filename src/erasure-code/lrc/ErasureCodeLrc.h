@@ -66,6 +66,7 @@ public:
   unsigned int data_chunk_count;
   std::string rule_root;
   std::string rule_device_class;
+  uint64_t flags;
   struct Step {
     Step(const std::string &_op, const std::string &_type, int _n) :
       op(_op),
@@ -79,7 +80,8 @@ public:
 
   explicit ErasureCodeLrc(const std::string &dir)
     : directory(dir),
-      chunk_count(0), data_chunk_count(0), rule_root("default")
+      chunk_count(0), data_chunk_count(0), rule_root("default"),
+      flags(0)
   {
     rule_steps.push_back(Step("chooseleaf", "host", 0));
   }
@@ -106,9 +108,7 @@ public:
 			     std::ostream *ss) const override;
 
   uint64_t get_supported_optimizations() const override {
-    return FLAG_EC_PLUGIN_PARTIAL_READ_OPTIMIZATION |
-      FLAG_EC_PLUGIN_PARTIAL_WRITE_OPTIMIZATION |
-      FLAG_EC_PLUGIN_ZERO_INPUT_ZERO_OUTPUT_OPTIMIZATION;
+    return flags;
   }
 
   unsigned int get_chunk_count() const override {
@@ -136,6 +136,12 @@ public:
                     shard_id_map<bufferptr> &in,
                     shard_id_map<bufferptr> &out) override;
 
+  void encode_delta(const bufferptr &old_data,
+                    const bufferptr &new_data,
+                    bufferptr *delta_maybe_in_place) override;
+  void apply_delta(const shard_id_map<bufferptr> &in,
+                   shard_id_map<bufferptr> &out) override;
+
   int init(ceph::ErasureCodeProfile &profile, std::ostream *ss) override;
 
   virtual int parse(ceph::ErasureCodeProfile &profile, std::ostream *ss);
@@ -11,6 +11,7 @@
 #include <optional>
 #include <string>
 #include <string_view>
+#include <vector>
 #include <boost/scoped_ptr.hpp>
 #include "include/encoding.h"
 #include "include/utime.h"
@@ -156,6 +157,19 @@ public:
       const std::string &end        ///< [in] The start bound of remove keys
       ) = 0;
 
+    /// Remove all keys in [start, end) with a single range tombstone,
+    /// without looking at how many keys the range holds.  Meant for ranges
+    /// known to be large, where per-key deletes would leave a tombstone
+    /// per key behind; backends without range tombstones fall back to
+    /// rm_range_keys().
+    virtual void rm_range_tombstone(
+      const std::string &prefix,    ///< [in] Prefix by which to remove keys
+      const std::string &start,     ///< [in] The start bound of remove keys
+      const std::string &end        ///< [in] The end bound of remove keys
+      ) {
+      rm_range_keys(prefix, start, end);
+    }
+
     /// Merge value into key
     virtual void merge(
       const std::string &prefix,   ///< [in] Prefix/CF ==> MUST match some established merge operator
@@ -221,6 +235,22 @@ public:
 		  ceph::buffer::list *value) {
     return get(prefix, std::string(key, keylen), value);
   }
+  /// Retrieve a batch of keys, each under its own prefix, in one call.
+  /// Backends that can look keys up in parallel override this; the
+  /// default falls back to one get() per key.
+  virtual int multi_get(
+    const std::vector<std::pair<std::string, std::string>> &keys, ///< [in] (prefix, key) pairs
+    std::vector<ceph::buffer::list> *values, ///< [out] values, in the order of keys
+    std::vector<int> *rs                     ///< [out] 0 or -ENOENT for each key
+    ) {
+    values->clear();
+    values->resize(keys.size());
+    rs->resize(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+      (*rs)[i] = get(keys[i].first, keys[i].second, &(*values)[i]);
+    }
+    return 0;
+  }
 
   // This superclass is used both by kv iterators *and* by the ObjectMap
   // omap iterator.  The class hierarchies are unfortunately tied together
@@ -91,6 +91,8 @@ static rocksdb::ConfigOptions make_config_options()
 static const char* sharding_def_dir = "sharding";
 static const char* sharding_def_file = "sharding/def";
 static const char* sharding_recreate = "sharding/recreate_columns";
+// column def of the layout an online reshard is migrating away from
+static const char* sharding_migrate_file = "sharding/migrate";
 static const char* resharding_column_lock = "reshardingXcommencingXlocked";
 
 
@@ -644,18 +646,22 @@ int RocksDBStore::load_rocksdb_options(bool create_if_missing, rocksdb::Options&
 }
 
 void RocksDBStore::add_column_family(const std::string& cf_name, uint32_t hash_l, uint32_t hash_h,
-				     size_t shard_idx, rocksdb::ColumnFamilyHandle *handle) {
+				     size_t shard_idx, rocksdb::ColumnFamilyHandle *handle,
+				     uint32_t gen) {
   dout(10) << __func__ << " column_name=" << cf_name << " shard_idx=" << shard_idx <<
-    " hash_l=" << hash_l << " hash_h=" << hash_h << " handle=" << (void*) handle << dendl;
+    " hash_l=" << hash_l << " hash_h=" << hash_h << " gen=" << gen <<
+    " handle=" << (void*) handle << dendl;
   bool exists = cf_handles.count(cf_name) > 0;
   auto& column = cf_handles[cf_name];
   if (exists) {
     ceph_assert(hash_l == column.hash_l);
     ceph_assert(hash_h == column.hash_h);
+    ceph_assert(gen == column.gen);
   } else {
     ceph_assert(hash_l < hash_h);
     column.hash_l = hash_l;
     column.hash_h = hash_h;
+    column.gen = gen;
   }
   if (column.handles.size() <= shard_idx)
     column.handles.resize(shard_idx + 1);
@@ -680,51 +686,188 @@ rocksdb::ColumnFamilyHandle *RocksDBStore::get_key_cf(const prefix_shards& shard
 }
 
 rocksdb::ColumnFamilyHandle *RocksDBStore::get_cf_handle(const std::string& prefix, const std::string& key) {
+  return get_cf_handle(prefix, key.data(), key.size());
+}
+
+rocksdb::ColumnFamilyHandle *RocksDBStore::get_cf_handle(const std::string& prefix, const char* key, size_t keylen) {
   auto iter = cf_handles.find(prefix);
   if (iter == cf_handles.end()) {
     return nullptr;
   } else {
-    if (iter->second.handles.size() == 1) {
-      return iter->second.handles[0];
+    const prefix_shards* shards = &iter->second;
+    if (auto m = get_migration(*shards); m) {
+      // being resharded online, new keys go to the new layout
+      shards = &m->to;
+    }
+    if (shards->handles.size() == 1) {
+      return shards->handles[0];
     } else {
-      return get_key_cf(iter->second, key.data(), key.size());
+      return get_key_cf(*shards, key, keylen);
     }
   }
 }
 
-rocksdb::ColumnFamilyHandle *RocksDBStore::get_cf_handle(const std::string& prefix, const char* key, size_t keylen) {
+rocksdb::ColumnFamilyHandle *RocksDBStore::get_reshard_source_cf(
+  const std::string& prefix, const char* key, size_t keylen)
+{
+  if (!reshard_active.load(std::memory_order_acquire)) {
+    return nullptr;
+  }
   auto iter = cf_handles.find(prefix);
   if (iter == cf_handles.end()) {
     return nullptr;
-  } else {
-    if (iter->second.handles.size() == 1) {
-      return iter->second.handles[0];
-    } else {
-      return get_key_cf(iter->second, key, keylen);
-    }
   }
+  auto m = get_migration(iter->second);
+  if (!m || m->done.load(std::memory_order_acquire)) {
+    return nullptr;
+  }
+  return get_key_cf(m->from, key, keylen);
+}
+
+std::vector<rocksdb::ColumnFamilyHandle *> RocksDBStore::get_prefix_handles(
+  const prefix_shards& shards) const
+{
+  auto m = get_migration(shards);
+  if (!m) {
+    return shards.handles;
+  }
+  auto handles = m->to.handles;
+  if (!m->done.load(std::memory_order_acquire)) {
+    handles.insert(handles.end(), m->from.handles.begin(), m->from.handles.end());
+  }
+  return handles;
 }
 
+/**
+ * Copies a batch, moving the ops on columns that are not part of the
+ * current layout of their prefix to the current one.  Such an op was
+ * resolved before a migration was published (it targets the old layout)
+ * or before one finished (it targets the dropped one, typically a delete
+ * of rm_reshard_source()).  Writes also delete the key from the layout
+ * still being drained, deletes remove it from every layout.
+ *
+ * Runs with reshard_lock held shared.
+ */
+struct RocksDBStore::ReshardBatchRewriter : public rocksdb::WriteBatch::Handler {
+  RocksDBStore& db;
+  rocksdb::WriteBatch out;
+  uint64_t rewritten = 0;
+
+  explicit ReshardBatchRewriter(RocksDBStore& db) : db(db) {}
+
+  /// the column if it is current, otherwise nullptr with @cur set to the
+  /// current layout and @src to the one being drained, if any
+  rocksdb::ColumnFamilyHandle *resolve(uint32_t id,
+				       const prefix_shards **cur,
+				       const prefix_shards **src) {
+    if (id == db.default_cf->GetID()) {
+      return db.default_cf;
+    }
+    auto p = db.cf_ids_to_prefix.find(id);
+    ceph_assert(p != db.cf_ids_to_prefix.end());
+    auto& shards = db.cf_handles.at(p->second);
+    *cur = &shards;
+    *src = nullptr;
+    if (auto m = db.get_migration(shards); m) {
+      *cur = &m->to;
+      if (!m->done.load(std::memory_order_acquire)) {
+	*src = &m->from;
+      }
+    }
+    for (auto h : (*cur)->handles) {
+      if (h->GetID() == id) {
+	return h;
+      }
+    }
+    ++rewritten;
+    return nullptr;
+  }
+  void rm_source(const prefix_shards *src, const rocksdb::Slice& key) {
+    if (src) {
+      out.Delete(db.get_key_cf(*src, key.data(), key.size()), key);
+    }
+  }
+
+  rocksdb::Status PutCF(uint32_t id, const rocksdb::Slice& key,
+			const rocksdb::Slice& value) override {
+    const prefix_shards *cur = nullptr, *src = nullptr;
+    auto cf = resolve(id, &cur, &src);
+    if (!cf) {
+      rm_source(src, key);
+      cf = db.get_key_cf(*cur, key.data(), key.size());
+    }
+    return out.Put(cf, key, value);
+  }
+  rocksdb::Status MergeCF(uint32_t id, const rocksdb::Slice& key,
+			  const rocksdb::Slice& value) override {
+    const prefix_shards *cur = nullptr, *src = nullptr;
+    auto cf = resolve(id, &cur, &src);
+    if (!cf) {
+      rm_source(src, key);
+      cf = db.get_key_cf(*cur, key.data(), key.size());
+    }
+    return out.Merge(cf, key, value);
+  }
+  rocksdb::Status DeleteCF(uint32_t id, const rocksdb::Slice& key) override {
+    const prefix_shards *cur = nullptr, *src = nullptr;
+    auto cf = resolve(id, &cur, &src);
+    if (!cf) {
+      rm_source(src, key);
+      cf = db.get_key_cf(*cur, key.data(), key.size());
+    }
+    return out.Delete(cf, key);
+  }
+  rocksdb::Status SingleDeleteCF(uint32_t id, const rocksdb::Slice& key) override {
+    const prefix_shards *cur = nullptr, *src = nullptr;
+    auto cf = resolve(id, &cur, &src);
+    if (!cf) {
+      // the key may have been written more than once in its new column
+      rm_source(src, key);
+      return out.Delete(db.get_key_cf(*cur, key.data(), key.size()), key);
+    }
+    return out.SingleDelete(cf, key);
+  }
+  rocksdb::Status DeleteRangeCF(uint32_t id, const rocksdb::Slice& begin,
+				const rocksdb::Slice& end) override {
+    const prefix_shards *cur = nullptr, *src = nullptr;
+    auto cf = resolve(id, &cur, &src);
+    if (cf) {
+      return out.DeleteRange(cf, begin, end);
+    }
+    for (auto h : cur->handles) {
+      out.DeleteRange(h, begin, end);
+    }
+    if (src) {
+      for (auto h : src->handles) {
+	out.DeleteRange(h, begin, end);
+      }
+    }
+    return rocksdb::Status::OK();
+  }
+  bool Continue() override {
+    return true;
+  }
+};
+
 /**
  * If the specified IteratorBounds arg has both an upper and a lower bound defined, and they have equal placement hash
  * strings, we can be sure that the entire iteration range exists in a single CF. In that case, we return the relevant
  * CF handle. In all other cases, we return a nullptr to indicate that the specified bounds cannot necessarily be mapped
  * to a single CF.
  */
-rocksdb::ColumnFamilyHandle *RocksDBStore::check_cf_handle_bounds(const cf_handles_iterator& iter, const IteratorBounds& bounds) {
+rocksdb::ColumnFamilyHandle *RocksDBStore::check_cf_handle_bounds(const prefix_shards& shards, const IteratorBounds& bounds) {
   if (!bounds.lower_bound || !bounds.upper_bound) {
     return nullptr;
   }
-  ceph_assert(iter != cf_handles.end());
-  ceph_assert(iter->second.handles.size() != 1);
-  if (iter->second.hash_l != 0) {
+  ceph_assert(shards.handles.size() != 1);
+  if (shards.hash_l != 0) {
     return nullptr;
   }
-  auto lower_bound_hash_str = get_key_hash_view(iter->second, bounds.lower_bound->data(), bounds.lower_bound->size());
-  auto upper_bound_hash_str = get_key_hash_view(iter->second, bounds.upper_bound->data(), bounds.upper_bound->size());
+  auto lower_bound_hash_str = get_key_hash_view(shards, bounds.lower_bound->data(), bounds.lower_bound->size());
+  auto upper_bound_hash_str = get_key_hash_view(shards, bounds.upper_bound->data(), bounds.upper_bound->size());
   if (lower_bound_hash_str == upper_bound_hash_str) {
     auto key = *bounds.lower_bound;
-    return get_key_cf(iter->second, key.data(), key.size());
+    return get_key_cf(shards, key.data(), key.size());
   } else {
     return nullptr;
   }
@@ -736,7 +879,11 @@ rocksdb::ColumnFamilyHandle *RocksDBStore::check_cf_handle_bounds(const cf_handl
  * column_def := column_name '(' shard_count ')'
  * column_def := column_name '(' shard_count ',' hash_begin '-' ')'
  * column_def := column_name '(' shard_count ',' hash_begin '-' hash_end ')'
+ * column_name := prefix [ '@' generation ]
  * I=write_buffer_size=1048576 O(6) m(7,10-) prefix(4,0-10)=disable_auto_compactions=true,max_bytes_for_level_base=1048576
+ *
+ * The generation is assigned by online resharding (reshard_online) so that
+ * the new columns of a prefix do not collide with the ones being drained.
  */
 bool RocksDBStore::parse_sharding_def(const std::string_view text_def_in,
 				     std::vector<ColumnFamily>& sharding_def,
@@ -762,6 +909,7 @@ bool RocksDBStore::parse_sharding_def(const std::string_view text_def_in,
     size_t shard_cnt = 1;
     uint32_t l_bound = 0;
     uint32_t h_bound = std::numeric_limits<uint32_t>::max();
+    uint32_t gen = 0;
 
     std::string_view column_def;
     size_t spos = text_def.find(' ');
@@ -819,22 +967,69 @@ bool RocksDBStore::parse_sharding_def(const std::string_view text_def_in,
     } else {
       name = column_def;
     }
-    sharding_def.emplace_back(std::string(name), shard_cnt, std::string(options), l_bound, h_bound);
+    if (size_t gpos = name.find('@'); gpos != std::string_view::npos) {
+      const char* nptr = &name[gpos + 1];
+      char* endptr;
+      gen = strtol(nptr, &endptr, 10);
+      if (nptr == endptr || endptr != name.data() + name.size()) {
+	*error_position = nptr;
+	*error_msg = "expecting integer";
+	break;
+      }
+      name = name.substr(0, gpos);
+    }
+    sharding_def.emplace_back(std::string(name), shard_cnt, std::string(options), l_bound, h_bound, gen);
   }
   return *error_position == nullptr;
 }
 
+// rocksdb name of shard @idx of a column: name[@gen][-idx]
+static std::string column_shard_name(const std::string& name, uint32_t gen,
+				     size_t shard_cnt, size_t idx)
+{
+  std::string cf_name = name;
+  if (gen > 0) {
+    cf_name += "@" + std::to_string(gen);
+  }
+  if (shard_cnt != 1) {
+    cf_name += "-" + std::to_string(idx);
+  }
+  return cf_name;
+}
+
+// reverse of column_shard_name(); returns the prefix
+static std::string split_column_name(const std::string& full_name,
+				     uint32_t* gen = nullptr,
+				     size_t* shard_idx = nullptr)
+{
+  size_t pos = full_name.find_first_of("@-");
+  if (gen) {
+    *gen = 0;
+  }
+  if (shard_idx) {
+    *shard_idx = 0;
+  }
+  if (pos == std::string::npos) {
+    return full_name;
+  }
+  size_t dpos = full_name.find('-', pos);
+  if (gen && full_name[pos] == '@') {
+    *gen = atoi(full_name.substr(pos + 1, dpos - pos - 1).c_str());
+  }
+  if (shard_idx && dpos != std::string::npos) {
+    *shard_idx = atoi(full_name.substr(dpos + 1).c_str());
+  }
+  return full_name.substr(0, pos);
+}
+
 void RocksDBStore::sharding_def_to_columns(const std::vector<ColumnFamily>& sharding_def,
 					  std::vector<std::string>& columns)
 {
   columns.clear();
   for (size_t i = 0; i < sharding_def.size(); i++) {
-    if (sharding_def[i].shard_cnt == 1) {
-	columns.push_back(sharding_def[i].name);
-    } else {
-      for (size_t j = 0; j < sharding_def[i].shard_cnt; j++) {
-	columns.push_back(sharding_def[i].name + "-" + std::to_string(j));
-      }
+    for (size_t j = 0; j < sharding_def[i].shard_cnt; j++) {
+      columns.push_back(column_shard_name(sharding_def[i].name, sharding_def[i].gen,
+					  sharding_def[i].shard_cnt, j));
     }
   }
 }
@@ -853,11 +1048,7 @@ int RocksDBStore::create_shards(const rocksdb::Options& opt,
       return r;
     }
     for (size_t idx = 0; idx < p.shard_cnt; idx++) {
-      std::string cf_name;
-      if (p.shard_cnt == 1)
-	cf_name = p.name;
-      else
-	cf_name = p.name + "-" + std::to_string(idx);
+      std::string cf_name = column_shard_name(p.name, p.gen, p.shard_cnt, idx);
       rocksdb::ColumnFamilyHandle *cf;
       status = db->CreateColumnFamily(cf_opt, cf_name, &cf);
       if (!status.ok()) {
@@ -866,7 +1057,7 @@ int RocksDBStore::create_shards(const rocksdb::Options& opt,
 	return -EINVAL;
       }
       // store the new CF handle
-      add_column_family(p.name, p.hash_l, p.hash_h, idx, cf);
+      add_column_family(p.name, p.hash_l, p.hash_h, idx, cf, p.gen);
     }
   }
   return 0;
@@ -1069,7 +1260,8 @@ int RocksDBStore::verify_sharding(const rocksdb::Options& opt,
 				  std::vector<rocksdb::ColumnFamilyDescriptor>& existing_cfs,
 				  std::vector<std::pair<size_t, RocksDBStore::ColumnFamily> >& existing_cfs_shard,
 				  std::vector<rocksdb::ColumnFamilyDescriptor>& missing_cfs,
-				  std::vector<std::pair<size_t, RocksDBStore::ColumnFamily> >& missing_cfs_shard)
+				  std::vector<std::pair<size_t, RocksDBStore::ColumnFamily> >& missing_cfs_shard,
+				  std::optional<ColumnFamily>& reshard_from)
 {
   rocksdb::Status status;
   std::string stored_sharding_text;
@@ -1094,6 +1286,31 @@ int RocksDBStore::verify_sharding(const rocksdb::Options& opt,
   std::sort(stored_sharding_def.begin(), stored_sharding_def.end(),
 	    [](ColumnFamily& a, ColumnFamily& b) { return a.name < b.name; } );
 
+  // an online reshard was interrupted; the marker only counts once the new
+  // layout of the prefix (next generation) has made it into sharding_def_file
+  reshard_from.reset();
+  if (opt.env->FileExists(sharding_migrate_file).ok()) {
+    std::string migrate_text;
+    std::vector<ColumnFamily> migrate_def;
+    status = rocksdb::ReadFileToString(opt.env, sharding_migrate_file, &migrate_text);
+    if (status.ok() &&
+	parse_sharding_def(migrate_text, migrate_def) &&
+	migrate_def.size() == 1) {
+      auto& from = migrate_def.front();
+      auto cur = std::find_if(stored_sharding_def.begin(), stored_sharding_def.end(),
+			      [&](const ColumnFamily& c) { return c.name == from.name; });
+      if (cur != stored_sharding_def.end() && cur->gen != from.gen) {
+	reshard_from = from;
+      }
+    }
+    if (reshard_from) {
+      dout(1) << __func__ << " online reshard in progress, from " << *reshard_from << dendl;
+    } else {
+      dout(1) << __func__ << " ignoring stale " << sharding_migrate_file
+	      << ": " << migrate_text << dendl;
+    }
+  }
+
   std::vector<string> rocksdb_cfs;
   status = rocksdb::DB::ListColumnFamilies(rocksdb::DBOptions(opt),
 					   path, &rocksdb_cfs);
@@ -1116,19 +1333,32 @@ int RocksDBStore::verify_sharding(const rocksdb::Options& opt,
     }
   };
 
+  if (reshard_from) {
+    // open whatever is left of the old layout; done first so that the
+    // block cache options of the new layout win
+    rocksdb::ColumnFamilyOptions cf_opt(opt);
+    int r = update_column_family_options(reshard_from->name, reshard_from->options, &cf_opt);
+    if (r != 0) {
+      return r;
+    }
+    for (size_t i = 0; i < reshard_from->shard_cnt; i++) {
+      std::string cf_name = column_shard_name(reshard_from->name, reshard_from->gen,
+					      reshard_from->shard_cnt, i);
+      if (std::find(rocksdb_cfs.begin(), rocksdb_cfs.end(), cf_name) != rocksdb_cfs.end()) {
+	existing_cfs.emplace_back(cf_name, cf_opt);
+	existing_cfs_shard.emplace_back(i, *reshard_from);
+      }
+    }
+  }
   for (auto& column : stored_sharding_def) {
     rocksdb::ColumnFamilyOptions cf_opt(opt);
     int r = update_column_family_options(column.name, column.options, &cf_opt);
     if (r != 0) {
       return r;
     }
-    if (column.shard_cnt == 1) {
-      emplace_cf(column, 0, column.name, cf_opt);
-    } else {
-      for (size_t i = 0; i < column.shard_cnt; i++) {
-	std::string cf_name = column.name + "-" + std::to_string(i);
-	emplace_cf(column, i, cf_name, cf_opt);
-      }
+    for (size_t i = 0; i < column.shard_cnt; i++) {
+      std::string cf_name = column_shard_name(column.name, column.gen, column.shard_cnt, i);
+      emplace_cf(column, i, cf_name, cf_opt);
     }
   }
   existing_cfs.emplace_back("default", opt);
@@ -1147,6 +1377,9 @@ std::ostream& operator<<(std::ostream& out, const RocksDBStore::ColumnFamily& cf
 {
   out << "(";
   out << cf.name;
+  if (cf.gen > 0) {
+    out << "@" << cf.gen;
+  }
   out << ",";
   out << cf.shard_cnt;
   out << ",";
@@ -1191,10 +1424,12 @@ int RocksDBStore::do_open(ostream &out,
     std::vector<std::pair<size_t, RocksDBStore::ColumnFamily> > existing_cfs_shard;
     std::vector<rocksdb::ColumnFamilyDescriptor> missing_cfs;
     std::vector<std::pair<size_t, RocksDBStore::ColumnFamily> > missing_cfs_shard;
+    std::optional<ColumnFamily> reshard_from;
 
     r = verify_sharding(opt,
 			existing_cfs, existing_cfs_shard,
-			missing_cfs, missing_cfs_shard);
+			missing_cfs, missing_cfs_shard,
+			reshard_from);
     if (r < 0) {
       return r;
     }
@@ -1203,6 +1438,12 @@ int RocksDBStore::do_open(ostream &out,
 				       sharding_recreate,
 				       &sharding_recreate_text);
     bool recreate_mode = status.ok() && sharding_recreate_text == "1";
+    // online reshard committed its new layout but did not get to create
+    // the columns for it
+    bool reshard_create_mode = reshard_from && !missing_cfs_shard.empty() &&
+      std::all_of(missing_cfs_shard.begin(), missing_cfs_shard.end(),
+		  [&](const auto& c) { return c.second.name == reshard_from->name; });
+    std::vector<std::pair<size_t, rocksdb::ColumnFamilyHandle*>> reshard_from_handles;
 
     ceph_assert(!recreate_mode || !open_readonly);
     if (recreate_mode == false && missing_cfs.size() != 0) {
@@ -1250,11 +1491,19 @@ int RocksDBStore::do_open(ostream &out,
       ceph_assert(handles.size() == existing_cfs.size());
       dout(10) << __func__ << " existing_cfs=" << existing_cfs.size() << dendl;
       for (size_t i = 0; i < existing_cfs_shard.size(); i++) {
-	add_column_family(existing_cfs_shard[i].second.name,
-			  existing_cfs_shard[i].second.hash_l,
-			  existing_cfs_shard[i].second.hash_h,
+	const auto& column = existing_cfs_shard[i].second;
+	if (reshard_from &&
+	    column.name == reshard_from->name &&
+	    column.gen == reshard_from->gen) {
+	  reshard_from_handles.emplace_back(existing_cfs_shard[i].first, handles[i]);
+	  continue;
+	}
+	add_column_family(column.name,
+			  column.hash_l,
+			  column.hash_h,
 			  existing_cfs_shard[i].first,
-			  handles[i]);
+			  handles[i],
+			  column.gen);
       }
       default_cf = handles[handles.size() - 1];
       must_close_default_cf = true;
@@ -1265,7 +1514,7 @@ int RocksDBStore::do_open(ostream &out,
 		       ) == missing_cfs.end())
 	{
 	dout(10) << __func__ << " missing_cfs=" << missing_cfs.size() << dendl;
-	ceph_assert(recreate_mode);
+	ceph_assert(recreate_mode || reshard_create_mode);
 	ceph_assert(missing_cfs.size() == missing_cfs_shard.size());
 	for (size_t i = 0; i < missing_cfs.size(); i++) {
 	  rocksdb::ColumnFamilyHandle *cf;
@@ -1279,9 +1528,18 @@ int RocksDBStore::do_open(ostream &out,
 			    missing_cfs_shard[i].second.hash_l,
 			    missing_cfs_shard[i].second.hash_h,
 			    missing_cfs_shard[i].first,
-			    cf);
+			    cf,
+			    missing_cfs_shard[i].second.gen);
+	}
+	if (recreate_mode) {
+	  opt.env->DeleteFile(sharding_recreate);
 	}
-	opt.env->DeleteFile(sharding_recreate);
+      }
+    }
+    if (reshard_from) {
+      r = reshard_resume(*reshard_from, reshard_from_handles, open_readonly);
+      if (r < 0) {
+	return r;
       }
     }
   }
@@ -1289,6 +1547,8 @@ int RocksDBStore::do_open(ostream &out,
   
   PerfCountersBuilder plb(cct, "rocksdb", l_rocksdb_first, l_rocksdb_last);
   plb.add_time_avg(l_rocksdb_get_latency, "get_latency", "Get latency", nullptr, PerfCountersBuilder::PRIO_USEFUL);
+  plb.add_time_avg(l_rocksdb_multi_get_latency, "multi_get_latency", "Multi-get latency");
+  plb.add_u64_avg(l_rocksdb_multi_get_keys, "multi_get_keys", "Keys per multi-get");
   plb.add_time_avg(l_rocksdb_submit_latency, "submit_latency", "Submit Latency");
   plb.add_time_avg(l_rocksdb_submit_sync_latency, "submit_sync_latency", "Submit Sync Latency");
   plb.add_u64_counter(l_rocksdb_compact, "compact", "Compactions");
@@ -1302,9 +1562,17 @@ int RocksDBStore::do_open(ostream &out,
   plb.add_time_avg(l_rocksdb_write_delay_time, "rocksdb_write_delay_time", "Rocksdb write delay time");
   plb.add_time_avg(l_rocksdb_write_pre_and_post_process_time, 
       "rocksdb_write_pre_and_post_time", "total time spent on writing a record, excluding write process");
+  plb.add_u64_counter(l_rocksdb_reshard_keys_moved, "reshard_keys_moved",
+		      "Keys moved by online resharding");
+  plb.add_u64_counter(l_rocksdb_reshard_bytes_moved, "reshard_bytes_moved",
+		      "Bytes moved by online resharding", nullptr, 0, unit_t(UNIT_BYTES));
   logger = plb.create_perf_counters();
   cct->get_perfcounters_collection()->add(logger);
 
+  if (!reshards.empty() && !reshards.back()->done && !open_readonly) {
+    reshard_thread.create("rocksdb_reshard");
+  }
+
   if (compact_on_mount) {
     derr << "Compacting rocksdb store..." << dendl;
     compact();
@@ -1346,6 +1614,7 @@ void RocksDBStore::close()
   } else {
     compact_queue_lock.unlock();
   }
+  reshard_stop_thread();
 
   if (logger) {
     cct->get_perfcounters_collection()->remove(logger);
@@ -1354,12 +1623,21 @@ void RocksDBStore::close()
   }
 
   // Ensure db is destroyed before dependent db_cache and filterpolicy
+  std::set<rocksdb::ColumnFamilyHandle*> handles;
   for (auto& p : cf_handles) {
-    for (size_t i = 0; i < p.second.handles.size(); i++) {
-      db->DestroyColumnFamilyHandle(p.second.handles[i]);
-    }
+    handles.insert(p.second.handles.begin(), p.second.handles.end());
+  }
+  for (auto& m : reshards) {
+    // both layouts of online reshards, dropped columns included
+    handles.insert(m->from.handles.begin(), m->from.handles.end());
+    handles.insert(m->to.handles.begin(), m->to.handles.end());
+  }
+  for (auto h : handles) {
+    db->DestroyColumnFamilyHandle(h);
   }
   cf_handles.clear();
+  reshards.clear();
+  reshard_active = false;
   if (must_close_default_cf) {
     db->DestroyColumnFamilyHandle(default_cf);
     must_close_default_cf = false;
@@ -1453,7 +1731,7 @@ int64_t RocksDBStore::estimate_prefix_size(const string& prefix,
   uint64_t size = 0;
   auto p_iter = cf_handles.find(prefix);
   if (p_iter != cf_handles.end()) {
-    for (auto cf : p_iter->second.handles) {
+    for (auto cf : get_prefix_handles(p_iter->second)) {
       uint64_t s = 0;
       string start = key_prefix + string(1, '\x00');
       string limit = key_prefix + string("\xff\xff\xff\xff");
@@ -1485,7 +1763,7 @@ int64_t RocksDBStore::estimate_range_size(
   uint64_t size = 0;
   auto p_iter = cf_handles.find(prefix);
   if (p_iter != cf_handles.end()) {
-    for (const auto cf : p_iter->second.handles) {
+    for (const auto cf : get_prefix_handles(p_iter->second)) {
       uint64_t s = 0;
       rocksdb::Range r(key_from, key_to);
       db->GetApproximateSizes(cf, &r, 1, &s, flags);
@@ -1516,8 +1794,8 @@ void RocksDBStore::get_statistics(Formatter *f)
   if (cct->_conf->rocksdb_collect_compaction_stats) {
     vector<rocksdb::ColumnFamilyHandle*> handles;
     handles.push_back(default_cf);
-    for (auto cf : cf_handles) {
-      for (auto shard_cf : cf.second.handles) {
+    for (auto& cf : cf_handles) {
+      for (auto shard_cf : get_prefix_handles(cf.second)) {
         handles.push_back(shard_cf);
       }
     }
@@ -1588,6 +1866,21 @@ int RocksDBStore::submit_common(rocksdb::WriteOptions& woptions, KeyValueDB::Tra
   RocksDBTransactionImpl * _t =
     static_cast<RocksDBTransactionImpl *>(t.get());
   woptions.disableWAL = disableWAL;
+  // keeps the layout from changing and the reshard thread from moving
+  // keys under this batch
+  std::shared_lock reshard_locker{reshard_lock};
+  if (uint64_t epoch = reshard_epoch.load(std::memory_order_acquire);
+      _t->reshard_epoch != epoch) {
+    // built (at least partly) against a layout an online reshard has
+    // replaced since; its columns may be gone by now
+    ReshardBatchRewriter rw(*this);
+    rocksdb::Status s = _t->bat.Iterate(&rw);
+    ceph_assert(s.ok());
+    dout(10) << __func__ << " re-resolved " << rw.rewritten << " of "
+	     << _t->bat.Count() << " ops for reshard epoch " << epoch << dendl;
+    _t->bat = std::move(rw.out);
+    _t->reshard_epoch = epoch;
+  }
   lgeneric_subdout(cct, rocksdb, 30) << __func__;
   RocksWBHandler bat_txc(*this, true);
   _t->bat.Iterate(&bat_txc);
@@ -1655,6 +1948,8 @@ int RocksDBStore::submit_transaction_sync(KeyValueDB::Transaction t)
 RocksDBStore::RocksDBTransactionImpl::RocksDBTransactionImpl(RocksDBStore *_db)
 {
   db = _db;
+  // read before any column is resolved, see submit_common()
+  reshard_epoch = db->reshard_epoch.load(std::memory_order_acquire);
 }
 
 void RocksDBStore::RocksDBTransactionImpl::put_bat(
@@ -1678,10 +1973,25 @@ void RocksDBStore::RocksDBTransactionImpl::put_bat(
   }
 }
 
+void RocksDBStore::RocksDBTransactionImpl::rm_reshard_source(
+  const string &prefix,
+  const char *k,
+  size_t keylen)
+{
+  // a key written or removed during an online reshard must not be
+  // shadowed by a stale copy left in the old layout. Called before the op
+  // itself: should the batch be re-resolved after the old layout is gone,
+  // this delete lands in the new layout and must not undo the op.
+  if (auto src = db->get_reshard_source_cf(prefix, k, keylen); src) {
+    bat.Delete(src, rocksdb::Slice(k, keylen));
+  }
+}
+
 string RocksDBStore::RocksDBTransactionImpl::get_summary_string(
   bool verbose) const
 {
   ceph_assert(db);
+  std::shared_lock l{db->reshard_lock};  // for cf_ids_to_prefix
   RocksWBHandler bat_txc(*db, verbose);
   bat.Iterate(&bat_txc);
   return bat_txc.get_seen();
@@ -1694,6 +2004,7 @@ void RocksDBStore::RocksDBTransactionImpl::set(
 {
   auto cf = db->get_cf_handle(prefix, k);
   if (cf) {
+    rm_reshard_source(prefix, k.data(), k.size());
     put_bat(bat, cf, k, to_set_bl);
   } else {
     string key = combine_strings(prefix, k);
@@ -1709,6 +2020,7 @@ void RocksDBStore::RocksDBTransactionImpl::set(
   auto cf = db->get_cf_handle(prefix, k, keylen);
   if (cf) {
     string key(k, keylen);  // fixme?
+    rm_reshard_source(prefix, k, keylen);
     put_bat(bat, cf, key, to_set_bl);
   } else {
     string key;
@@ -1722,6 +2034,7 @@ void RocksDBStore::RocksDBTransactionImpl::rmkey(const string &prefix,
 {
   auto cf = db->get_cf_handle(prefix, k);
   if (cf) {
+    rm_reshard_source(prefix, k.data(), k.size());
     bat.Delete(cf, rocksdb::Slice(k));
   } else {
     bat.Delete(db->default_cf, combine_strings(prefix, k));
@@ -1734,6 +2047,7 @@ void RocksDBStore::RocksDBTransactionImpl::rmkey(const string &prefix,
 {
   auto cf = db->get_cf_handle(prefix, k, keylen);
   if (cf) {
+    rm_reshard_source(prefix, k, keylen);
     bat.Delete(cf, rocksdb::Slice(k, keylen));
   } else {
     string key;
@@ -1747,6 +2061,7 @@ void RocksDBStore::RocksDBTransactionImpl::rm_single_key(const string &prefix,
 {
   auto cf = db->get_cf_handle(prefix, k);
   if (cf) {
+    rm_reshard_source(prefix, k.data(), k.size());
     bat.SingleDelete(cf, k);
   } else {
     bat.SingleDelete(db->default_cf, combine_strings(prefix, k));
@@ -1775,7 +2090,7 @@ void RocksDBStore::RocksDBTransactionImpl::rmkeys_by_prefix(const string &prefix
     }
   } else {
     ceph_assert(p_iter->second.handles.size() >= 1);
-    for (auto cf : p_iter->second.handles) {
+    for (auto cf : db->get_prefix_handles(p_iter->second)) {
       uint64_t cnt = db->get_delete_range_threshold();
       bat.SetSavePoint();
       auto it = db->new_shard_iterator(cf);
@@ -1827,7 +2142,7 @@ void RocksDBStore::RocksDBTransactionImpl::rm_range_keys(const string &prefix,
     }
   } else if (cnt == 0) {
     ceph_assert(p_iter->second.handles.size() >= 1);
-    for (auto cf : p_iter->second.handles) {
+    for (auto cf : db->get_prefix_handles(p_iter->second)) {
       ldout(db->cct, 10) << __func__ << " p_iter != end(), resorting to DeleteRange"
 			   << dendl;
 	bat.DeleteRange(cf, rocksdb::Slice(start), rocksdb::Slice(end));
@@ -1837,7 +2152,7 @@ void RocksDBStore::RocksDBTransactionImpl::rm_range_keys(const string &prefix,
     bounds.lower_bound = start;
     bounds.upper_bound = end;
     ceph_assert(p_iter->second.handles.size() >= 1);
-    for (auto cf : p_iter->second.handles) {
+    for (auto cf : db->get_prefix_handles(p_iter->second)) {
       cnt = db->get_delete_range_threshold();
       uint64_t cnt0 = cnt;
       bat.SetSavePoint();
@@ -1863,6 +2178,28 @@ void RocksDBStore::RocksDBTransactionImpl::rm_range_keys(const string &prefix,
   ldout(db->cct, 10) << __func__ << " end" << dendl;
 }
 
+void RocksDBStore::RocksDBTransactionImpl::rm_range_tombstone(
+  const string &prefix,
+  const string &start,
+  const string &end)
+{
+  ldout(db->cct, 10) << __func__
+                     << " prefix=" << prefix
+                     << " start=" << pretty_binary_string(start)
+		     << " end=" << pretty_binary_string(end) << dendl;
+  auto p_iter = db->cf_handles.find(prefix);
+  if (p_iter == db->cf_handles.end()) {
+    bat.DeleteRange(db->default_cf,
+		    rocksdb::Slice(combine_strings(prefix, start)),
+		    rocksdb::Slice(combine_strings(prefix, end)));
+  } else {
+    ceph_assert(p_iter->second.handles.size() >= 1);
+    for (auto cf : db->get_prefix_handles(p_iter->second)) {
+      bat.DeleteRange(cf, rocksdb::Slice(start), rocksdb::Slice(end));
+    }
+  }
+}
+
 void RocksDBStore::RocksDBTransactionImpl::merge(
   const string &prefix,
   const string &k,
@@ -1908,35 +2245,18 @@ int RocksDBStore::get(
     const std::set<string> &keys,
     std::map<string, bufferlist> *out)
 {
-  rocksdb::PinnableSlice value;
   utime_t start = ceph_clock_now();
-  if (cf_handles.count(prefix) > 0) {
-    for (auto& key : keys) {
-      auto cf_handle = get_cf_handle(prefix, key);
-      auto status = db->Get(rocksdb::ReadOptions(),
-			    cf_handle,
-			    rocksdb::Slice(key),
-			    &value);
-      if (status.ok()) {
-	(*out)[key].append(value.data(), value.size());
-      } else if (status.IsIOError()) {
-	ceph_abort_msg(status.getState());
-      }
-      value.Reset();
-    }
-  } else {
-    for (auto& key : keys) {
-      string k = combine_strings(prefix, key);
-      auto status = db->Get(rocksdb::ReadOptions(),
-			    default_cf,
-			    rocksdb::Slice(k),
-			    &value);
-      if (status.ok()) {
-	(*out)[key].append(value.data(), value.size());
-      } else if (status.IsIOError()) {
-	ceph_abort_msg(status.getState());
-      }
-      value.Reset();
+  std::vector<std::pair<string, string>> ks;
+  ks.reserve(keys.size());
+  for (auto& key : keys) {
+    ks.emplace_back(prefix, key);
+  }
+  std::vector<bufferlist> values;
+  std::vector<int> rs;
+  _multi_get(ks, &values, &rs);
+  for (size_t i = 0; i < ks.size(); ++i) {
+    if (rs[i] == 0) {
+      (*out)[ks[i].second] = std::move(values[i]);
     }
   }
   utime_t lat = ceph_clock_now() - start;
@@ -1944,6 +2264,102 @@ int RocksDBStore::get(
   return 0;
 }
 
+int RocksDBStore::multi_get(
+  const std::vector<std::pair<string, string>> &keys,
+  std::vector<bufferlist> *values,
+  std::vector<int> *rs)
+{
+  utime_t start = ceph_clock_now();
+  _multi_get(keys, values, rs);
+  utime_t lat = ceph_clock_now() - start;
+  logger->tinc_with_max(l_rocksdb_multi_get_latency, lat);
+  logger->inc(l_rocksdb_multi_get_keys, keys.size());
+  return 0;
+}
+
+void RocksDBStore::_multi_get(
+  const std::vector<std::pair<string, string>> &keys,
+  std::vector<bufferlist> *values,
+  std::vector<int> *rs)
+{
+  size_t n = keys.size();
+  values->clear();
+  values->resize(n);
+  rs->assign(n, -ENOENT);
+  if (n == 0) {
+    return;
+  }
+  std::vector<rocksdb::ColumnFamilyHandle*> cfs(n);
+  std::vector<rocksdb::Slice> slices(n);
+  // old layout columns of keys under online reshard, empty if none
+  std::vector<rocksdb::ColumnFamilyHandle*> srcs;
+  // backing store for keys that live in the default CF; reserved up front
+  // so the slices pointing into it stay valid
+  std::vector<string> combined;
+  combined.reserve(n);
+  for (size_t i = 0; i < n; ++i) {
+    auto& [prefix, key] = keys[i];
+    auto cf = get_cf_handle(prefix, key);
+    if (cf) {
+      cfs[i] = cf;
+      slices[i] = rocksdb::Slice(key);
+      if (auto src = get_reshard_source_cf(prefix, key.data(), key.size()); src) {
+	srcs.resize(n);
+	srcs[i] = src;
+      }
+    } else {
+      cfs[i] = default_cf;
+      combined.push_back(combine_strings(prefix, key));
+      slices[i] = rocksdb::Slice(combined.back());
+    }
+  }
+  rocksdb::ReadOptions ro;
+  ro.async_io = cct->_conf.get_val<bool>("rocksdb_multi_get_async_io");
+  auto lookup = [&](size_t cnt, rocksdb::ColumnFamilyHandle** c,
+		    rocksdb::Slice* k, const size_t* idx) {
+    std::vector<rocksdb::PinnableSlice> pvalues(cnt);
+    std::vector<rocksdb::Status> statuses(cnt);
+    db->MultiGet(ro, cnt, c, k, pvalues.data(), statuses.data());
+    for (size_t j = 0; j < cnt; ++j) {
+      size_t i = idx ? idx[j] : j;
+      if (statuses[j].ok()) {
+	(*values)[i].append(pvalues[j].data(), pvalues[j].size());
+	(*rs)[i] = 0;
+      } else if (!statuses[j].IsNotFound()) {
+	ceph_abort_msg(statuses[j].getState());
+      }
+    }
+  };
+  if (srcs.empty()) {
+    lookup(n, cfs.data(), slices.data(), nullptr);
+    return;
+  }
+  // look into the old layout first; a key missing there is either in
+  // the new one or does not exist
+  std::vector<size_t> idx;
+  std::vector<rocksdb::ColumnFamilyHandle*> c;
+  std::vector<rocksdb::Slice> k;
+  for (size_t i = 0; i < n; ++i) {
+    if (srcs[i]) {
+      idx.push_back(i);
+      c.push_back(srcs[i]);
+      k.push_back(slices[i]);
+    }
+  }
+  lookup(idx.size(), c.data(), k.data(), idx.data());
+  idx.clear();
+  c.clear();
+  k.clear();
+  for (size_t i = 0; i < n; ++i) {
+    if ((*rs)[i] != 0) {
+      idx.push_back(i);
+      c.push_back(cfs[i]);
+      k.push_back(slices[i]);
+    }
+  }
+  lookup(idx.size(), c.data(), k.data(), idx.data());
+}
+
 int RocksDBStore::get(
     const string &prefix,
     const string &key,
@@ -1956,10 +2372,17 @@ int RocksDBStore::get(
   rocksdb::Status s;
   auto cf = get_cf_handle(prefix, key);
   if (cf) {
-    s = db->Get(rocksdb::ReadOptions(),
-		cf,
-		rocksdb::Slice(key),
-		&value);
+    if (auto src = get_reshard_source_cf(prefix, key.data(), key.size()); src) {
+      s = db->Get(rocksdb::ReadOptions(), src, rocksdb::Slice(key), &value);
+      if (s.IsNotFound()) {
+	s = db->Get(rocksdb::ReadOptions(), cf, rocksdb::Slice(key), &value);
+      }
+    } else {
+      s = db->Get(rocksdb::ReadOptions(),
+		  cf,
+		  rocksdb::Slice(key),
+		  &value);
+    }
   } else {
     string k = combine_strings(prefix, key);
     s = db->Get(rocksdb::ReadOptions(),
@@ -1992,10 +2415,17 @@ int RocksDBStore::get(
   rocksdb::Status s;
   auto cf = get_cf_handle(prefix, key, keylen);
   if (cf) {
-    s = db->Get(rocksdb::ReadOptions(),
-		cf,
-		rocksdb::Slice(key, keylen),
-		&value);
+    if (auto src = get_reshard_source_cf(prefix, key, keylen); src) {
+      s = db->Get(rocksdb::ReadOptions(), src, rocksdb::Slice(key, keylen), &value);
+      if (s.IsNotFound()) {
+	s = db->Get(rocksdb::ReadOptions(), cf, rocksdb::Slice(key, keylen), &value);
+      }
+    } else {
+      s = db->Get(rocksdb::ReadOptions(),
+		  cf,
+		  rocksdb::Slice(key, keylen),
+		  &value);
+    }
   } else {
     string k;
     combine_strings(prefix, key, keylen, &k);
@@ -2374,8 +2804,8 @@ void RocksDBStore::compact()
   logger->inc(l_rocksdb_compact);
   rocksdb::CompactRangeOptions options;
   db->CompactRange(options, default_cf, nullptr, nullptr);
-  for (auto cf : cf_handles) {
-    for (auto shard_cf : cf.second.handles) {
+  for (auto& cf : cf_handles) {
+    for (auto shard_cf : get_prefix_handles(cf.second)) {
       db->CompactRange(
 	options,
 	shard_cf,
@@ -2483,7 +2913,7 @@ void RocksDBStore::compact_range(const string& start, const string& end)
 			    const std::string& end) {
     rocksdb::Slice cstart(start);
     rocksdb::Slice cend(end);
-    for (const auto& shard_it : column_it->second.handles) {
+    for (const auto& shard_it : get_prefix_handles(column_it->second)) {
       db->CompactRange(options, shard_it, &cstart, &cend);
     }
   };
@@ -3277,9 +3707,11 @@ public:
         options.iterate_upper_bound = &iterate_upper_bound;
       }
     }
-    for (auto& s : shards) {
-      iters.push_back(db->db->NewIterator(options, s));
-    }
+    // one consistent view over all shards; an online reshard moves keys
+    // between them atomically, so separate iterators could see a key in
+    // both or in neither
+    rocksdb::Status status = db->db->NewIterators(options, shards, &iters);
+    ceph_assert(status.ok());
   }
   ~ShardMergeIteratorImpl() {
     for (auto& it : iters) {
@@ -3463,11 +3895,23 @@ KeyValueDB::Iterator RocksDBStore::get_iterator(const std::string& prefix, Itera
 {
   auto cf_it = cf_handles.find(prefix);
   if (cf_it != cf_handles.end()) {
+    const prefix_shards* shards = &cf_it->second;
+    if (auto m = get_migration(*shards); m) {
+      if (!m->done.load(std::memory_order_acquire)) {
+	// online reshard in progress, keys may be in either layout
+	return std::make_shared<ShardMergeIteratorImpl>(
+	  this,
+	  prefix,
+	  get_prefix_handles(*shards),
+	  std::move(bounds));
+      }
+      shards = &m->to;
+    }
     rocksdb::ColumnFamilyHandle* cf = nullptr;
-    if (cf_it->second.handles.size() == 1) {
-      cf = cf_it->second.handles[0];
+    if (shards->handles.size() == 1) {
+      cf = shards->handles[0];
     } else if (cct->_conf->osd_rocksdb_iterator_bounds_enabled) {
-      cf = check_cf_handle_bounds(cf_it, bounds);
+      cf = check_cf_handle_bounds(*shards, bounds);
     }
     if (cf) {
       return std::make_shared<CFIteratorImpl>(
@@ -3479,7 +3923,7 @@ KeyValueDB::Iterator RocksDBStore::get_iterator(const std::string& prefix, Itera
       return std::make_shared<ShardMergeIteratorImpl>(
         this,
         prefix,
-        cf_it->second.handles,
+        shards->handles,
         std::move(bounds));
     }
   } else {
@@ -3593,13 +4037,8 @@ int RocksDBStore::prepare_for_reshard(const std::string& new_sharding,
 
   std::vector<rocksdb::ColumnFamilyDescriptor> cfs_to_open;
   for (const auto& full_name : existing_columns) {
-    //split col_name to <prefix>-<number>
-    std::string base_name;
-    size_t pos = full_name.find('-');
-    if (std::string::npos == pos)
-      base_name = full_name;
-    else
-      base_name = full_name.substr(0,pos);
+    //split col_name to <prefix>[@<gen>]-<number>
+    std::string base_name = split_column_name(full_name);
 
     rocksdb::ColumnFamilyOptions cf_opt(opt);
     // search if we have options for this column
@@ -3651,12 +4090,7 @@ int RocksDBStore::prepare_for_reshard(const std::string& new_sharding,
 
   //6. create missing columns
   for (const auto& full_name : missing_columns) {
-    std::string base_name;
-    size_t pos = full_name.find('-');
-    if (std::string::npos == pos)
-      base_name = full_name;
-    else
-      base_name = full_name.substr(0,pos);
+    std::string base_name = split_column_name(full_name);
 
     rocksdb::ColumnFamilyOptions cf_opt(opt);
     // search if we have options for this column
@@ -3687,16 +4121,10 @@ int RocksDBStore::prepare_for_reshard(const std::string& new_sharding,
   for (size_t i = 0; i < existing_columns.size(); i++) {
     std::string full_name = existing_columns[i];
     rocksdb::ColumnFamilyHandle *cf = handles[i];
-    std::string base_name;
+    uint32_t gen = 0;
     size_t shard_idx = 0;
-    size_t pos = full_name.find('-');
     dout(10) << "processing column " << full_name << dendl;
-    if (std::string::npos == pos) {
-      base_name = full_name;
-    } else {
-      base_name = full_name.substr(0,pos);
-      shard_idx = atoi(full_name.substr(pos+1).c_str());
-    }
+    std::string base_name = split_column_name(full_name, &gen, &shard_idx);
     if (rocksdb::kDefaultColumnFamilyName == base_name) {
       default_cf = handles[i];
       must_close_default_cf = true;
@@ -3705,9 +4133,9 @@ int RocksDBStore::prepare_for_reshard(const std::string& new_sharding,
       to_process_columns.emplace(full_name, std::move(ptr));
     } else {
       for (const auto& nsd : new_sharding_def) {
-	if (nsd.name == base_name) {
+	if (nsd.name == base_name && nsd.gen == gen) {
 	  if (shard_idx < nsd.shard_cnt) {
-	    add_column_family(base_name, nsd.hash_l, nsd.hash_h, shard_idx, cf);
+	    add_column_family(base_name, nsd.hash_l, nsd.hash_h, shard_idx, cf, gen);
 	  } else {
 	    //ignore columns with index larger then shard count
 	  }
@@ -3738,12 +4166,9 @@ int RocksDBStore::reshard_cleanup(const RocksDBStore::columns_t& current_columns
 {
   std::vector<std::string> new_sharding_columns;
   for (const auto& [name, handle] : cf_handles) {
-    if (handle.handles.size() == 1) {
-      new_sharding_columns.push_back(name);
-    } else {
-      for (size_t i = 0; i < handle.handles.size(); i++) {
-	new_sharding_columns.push_back(name + "-" + std::to_string(i));
-      }
+    for (size_t i = 0; i < handle.handles.size(); i++) {
+      new_sharding_columns.push_back(
+	column_shard_name(name, handle.gen, handle.handles.size(), i));
     }
   }
 
@@ -3889,7 +4314,7 @@ int RocksDBStore::reshard(const std::string& new_sharding, const RocksDBStore::r
       ceph_assert(handle.get() == default_cf);
       r = process_column(default_cf, std::string());
     } else {
-      std::string fixed_prefix = name.substr(0, name.find('-'));
+      std::string fixed_prefix = split_column_name(name);
       dout(10) << "Prefix: " << fixed_prefix << dendl;
       r = process_column(handle.get(), fixed_prefix);
     }
@@ -3918,10 +4343,448 @@ int RocksDBStore::reshard(const std::string& new_sharding, const RocksDBStore::r
     derr << __func__ << " cannot write to " << sharding_def_file << dendl;
     return -EIO;
   }
+  // all columns were redistributed, including leftovers of an
+  // interrupted online reshard
+  env->DeleteFile(sharding_migrate_file);
 
   return r;
 }
 
+int RocksDBStore::reshard_online(const std::string& column_def, std::ostream& out)
+{
+  std::vector<ColumnFamily> new_def;
+  char const* error_position = nullptr;
+  std::string error_msg;
+  if (column_def.find(' ') != std::string::npos ||
+      !parse_sharding_def(column_def, new_def, &error_position, &error_msg) ||
+      new_def.size() != 1) {
+    out << "expecting a single column definition, e.g. p(8,0-12)";
+    if (error_position) {
+      out << ": " << error_msg << " at offset " << error_position - column_def.data();
+    }
+    return -EINVAL;
+  }
+  ColumnFamily& to_def = new_def.front();
+  if (to_def.gen != 0 || column_def[to_def.name.size()] == '@') {
+    out << "column generation is assigned by the reshard itself";
+    return -EINVAL;
+  }
+  if (to_def.shard_cnt == 0 || to_def.hash_l >= to_def.hash_h) {
+    out << "invalid shard count or hash range";
+    return -EINVAL;
+  }
+  {
+    // A cache of its own would replace cf_bbt_opts[prefix] under the live
+    // readers of that map, and would never be registered with the
+    // priority cache manager, which picked up the old one at mount.
+    // The new columns keep the cache the prefix already has instead.
+    std::unordered_map<std::string, std::string> opt_map;
+    std::string block_cache_opt;
+    int r = split_column_family_options(to_def.options, &opt_map, &block_cache_opt);
+    if (r != 0) {
+      out << "invalid options for column " << to_def.name;
+      return r;
+    }
+    bool cache_opt = !block_cache_opt.empty();
+    for (const auto& [k, v] : opt_map) {
+      cache_opt = cache_opt || k.starts_with("block_cache") ||
+	k == "block_based_table_factory" || k == "table_factory";
+    }
+    if (cache_opt) {
+      out << "block cache options cannot be changed online, reshard "
+	  << to_def.name << " offline";
+      return -ENOTSUP;
+    }
+  }
+  for (const auto& [prefix, mop] : merge_ops) {
+    if (prefix == to_def.name) {
+      // a merge into the new layout cannot see a base value left in the old one
+      out << "prefix " << prefix << " has a merge operator, reshard it offline";
+      return -ENOTSUP;
+    }
+  }
+
+  std::lock_guard l(reshard_ctl_lock);
+  if (reshard_active) {
+    out << "online reshard of prefix " << reshards.back()->prefix << " in progress";
+    return -EBUSY;
+  }
+  if (reshard_thread.is_started()) {
+    // the previous migration is done, but may still be dropping its old
+    // columns and removing sharding_migrate_file
+    reshard_thread.join();
+  }
+  auto p = cf_handles.find(to_def.name);
+  if (p == cf_handles.end()) {
+    out << "prefix " << to_def.name << " has no column family of its own,"
+	<< " use ceph-bluestore-tool reshard to move it out of the default one";
+    return -ENOTSUP;
+  }
+  // current layout: either as opened, or the result of an earlier
+  // online reshard in this session
+  const prefix_shards* cur = &p->second;
+  if (auto prev = get_migration(p->second); prev) {
+    cur = &prev->to;
+  }
+
+  std::string stored_sharding;
+  if (!get_sharding(stored_sharding)) {
+    out << "cannot read " << sharding_def_file;
+    return -EIO;
+  }
+  std::vector<std::string> columns = get_str_vec(stored_sharding, " ");
+  std::optional<ColumnFamily> from_def;
+  size_t from_pos = 0;
+  for (; from_pos < columns.size(); from_pos++) {
+    std::vector<ColumnFamily> d;
+    if (parse_sharding_def(columns[from_pos], d) &&
+	d.size() == 1 && d.front().name == to_def.name) {
+      from_def = d.front();
+      break;
+    }
+  }
+  if (!from_def || from_def->gen != cur->gen) {
+    out << "prefix " << to_def.name << " not found in " << sharding_def_file;
+    return -EIO;
+  }
+  to_def.gen = from_def->gen + 1;
+  std::string from_column = columns[from_pos];
+  // carry the block cache of the old column over, so a reopen sets the
+  // new one up the same way
+  std::string to_column = column_def;
+  {
+    std::unordered_map<std::string, std::string> opt_map;
+    std::string block_cache_opt;
+    if (split_column_family_options(from_def->options, &opt_map, &block_cache_opt) == 0 &&
+	!block_cache_opt.empty()) {
+      to_column += to_def.options.empty() ? "=" : ";";
+      to_column += "block_cache={" + block_cache_opt + "}";
+    }
+  }
+  columns[from_pos] = to_def.name + "@" + std::to_string(to_def.gen) +
+    to_column.substr(to_def.name.size());
+  std::string new_sharding;
+  for (const auto& c : columns) {
+    if (!new_sharding.empty()) {
+      new_sharding += " ";
+    }
+    new_sharding += c;
+  }
+
+  // same base as create_shards(): default CF settings, block cache and
+  // merge operators
+  rocksdb::ColumnFamilyOptions cf_opt(db->GetOptions(default_cf));
+  int r = update_column_family_options(to_def.name, to_def.options, &cf_opt);
+  if (r != 0) {
+    out << "invalid options for column " << to_def.name;
+    return r;
+  }
+  if (auto c = cf_bbt_opts.find(to_def.name); c != cf_bbt_opts.end()) {
+    cf_opt.table_factory.reset(NewBlockBasedTableFactory(c->second));
+  }
+
+  auto m = std::make_unique<reshard_migration>(to_def.name, *from_def);
+  m->from = *cur;
+  m->from.migration.p = nullptr;
+  m->to.hash_l = to_def.hash_l;
+  m->to.hash_h = to_def.hash_h;
+  m->to.gen = to_def.gen;
+
+  // the old layout is recorded before the new one is committed, so that a
+  // reopen after any step finds its keys
+  env->CreateDir(sharding_def_dir);
+  if (!rocksdb::WriteStringToFile(env, from_column, sharding_migrate_file, true).ok()) {
+    out << "cannot write to " << sharding_migrate_file;
+    return -EIO;
+  }
+  if (!rocksdb::WriteStringToFile(env, new_sharding, sharding_def_file, true).ok()) {
+    env->DeleteFile(sharding_migrate_file);
+    out << "cannot write to " << sharding_def_file;
+    return -EIO;
+  }
+  for (size_t idx = 0; idx < to_def.shard_cnt; idx++) {
+    std::string cf_name = column_shard_name(to_def.name, to_def.gen, to_def.shard_cnt, idx);
+    rocksdb::ColumnFamilyHandle *cf;
+    rocksdb::Status status = db->CreateColumnFamily(cf_opt, cf_name, &cf);
+    if (!status.ok()) {
+      derr << __func__ << " Failed to create rocksdb column family: "
+	   << cf_name << dendl;
+      for (auto h : m->to.handles) {
+	db->DropColumnFamily(h);
+	db->DestroyColumnFamilyHandle(h);
+      }
+      rocksdb::WriteStringToFile(env, stored_sharding, sharding_def_file, true);
+      env->DeleteFile(sharding_migrate_file);
+      out << "cannot create column family " << cf_name << ": " << status.ToString();
+      return -EINVAL;
+    }
+    m->to.handles.push_back(cf);
+  }
+  m->started = ceph_clock_now();
+  dout(1) << __func__ << " prefix " << m->prefix << " from " << m->from_def
+	  << " to " << to_def << dendl;
+
+  {
+    // no submit is running while the layout changes; those that follow
+    // re-resolve what was built against the old one
+    std::unique_lock wl{reshard_lock};
+    for (auto h : m->to.handles) {
+      cf_ids_to_prefix.emplace(h->GetID(), to_def.name);
+    }
+    // whoever sees the migration must also add the source deletes
+    reshard_active = true;
+    p->second.migration.p.store(m.get(), std::memory_order_release);
+    reshard_epoch.fetch_add(1, std::memory_order_release);
+  }
+  reshards.push_back(std::move(m));
+  reshard_thread.create("rocksdb_reshard");
+  out << "resharding prefix " << to_def.name << " to "
+      << column_shard_name(to_def.name, to_def.gen, to_def.shard_cnt, 0)
+      << (to_def.shard_cnt > 1 ? "..." : "") << std::endl;
+  return 0;
+}
+
+int RocksDBStore::reshard_resume(
+  const ColumnFamily& from_def,
+  std::vector<std::pair<size_t, rocksdb::ColumnFamilyHandle*>>& from_handles,
+  bool open_readonly)
+{
+  auto p = cf_handles.find(from_def.name);
+  if (p == cf_handles.end()) {
+    derr << __func__ << " no columns for prefix " << from_def.name << dendl;
+    return -EIO;
+  }
+  if (from_handles.size() < from_def.shard_cnt) {
+    // interrupted while dropping the drained old layout
+    dout(1) << __func__ << " dropping remains of " << from_def << dendl;
+    for (auto& [idx, h] : from_handles) {
+      if (!open_readonly) {
+	db->DropColumnFamily(h);
+      }
+      db->DestroyColumnFamilyHandle(h);
+    }
+    if (!open_readonly) {
+      env->DeleteFile(sharding_migrate_file);
+    }
+    return 0;
+  }
+  auto m = std::make_unique<reshard_migration>(from_def.name, from_def);
+  m->from.hash_l = from_def.hash_l;
+  m->from.hash_h = from_def.hash_h;
+  m->from.gen = from_def.gen;
+  m->from.handles.resize(from_def.shard_cnt);
+  for (auto& [idx, h] : from_handles) {
+    m->from.handles[idx] = h;
+    cf_ids_to_prefix.emplace(h->GetID(), from_def.name);
+  }
+  m->to = p->second;
+  m->started = ceph_clock_now();
+  dout(1) << __func__ << " resuming reshard of prefix " << m->prefix
+	  << " from " << from_def << dendl;
+  reshard_active = true;
+  p->second.migration.p.store(m.get(), std::memory_order_release);
+  reshards.push_back(std::move(m));
+  return 0;
+}
+
+int RocksDBStore::reshard_move_batch(rocksdb::ColumnFamilyHandle *from,
+				     std::string *cursor,
+				     uint64_t *keys,
+				     bool *more)
+{
+  reshard_migration *m = reshards.back().get();
+  uint64_t max_keys = cct->_conf.get_val<uint64_t>("rocksdb_online_reshard_batch_keys");
+  uint64_t max_bytes = cct->_conf.get_val<Option::size_t>("rocksdb_online_reshard_batch_bytes");
+  uint64_t bytes = 0;
+  std::vector<std::string> batch_keys;
+
+  // scan without blocking submits
+  std::unique_ptr<rocksdb::Iterator> it{db->NewIterator(rocksdb::ReadOptions(), from)};
+  for (it->Seek(*cursor);
+       it->Valid() && batch_keys.size() < max_keys && bytes < max_bytes;
+       it->Next()) {
+    batch_keys.push_back(it->key().ToString());
+    bytes += it->key().size() + it->value().size();
+  }
+  if (!it->status().ok()) {
+    derr << __func__ << " iterator error: " << it->status().ToString() << dendl;
+    return -EIO;
+  }
+  *more = it->Valid();
+  if (*more) {
+    *cursor = it->key().ToString();
+  }
+  it.reset();
+  *keys = 0;
+  if (batch_keys.empty()) {
+    return 0;
+  }
+
+  // Every submit that touched one of these keys since the scan deleted it
+  // from the old layout, so whatever is still there is the latest version.
+  // Only the re-read and the move exclude submits, not the scan.
+  size_t n = batch_keys.size();
+  std::vector<rocksdb::Slice> slices(batch_keys.begin(), batch_keys.end());
+  std::vector<rocksdb::PinnableSlice> cur_values(n);
+  std::vector<rocksdb::Status> statuses(n);
+  rocksdb::WriteBatch bat;
+  bytes = 0;
+  std::unique_lock wl{reshard_lock};
+  db->MultiGet(rocksdb::ReadOptions(), from, n, slices.data(),
+	       cur_values.data(), statuses.data(), true);
+  for (size_t i = 0; i < n; ++i) {
+    if (statuses[i].IsNotFound()) {
+      continue;
+    }
+    if (!statuses[i].ok()) {
+      derr << __func__ << " read error: " << statuses[i].ToString() << dendl;
+      return -EIO;
+    }
+    const std::string& key = batch_keys[i];
+    bat.Put(get_key_cf(m->to, key.data(), key.size()), key, cur_values[i]);
+    bat.Delete(from, key);
+    bytes += key.size() + cur_values[i].size();
+    ++*keys;
+  }
+  if (*keys > 0) {
+    rocksdb::WriteOptions woptions;
+    woptions.disableWAL = disableWAL;
+    rocksdb::Status s = db->Write(woptions, &bat);
+    if (!s.ok()) {
+      derr << __func__ << " write error: " << s.ToString() << dendl;
+      return -EIO;
+    }
+  }
+  wl.unlock();
+
+  dout(20) << __func__ << " moved " << *keys << " of " << n << " keys" << dendl;
+  m->keys_moved += *keys;
+  m->bytes_moved += bytes;
+  logger->inc(l_rocksdb_reshard_keys_moved, *keys);
+  logger->inc(l_rocksdb_reshard_bytes_moved, bytes);
+  return 0;
+}
+
+int RocksDBStore::reshard_finish(reshard_migration *m)
+{
+  {
+    std::unique_lock wl{reshard_lock};
+    m->done = true;
+    reshard_active = false;
+    reshard_epoch.fetch_add(1, std::memory_order_release);
+  }
+  // readers still holding the old handles are fine, dropped columns stay
+  // readable until their handles are destroyed in close(); transactions
+  // that refer to them are re-resolved on submit
+  for (auto h : m->from.handles) {
+    rocksdb::Status status = db->DropColumnFamily(h);
+    if (!status.ok()) {
+      derr << __func__ << " cannot drop column " << h->GetName()
+	   << ": " << status.ToString() << dendl;
+      return -EIO;
+    }
+  }
+  env->DeleteFile(sharding_migrate_file);
+  dout(1) << __func__ << " prefix " << m->prefix << " moved "
+	  << m->keys_moved.load() << " keys, " << byte_u_t(m->bytes_moved.load())
+	  << " in " << m->passes.load() << " passes, "
+	  << ceph_clock_now() - m->started << dendl;
+  return 0;
+}
+
+void RocksDBStore::reshard_thread_entry()
+{
+  reshard_migration *m = reshards.back().get();
+  dout(10) << __func__ << " enter, prefix " << m->prefix << dendl;
+  auto stopping = [this] {
+    std::lock_guard l(reshard_thread_lock);
+    return reshard_stop;
+  };
+  while (true) {
+    uint64_t pass_keys = 0;
+    for (auto from : m->from.handles) {
+      std::string cursor;
+      bool more = true;
+      while (more) {
+	if (stopping()) {
+	  dout(1) << __func__ << " interrupted, prefix " << m->prefix
+		  << " continues on next open" << dendl;
+	  return;
+	}
+	auto start = ceph::mono_clock::now();
+	uint64_t keys = 0;
+	int r = reshard_move_batch(from, &cursor, &keys, &more);
+	if (r < 0) {
+	  derr << __func__ << " moving keys of prefix " << m->prefix
+	       << " failed: " << cpp_strerror(r) << dendl;
+	  return;
+	}
+	pass_keys += keys;
+	uint64_t rate = cct->_conf.get_val<uint64_t>("rocksdb_online_reshard_keys_per_sec");
+	if (rate > 0 && keys > 0) {
+	  auto wait = ceph::make_timespan(double(keys) / rate) -
+	    (ceph::mono_clock::now() - start);
+	  if (wait > ceph::timespan::zero()) {
+	    std::unique_lock l(reshard_thread_lock);
+	    reshard_cond.wait_for(l, wait, [this] { return reshard_stop; });
+	  }
+	}
+      }
+    }
+    ++m->passes;
+    dout(5) << __func__ << " prefix " << m->prefix << " pass " << m->passes.load()
+	    << " moved " << pass_keys << " keys" << dendl;
+    if (pass_keys == 0) {
+      break;
+    }
+    // nothing writes to the old layout any more (stale batches are
+    // re-resolved on submit), so this is a cheap check that the columns
+    // are empty before they are dropped, with the tombstones of this pass
+    // compacted away first
+    for (auto from : m->from.handles) {
+      db->CompactRange(rocksdb::CompactRangeOptions(), from, nullptr, nullptr);
+    }
+  }
+  reshard_finish(m);
+  dout(10) << __func__ << " exit" << dendl;
+}
+
+void RocksDBStore::reshard_stop_thread()
+{
+  std::lock_guard l(reshard_ctl_lock);
+  if (!reshard_thread.is_started()) {
+    return;
+  }
+  {
+    std::lock_guard l(reshard_thread_lock);
+    reshard_stop = true;
+    reshard_cond.notify_all();
+  }
+  dout(1) << __func__ << " waiting for reshard thread to stop" << dendl;
+  reshard_thread.join();
+  reshard_stop = false;
+}
+
+void RocksDBStore::dump_reshard_status(ceph::Formatter *f)
+{
+  std::lock_guard l(reshard_ctl_lock);
+  f->open_array_section("online_reshard");
+  for (const auto& m : reshards) {
+    f->open_object_section("migration");
+    f->dump_string("prefix", m->prefix);
+    f->dump_stream("from") << m->from_def;
+    f->dump_unsigned("to_gen", m->to.gen);
+    f->dump_unsigned("to_shards", m->to.handles.size());
+    f->dump_bool("done", m->done);
+    f->dump_unsigned("passes", m->passes);
+    f->dump_unsigned("keys_moved", m->keys_moved);
+    f->dump_unsigned("bytes_moved", m->bytes_moved);
+    f->dump_stream("started") << m->started;
+    f->close_section();
+  }
+  f->close_section();
+}
+
 bool RocksDBStore::get_sharding(std::string& sharding) {
   rocksdb::Status status;
   std::string stored_sharding_text;
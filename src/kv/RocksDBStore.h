@@ -14,6 +14,7 @@
 #include <map>
 #include <string>
 #include <memory>
+#include <atomic>
 #include <boost/scoped_ptr.hpp>
 #include "rocksdb/write_batch.h"
 #include "rocksdb/perf_context.h"
@@ -37,6 +38,8 @@
 enum {
   l_rocksdb_first = 34300,
   l_rocksdb_get_latency,
+  l_rocksdb_multi_get_latency,
+  l_rocksdb_multi_get_keys,
   l_rocksdb_submit_latency,
   l_rocksdb_submit_sync_latency,
   l_rocksdb_compact,
@@ -49,6 +52,8 @@ enum {
   l_rocksdb_write_memtable_time,
   l_rocksdb_write_delay_time,
   l_rocksdb_write_pre_and_post_process_time,
+  l_rocksdb_reshard_keys_moved,
+  l_rocksdb_reshard_bytes_moved,
   l_rocksdb_last,
 };
 
@@ -114,9 +119,11 @@ public:
     std::string options;   //< configure option string for this CF
     uint32_t hash_l;  //< first character to take for hash calc.
     uint32_t hash_h;  //< last character to take for hash calc.
+    uint32_t gen;     //< layout generation, bumped by each online reshard
     ColumnFamily(const std::string &name, size_t shard_cnt, const std::string &options,
-		 uint32_t hash_l, uint32_t hash_h)
-      : name(name), shard_cnt(shard_cnt), options(options), hash_l(hash_l), hash_h(hash_h) {}
+		 uint32_t hash_l, uint32_t hash_h, uint32_t gen = 0)
+      : name(name), shard_cnt(shard_cnt), options(options), hash_l(hash_l), hash_h(hash_h),
+	gen(gen) {}
   };
 
 private:
@@ -126,25 +133,115 @@ private:
   rocksdb::ColumnFamilyHandle *default_cf = nullptr;
   ceph::mutex backup_lock = ceph::make_mutex("RocksDBStore::Backup");
 
+  struct reshard_migration;
+
   /// column families in use, name->handles
   struct prefix_shards {
     uint32_t hash_l;  //< first character to take for hash calc.
     uint32_t hash_h;  //< last character to take for hash calc.
+    uint32_t gen = 0; //< layout generation of the handles
     std::vector<rocksdb::ColumnFamilyHandle *> handles;
+    /// set while the prefix is being moved to another layout online;
+    /// never cleared before close(), so readers need no lock
+    struct migration_ptr {
+      std::atomic<reshard_migration*> p = nullptr;
+      migration_ptr() = default;
+      migration_ptr(const migration_ptr& o) : p(o.p.load()) {}
+      migration_ptr& operator=(const migration_ptr& o) {
+	p = o.p.load();
+	return *this;
+      }
+    } migration;
+  };
+
+  /**
+   * Online reshard of a single column family backed prefix.
+   *
+   * The new layout gets a fresh generation of columns (name@gen[-idx]).
+   * From the moment the migration is published every write of the prefix
+   * goes to @to and deletes the key from @from; reads look into @from
+   * first and fall back to @to, iterators merge both.  The reshard thread
+   * moves the remaining keys over in throttled batches, serialized against
+   * transaction submits by reshard_lock, and drops the @from columns once
+   * a full pass finds nothing left to move.
+   *
+   * Transactions resolve their columns while they are built, so one built
+   * across a publish or a finish may refer to a layout that is no longer
+   * current; submit_common() spots those by reshard_epoch and re-resolves
+   * their ops against the current layout.
+   */
+  struct reshard_migration {
+    std::string prefix;
+    ColumnFamily from_def;      //< old layout, as stored in sharding_migrate_file
+    prefix_shards from;         //< old layout, drained by the reshard thread
+    prefix_shards to;           //< new layout, receives all writes
+    std::atomic<bool> done = false;  //< @from is empty (and dropped)
+    std::atomic<uint64_t> keys_moved = 0;
+    std::atomic<uint64_t> bytes_moved = 0;
+    std::atomic<uint32_t> passes = 0;
+    utime_t started;
+    reshard_migration(const std::string& prefix, const ColumnFamily& from_def)
+      : prefix(prefix), from_def(from_def) {}
   };
+  /// migrations since open, only the last one may still be running;
+  /// finished ones are kept as prefix_shards may point to them
+  std::vector<std::unique_ptr<reshard_migration>> reshards;
+  ceph::mutex reshard_ctl_lock =
+    ceph::make_mutex("RocksDBStore::reshard_ctl_lock");
+  /// a migration is running: writes and reads consult both layouts
+  std::atomic<bool> reshard_active = false;
+  /// bumped whenever the layout of a prefix changes, i.e. when a migration
+  /// is published and when it finishes
+  std::atomic<uint64_t> reshard_epoch = 0;
+  /// taken shared by every transaction submit, exclusive to publish or
+  /// finish a migration and to move each batch of keys; protects
+  /// cf_ids_to_prefix and keeps the layout stable during a submit
+  ceph::shared_mutex reshard_lock =
+    ceph::make_shared_mutex("RocksDBStore::reshard_lock");
+  struct ReshardBatchRewriter;
+  ceph::mutex reshard_thread_lock =
+    ceph::make_mutex("RocksDBStore::reshard_thread_lock");
+  ceph::condition_variable reshard_cond;
+  bool reshard_stop = false;
+  class ReshardThread : public Thread {
+    RocksDBStore *db;
+  public:
+    explicit ReshardThread(RocksDBStore *d) : db(d) {}
+    void *entry() override {
+      db->reshard_thread_entry();
+      return NULL;
+    }
+  } reshard_thread;
+  void reshard_thread_entry();
+  int reshard_move_batch(rocksdb::ColumnFamilyHandle *from, std::string *cursor,
+			 uint64_t *keys, bool *more);
+  int reshard_finish(reshard_migration *m);
+  void reshard_stop_thread();
+  int reshard_resume(const ColumnFamily& from_def,
+		     std::vector<std::pair<size_t, rocksdb::ColumnFamilyHandle*>>& from_handles,
+		     bool open_readonly);
+  reshard_migration *get_migration(const prefix_shards& shards) const {
+    return shards.migration.p.load(std::memory_order_acquire);
+  }
+  /// old-layout column a key may still live in, or nullptr
+  rocksdb::ColumnFamilyHandle *get_reshard_source_cf(const std::string& prefix,
+						     const char* key, size_t keylen);
+  /// every column that may hold keys of the prefix
+  std::vector<rocksdb::ColumnFamilyHandle *> get_prefix_handles(const prefix_shards& shards) const;
   std::unordered_map<std::string, prefix_shards> cf_handles;
   typedef decltype(cf_handles)::iterator cf_handles_iterator;
   std::unordered_map<uint32_t, std::string> cf_ids_to_prefix;
   std::unordered_map<std::string, rocksdb::BlockBasedTableOptions> cf_bbt_opts;
   
   void add_column_family(const std::string& cf_name, uint32_t hash_l, uint32_t hash_h,
-			 size_t shard_idx, rocksdb::ColumnFamilyHandle *handle);
+			 size_t shard_idx, rocksdb::ColumnFamilyHandle *handle,
+			 uint32_t gen = 0);
   bool is_column_family(const std::string& prefix);
   std::string_view get_key_hash_view(const prefix_shards& shards, const char* key, const size_t keylen);
   rocksdb::ColumnFamilyHandle *get_key_cf(const prefix_shards& shards, const char* key, const size_t keylen);
   rocksdb::ColumnFamilyHandle *get_cf_handle(const std::string& prefix, const std::string& key);
   rocksdb::ColumnFamilyHandle *get_cf_handle(const std::string& prefix, const char* key, size_t keylen);
-  rocksdb::ColumnFamilyHandle *check_cf_handle_bounds(const cf_handles_iterator& it, const IteratorBounds& bounds);
+  rocksdb::ColumnFamilyHandle *check_cf_handle_bounds(const prefix_shards& shards, const IteratorBounds& bounds);
 
   int submit_common(rocksdb::WriteOptions& woptions, KeyValueDB::Transaction t);
   int install_cf_mergeop(const std::string &cf_name, rocksdb::ColumnFamilyOptions *cf_opt);
@@ -173,7 +270,8 @@ private:
 		      std::vector<rocksdb::ColumnFamilyDescriptor>& existing_cfs,
 		      std::vector<std::pair<size_t, RocksDBStore::ColumnFamily> >& existing_cfs_shard,
 		      std::vector<rocksdb::ColumnFamilyDescriptor>& missing_cfs,
-		      std::vector<std::pair<size_t, RocksDBStore::ColumnFamily> >& missing_cfs_shard);
+		      std::vector<std::pair<size_t, RocksDBStore::ColumnFamily> >& missing_cfs_shard,
+		      std::optional<ColumnFamily>& reshard_from);
   std::shared_ptr<rocksdb::Cache> create_block_cache(
     const std::string& name,
     const std::string& cache_type, size_t cache_size, double cache_prio_high = 0.0);
@@ -278,6 +376,7 @@ public:
     dbstats(NULL),
     compact_queue_stop(false),
     compact_thread(this),
+    reshard_thread(this),
     compact_on_mount(false),
     disableWAL(false)
   {}
@@ -321,6 +420,8 @@ public:
   public:
     rocksdb::WriteBatch bat;
     RocksDBStore *db;
+    /// RocksDBStore::reshard_epoch when the columns were resolved
+    uint64_t reshard_epoch;
 
     explicit RocksDBTransactionImpl(RocksDBStore *_db);
   private:
@@ -329,6 +430,10 @@ public:
       rocksdb::ColumnFamilyHandle *cf,
       const std::string &k,
       const ceph::bufferlist &to_set_bl);
+    void rm_reshard_source(
+      const std::string &prefix,
+      const char *k,
+      size_t keylen);
 
   public:
     size_t get_count() const override {
@@ -364,6 +469,10 @@ public:
       const std::string &prefix,
       const std::string &start,
       const std::string &end) override;
+    void rm_range_tombstone(
+      const std::string &prefix,
+      const std::string &start,
+      const std::string &end) override;
     void merge(
       const std::string& prefix,
       const std::string& k,
@@ -391,6 +500,16 @@ public:
     const char *key,
     size_t keylen,
     ceph::bufferlist *out) override;
+  int multi_get(
+    const std::vector<std::pair<std::string, std::string>> &keys,
+    std::vector<ceph::bufferlist> *values,
+    std::vector<int> *rs) override;
+private:
+  void _multi_get(
+    const std::vector<std::pair<std::string, std::string>> &keys,
+    std::vector<ceph::bufferlist> *values,
+    std::vector<int> *rs);
+public:
 
 
   class RocksDBWholeSpaceIteratorImpl :
@@ -589,6 +708,11 @@ public:
     bool   unittest_fail_after_successful_processing = false;
   };
   int reshard(const std::string& new_sharding, const resharding_ctrl* ctrl = nullptr);
+  /// Move one column family backed prefix to the layout given by
+  /// @column_def (e.g. "p(8,0-12)=block_cache={type=binned_lru}") while
+  /// the store stays open; keys are migrated in the background.
+  int reshard_online(const std::string& column_def, std::ostream& out);
+  void dump_reshard_status(ceph::Formatter *f);
   bool get_sharding(std::string& sharding);
   void util_divide_key_range(
     const std::string& prefix,        // Table to operate on.
@@ -114,6 +114,8 @@ BinnedLRUCacheShard::BinnedLRUCacheShard(CephContext *c, size_t capacity, bool s
       strict_capacity_limit_(strict_capacity_limit),
       high_pri_pool_ratio_(high_pri_pool_ratio),
       high_pri_pool_capacity_(0),
+      probation_ratio_(0),
+      probation_usage_(0),
       usage_(0),
       lru_usage_(0),
       age_bins(1) {
@@ -122,6 +124,7 @@ BinnedLRUCacheShard::BinnedLRUCacheShard(CephContext *c, size_t capacity, bool s
   lru_.next = &lru_;
   lru_.prev = &lru_;
   lru_low_pri_ = &lru_;
+  lru_probation_ = &lru_;
   SetCapacity(capacity);
 }
 
@@ -202,12 +205,20 @@ size_t BinnedLRUCacheShard::GetHighPriPoolUsage() const {
   return high_pri_pool_usage_;
 }
 
+size_t BinnedLRUCacheShard::GetProbationUsage() const {
+  std::lock_guard<std::mutex> l(mutex_);
+  return probation_usage_;
+}
+
 void BinnedLRUCacheShard::LRU_Remove(BinnedLRUHandle* e) {
   ceph_assert(e->next != nullptr);
   ceph_assert(e->prev != nullptr);
   if (lru_low_pri_ == e) {
     lru_low_pri_ = e->prev;
   }
+  if (lru_probation_ == e) {
+    lru_probation_ = e->prev;
+  }
   e->next->prev = e->prev;
   e->prev->next = e->next;
   e->prev = e->next = nullptr;
@@ -215,6 +226,10 @@ void BinnedLRUCacheShard::LRU_Remove(BinnedLRUHandle* e) {
   if (e->InHighPriPool()) {
     ceph_assert(high_pri_pool_usage_ >= e->charge);
     high_pri_pool_usage_ -= e->charge;
+  } else if (e->InProbation()) {
+    ceph_assert(probation_usage_ >= e->charge);
+    probation_usage_ -= e->charge;
+    e->SetInProbation(false);
   } else {
     ceph_assert(*(e->age_bin) >= e->charge);
     *(e->age_bin) -= e->charge;
@@ -235,6 +250,22 @@ void BinnedLRUCacheShard::LRU_Insert(BinnedLRUHandle* e) {
     e->SetInHighPriPool(true);
     high_pri_pool_usage_ += e->charge;
     MaintainPoolSize();
+  } else if (probation_ratio_ > 0 && !e->HasHit()) {
+    // Insert "e" to the head of the probation segment. Entries on
+    // probation are not binned: until they are hit, they should not make
+    // the PriorityCache balancer grow the cache on their behalf.
+    e->next = lru_probation_->next;
+    e->prev = lru_probation_;
+    e->prev->next = e;
+    e->next->prev = e;
+    e->SetInHighPriPool(false);
+    e->SetInProbation(true);
+    if (lru_low_pri_ == lru_probation_) {
+      // the protected part of the low-pri pool is empty
+      lru_low_pri_ = e;
+    }
+    lru_probation_ = e;
+    probation_usage_ += e->charge;
   } else {
     // Insert "e" to the head of low-pri pool. Note that when
     // high_pri_pool_ratio is 0, head of low-pri pool is also head of LRU list.
@@ -247,6 +278,7 @@ void BinnedLRUCacheShard::LRU_Insert(BinnedLRUHandle* e) {
     *(e->age_bin) += e->charge;
   }
   lru_usage_ += e->charge;
+  MaintainProbationSize();
 }
 
 uint64_t BinnedLRUCacheShard::sum_bins(uint32_t start, uint32_t end) const {
@@ -274,6 +306,29 @@ void BinnedLRUCacheShard::MaintainPoolSize() {
   }
 }
 
+void BinnedLRUCacheShard::MaintainProbationSize() {
+  if (probation_ratio_ <= 0) {
+    return;
+  }
+  size_t low_pri_capacity =
+    capacity_ > high_pri_pool_usage_ ? capacity_ - high_pri_pool_usage_ : 0;
+  double protected_capacity = low_pri_capacity * (1.0 - probation_ratio_);
+  size_t low_pri_usage = lru_usage_ - high_pri_pool_usage_;
+  while (low_pri_usage - probation_usage_ > protected_capacity) {
+    // Demote the last protected entry: it becomes the head of the
+    // probation segment and needs another hit to be protected again.
+    ceph_assert(lru_probation_ != lru_low_pri_);
+    lru_probation_ = lru_probation_->next;
+    ceph_assert(lru_probation_ != &lru_);
+    ceph_assert(!lru_probation_->InHighPriPool());
+    lru_probation_->SetInProbation(true);
+    lru_probation_->ClearHit();
+    probation_usage_ += lru_probation_->charge;
+    ceph_assert(*(lru_probation_->age_bin) >= lru_probation_->charge);
+    *(lru_probation_->age_bin) -= lru_probation_->charge;
+  }
+}
+
 void BinnedLRUCacheShard::EvictFromLRU(size_t charge,
                                  BinnedLRUHandle*& deleted) {
 
@@ -311,6 +366,7 @@ void BinnedLRUCacheShard::SetCapacity(size_t capacity) {
     capacity_ = capacity;
     high_pri_pool_capacity_ = capacity_ * high_pri_pool_ratio_;
     EvictFromLRU(0, deleted);
+    MaintainProbationSize();
   }
   // we free the entries here outside of mutex for
   // performance reasons
@@ -322,13 +378,14 @@ ShardStats BinnedLRUCacheShard::GetStats() {
   stats[l_capacity] = capacity_;
   stats[l_usage] = usage_;
   stats[l_pinned] = usage_ - lru_usage_;
+  stats[l_probation] = probation_usage_;
   stats[l_misses] = stats[l_lookups] - stats[l_hits];
   return stats;
 }
 
 void BinnedLRUCacheShard::ClearStats() {
   std::lock_guard<std::mutex> l(mutex_);
-  for (int i = l_inserts; i <= l_misses; i++) {
+  for (int i = l_inserts; i < stat_cnt; i++) {
     stats[i] = 0;
   }
 }
@@ -353,11 +410,19 @@ rocksdb::Cache::Handle* BinnedLRUCacheShard::Lookup(const rocksdb::Slice& key, u
   if (e != nullptr) {
     ceph_assert(e->InCache());
     if (e->refs == 1) {
+      if (e->InProbation()) {
+        stats[l_promotions]++;
+      }
       LRU_Remove(e);
     }
     e->refs++;
     e->SetHit();
     stats[l_hits]++;
+    if (e->IsHighPri()) {
+      stats[l_hipri_hits]++;
+    } else {
+      stats[l_lopri_hits]++;
+    }
   }
   return e;
 }
@@ -377,6 +442,13 @@ void BinnedLRUCacheShard::SetHighPriPoolRatio(double high_pri_pool_ratio) {
   high_pri_pool_ratio_ = high_pri_pool_ratio;
   high_pri_pool_capacity_ = capacity_ * high_pri_pool_ratio_;
   MaintainPoolSize();
+  MaintainProbationSize();
+}
+
+void BinnedLRUCacheShard::SetProbationRatio(double probation_ratio) {
+  std::lock_guard<std::mutex> l(mutex_);
+  probation_ratio_ = probation_ratio;
+  MaintainProbationSize();
 }
 
 bool BinnedLRUCacheShard::Release(rocksdb::Cache::Handle* handle, bool force_erase) {
@@ -447,6 +519,9 @@ rocksdb::Status BinnedLRUCacheShard::Insert(const rocksdb::Slice& key, uint32_t
     std::lock_guard<std::mutex> l(mutex_);
     stats[l_elems]++;
     stats[l_inserts]++;
+    if (priority == rocksdb::Cache::Priority::HIGH) {
+      stats[l_hipri_inserts]++;
+    }
     // Free the space following strict LRU policy until enough space
     // is freed or the lru list is empty
     EvictFromLRU(charge, deleted);
@@ -609,8 +684,10 @@ std::string BinnedLRUCacheShard::GetPrintableOptions() const {
   char buffer[kBufferSize];
   {
     std::lock_guard<std::mutex> l(mutex_);
-    snprintf(buffer, kBufferSize, "    high_pri_pool_ratio: %.3lf\n",
-             high_pri_pool_ratio_);
+    snprintf(buffer, kBufferSize,
+             "    high_pri_pool_ratio: %.3lf\n"
+             "    probation_ratio: %.3lf\n",
+             high_pri_pool_ratio_, probation_ratio_);
   }
   return std::string(buffer);
 }
@@ -667,14 +744,14 @@ public:
       if (!ceph::common::cmd_getval(cmdmap, "shard_no", shard_no)) {
         outstr << fmt::format("{:>5}", "shard");
         for (int j = 0; j < stat_cnt; j++) {
-          outstr << fmt::format("{:>10}", ShardStats::stat_name[j]);
+          outstr << fmt::format("{:>11}", ShardStats::stat_name[j]);
         }
         outstr << std::endl;
         for (int i = 0; i < cache.num_shards_; i++) {
           outstr << fmt::format("{:>5}", i);
           ShardStats s = cache.shards_[i].GetStats();
           for (int j = 0; j < stat_cnt; j++) {
-            outstr << fmt::format("{:>10}", s[j]);
+            outstr << fmt::format("{:>11}", s[j]);
           }
           outstr << std::endl;
         }
@@ -721,6 +798,7 @@ BinnedLRUCache::BinnedLRUCache(
     new (&shards_[i])
         BinnedLRUCacheShard(c, per_shard, strict_capacity_limit, high_pri_pool_ratio);
   }
+  SetProbationRatio(cct->_conf.get_val<double>("rocksdb_cache_probation_ratio"));
   SetupPerfCounters();
   asok_hook = new SocketHook(*this);
 }
@@ -730,7 +808,7 @@ void BinnedLRUCache::SetupPerfCounters()
   int l_first = 0;
   int l_last = l_first + 1 + stat_cnt;
   PerfCountersBuilder b(cct, std::string("rocksdb-cache-") + name, l_first, l_last);
-  for (uint32_t j = l_capacity; j <= l_misses; j++) {
+  for (uint32_t j = l_capacity; j < stat_cnt; j++) {
     b.add_u64(1 + j, ShardStats::stat_name[j], ShardStats::stat_descr[j],
       nullptr, PerfCountersBuilder::PRIO_USEFUL);
   }
@@ -811,6 +889,12 @@ void BinnedLRUCache::SetHighPriPoolRatio(double high_pri_pool_ratio) {
   }
 }
 
+void BinnedLRUCache::SetProbationRatio(double probation_ratio) {
+  for (int i = 0; i < num_shards_; i++) {
+    shards_[i].SetProbationRatio(probation_ratio);
+  }
+}
+
 double BinnedLRUCache::GetHighPriPoolRatio() const {
   double result = 0.0;
   if (num_shards_ > 0) {
@@ -898,13 +982,13 @@ void BinnedLRUCache::UpdatePerfCounters() {
     stats.add(s);
   }
   //set these
-  for (int j = l_capacity ; j <= l_elems; j++) {
+  for (int j = l_capacity ; j <= l_probation; j++) {
     perfstats->set(1 + j, stats[j]);
   }
   //increment these, so one can reset perf counters
   ShardStats tmp = stats;
   tmp.sub(prev_stats);
-  for (int j = l_inserts; j <= l_misses; j++) {
+  for (int j = l_inserts; j < stat_cnt; j++) {
     perfstats->inc(1 + j, tmp[j]);
   }
   prev_stats = stats;
@@ -75,6 +75,9 @@ struct BinnedLRUHandle : public rocksdb::Cache::Handle {
   //   in_cache:    whether this entry is referenced by the hash table.
   //   is_high_pri: whether this entry is high priority entry.
   //   in_high_pri_pool: whether this entry is in high-pri pool.
+  //   has_hit:     whether this entry was looked up since its insertion
+  //                or its last demotion to probation.
+  //   in_probation: whether this entry is in the probation segment.
   char flags;
 
   uint32_t hash;     // Hash of key(); used for fast sharding and comparisons
@@ -95,6 +98,7 @@ struct BinnedLRUHandle : public rocksdb::Cache::Handle {
   bool IsHighPri() { return flags & 2; }
   bool InHighPriPool() { return flags & 4; }
   bool HasHit() { return flags & 8; }
+  bool InProbation() { return flags & 16; }
 
   void SetInCache(bool in_cache) {
     if (in_cache) {
@@ -121,6 +125,15 @@ struct BinnedLRUHandle : public rocksdb::Cache::Handle {
   }
 
   void SetHit() { flags |= 8; }
+  void ClearHit() { flags &= ~8; }
+
+  void SetInProbation(bool in_probation) {
+    if (in_probation) {
+      flags |= 16;
+    } else {
+      flags &= ~16;
+    }
+  }
 
   void Free() {
     ceph_assert((refs == 1 && InCache()) || (refs == 0 && !InCache()));
@@ -179,10 +192,15 @@ enum stat_e : int {
   l_usage,        // current usage of the shard
   l_pinned,       // size in elements currently referenced
   l_elems,        // count of separate items in shard
+  l_probation,    // size of entries in the probation segment
   l_inserts,      // increased when element inserted into the cache
   l_lookups,      // increased when trying to find element in shard
   l_hits,         // increased when lookup successful
   l_misses,       // calculated from lookups - hits
+  l_hipri_inserts, // inserts with high priority (a miss on a high pri entry)
+  l_hipri_hits,   // successful lookups of high priority entries
+  l_lopri_hits,   // successful lookups of low priority entries
+  l_promotions,   // entries moved out of probation by a hit
   stat_cnt
 };
 
@@ -197,20 +215,30 @@ struct ShardStats {
     "usage",
     "pinned",
     "elems",
+    "probation",
     "inserts",
     "lookups",
     "hits",
     "misses",
+    "hipri_ins",
+    "hipri_hits",
+    "lopri_hits",
+    "promotions",
   };
   static constexpr char const* stat_descr[stat_cnt] = {
     "capacity assigned",
     "current usage",
     "currently pinned size (in use)",
     "number of elems in shard",
+    "size of entries on probation",
     "inserts into shard",
     "lookups for an element",
     "lookup successful",
     "lookup failure",
+    "inserts of high priority elements",
+    "lookup of a high priority element successful",
+    "lookup of a low priority element successful",
+    "elements promoted out of probation",
   };
   void add(const ShardStats& other) {
     for (int j = 0; j < stat_cnt; j++) {
@@ -242,6 +270,10 @@ class alignas(CACHE_LINE_SIZE) BinnedLRUCacheShard : public CacheShard {
   // Set percentage of capacity reserved for high-pri cache entries.
   void SetHighPriPoolRatio(double high_pri_pool_ratio);
 
+  // Set the share of the low-pri pool kept for entries on probation.
+  // 0 disables the probation segment.
+  void SetProbationRatio(double probation_ratio);
+
   // Like Cache methods, but with an extra "hash" parameter.
   virtual rocksdb::Status Insert(const rocksdb::Slice& key, uint32_t hash,
                         rocksdb::Cache::ObjectPtr value,
@@ -295,6 +327,9 @@ class alignas(CACHE_LINE_SIZE) BinnedLRUCacheShard : public CacheShard {
   // Retrieves high pri pool usage
   size_t GetHighPriPoolUsage() const;
 
+  // Retrieves probation segment usage
+  size_t GetProbationUsage() const;
+
   // Rotate the bins
   void shift_bins();
 
@@ -320,6 +355,10 @@ class alignas(CACHE_LINE_SIZE) BinnedLRUCacheShard : public CacheShard {
   // high-pri pool is no larger than the size specify by high_pri_pool_pct.
   void MaintainPoolSize();
 
+  // Demote the last entries of the protected low-pri segment to the head of
+  // the probation segment until the protected segment fits in its share.
+  void MaintainProbationSize();
+
   // Just reduce the reference count by 1.
   // Return true if last reference
   bool Unref(BinnedLRUHandle* e);
@@ -356,6 +395,19 @@ class alignas(CACHE_LINE_SIZE) BinnedLRUCacheShard : public CacheShard {
   // Pointer to head of low-pri pool in LRU list.
   BinnedLRUHandle* lru_low_pri_;
 
+  // Pointer to head of probation segment in LRU list. The probation
+  // segment is the oldest part of the low-pri pool: low-pri entries that
+  // have not been hit since insertion start there, and are evicted before
+  // anything that has been hit, so that a scan cannot flush the working
+  // set. A hit moves the entry to the head of the low-pri pool.
+  BinnedLRUHandle* lru_probation_;
+
+  // Share of the low-pri pool kept for the probation segment.
+  double probation_ratio_;
+
+  // Memory size for entries in probation segment.
+  size_t probation_usage_;
+
   // Info about the shard
   ShardStats stats;
   // ------------^^^^^^^^^^^^^-----------
@@ -415,6 +467,8 @@ class BinnedLRUCache : public ShardedCache {
   size_t TEST_GetLRUSize();
   // Sets the high pri pool ratio
   void SetHighPriPoolRatio(double high_pri_pool_ratio);
+  // Sets the probation ratio
+  void SetProbationRatio(double probation_ratio);
   //  Retrieves high pri pool ratio
   double GetHighPriPoolRatio() const;
   // Retrieves high pri pool usage
@@ -983,6 +983,7 @@ ceph_add_osd_perf_query(BaseMgrModule *self, PyObject *args)
     {"latency", PerformanceCounterType::LATENCY},
     {"write_latency", PerformanceCounterType::WRITE_LATENCY},
     {"read_latency", PerformanceCounterType::READ_LATENCY},
+    {"cpu_time", PerformanceCounterType::CPU_TIME},
   };
 
   PyObject *py_query = nullptr;
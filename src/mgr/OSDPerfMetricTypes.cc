@@ -55,6 +55,7 @@ void PerformanceCounterDescriptor::pack_counter(const PerformanceCounter &c,
   case PerformanceCounterType::LATENCY:
   case PerformanceCounterType::WRITE_LATENCY:
   case PerformanceCounterType::READ_LATENCY:
+  case PerformanceCounterType::CPU_TIME:
     encode(c.second, *bl);
     break;
   default:
@@ -77,6 +78,7 @@ void PerformanceCounterDescriptor::unpack_counter(
   case PerformanceCounterType::LATENCY:
   case PerformanceCounterType::WRITE_LATENCY:
   case PerformanceCounterType::READ_LATENCY:
+  case PerformanceCounterType::CPU_TIME:
     decode(c->second, bl);
     break;
   default:
@@ -105,6 +107,8 @@ std::ostream& operator<<(std::ostream& os,
     return os << "write latency";
   case PerformanceCounterType::READ_LATENCY:
     return os << "read latency";
+  case PerformanceCounterType::CPU_TIME:
+    return os << "cpu time";
   default:
     return os << "unknown (" << static_cast<int>(d.type) << ")";
   }
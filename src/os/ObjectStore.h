@@ -491,6 +491,43 @@ public:
      ceph::buffer::list& bl,
      uint32_t op_flags = 0) = 0;
 
+  /// one read of a read_batch() call
+  struct read_op_t {
+    ghobject_t oid;
+    uint64_t offset = 0;
+    size_t len = 0;
+    ceph::buffer::list bl;  ///< [out] data read
+    int r = 0;              ///< [out] bytes read or negative error code
+
+    read_op_t() = default;
+    read_op_t(const ghobject_t& o, uint64_t off, size_t l)
+      : oid(o), offset(off), len(l) {}
+  };
+
+  /**
+   * read_batch -- read from several objects of a collection at once
+   *
+   * Each op is handled as by read(), with its result in op.r and op.bl.
+   * Backends may look up all objects under a single collection lock
+   * and submit the device I/O of all ops together; the default version
+   * reads them one by one.
+   *
+   * @param c collection
+   * @param ops reads to perform, results are filled in place
+   * @param op_flags is CEPH_OSD_OP_FLAG_*, applied to every op
+   * @returns 0 on success, or negative error code if the whole batch failed.
+   */
+  virtual int read_batch(
+    CollectionHandle &c,
+    std::vector<read_op_t>& ops,
+    uint32_t op_flags = 0) {
+    for (auto& op : ops) {
+      op.bl.clear();
+      op.r = read(c, op.oid, op.offset, op.len, op.bl, op_flags);
+    }
+    return 0;
+  }
+
   /**
    * fiemap -- get extent std::map of data of an object
    *
@@ -52,14 +52,24 @@ Allocator *Allocator::create(
   } else if (type == "btree") {
     return new BtreeAllocator(cct, size, block_size, name);
   } else if (type == "hybrid") {
-    return new HybridAvlAllocator(cct, size, block_size,
+    auto a = new HybridAvlAllocator(cct, size, block_size,
       cct->_conf.get_val<uint64_t>("bluestore_hybrid_alloc_mem_cap"),
       name);
+    a->enable_cpu_cache(
+      cct->_conf.get_val<uint64_t>("bluestore_alloc_cpu_cache_shards"),
+      cct->_conf.get_val<Option::size_t>("bluestore_alloc_cpu_cache_max_alloc"),
+      cct->_conf.get_val<Option::size_t>("bluestore_alloc_cpu_cache_refill"));
+    return a;
   }  else if (type == "hybrid_btree2") {
-    return new HybridBtree2Allocator(cct, size, block_size,
+    auto a = new HybridBtree2Allocator(cct, size, block_size,
       cct->_conf.get_val<uint64_t>("bluestore_hybrid_alloc_mem_cap"),
       cct->_conf.get_val<double>("bluestore_btree2_alloc_weight_factor"),
       name);
+    a->enable_cpu_cache(
+      cct->_conf.get_val<uint64_t>("bluestore_alloc_cpu_cache_shards"),
+      cct->_conf.get_val<Option::size_t>("bluestore_alloc_cpu_cache_max_alloc"),
+      cct->_conf.get_val<Option::size_t>("bluestore_alloc_cpu_cache_refill"));
+    return a;
   }
   if (alloc == nullptr) {
     lderr(cct) << "Allocator::" << __func__ << " unknown alloc type "
@@ -228,6 +228,18 @@ void AllocatorPerf::_init_logger(std::string_view name) {
     "Allocator lockless fast-path allocation latency",
     "fpl",
     PerfCountersBuilder::PRIO_USEFUL);
+  b.add_u64_counter(l_bluestore_allocator_cpu_cache_hit,
+    "cpu_cache_hit",
+    "Allocations served from per-CPU extent caches");
+  b.add_u64_counter(l_bluestore_allocator_cpu_cache_miss,
+    "cpu_cache_miss",
+    "Eligible allocations that bypassed per-CPU extent caches");
+  b.add_u64_counter(l_bluestore_allocator_cpu_cache_refill,
+    "cpu_cache_refill",
+    "Per-CPU extent cache refills from the allocator");
+  b.add_u64_counter(l_bluestore_allocator_cpu_cache_flush,
+    "cpu_cache_flush",
+    "Batched releases from per-CPU extent caches to the allocator");
 
   logger = b.create_perf_counters();
 
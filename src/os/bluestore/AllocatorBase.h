@@ -14,7 +14,10 @@
 #define CEPH_OS_BLUESTORE_ALLOCATORBASE_H
 
 #include <functional>
+#include <memory>
 #include <ostream>
+#include <sched.h>
+#include <thread>
 #include "include/ceph_assert.h"
 #include "bluestore_types.h"
 #include "common/ceph_mutex.h"
@@ -27,6 +30,10 @@ enum {
   l_bluestore_allocator_alloc_process_lat,
   l_bluestore_allocator_lock_wait_lat,
   l_bluestore_allocator_nolock_process_lat,
+  l_bluestore_allocator_cpu_cache_hit,
+  l_bluestore_allocator_cpu_cache_miss,
+  l_bluestore_allocator_cpu_cache_refill,
+  l_bluestore_allocator_cpu_cache_flush,
   l_bluestore_allocator_last
 };
 
@@ -258,6 +265,146 @@ protected:
     }
   };
 
+  /*
+   * Per-CPU magazines of free extents reserved from the underlying
+   * allocator. Small allocations are carved from the extents cached
+   * in the shard of the CPU the caller runs on, and small releases
+   * are put back there, so neither touches the allocator lock.
+   * Each shard is guarded by a try-only flag: a busy shard is bypassed
+   * rather than waited for. Only drain() (used for enumeration and
+   * shutdown) spins on it.
+   * Refilling and flushing back to the allocator is done by the owner,
+   * see HybridAllocatorBase.
+   */
+  class PerCpuExtentCache {
+  public:
+    struct alignas(64) shard_t {
+      std::atomic_flag busy = ATOMIC_FLAG_INIT;
+      PExtentVector extents;   ///< carved from the back
+      uint64_t bytes = 0;
+      uint64_t refill_size = 0; ///< adapted to the allocator's fragmentation
+    };
+
+  private:
+    const size_t num_shards;
+    const uint64_t max_want;     ///< largest request served from the cache
+    const uint64_t max_refill;
+    const uint64_t max_bytes;    ///< per shard, excess is flushed
+    const size_t max_extents;
+    std::unique_ptr<shard_t[]> shards;
+    std::atomic<uint64_t> cached_bytes = 0;
+
+  public:
+    PerCpuExtentCache(size_t _num_shards,
+                      uint64_t _max_want,
+                      uint64_t _max_refill) :
+      num_shards(_num_shards),
+      max_want(_max_want),
+      max_refill(std::max(_max_refill, _max_want)),
+      max_bytes(max_refill * 4),
+      max_extents(64),
+      shards(new shard_t[_num_shards])
+    {
+      ceph_assert(num_shards);
+      for (size_t i = 0; i < num_shards; ++i) {
+        shards[i].refill_size = max_refill;
+        shards[i].extents.reserve(max_extents);
+      }
+    }
+    uint64_t get_max_want() const {
+      return max_want;
+    }
+    uint64_t get_max_refill() const {
+      return max_refill;
+    }
+    uint64_t get_cached_bytes() const {
+      return cached_bytes.load();
+    }
+    size_t get_num_shards() const {
+      return num_shards;
+    }
+
+    shard_t* try_lock_local() {
+      int cpu = sched_getcpu();
+      size_t idx = cpu >= 0 ?
+        size_t(cpu) :
+        std::hash<std::thread::id>{}(std::this_thread::get_id());
+      auto* s = &shards[idx % num_shards];
+      if (s->busy.test_and_set(std::memory_order_acquire)) {
+        return nullptr;
+      }
+      return s;
+    }
+    shard_t* lock(size_t idx) {
+      auto* s = &shards[idx];
+      while (s->busy.test_and_set(std::memory_order_acquire)) {
+        std::this_thread::yield();
+      }
+      return s;
+    }
+    void unlock(shard_t* s) {
+      s->busy.clear(std::memory_order_release);
+    }
+
+    // the following require the shard to be locked
+    bool try_get(shard_t* s, uint64_t want, uint64_t* offset) {
+      for (auto i = s->extents.size(); i > 0; --i) {
+        auto& e = s->extents[i - 1];
+        if (e.length >= want) {
+          *offset = e.offset;
+          e.offset += want;
+          e.length -= want;
+          if (e.length == 0) {
+            s->extents.erase(s->extents.begin() + (i - 1));
+          }
+          s->bytes -= want;
+          cached_bytes -= want;
+          return true;
+        }
+      }
+      return false;
+    }
+    bool try_put(shard_t* s, uint64_t offset, uint64_t len) {
+      if (len > max_refill || s->extents.size() >= max_extents) {
+        return false;
+      }
+      s->extents.emplace_back(offset, len);
+      s->bytes += len;
+      cached_bytes += len;
+      return true;
+    }
+    /// move extents shorter than min_len, or anything above max_bytes,
+    /// to the release set
+    void trim(shard_t* s, uint64_t min_len, release_set_t* out) {
+      auto it = s->extents.begin();
+      while (it != s->extents.end()) {
+        if (it->length < min_len || s->bytes > max_bytes) {
+          out->insert(it->offset, it->length);
+          s->bytes -= it->length;
+          cached_bytes -= it->length;
+          it = s->extents.erase(it);
+        } else {
+          ++it;
+        }
+      }
+    }
+    void drain(shard_t* s, release_set_t* out) {
+      for (auto& e : s->extents) {
+        out->insert(e.offset, e.length);
+      }
+      cached_bytes -= s->bytes;
+      s->bytes = 0;
+      s->extents.clear();
+    }
+    void drain(release_set_t* out) {
+      for (size_t i = 0; i < num_shards; ++i) {
+        auto* s = lock(i);
+        drain(s, out);
+        unlock(s);
+      }
+    }
+  };
+
 public:
   AllocatorBase(std::string_view name,
 		int64_t _capacity,
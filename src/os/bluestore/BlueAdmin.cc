@@ -12,6 +12,7 @@
 #include <sstream>
 #include <vector>
 #include <limits>
+#include <map>
 
 #define dout_subsys ceph_subsys_bluestore
 #define dout_context store.cct
@@ -82,6 +83,42 @@ BlueStore::SocketHook::SocketHook(BlueStore& store)
       this,
       "print RocksDB sharding");
     ceph_assert(r == 0);
+    r = admin_socket->register_command(
+      "bluestore online reshard start "
+      "name=column_def,type=CephString,req=true",
+      this,
+      "reshard one RocksDB column, e.g. p(8), while the OSD keeps running");
+    ceph_assert(r == 0);
+    r = admin_socket->register_command(
+      "bluestore online reshard status",
+      this,
+      "print progress of online RocksDB resharding");
+    ceph_assert(r == 0);
+    r = admin_socket->register_command(
+      "bluestore defrag status",
+      this,
+      "print background defragmentation state and totals");
+    ceph_assert(r == 0);
+    r = admin_socket->register_command(
+      "bluestore defrag pause",
+      this,
+      "stop rewriting queued fragmented objects until resumed");
+    ceph_assert(r == 0);
+    r = admin_socket->register_command(
+      "bluestore defrag resume",
+      this,
+      "resume background defragmentation");
+    ceph_assert(r == 0);
+    r = admin_socket->register_command(
+      "bluestore cache shards",
+      this,
+      "print per-shard onode/buffer cache occupancy, hits, misses and trims");
+    ceph_assert(r == 0);
+    r = admin_socket->register_command(
+      "bluestore deferred policy",
+      this,
+      "print the adaptive deferred/direct write decision table");
+    ceph_assert(r == 0);
     r = admin_socket->register_command("bluestore bluefs-bdev-expand",
                                        this,
                                        "Instruct BlueFS to check the size of its block devices"
@@ -225,6 +262,16 @@ int BlueStore::SocketHook::call(
       ss << "Failed to get sharding" << std::endl;
     }
     return r;
+  } else if (command == "bluestore online reshard start") {
+    std::string column_def;
+    cmd_getval(cmdmap, "column_def", column_def);
+    return store.db_reshard_online(column_def, ss);
+  } else if (command == "bluestore online reshard status") {
+    int r = store.dump_db_reshard_status(f);
+    if (r < 0) {
+      ss << "online reshard requires rocksdb";
+    }
+    return r;
   } else if (command == "bluestore runtime frag score") {
     std::shared_lock l(store.coll_lock);
     std::string coll;
@@ -296,6 +343,55 @@ int BlueStore::SocketHook::call(
       }
     }
     return 0;
+  } else if (command == "bluestore defrag status") {
+    store._dump_defrag_status(f);
+    return 0;
+  } else if (command == "bluestore defrag pause") {
+    store._defrag_set_paused(true);
+    return 0;
+  } else if (command == "bluestore defrag resume") {
+    store._defrag_set_paused(false);
+    return 0;
+  } else if (command == "bluestore cache shards") {
+    std::map<OnodeCacheShard*, size_t> onode_colls;
+    std::map<BufferCacheShard*, size_t> buffer_colls;
+    {
+      std::shared_lock l(store.coll_lock);
+      for (const auto& it : store.coll_map) {
+        ++onode_colls[it.second->get_onode_cache()];
+        ++buffer_colls[it.second->cache];
+      }
+    }
+    f->open_array_section("onode_cache_shards");
+    for (size_t i = 0; i < store.onode_cache_shards.size(); ++i) {
+      auto shard = store.onode_cache_shards[i];
+      f->open_object_section("shard");
+      f->dump_unsigned("shard", i);
+      f->dump_unsigned("collections", onode_colls[shard]);
+      shard->dump_stats(f);
+      f->close_section();
+    }
+    f->close_section();
+    f->open_array_section("buffer_cache_shards");
+    for (size_t i = 0; i < store.buffer_cache_shards.size(); ++i) {
+      auto shard = store.buffer_cache_shards[i];
+      f->open_object_section("shard");
+      f->dump_unsigned("shard", i);
+      f->dump_unsigned("collections", buffer_colls[shard]);
+      {
+        std::lock_guard l(shard->lock);
+        f->dump_unsigned("bytes", shard->_get_bytes());
+      }
+      shard->dump_stats(f);
+      f->close_section();
+    }
+    f->close_section();
+    return 0;
+  } else if (command == "bluestore deferred policy") {
+    f->open_object_section("deferred_policy");
+    store.deferred_policy.dump(f, store.prefer_deferred_size);
+    f->close_section();
+    return 0;
   } else if (command == "bluestore bluefs-bdev-expand"){
     std::stringstream result;
     int ret = store.expand_devices(result);
@@ -422,6 +422,18 @@ void BlueFS::_init_logger()
 		    "Bytes requested in prefetch read mode",
 		     NULL,
 		    PerfCountersBuilder::PRIO_USEFUL, unit_t(UNIT_BYTES));
+  b.add_u64_counter(l_bluefs_readahead_hit_count, "readahead_hit_count",
+		    "Sequential buffer refills served from readahead",
+		     NULL,
+		    PerfCountersBuilder::PRIO_DEBUGONLY);
+  b.add_u64_counter(l_bluefs_readahead_bytes, "readahead_bytes",
+		    "Bytes read asynchronously ahead of sequential readers",
+		     NULL,
+		    PerfCountersBuilder::PRIO_DEBUGONLY, unit_t(UNIT_BYTES));
+  b.add_u64_counter(l_bluefs_readahead_dropped_bytes, "readahead_dropped_bytes",
+		    "Readahead bytes discarded without being used",
+		     NULL,
+		    PerfCountersBuilder::PRIO_DEBUGONLY, unit_t(UNIT_BYTES));
   b.add_u64_counter(l_bluefs_write_count, "write_count",
 		    "Write requests processed");
   b.add_u64_counter(l_bluefs_write_disk_count, "write_disk_count",
@@ -441,6 +453,18 @@ void BlueFS::_init_logger()
                     "Average bluefs fsync latency",
                     "fs_t",
                     PerfCountersBuilder::PRIO_INTERESTING);
+  b.add_time_avg   (l_bluefs_log_sync_wait_lat, "log_sync_wait_lat",
+                    "Average time waiting for the log lock to sync the log");
+  b.add_time_avg   (l_bluefs_log_sync_write_lat, "log_sync_write_lat",
+                    "Average time encoding and writing a log transaction");
+  b.add_time_avg   (l_bluefs_log_sync_flush_lat, "log_sync_flush_lat",
+                    "Average time flushing the device after a log write");
+  b.add_u64_counter(l_bluefs_log_sync_files, "log_sync_files",
+                    "Dirty file updates carried by log syncs");
+  b.add_u64_counter(l_bluefs_log_sync_piggyback, "log_sync_piggyback",
+                    "Log syncs satisfied by another thread's log write");
+  b.add_u64_counter(l_bluefs_log_compact_queued, "log_compact_queued",
+                    "Log compactions handed to the background thread");
   b.add_time_avg   (l_bluefs_flush_lat, "flush_lat",
                     "Average bluefs flush latency",
                     "fl_t",
@@ -1220,6 +1244,9 @@ int BlueFS::mount()
            << dendl;
   // update log size
   logger->set(l_bluefs_log_bytes, log.writer->file->fnode.size);
+  if (cct->_conf->bluefs_log_compact_background) {
+    _log_compact_start();
+  }
   return 0;
 
  out:
@@ -1248,6 +1275,7 @@ void BlueFS::umount(bool avoid_compact)
 {
   dout(1) << __func__ << dendl;
 
+  _log_compact_stop();
   sync_metadata(avoid_compact);
   if (cct->_conf->bluefs_check_volume_selector_on_mount) {
     _check_vselector_LNF();
@@ -2890,7 +2918,12 @@ int64_t BlueFS::_read(
       s_lock.unlock();
       std::unique_lock u_lock(h->lock);
       buf->bl.reassign_to_mempool(mempool::mempool_bluefs_file_reader);
-      if (off < buf->bl_off || off >= buf->get_buf_end()) {
+      if ((off < buf->bl_off || off >= buf->get_buf_end()) &&
+	  _readahead_take(h, off)) {
+	buf->bl.reassign_to_mempool(mempool::mempool_bluefs_file_reader);
+	logger->inc(l_bluefs_readahead_hit_count);
+	_readahead_submit(h);
+      } else if (off < buf->bl_off || off >= buf->get_buf_end()) {
         // if precondition hasn't changed during locking upgrade.
         buf->bl.clear();
         buf->bl_off = off & super.block_mask();
@@ -2931,6 +2964,7 @@ int64_t BlueFS::_read(
 	logger->inc(l_bluefs_read_disk_bytes, l);
 
         ceph_assert(r == 0);
+	_readahead_submit(h);
       }
       u_lock.unlock();
       s_lock.lock();
@@ -2976,6 +3010,83 @@ int64_t BlueFS::_read(
   return ret;
 }
 
+// Called with h->lock held exclusively when off is not in the prefetch
+// buffer.  A miss right at the end of the buffer counts as sequential and
+// is served from the readahead queue if possible; any other miss drops
+// the queue.
+bool BlueFS::_readahead_take(FileReader *h, uint64_t off)
+{
+  auto* buf = &h->buf;
+  if (buf->bl.length() == 0 || off != buf->get_buf_end()) {
+    buf->seq_misses = 0;
+    for (auto& ra : buf->readahead) {
+      logger->inc(l_bluefs_readahead_dropped_bytes, ra.bl.length());
+    }
+    buf->readahead.clear();
+    return false;
+  }
+  ++buf->seq_misses;
+  if (buf->readahead.empty()) {
+    return false;
+  }
+  auto& ra = buf->readahead.front();
+  ceph_assert(ra.off == off);
+  ra.ioc->aio_wait();
+  ceph_assert(ra.ioc->get_return_value() == 0);
+  dout(20) << __func__ << " h " << h << " 0x" << std::hex
+	   << ra.off << "~" << ra.bl.length() << std::dec << dendl;
+  buf->bl.clear();
+  buf->bl.claim_append(ra.bl);
+  buf->bl_off = ra.off;
+  buf->readahead.pop_front();
+  return true;
+}
+
+// Keep up to bluefs_readahead_max_bytes of asynchronous reads in flight
+// beyond the prefetch buffer of a sequential reader.  Reads are direct
+// and aligned; buffered readers, the log reader and zero-checking mode
+// keep using the synchronous path only.
+void BlueFS::_readahead_submit(FileReader *h)
+{
+  auto* buf = &h->buf;
+  uint64_t window = cct->_conf->bluefs_readahead_max_bytes;
+  if (!window ||
+      h->buffered ||
+      h->ignore_eof ||
+      cct->_conf->bluefs_check_for_zeros ||
+      buf->seq_misses < cct->_conf->bluefs_readahead_trigger) {
+    return;
+  }
+  uint64_t chunk = round_up_to(
+    std::max<uint64_t>(buf->max_prefetch, super.block_size),
+    super.block_size);
+  uint64_t eof_offset = round_up_to(h->file->fnode.size, super.block_size);
+  uint64_t pos = buf->get_readahead_end();
+  while (pos < eof_offset && pos - buf->get_buf_end() < window) {
+    uint64_t x_off = 0;
+    auto p = h->file->fnode.seek(pos, &x_off);
+    if (p == h->file->fnode.extents.end()) {
+      break;
+    }
+    uint64_t l = std::min({p->length - x_off, chunk, eof_offset - pos});
+    buf->readahead.emplace_back();
+    auto& ra = buf->readahead.back();
+    ra.off = pos;
+    ra.ioc.reset(new IOContext(cct, NULL));
+    dout(20) << __func__ << " h " << h << " 0x" << std::hex
+	     << pos << "~" << l << std::dec << " of " << *p << dendl;
+    int r = bdev[p->bdev]->aio_read(p->offset + x_off, l, &ra.bl, ra.ioc.get());
+    ceph_assert(r == 0);
+    if (ra.ioc->has_pending_aios()) {
+      bdev[p->bdev]->aio_submit(ra.ioc.get());
+    }
+    logger->inc(l_bluefs_read_disk_count, 1);
+    logger->inc(l_bluefs_read_disk_bytes, l);
+    logger->inc(l_bluefs_readahead_bytes, l);
+    pos += l;
+  }
+}
+
 void BlueFS::invalidate_cache(FileRef f, uint64_t offset, uint64_t length)
 {
   std::lock_guard l(f->lock);
@@ -3735,7 +3846,7 @@ uint64_t BlueFS::_log_advance_seq()
 
 // Adds to log.t file modifications mentioned in `dirty.files`.
 // Note: some bluefs ops may have already been stored in log.t transaction.
-void BlueFS::_consume_dirty(uint64_t seq)
+size_t BlueFS::_consume_dirty(uint64_t seq)
 {
   ceph_assert(ceph_mutex_is_locked(dirty.lock));
   ceph_assert(ceph_mutex_is_locked(log.lock));
@@ -3753,7 +3864,9 @@ void BlueFS::_consume_dirty(uint64_t seq)
       dout(20) << __func__ << "   op_file_update_inc " << f.fnode << dendl;
       log.t.op_file_update_inc(f.fnode);
     }
+    return lsi->second.size();
   }
+  return 0;
 }
 
 int64_t BlueFS::_maybe_extend_log() {
@@ -3904,31 +4017,50 @@ void BlueFS::_release_pending_allocations(vector<interval_set<uint64_t>>& to_rel
 
 int BlueFS::_flush_and_sync_log_LD(uint64_t want_seq)
 {
+  if (want_seq) {
+    // a log write that is already done may have carried our update
+    std::lock_guard dl(dirty.lock);
+    if (want_seq <= dirty.seq_stable) {
+      logger->inc(l_bluefs_log_sync_piggyback);
+      return 0;
+    }
+  }
+  auto t0 = mono_clock::now();
   log.lock.lock();
+  logger->tinc_with_max(l_bluefs_log_sync_wait_lat, mono_clock::now() - t0);
   dirty.lock.lock();
   if (want_seq && want_seq <= dirty.seq_stable) {
     dout(10) << __func__ << " want_seq " << want_seq << " <= seq_stable "
       << dirty.seq_stable << ", done" << dendl;
+    logger->inc(l_bluefs_log_sync_piggyback);
     dirty.lock.unlock();
     log.lock.unlock();
     return 0;
   }
   
   ceph_assert(want_seq == 0 || want_seq <= dirty.seq_live); // illegal to request seq that was not created yet
+  // group commit: every file that went dirty before this point, i.e. all
+  // fsyncs queued behind us on log.lock, is carried by this single write
   uint64_t seq =_log_advance_seq();
-  _consume_dirty(seq);
+  logger->inc(l_bluefs_log_sync_files, _consume_dirty(seq));
   vector<interval_set<uint64_t>> to_release(dirty.pending_release.size());
   to_release.swap(dirty.pending_release);
   dirty.lock.unlock();
 
+  auto t1 = mono_clock::now();
   _maybe_extend_log();
   _flush_and_sync_log_core();
+  auto t2 = mono_clock::now();
   _flush_bdev(log.writer);
+  logger->tinc_with_max(l_bluefs_log_sync_write_lat, t2 - t1);
+  logger->tinc_with_max(l_bluefs_log_sync_flush_lat, mono_clock::now() - t2);
   logger->set(l_bluefs_log_bytes, log.writer->file->fnode.size);
-  //now log.lock is no longer needed
-  log.lock.unlock();
 
+  // publish seq_stable before letting the next syncer in, so that the
+  // fsyncs we carried see it and skip a redundant log write
   _clear_dirty_set_stable_D(seq);
+  log.lock.unlock();
+
   _release_pending_allocations(to_release);
 
   _update_logger_stats();
@@ -4751,6 +4883,15 @@ void BlueFS::_maybe_compact_log_LNF_NF_LD_D()
 {
   if (!cct->_conf->bluefs_replay_recovery_disable_compact &&
       _should_start_compact_log_L_N()) {
+    if (log_compact_thread && !cct->_conf->bluefs_compact_log_sync) {
+      std::lock_guard l(log_compact_lock);
+      if (!log_compact_requested) {
+	log_compact_requested = true;
+	logger->inc(l_bluefs_log_compact_queued);
+	log_compact_cond.notify_one();
+      }
+      return;
+    }
     auto t0 = mono_clock::now();
     if (cct->_conf->bluefs_compact_log_sync) {
       _compact_log_sync_LNF_LD();
@@ -4761,6 +4902,50 @@ void BlueFS::_maybe_compact_log_LNF_NF_LD_D()
   }
 }
 
+void BlueFS::_log_compact_start()
+{
+  ceph_assert(!log_compact_thread);
+  log_compact_stop = false;
+  log_compact_requested = false;
+  log_compact_thread = std::make_unique<LogCompactThread>(this);
+  log_compact_thread->create("bluefs_compact");
+}
+
+void BlueFS::_log_compact_stop()
+{
+  if (!log_compact_thread) {
+    return;
+  }
+  {
+    std::lock_guard l(log_compact_lock);
+    log_compact_stop = true;
+    log_compact_cond.notify_all();
+  }
+  log_compact_thread->join();
+  log_compact_thread.reset();
+}
+
+void BlueFS::_log_compact_thread_entry()
+{
+  dout(10) << __func__ << " start" << dendl;
+  std::unique_lock l(log_compact_lock);
+  while (!log_compact_stop) {
+    if (!log_compact_requested) {
+      log_compact_cond.wait(l);
+      continue;
+    }
+    log_compact_requested = false;
+    l.unlock();
+    if (_should_start_compact_log_L_N()) {
+      auto t0 = mono_clock::now();
+      _compact_log_async_LD_LNF_D();
+      logger->tinc_with_max(l_bluefs_compaction_lat, mono_clock::now() - t0);
+    }
+    l.lock();
+  }
+  dout(10) << __func__ << " finish" << dendl;
+}
+
 int BlueFS::open_for_write(
   std::string_view dirname,
   std::string_view filename,
@@ -5,6 +5,8 @@
 #define CEPH_OS_BLUESTORE_BLUEFS_H
 
 #include <atomic>
+#include <list>
+#include <memory>
 #include <mutex>
 #include <limits>
 #include <uuid/uuid.h>
@@ -72,12 +74,21 @@ enum {
   l_bluefs_read_disk_bytes_slow,
   l_bluefs_read_prefetch_count,
   l_bluefs_read_prefetch_bytes,
+  l_bluefs_readahead_hit_count,
+  l_bluefs_readahead_bytes,
+  l_bluefs_readahead_dropped_bytes,
   l_bluefs_write_count,
   l_bluefs_write_disk_count,
   l_bluefs_write_bytes,
   l_bluefs_compaction_lat,
   l_bluefs_compaction_lock_lat,
   l_bluefs_fsync_lat,
+  l_bluefs_log_sync_wait_lat,
+  l_bluefs_log_sync_write_lat,
+  l_bluefs_log_sync_flush_lat,
+  l_bluefs_log_sync_files,
+  l_bluefs_log_sync_piggyback,
+  l_bluefs_log_compact_queued,
   l_bluefs_flush_lat,
   l_bluefs_unlink_lat,
   l_bluefs_truncate_lat,
@@ -532,12 +543,37 @@ public:
     uint64_t pos = 0;       ///< current logical offset
     uint64_t max_prefetch;  ///< max allowed prefetch
 
+    /// asynchronous read issued ahead of the prefetch buffer
+    struct readahead_t {
+      uint64_t off = 0;                  ///< logical offset
+      ceph::buffer::list bl;             ///< filled once ioc completes
+      std::unique_ptr<IOContext> ioc;
+
+      readahead_t() = default;
+      readahead_t(const readahead_t&) = delete;
+      readahead_t& operator=(const readahead_t&) = delete;
+      ~readahead_t() {
+	// buffers are owned by the aio until it completes
+	if (ioc) {
+	  ioc->aio_wait();
+	}
+      }
+      uint64_t get_end() const {
+	return off + bl.length();
+      }
+    };
+    std::list<readahead_t> readahead; ///< contiguous, starting at buf end
+    unsigned seq_misses = 0;  ///< consecutive misses right at buf end
+
     explicit FileReaderBuffer(uint64_t mpf)
       : max_prefetch(mpf) {}
 
     uint64_t get_buf_end() const {
       return bl_off + bl.length();
     }
+    uint64_t get_readahead_end() const {
+      return readahead.empty() ? get_buf_end() : readahead.back().get_end();
+    }
     uint64_t get_buf_remaining(uint64_t p) const {
       if (p >= bl_off && p < bl_off + bl.length())
 	return bl_off + bl.length() - p;
@@ -640,6 +676,22 @@ private:
   std::atomic<bool> log_is_compacting{false};                    ///< signals that bluefs log is already ongoing compaction
   std::atomic<bool> log_forbidden_to_expand{false};              ///< used to signal that async compaction is in state
                                                                  ///  that prohibits expansion of bluefs log
+
+  /// runs async log compaction off the fsync path,
+  /// see bluefs_log_compact_background
+  struct LogCompactThread : public Thread {
+    BlueFS *bluefs;
+    explicit LogCompactThread(BlueFS *fs) : bluefs(fs) {}
+    void *entry() override {
+      bluefs->_log_compact_thread_entry();
+      return NULL;
+    }
+  };
+  std::unique_ptr<LogCompactThread> log_compact_thread;
+  ceph::mutex log_compact_lock = ceph::make_mutex("BlueFS::log_compact_lock");
+  ceph::condition_variable log_compact_cond;
+  bool log_compact_stop = false;
+  bool log_compact_requested = false;
   /*
    * There are up to 3 block devices:
    *
@@ -724,7 +776,7 @@ private:
   int64_t _maybe_extend_log();
   void _extend_log(uint64_t amount);
   uint64_t _log_advance_seq();
-  void _consume_dirty(uint64_t seq);
+  size_t _consume_dirty(uint64_t seq);
   void _clear_dirty_set_stable_D(uint64_t seq_stable);
   void _release_pending_allocations(std::vector<interval_set<uint64_t>>& to_release);
 
@@ -753,6 +805,9 @@ private:
 
   void _compact_log_sync_LNF_LD();
   void _compact_log_async_LD_LNF_D();
+  void _log_compact_start();
+  void _log_compact_stop();
+  void _log_compact_thread_entry();
 
   void _rewrite_log_and_layout_sync_LNF_LD(bool permit_dev_fallback,
 				    int super_dev,
@@ -790,6 +845,8 @@ private:
     size_t len,      ///< [in] this many bytes
     ceph::buffer::list *outbl,   ///< [out] optional: reference the result here
     char *out);      ///< [out] optional: or copy it here
+  bool _readahead_take(FileReader *h, uint64_t offset);
+  void _readahead_submit(FileReader *h);
   int64_t _read_random(
     FileReader *h,   ///< [in] read from here
     uint64_t offset, ///< [in] offset
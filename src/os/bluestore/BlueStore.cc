@@ -139,6 +139,7 @@ const string PREFIX_OMAP = "M";        // u64 + keyname -> value
 const string PREFIX_PGMETA_OMAP = "P"; // u64 + keyname -> value(for meta coll)
 const string PREFIX_PERPOOL_OMAP = "m"; // s64 + u64 + keyname -> value
 const string PREFIX_PERPG_OMAP = "p";   // u64(pool) + u32(hash) + u64(id) + keyname -> value
+                                        // (id is a compact nid for FLAG_COMPACT_OMAP)
 const string PREFIX_DEFERRED = "L";    // id -> deferred_transaction_t
 const string PREFIX_ALLOC = "B";       // u64 offset -> u64 length (freelist)
 const string PREFIX_ALLOC_BITMAP = "b";// (see BitmapFreelistManager)
@@ -1099,9 +1100,20 @@ struct LruOnodeCacheShard : public BlueStore::OnodeCacheShard {
       &BlueStore::Onode::lru_item> > list_t;
 
   list_t lru;
+  /// [pack_pos, lru.end()) has been looked at by _pack_cold()
+  list_t::iterator pack_pos = lru.end();
 
   explicit LruOnodeCacheShard(CephContext *cct) : BlueStore::OnodeCacheShard(cct) {}
 
+  void _lru_erase(BlueStore::Onode* o)
+  {
+    auto p = lru.iterator_to(*o);
+    if (p == pack_pos) {
+      ++pack_pos;
+    }
+    lru.erase(p);
+  }
+
   void _add(BlueStore::Onode* o, int level) override
   {
     o->set_cached();
@@ -1119,7 +1131,7 @@ struct LruOnodeCacheShard : public BlueStore::OnodeCacheShard {
     o->clear_cached();
     if (o->lru_item.is_linked()) {
       *(o->cache_age_bin) -= 1;
-      lru.erase(lru.iterator_to(*o));
+      _lru_erase(o);
     }
     ceph_assert(num);
     --num;
@@ -1155,7 +1167,7 @@ struct LruOnodeCacheShard : public BlueStore::OnodeCacheShard {
         }
       } else if (o->exists) {
         // move onode within LRU
-        lru.erase(lru.iterator_to(*o));
+        _lru_erase(o);
         lru.push_front(*o);
         if (o->cache_age_bin != age_bins.front()) {
           *(o->cache_age_bin) -= 1;
@@ -1169,6 +1181,33 @@ struct LruOnodeCacheShard : public BlueStore::OnodeCacheShard {
     ocs->lock.unlock();
   }
 
+  // Pack the extent maps of onodes that have not been touched since the
+  // last age bin rotation, coldest first.  Called periodically by the
+  // mempool thread; the walk is bounded and resumes where it stopped, so
+  // the shard lock is only held briefly.  Onodes touched again move to
+  // the front and are looked at once more after they go cold.
+  void pack_cold() override
+  {
+    uint64_t pack_min = cct->_conf->bluestore_extent_map_pack_min_extents;
+    if (!pack_min) {
+      return;
+    }
+    std::lock_guard l(lock);
+    unsigned budget = 1024;
+    while (budget-- > 0 && pack_pos != lru.begin()) {
+      auto p = std::prev(pack_pos);
+      if (p->cache_age_bin == age_bins.front()) {
+        break;  // this one and everything in front of it is still hot
+      }
+      // lookups take our lock, so an onode referenced by the cache only
+      // stays that way while we hold it
+      if (p->pin_nref == 1 && p->extent_map.extent_map.size() >= pack_min) {
+        p->extent_map.pack_shards();
+      }
+      pack_pos = p;
+    }
+  }
+
   void _trim_to(uint64_t new_size) override
   {
     if (new_size >= lru.size()) {
@@ -1180,7 +1219,7 @@ struct LruOnodeCacheShard : public BlueStore::OnodeCacheShard {
                                  // to reach new_size target.
     while (n-- > 0 && lru.size() > 0) {
       BlueStore::Onode *o = &lru.back();
-      lru.pop_back();
+      _lru_erase(o);
 
       dout(20) << __func__ << "  rm " << o->oid << " "
                << o->nref << " " << o->cached << dendl;
@@ -1211,6 +1250,21 @@ struct LruOnodeCacheShard : public BlueStore::OnodeCacheShard {
     *onodes += num;
     *pinned_onodes += num - lru.size();
   }
+  void collect_hot(
+    size_t max,
+    std::vector<std::pair<coll_t, ghobject_t>> *out) override
+  {
+    std::lock_guard l(lock);
+    for (auto& o : lru) {
+      if (max == 0) {
+        break;
+      }
+      if (o.exists) {
+        out->emplace_back(o.c->cid, o.oid);
+        --max;
+      }
+    }
+  }
 #ifdef DEBUG_CACHE
   void _audit(const char *when) override
   {
@@ -1928,6 +1982,8 @@ void BlueStore::BufferSpace::read(
   uint64_t miss_bytes = want_bytes - hit_bytes;
   cache->logger->inc(l_bluestore_buffer_hit_bytes, hit_bytes);
   cache->logger->inc(l_bluestore_buffer_miss_bytes, miss_bytes);
+  cache->hits.fetch_add(hit_bytes, std::memory_order_relaxed);
+  cache->misses.fetch_add(miss_bytes, std::memory_order_relaxed);
 }
 
 void BlueStore::BufferSpace::_finish_write(BufferCacheShard* cache,
@@ -2096,6 +2152,7 @@ BlueStore::OnodeRef BlueStore::OnodeSpace::lookup(const ghobject_t& oid)
     if (p == onode_map.end()) {
       ldout(cache->cct, 30) << __func__ << " " << oid << " miss" << dendl;
       cache->logger->inc(l_bluestore_onode_misses);
+      cache->misses.fetch_add(1, std::memory_order_relaxed);
     } else {
       ldout(cache->cct, 30) << __func__ << " " << oid << " hit " << p->second
                             << " " << p->second->nref
@@ -2106,6 +2163,7 @@ BlueStore::OnodeRef BlueStore::OnodeSpace::lookup(const ghobject_t& oid)
       o = p->second;
 
       cache->logger->inc(l_bluestore_onode_hits);
+      cache->hits.fetch_add(1, std::memory_order_relaxed);
     }
   }
 
@@ -4362,28 +4420,35 @@ void BlueStore::ExtentMap::maybe_load_shard(
       dout(30) << __func__ << " opening shard 0x" << std::hex
 	       << p->shard_info->offset << std::dec << dendl;
       bufferlist v;
-      generate_extent_shard_key_and_apply(
-	onode->key, p->shard_info->offset, &key,
-        [&](const string& final_key) {
-          int r = db->get(PREFIX_OBJ, final_key, &v);
-          if (r < 0) {
-	    derr << __func__ << " missing shard 0x" << std::hex
-		 << p->shard_info->offset << std::dec << " for " << onode->oid
-		 << dendl;
-	    ceph_assert(r >= 0);
+      bool unpacked = p->packed.length() > 0;
+      if (unpacked) {
+        v.swap(p->packed);
+      } else {
+        generate_extent_shard_key_and_apply(
+	  onode->key, p->shard_info->offset, &key,
+          [&](const string& final_key) {
+            int r = db->get(PREFIX_OBJ, final_key, &v);
+            if (r < 0) {
+	      derr << __func__ << " missing shard 0x" << std::hex
+		   << p->shard_info->offset << std::dec << " for " << onode->oid
+		   << dendl;
+	      ceph_assert(r >= 0);
+            }
           }
-        }
-      );
+        );
+        ceph_assert(v.length() == p->shard_info->bytes);
+      }
       p->extents = decode_some(v);
       p->loaded = true;
       uint32_t shard_end =
         (size_t)start + 1 < shards.size() ? (p + 1)->shard_info->offset : OBJECT_MAX_SIZE;
       dout(20) << __func__ << " open shard for range 0x"
                << std::hex << p->shard_info->offset << "~" << shard_end << std::dec
-	       << " (" << v.length() << " bytes)" << dendl;
+	       << " (" << v.length() << " bytes"
+	       << (unpacked ? ", unpacked" : "") << ")" << dendl;
       ceph_assert(p->dirty == false);
-      ceph_assert(v.length() == p->shard_info->bytes);
-      onode->c->store->logger->inc(l_bluestore_onode_shard_misses);
+      onode->c->store->logger->inc(unpacked ? l_bluestore_onode_shard_unpacked
+					    : l_bluestore_onode_shard_misses);
     } else {
       onode->c->store->logger->inc(l_bluestore_onode_shard_hits);
     }
@@ -4391,6 +4456,55 @@ void BlueStore::ExtentMap::maybe_load_shard(
   }
 }
 
+unsigned BlueStore::ExtentMap::pack_shards()
+{
+  if (shards.empty() || needs_reshard()) {
+    return 0;
+  }
+  for (auto& s : shards) {
+    if (s.dirty) {
+      // an update is in flight; encoding now could race with resharding
+      return 0;
+    }
+  }
+  unsigned released = 0;
+  unsigned packed = 0;
+  for (size_t i = 0; i < shards.size(); ++i) {
+    auto& s = shards[i];
+    if (!s.loaded) {
+      continue;
+    }
+    uint32_t start = s.shard_info->offset;
+    uint32_t end =
+      i + 1 < shards.size() ? shards[i + 1].shard_info->offset : OBJECT_MAX_SIZE;
+    bufferlist bl;
+    unsigned n = 0;
+    if (encode_some(start, end - start, bl, &n, false, false)) {
+      // a clean shard is always encodable as is; if it isn't, don't
+      // leave a spurious reshard request behind and keep it decoded
+      clear_needs_reshard();
+      break;
+    }
+    Extent dummy(start);
+    auto p = extent_map.lower_bound(dummy);
+    while (p != extent_map.end() && p->logical_offset < end) {
+      p = extent_map.erase_and_dispose(p, DeleteDisposer());
+      ++released;
+    }
+    bl.reassign_to_mempool(mempool::mempool_bluestore_cache_meta);
+    s.packed.swap(bl);
+    s.extents = n;
+    s.loaded = false;
+    ++packed;
+  }
+  if (packed) {
+    dout(20) << __func__ << " " << onode->oid << " packed " << packed
+	     << " shards, released " << released << " extents" << dendl;
+    onode->c->store->logger->inc(l_bluestore_onode_shard_packed, packed);
+  }
+  return released;
+}
+
 void BlueStore::ExtentMap::dirty_range(
   uint32_t offset,
   uint32_t length)
@@ -4842,6 +4956,58 @@ std::ostream& operator<<(std::ostream& out, const BlueStore::ExtentMap::debug_au
 #undef dout_prefix
 #define dout_prefix *_dout << "bluestore.onode(" << this << ")." << __func__ << " "
 
+/*
+ * Compact omap nid: a marker byte 0xf0 + n, followed by the n significant
+ * bytes of the nid in big endian order.  The marker keeps the encoding
+ * order preserving and prefix free, and tells it apart from the legacy
+ * fixed 8 byte nid, whose first byte is 0 for any nid below 2^56.  A
+ * typical nid takes 4 or 5 bytes instead of 8.
+ */
+static constexpr uint8_t OMAP_COMPACT_NID_MARKER = 0xf0;
+
+static size_t _omap_nid_len(uint8_t flags, uint64_t nid)
+{
+  if (!bluestore_onode_t::is_compact_omap(flags)) {
+    return sizeof(uint64_t);
+  }
+  size_t n = 1;
+  while (n < sizeof(uint64_t) && (nid >> (n * 8))) {
+    ++n;
+  }
+  return 1 + n;
+}
+
+template<typename S>
+static void _key_encode_omap_nid(uint8_t flags, uint64_t nid, S *out)
+{
+  if (!bluestore_onode_t::is_compact_omap(flags)) {
+    _key_encode_u64(nid, out);
+    return;
+  }
+  size_t n = _omap_nid_len(flags, nid) - 1;
+  out->push_back((char)(OMAP_COMPACT_NID_MARKER + n));
+  while (n--) {
+    out->push_back((char)(nid >> (n * 8)));
+  }
+}
+
+/// decode an omap nid in either format
+static const char *_key_decode_omap_nid(const char *key, uint64_t *nid)
+{
+  uint8_t marker = *key;
+  if (marker <= OMAP_COMPACT_NID_MARKER ||
+      marker > OMAP_COMPACT_NID_MARKER + sizeof(uint64_t)) {
+    return _key_decode_u64(key, nid);
+  }
+  size_t n = marker - OMAP_COMPACT_NID_MARKER;
+  ++key;
+  *nid = 0;
+  while (n--) {
+    *nid = (*nid << 8) | (uint8_t)*key++;
+  }
+  return key;
+}
+
 const std::string& BlueStore::Onode::calc_omap_prefix(uint8_t flags)
 {
   if (bluestore_onode_t::is_pgmeta_omap(flags)) {
@@ -4870,7 +5036,7 @@ void BlueStore::Onode::calc_omap_header(
       _key_encode_u64(o->c->pool(), out);
     }
   }
-  _key_encode_u64(o->onode.nid, out);
+  _key_encode_omap_nid(flags, o->onode.nid, out);
   out->push_back('-');
 }
 
@@ -4887,7 +5053,7 @@ void BlueStore::Onode::calc_omap_key(uint8_t flags,
       _key_encode_u64(o->c->pool(), out);
     }
   }
-  _key_encode_u64(o->onode.nid, out);
+  _key_encode_omap_nid(flags, o->onode.nid, out);
   out->push_back('.');
   out->append(key);
 }
@@ -4905,7 +5071,7 @@ void BlueStore::Onode::calc_omap_tail(
       _key_encode_u64(o->c->pool(), out);
     }
   }
-  _key_encode_u64(o->onode.nid, out);
+  _key_encode_omap_nid(flags, o->onode.nid, out);
   out->push_back('~');
 }
 
@@ -5009,7 +5175,8 @@ void BlueStore::Onode::dump(Formatter* f) const
   extent_map.dump(f);
 }
 
-void BlueStore::Onode::rewrite_omap_key(const string& old, string *out)
+void BlueStore::Onode::rewrite_omap_key(const Onode& from, const string& old,
+					 string *out)
 {
   if (!onode.is_pgmeta_omap()) {
     if (onode.is_perpg_omap()) {
@@ -5019,13 +5186,15 @@ void BlueStore::Onode::rewrite_omap_key(const string& old, string *out)
       _key_encode_u64(c->pool(), out);
     }
   }
-  _key_encode_u64(onode.nid, out);
-  out->append(old.c_str() + out->length(), old.size() - out->length());
+  _key_encode_omap_nid(onode.flags, onode.nid, out);
+  // keep the separator and the user key
+  size_t pos = from.calc_userkey_offset_in_omap_key() - 1;
+  out->append(old.c_str() + pos, old.size() - pos);
 }
 
 size_t BlueStore::Onode::calc_userkey_offset_in_omap_key() const
 {
-  size_t pos = sizeof(uint64_t) + 1;
+  size_t pos = _omap_nid_len(onode.flags, onode.nid) + 1;
   if (!onode.is_pgmeta_omap()) {
     if (onode.is_perpg_omap()) {
       pos += sizeof(uint64_t) + sizeof(uint32_t);
@@ -5581,6 +5750,7 @@ void *BlueStore::MempoolThread::entry()
   utime_t next_resize = ceph_clock_now();
   utime_t next_bin_rotation = ceph_clock_now();
   utime_t next_deferred_force_submit = ceph_clock_now();
+  utime_t next_deferred_tune = ceph_clock_now();
   utime_t alloc_stats_dump_clock = ceph_clock_now();
 
   bool interval_stats_trim = false;
@@ -5663,10 +5833,25 @@ void *BlueStore::MempoolThread::entry()
       next_deferred_force_submit += max_defer_interval/3;
     }
 
+    // adaptive deferred write threshold
+    double deferred_adaptive_interval =
+      store->cct->_conf.get_val<double>("bluestore_deferred_adaptive_interval");
+    if (store->deferred_policy.enabled &&
+	deferred_adaptive_interval > 0 &&
+	next_deferred_tune < ceph_clock_now()) {
+      store->_tune_deferred_policy();
+      next_deferred_tune = ceph_clock_now();
+      next_deferred_tune += deferred_adaptive_interval;
+    }
+
     // Now Resize the shards 
     _resize_shards(interval_stats_trim);
     interval_stats_trim = false;
 
+    for (auto i : store->onode_cache_shards) {
+      i->pack_cold();
+    }
+
     store->refresh_perf_counters();
     uint64_t period = store->cct->_conf.get_val<uint64_t>("bluestore_fragmentation_check_period");
     if (period != 0 && store->alloc) {
@@ -5880,6 +6065,8 @@ std::vector<std::string> BlueStore::get_tracked_keys() const noexcept
     "bluestore_prefer_deferred_size"s,
     "bluestore_prefer_deferred_size_hdd"s,
     "bluestore_prefer_deferred_size_ssd"s,
+    "bluestore_deferred_adaptive"s,
+    "bluestore_deferred_adaptive_probe_interval"s,
     "bluestore_deferred_batch_ops"s,
     "bluestore_deferred_batch_ops_hdd"s,
     "bluestore_deferred_batch_ops_ssd"s,
@@ -5955,6 +6142,8 @@ void BlueStore::handle_conf_change(const ConfigProxy& conf,
   if (changed.count("bluestore_prefer_deferred_size") ||
       changed.count("bluestore_prefer_deferred_size_hdd") ||
       changed.count("bluestore_prefer_deferred_size_ssd") ||
+      changed.count("bluestore_deferred_adaptive") ||
+      changed.count("bluestore_deferred_adaptive_probe_interval") ||
       changed.count("bluestore_max_alloc_size") ||
       changed.count("bluestore_deferred_batch_ops") ||
       changed.count("bluestore_deferred_batch_ops_hdd") ||
@@ -6433,9 +6622,17 @@ void BlueStore::_init_logger()
   b.add_u64_counter(l_bluestore_reads_with_retries, "reads_with_retries",
                     "Read operations that required at least one retry due to failed checksum validation",
 		    "rd_r", PerfCountersBuilder::PRIO_USEFUL);
+  b.add_u64_counter(l_bluestore_read_shared_bytes, "read_shared_bytes",
+		    "Read bytes returned by reference to device or cache buffers",
+		    NULL, 0, unit_t(UNIT_BYTES));
+  b.add_u64_counter(l_bluestore_read_copied_bytes, "read_copied_bytes",
+		    "Read bytes returned in newly filled buffers (decompressed data, holes)",
+		    NULL, 0, unit_t(UNIT_BYTES));
   b.add_time_avg(l_bluestore_read_lat, "read_lat",
 		 "Average read latency",
 		 "r_l", PerfCountersBuilder::PRIO_CRITICAL);
+  b.add_u64_avg(l_bluestore_read_batch_ops, "read_batch_ops",
+		"Average number of objects read per read_batch call");
   //****************************************
 
   // kv_thread latencies
@@ -6452,6 +6649,10 @@ void BlueStore::_init_logger()
   b.add_time_avg(l_bluestore_kv_final_lat, "kv_final_lat",
 		 "Average kv_finalize thread latency",
 		 "kfll", PerfCountersBuilder::PRIO_INTERESTING);
+  b.add_u64_avg(l_bluestore_kv_sync_batch, "kv_sync_batch",
+		"Average number of transactions committed per kv_sync cycle");
+  b.add_u64(l_bluestore_kv_final_queued, "kv_final_queued",
+	    "Number of committed transactions waiting for finalization");
   //****************************************
 
   // write op stats
@@ -6515,6 +6716,11 @@ void BlueStore::_init_logger()
 		    NULL,
 		    PerfCountersBuilder::PRIO_DEBUGONLY,
 		    unit_t(UNIT_BYTES));
+  b.add_u64(l_bluestore_prefer_deferred_size, "prefer_deferred_size",
+	    "Current size threshold below which writes are deferred",
+	    NULL,
+	    PerfCountersBuilder::PRIO_DEBUGONLY,
+	    unit_t(UNIT_BYTES));
 
   b.add_u64_counter(l_bluestore_write_big_skipped_blobs,
       "write_big_skipped_blobs",
@@ -6551,6 +6757,12 @@ void BlueStore::_init_logger()
 	    "Sum for beneficial compress ops");
   b.add_u64_counter(l_bluestore_compress_rejected_count, "compress_rejected_count",
 	    "Sum for compress ops rejected due to low net gain of space");
+  b.add_u64(l_bluestore_compress_queue, "compress_queue",
+	    "Batches waiting for a compression worker");
+  b.add_u64_counter(l_bluestore_compress_offloaded, "compress_offloaded",
+	    "Sum for blobs compressed by a compression worker");
+  b.add_time_avg(l_bluestore_compress_wait_lat, "compress_wait_lat",
+	    "Average time spent waiting for compression workers");
   //****************************************
 
   // onode cache stats
@@ -6570,6 +6782,15 @@ void BlueStore::_init_logger()
   b.add_u64_counter(l_bluestore_onode_shard_misses,
 		    "onode_shard_misses",
 		    "Count of onode shard cache lookups misses");
+  b.add_u64_counter(l_bluestore_onode_shard_packed,
+		    "onode_shard_packed",
+		    "Count of idle onode shards packed into encoded form");
+  b.add_u64_counter(l_bluestore_onode_shard_unpacked,
+		    "onode_shard_unpacked",
+		    "Count of onode shard lookups decoded from packed form");
+  b.add_u64_counter(l_bluestore_warm_cache_onodes,
+		    "warm_cache_onodes",
+		    "Onodes prefetched from the shutdown cache snapshot");
   b.add_u64(l_bluestore_extents, "onode_extents",
 	    "Number of extents in cache");
   b.add_u64(l_bluestore_blobs, "onode_blobs",
@@ -6650,6 +6871,10 @@ void BlueStore::_init_logger()
     "ogvl", PerfCountersBuilder::PRIO_USEFUL);
   b.add_time_avg(l_bluestore_omap_clear_lat, "omap_clear_lat",
     "Average omap clear call latency");
+  b.add_u64_counter(l_bluestore_omap_range_deletes, "omap_range_deletes",
+    "Omap clears done with a single range tombstone");
+  b.add_u64_counter(l_bluestore_kv_range_compactions, "kv_range_compactions",
+    "Key ranges queued for compaction after bulk removal");
   b.add_time_avg(l_bluestore_clist_lat, "clist_lat",
     "Average collection listing latency",
     "cl_l", PerfCountersBuilder::PRIO_USEFUL);
@@ -6731,6 +6956,18 @@ void BlueStore::_init_logger()
     "Latency of static fragmentation measurement during scrub",
     "sfl",
     PerfCountersBuilder::PRIO_USEFUL);
+  b.add_u64_counter(l_bluestore_defrag_queued, "defrag_queued",
+    "Objects queued for background defragmentation");
+  b.add_u64_counter(l_bluestore_defrag_onodes, "defrag_onodes",
+    "Objects rewritten by background defragmentation");
+  b.add_u64_counter(l_bluestore_defrag_skipped, "defrag_skipped",
+    "Queued objects the defragmenter left alone (gone, shared blobs, busy)");
+  b.add_u64_counter(l_bluestore_defrag_extents_merged,
+    "defrag_extents_merged",
+    "Disjoint device extents removed by background defragmentation");
+  b.add_u64_counter(l_bluestore_defrag_bytes, "defrag_bytes",
+    "Bytes rewritten by background defragmentation",
+    NULL, 0, unit_t(UNIT_BYTES));
 
   logger = b.create_perf_counters();
   cct->get_perfcounters_collection()->add(logger);
@@ -7231,6 +7468,14 @@ void BlueStore::_set_alloc_sizes(void)
       prefer_deferred_size = cct->_conf->bluestore_prefer_deferred_size_ssd;
     }
   }
+  deferred_policy.max_size = prefer_deferred_size.load();
+  deferred_policy.base = block_size;
+  deferred_policy.probe_interval = cct->_conf.get_val<uint64_t>(
+    "bluestore_deferred_adaptive_probe_interval");
+  deferred_policy.enabled = cct->_conf->bluestore_deferred_adaptive;
+  if (logger) {
+    logger->set(l_bluestore_prefer_deferred_size, prefer_deferred_size);
+  }
 
   if (cct->_conf->bluestore_deferred_batch_ops) {
     deferred_batch_ops = cct->_conf->bluestore_deferred_batch_ops;
@@ -7251,6 +7496,96 @@ void BlueStore::_set_alloc_sizes(void)
 	   << dendl;
 }
 
+uint64_t BlueStore::DeferredPolicy::update(
+  uint64_t cur,
+  double ratio,
+  uint64_t min_samples)
+{
+  std::lock_guard l(lock);
+  for (unsigned c = 0; c < CLASSES; ++c) {
+    for (unsigned p = 0; p < 2; ++p) {
+      uint64_t sum = lat[c][p].sum_ns;
+      uint64_t count = lat[c][p].count;
+      uint64_t dcount = count - last_count[c][p];
+      interval_count[c][p] = dcount;
+      // keep the previous estimate if there is too little fresh data
+      if (dcount >= min_samples) {
+	avg_ns[c][p] = (double)(sum - last_sum_ns[c][p]) / dcount;
+	last_sum_ns[c][p] = sum;
+	last_count[c][p] = count;
+      }
+    }
+  }
+
+  // classes 0..k are deferred, k+1.. are direct
+  uint64_t b = base;
+  uint64_t max = max_size;
+  if (max < b) {
+    return max;
+  }
+  unsigned kmax = 0;
+  while (kmax + 1 < CLASSES && (b << (kmax + 1)) <= max) {
+    ++kmax;
+  }
+  unsigned k = 0;
+  while (k < kmax && (b << (k + 1)) <= cur) {
+    ++k;
+  }
+  // compare both paths for the same class on either side of the boundary;
+  // the write path probes the minority path there (see use_deferred())
+  auto known = [&](unsigned c) {
+    return c < CLASSES && avg_ns[c][DEFERRED] > 0 && avg_ns[c][DIRECT] > 0;
+  };
+  if (k < kmax && known(k + 1) &&
+      avg_ns[k + 1][DIRECT] > avg_ns[k + 1][DEFERRED] * ratio) {
+    // the first direct class would be cheaper deferred
+    ++k;
+  } else if (k > 0 && known(k) &&
+	     avg_ns[k][DEFERRED] > avg_ns[k][DIRECT] * ratio) {
+    // the last deferred class would be cheaper direct
+    --k;
+  }
+  return b << k;
+}
+
+void BlueStore::DeferredPolicy::dump(Formatter *f, uint64_t cur)
+{
+  std::lock_guard l(lock);
+  f->dump_bool("enabled", enabled);
+  f->dump_unsigned("prefer_deferred_size", cur);
+  f->dump_unsigned("max_prefer_deferred_size", max_size);
+  f->dump_unsigned("probe_interval", probe_interval);
+  f->open_array_section("size_classes");
+  uint64_t b = base;
+  for (unsigned c = 0; c < CLASSES; ++c) {
+    f->open_object_section("class");
+    f->dump_unsigned("min_bytes", c ? b << (c - 1) : 0);
+    f->dump_string("max_bytes", c + 1 < CLASSES ? stringify((b << c) - 1) : "inf");
+    f->dump_string("decision", (b << c) <= cur ? "deferred" : "direct");
+    f->dump_float("direct_lat_ms", avg_ns[c][DIRECT] / 1000000.0);
+    f->dump_unsigned("direct_samples", interval_count[c][DIRECT]);
+    f->dump_float("deferred_lat_ms", avg_ns[c][DEFERRED] / 1000000.0);
+    f->dump_unsigned("deferred_samples", interval_count[c][DEFERRED]);
+    f->close_section();
+  }
+  f->close_section();
+}
+
+void BlueStore::_tune_deferred_policy()
+{
+  uint64_t cur = prefer_deferred_size;
+  uint64_t next = deferred_policy.update(
+    cur,
+    cct->_conf.get_val<double>("bluestore_deferred_adaptive_ratio"),
+    cct->_conf.get_val<uint64_t>("bluestore_deferred_adaptive_min_samples"));
+  if (next != cur) {
+    dout(5) << __func__ << " prefer_deferred_size 0x" << std::hex << cur
+	    << " -> 0x" << next << std::dec << dendl;
+    prefer_deferred_size = next;
+    logger->set(l_bluestore_prefer_deferred_size, next);
+  }
+}
+
 int BlueStore::_open_bdev(bool create)
 {
   ceph_assert(bdev == NULL);
@@ -8547,9 +8882,38 @@ void BlueStore::_set_per_pool_omap()
   } else {
     dout(10) << __func__ << " per_pool_omap not present" << dendl;
   }
+  bl.clear();
+  db->get(PREFIX_SUPER, "compact_omap", &bl);
+  compact_omap = bl.length() > 0;
+  use_compact_omap = compact_omap &&
+    cct->_conf.get_val<bool>("bluestore_omap_compact_keys");
+  dout(10) << __func__ << " compact_omap = " << compact_omap
+	   << " use_compact_omap = " << use_compact_omap << dendl;
   _check_no_per_pg_or_pool_omap_alert();
 }
 
+void BlueStore::_enable_compact_omap()
+{
+  dout(1) << __func__ << " raising min_compat_ondisk_format to "
+	  << compact_omap_compat_ondisk_format << dendl;
+  KeyValueDB::Transaction t = db->get_transaction();
+  {
+    bufferlist bl;
+    bl.append("1");
+    t->set(PREFIX_SUPER, "compact_omap", bl);
+  }
+  {
+    // releases that cannot decode compact keys must not open the store
+    bufferlist bl;
+    encode(compact_omap_compat_ondisk_format, bl);
+    t->set(PREFIX_SUPER, "min_compat_ondisk_format", bl);
+  }
+  int r = db->submit_transaction_sync(t);
+  ceph_assert(r == 0);
+  compact_omap = true;
+  use_compact_omap = true;
+}
+
 void BlueStore::_open_statfs()
 {
   osd_pools.clear();
@@ -9230,6 +9594,26 @@ bool BlueStore::get_db_sharding(std::string& res_sharding)
   return ret;
 }
 
+int BlueStore::db_reshard_online(const std::string& column_def, std::ostream& out)
+{
+  RocksDBStore* rdb = dynamic_cast<RocksDBStore*>(db);
+  if (!rdb) {
+    out << "online reshard requires rocksdb";
+    return -EOPNOTSUPP;
+  }
+  return rdb->reshard_online(column_def, out);
+}
+
+int BlueStore::dump_db_reshard_status(ceph::Formatter *f)
+{
+  RocksDBStore* rdb = dynamic_cast<RocksDBStore*>(db);
+  if (!rdb) {
+    return -EOPNOTSUPP;
+  }
+  rdb->dump_reshard_status(f);
+  return 0;
+}
+
 int BlueStore::expand_devices(ostream& out)
 {
   bool need_to_close = false;
@@ -9681,12 +10065,17 @@ int BlueStore::_mount()
   if (r < 0) {
     return r;
   }
+  if (!compact_omap &&
+      cct->_conf.get_val<bool>("bluestore_omap_compact_keys")) {
+    _enable_compact_omap();
+  }
 
   // The recovery process for allocation-map needs to open collection early
   r = _open_collections();
   if (r < 0) {
     return r;
   }
+  _warm_cache_load();
   auto shutdown_cache = make_scope_guard([&] {
     if (!mounted) {
       _shutdown_cache();
@@ -9730,6 +10119,12 @@ int BlueStore::_mount()
     bluefs->spillover_cleaner_start();
   }
 
+  if (!warm_cache_keys.empty()) {
+    warm_cache_thread = std::make_unique<WarmCacheThread>(this);
+    warm_cache_thread->create("bstore_warm");
+  }
+  _defrag_start();
+
   mounted = true;
   return 0;
 }
@@ -9738,6 +10133,10 @@ int BlueStore::umount()
 {
   dout(5) << __func__ << dendl;
   ceph_assert(_kv_only || mounted);
+  if (!_kv_only) {
+    // it queues transactions of its own
+    _defrag_stop();
+  }
   _osr_drain_all();
 
   if (bluefs) {
@@ -9750,6 +10149,8 @@ int BlueStore::umount()
 
   if (!_kv_only) {
     mempool_thread.shutdown();
+    _warm_cache_stop();
+    _warm_cache_save();
     dout(20) << __func__ << " stopping kv thread" << dendl;
     _kv_stop();
     // skip cache cleanup step on fast shutdown
@@ -9772,6 +10173,401 @@ int BlueStore::umount()
   return 0;
 }
 
+// Warm start: on umount the most recently used onode ids are written to
+// a small BlueFS file; the next mount reads and removes it, and a
+// background thread faults those onodes (and their extent maps) back in
+// until the onode cache is at its current budget.
+static const std::string warm_cache_dir  = "WARM_CACHE_DIR";
+static const std::string warm_cache_file = "WARM_CACHE_FILE";
+static const uint32_t warm_cache_version = 1;
+
+int BlueStore::_warm_cache_save()
+{
+  if (!bluefs || !cct->_conf.get_val<bool>("bluestore_warm_cache")) {
+    return 0;
+  }
+  auto max = cct->_conf.get_val<uint64_t>("bluestore_warm_cache_max_onodes");
+  std::vector<std::pair<coll_t, ghobject_t>> keys;
+  for (auto s : onode_cache_shards) {
+    s->collect_hot(max / onode_cache_shards.size() + 1, &keys);
+  }
+  bufferlist bl;
+  encode(warm_cache_version, bl);
+  encode(keys, bl);
+  uint32_t crc = bl.crc32c(-1);
+  encode(crc, bl);
+
+  int r = 0;
+  if (!bluefs->dir_exists(warm_cache_dir)) {
+    r = bluefs->mkdir(warm_cache_dir);
+    if (r < 0) {
+      derr << __func__ << " mkdir failed: " << cpp_strerror(r) << dendl;
+      return r;
+    }
+  }
+  BlueFS::FileWriter *h = nullptr;
+  r = bluefs->open_for_write(warm_cache_dir, warm_cache_file, &h, false);
+  if (r < 0) {
+    derr << __func__ << " open_for_write failed: " << cpp_strerror(r) << dendl;
+    return r;
+  }
+  h->append(bl);
+  r = bluefs->fsync(h);
+  bluefs->close_writer(h);
+  if (r < 0) {
+    derr << __func__ << " fsync failed: " << cpp_strerror(r) << dendl;
+    return r;
+  }
+  dout(1) << __func__ << " saved " << keys.size() << " onode ids, "
+	  << bl.length() << " bytes" << dendl;
+  return 0;
+}
+
+int BlueStore::_warm_cache_load()
+{
+  warm_cache_keys.clear();
+  if (!bluefs || !bluefs->dir_exists(warm_cache_dir)) {
+    return 0;
+  }
+  uint64_t size = 0;
+  int r = bluefs->stat(warm_cache_dir, warm_cache_file, &size, nullptr);
+  if (r < 0) {
+    return 0;
+  }
+  if (cct->_conf.get_val<bool>("bluestore_warm_cache") &&
+      size > sizeof(uint32_t)) {
+    BlueFS::FileReader *h = nullptr;
+    r = bluefs->open_for_read(warm_cache_dir, warm_cache_file, &h, false);
+    if (r == 0) {
+      bufferlist bl;
+      auto len = bluefs->read(h, 0, size, &bl, nullptr);
+      delete h;
+      if (len == (int64_t)size) {
+	bufferlist body;
+	body.substr_of(bl, 0, size - sizeof(uint32_t));
+	try {
+	  uint32_t crc, expected_crc;
+	  auto p = bl.cbegin();
+	  p.seek(size - sizeof(uint32_t));
+	  decode(expected_crc, p);
+	  crc = body.crc32c(-1);
+	  if (crc != expected_crc) {
+	    throw ceph::buffer::malformed_input("crc mismatch");
+	  }
+	  uint32_t v;
+	  p = body.cbegin();
+	  decode(v, p);
+	  if (v == warm_cache_version) {
+	    decode(warm_cache_keys, p);
+	  }
+	} catch (ceph::buffer::error& e) {
+	  derr << __func__ << " ignoring corrupt snapshot: " << e.what() << dendl;
+	  warm_cache_keys.clear();
+	}
+      }
+    }
+  }
+  // the snapshot only describes the cache at the last clean shutdown
+  bluefs->unlink(warm_cache_dir, warm_cache_file);
+  bluefs->sync_metadata(false);
+  dout(1) << __func__ << " loaded " << warm_cache_keys.size()
+	  << " onode ids" << dendl;
+  return 0;
+}
+
+void BlueStore::_warm_cache_prefetch()
+{
+  auto start = mono_clock::now();
+  uint64_t loaded = 0;
+  size_t n = 0;
+  CollectionRef c;
+  for (auto& [cid, oid] : warm_cache_keys) {
+    if (warm_cache_stop) {
+      break;
+    }
+    if ((n++ % 256) == 0) {
+      // respect the budget handed out by the priority cache
+      uint64_t onodes = 0, pinned = 0, max = 0;
+      for (auto s : onode_cache_shards) {
+	s->add_stats(&onodes, &pinned);
+	max += s->max;
+      }
+      if (max && onodes >= max) {
+	dout(5) << __func__ << " onode cache full (" << onodes << "/" << max
+		<< ")" << dendl;
+	break;
+      }
+    }
+    if (!c || c->cid != cid) {
+      c = _get_collection(cid);
+      if (!c) {
+	continue;
+      }
+    }
+    std::shared_lock l(c->lock);
+    OnodeRef o = c->get_onode(oid, false);
+    if (o && o->exists) {
+      o->extent_map.fault_range(db, 0, o->onode.size);
+      ++loaded;
+      logger->inc(l_bluestore_warm_cache_onodes);
+    }
+  }
+  dout(1) << __func__ << " prefetched " << loaded << "/"
+	  << warm_cache_keys.size() << " onodes in "
+	  << ceph::to_seconds<double>(mono_clock::now() - start) << "s" << dendl;
+  warm_cache_keys.clear();
+  warm_cache_keys.shrink_to_fit();
+}
+
+void BlueStore::_warm_cache_stop()
+{
+  if (warm_cache_thread) {
+    warm_cache_stop = true;
+    warm_cache_thread->join();
+    warm_cache_thread.reset();
+    warm_cache_stop = false;
+  }
+  warm_cache_keys.clear();
+}
+
+// Background defragmentation: a read that needs at least
+// bluestore_defrag_min_extents device ios queues its object, and
+// bstore_defrag rewrites the data of queued objects into new blobs, one
+// object per transaction, whenever no other transaction is in flight.
+void BlueStore::_defrag_start()
+{
+  {
+    std::lock_guard l(defrag_lock);
+    defrag_stop = false;
+    defrag_queue.clear();
+    defrag_pending.clear();
+  }
+  defrag_thread = std::make_unique<DefragThread>(this);
+  defrag_thread->create("bstore_defrag");
+}
+
+void BlueStore::_defrag_stop()
+{
+  if (!defrag_thread) {
+    return;
+  }
+  {
+    std::lock_guard l(defrag_lock);
+    defrag_stop = true;
+    defrag_cond.notify_all();
+  }
+  defrag_thread->join();
+  defrag_thread.reset();
+  std::lock_guard l(defrag_lock);
+  defrag_queue.clear();
+  defrag_pending.clear();
+}
+
+void BlueStore::_defrag_note(Collection *c, const OnodeRef& o)
+{
+  if (!c->cid.is_pg() || o->oid.is_pgmeta() ||
+      o->onode.size > cct->_conf->bluestore_defrag_max_object_size) {
+    return;
+  }
+  std::lock_guard l(defrag_lock);
+  if (defrag_stop ||
+      defrag_queue.size() >= cct->_conf->bluestore_defrag_queue_max) {
+    return;
+  }
+  if (defrag_pending.emplace(c->cid, o->oid).second) {
+    dout(20) << __func__ << " " << c->cid << " " << o->oid << dendl;
+    defrag_queue.emplace_back(c->cid, o->oid);
+    logger->inc(l_bluestore_defrag_queued);
+    defrag_cond.notify_one();
+  }
+}
+
+void BlueStore::_defrag_thread_entry()
+{
+  std::unique_lock l(defrag_lock);
+  while (!defrag_stop) {
+    if (defrag_queue.empty() || defrag_paused ||
+	!cct->_conf->bluestore_defrag_enable) {
+      defrag_cond.wait_for(l, std::chrono::seconds(1));
+      continue;
+    }
+    if (throttle.transactions > 0) {
+      // leave the device to client io
+      defrag_cond.wait_for(l, std::chrono::milliseconds(100));
+      continue;
+    }
+    auto [cid, oid] = defrag_queue.front();
+    defrag_queue.pop_front();
+    l.unlock();
+    uint64_t rewritten = 0;
+    int r = _defrag_onode(cid, oid, &rewritten);
+    l.lock();
+    defrag_pending.erase({cid, oid});
+    if (r < 0) {
+      dout(10) << __func__ << " " << cid << " " << oid << " skipped: "
+	       << cpp_strerror(r) << dendl;
+      logger->inc(l_bluestore_defrag_skipped);
+      continue;
+    }
+    uint64_t rate = cct->_conf->bluestore_defrag_max_bytes_per_sec;
+    if (rewritten && rate) {
+      auto until = ceph::mono_clock::now() +
+	std::chrono::microseconds(rewritten * 1000000 / rate);
+      defrag_cond.wait_until(l, until, [this] { return defrag_stop; });
+    }
+  }
+}
+
+int BlueStore::_defrag_onode(
+  const coll_t& cid,
+  const ghobject_t& oid,
+  uint64_t *rewritten)
+{
+  CollectionRef c = _get_collection(cid);
+  if (!c) {
+    return -ENOENT;
+  }
+  OpSequencer *osr = c->osr.get();
+  TransContext *txc = nullptr;
+  // a transaction queued ahead of @self that has not applied its ops yet
+  // would commit, ahead of us, an onode without our changes
+  auto preparing_ahead = [osr](const TransContext *self) {
+    std::lock_guard ql(osr->qlock);
+    for (auto& t : osr->q) {
+      if (&t == self) {
+	break;
+      }
+      if (t.get_state() == TransContext::STATE_PREPARE) {
+	return true;
+      }
+    }
+    return false;
+  };
+  {
+    // this thread is a second writer next to the osd, so everything up
+    // to encoding the onode happens under the collection lock; any
+    // transaction created after ours applies its ops after us
+    std::unique_lock l(c->lock);
+    if (preparing_ahead(nullptr)) {
+      return -EBUSY;
+    }
+    OnodeRef o;
+    if (c->exists) {
+      o = c->get_onode(oid, false);
+    }
+    if (!o || !o->exists) {
+      return -ENOENT;
+    }
+    o->extent_map.fault_range(db, 0, o->onode.size);
+    int score = o->get_fragmentation_score();
+    interval_set<uint64_t> data;
+    for (auto& e : o->extent_map.extent_map) {
+      if (e.blob->get_blob().is_shared()) {
+	// keep the space shared with clones
+	return -EBUSY;
+      }
+      data.union_insert(e.logical_offset, e.length);
+    }
+    if (score < (int)cct->_conf->bluestore_defrag_min_extents ||
+	o->onode.size > cct->_conf->bluestore_defrag_max_object_size) {
+      return -ERANGE;
+    }
+    // read everything first: a read error (EIO, bad csum) leaves the
+    // object as it is, with nothing queued
+    std::vector<bufferlist> bls(data.num_intervals());
+    auto bl = bls.begin();
+    for (auto p = data.begin(); p != data.end(); ++p, ++bl) {
+      int r = _do_read(c.get(), o, p.get_start(), p.get_len(), *bl,
+		       CEPH_OSD_OP_FLAG_FADVISE_DONTNEED);
+      if (r < 0) {
+	derr << __func__ << " " << cid << " " << oid << " read 0x" << std::hex
+	     << p.get_start() << "~" << p.get_len() << std::dec
+	     << " failed: " << cpp_strerror(r) << dendl;
+	return r;
+      }
+      ceph_assert((uint64_t)r == p.get_len());
+    }
+
+    txc = _txc_create(c.get(), osr, nullptr);
+    if (preparing_ahead(txc)) {
+      // one was created since the check above, ours has not done anything
+      osr->unqueue_unused(txc);
+      delete txc;
+      return -EBUSY;
+    }
+    bl = bls.begin();
+    for (auto p = data.begin(); p != data.end(); ++p, ++bl) {
+      int r = _write(txc, c, o, p.get_start(), p.get_len(), *bl,
+		     CEPH_OSD_OP_FLAG_FADVISE_DONTNEED);
+      ceph_assert(r == 0);
+      *rewritten += p.get_len();
+    }
+    int new_score = o->get_fragmentation_score();
+    dout(10) << __func__ << " " << cid << " " << oid << " extents "
+	     << score << " -> " << new_score << ", rewrote 0x"
+	     << std::hex << *rewritten << std::dec << dendl;
+    logger->inc(l_bluestore_defrag_onodes);
+    logger->inc(l_bluestore_defrag_bytes, *rewritten);
+    if (new_score < score) {
+      logger->inc(l_bluestore_defrag_extents_merged, score - new_score);
+    }
+    txc->bytes = *rewritten;
+    _txc_calc_cost(txc);
+    _txc_write_nodes(txc, txc->t);
+    if (txc->deferred_txn) {
+      txc->deferred_txn->seq = ++deferred_seq;
+      bufferlist bl;
+      encode(*txc->deferred_txn, bl);
+      string key;
+      get_deferred_key(txc->deferred_txn->seq, &key);
+      txc->t->set(PREFIX_DEFERRED, key, bl);
+    }
+    _txc_finalize_kv(txc, txc->t);
+  }
+
+  auto tstart = mono_clock::now();
+  if (!throttle.try_start_transaction(*db, *txc, tstart)) {
+    ++deferred_aggressive;
+    deferred_try_submit();
+    {
+      std::lock_guard l(kv_lock);
+      if (!kv_sync_in_progress) {
+	kv_sync_in_progress = true;
+	kv_cond.notify_one();
+      }
+    }
+    throttle.finish_start_transaction(*db, *txc, tstart);
+    --deferred_aggressive;
+  }
+  logger->inc(l_bluestore_txc);
+  _txc_state_proc(txc);
+  return 0;
+}
+
+void BlueStore::_defrag_set_paused(bool paused)
+{
+  std::lock_guard l(defrag_lock);
+  defrag_paused = paused;
+  defrag_cond.notify_all();
+}
+
+void BlueStore::_dump_defrag_status(Formatter *f)
+{
+  std::lock_guard l(defrag_lock);
+  f->open_object_section("defrag");
+  f->dump_bool("enabled", cct->_conf->bluestore_defrag_enable);
+  f->dump_bool("running", !defrag_stop);
+  f->dump_bool("paused", defrag_paused);
+  f->dump_unsigned("queued", defrag_queue.size());
+  f->dump_unsigned("in_progress", defrag_pending.size() - defrag_queue.size());
+  f->dump_unsigned("onodes", logger->get(l_bluestore_defrag_onodes));
+  f->dump_unsigned("skipped", logger->get(l_bluestore_defrag_skipped));
+  f->dump_unsigned("extents_merged",
+		   logger->get(l_bluestore_defrag_extents_merged));
+  f->dump_unsigned("bytes", logger->get(l_bluestore_defrag_bytes));
+  f->close_section();
+}
+
 int BlueStore::cold_open()
 {
   return _open_db_and_around(true);
@@ -10677,18 +11473,23 @@ void BlueStore::_fsck_check_object_omap(FSCKDepth depth,
     }
   }
   if (repairer &&
-    !o->onode.is_perpg_omap() &&
-    !o->onode.is_pgmeta_omap()) {
-    dout(10) << "fsck converting " << o->oid << " omap to per-pg" << dendl;
+    !o->onode.is_pgmeta_omap() &&
+    (!o->onode.is_perpg_omap() ||
+     (use_compact_omap && !o->onode.is_compact_omap()))) {
+    uint8_t new_flags = o->onode.flags |
+      bluestore_onode_t::FLAG_PERPOOL_OMAP |
+      bluestore_onode_t::FLAG_PERPG_OMAP;
+    if (use_compact_omap) {
+      new_flags |= bluestore_onode_t::FLAG_COMPACT_OMAP;
+    }
+    dout(10) << "fsck converting " << o->oid << " omap to "
+	     << (use_compact_omap ? "compact per-pg" : "per-pg") << dendl;
     bufferlist header;
     map<string, bufferlist> kv;
     {
       KeyValueDB::Transaction txn = db->get_transaction();
       uint64_t txn_cost = 0;
       const string& prefix = Onode::calc_omap_prefix(o->onode.flags);
-      uint8_t new_flags = o->onode.flags |
-	bluestore_onode_t::FLAG_PERPOOL_OMAP |
-	bluestore_onode_t::FLAG_PERPG_OMAP;
       const string& new_omap_prefix = Onode::calc_omap_prefix(new_flags);
 
       KeyValueDB::Iterator it = db->get_iterator(prefix);
@@ -10755,7 +11556,7 @@ void BlueStore::_fsck_check_object_omap(FSCKDepth depth,
       txn->rm_range_keys(old_omap_prefix, old_head, old_tail);
       txn->rmkey(old_omap_prefix, old_tail);
       // set flag
-      o->onode.set_flag(bluestore_onode_t::FLAG_PERPOOL_OMAP | bluestore_onode_t::FLAG_PERPG_OMAP);
+      o->onode.set_flag(new_flags);
       _record_onode(o, txn);
       db->submit_transaction_sync(txn);
       repairer->inc_repaired();
@@ -11316,6 +12117,11 @@ int BlueStore::_fsck_on_open(BlueStore::FSCKDepth depth, bool repair, bluestore_
     derr << "fsck " << w << ": store not yet converted to per-pg omap"
 	 << dendl;
   }
+  if (repair && !compact_omap &&
+      cct->_conf.get_val<bool>("bluestore_omap_compact_keys")) {
+    // must be on disk before the object pass below writes compact keys
+    _enable_compact_omap();
+  }
 
   if (g_conf()->bluestore_debug_fsck_abort) {
     dout(1) << __func__ << " debug abort" << dendl;
@@ -11800,7 +12606,7 @@ int BlueStore::_fsck_on_open(BlueStore::FSCKDepth depth, bool repair, bluestore_
         const char* c = k.c_str();
         c = _key_decode_u64(c, &pool);
         c = _key_decode_u32(c, &hash);
-        c = _key_decode_u64(c, &omap_head);
+        c = _key_decode_omap_nid(c, &omap_head);
         auto p =
 	  pool > 0 ? pool : META_POOL_ID; // we erroneously use pool==0 for
 	                                  // meta (aka pool==-1) objects
@@ -12160,7 +12966,8 @@ void BlueStore::inject_legacy_omap(coll_t cid, ghobject_t oid)
   o->onode.clear_flag(
     bluestore_onode_t::FLAG_PERPG_OMAP |
     bluestore_onode_t::FLAG_PERPOOL_OMAP |
-    bluestore_onode_t::FLAG_PGMETA_OMAP);
+    bluestore_onode_t::FLAG_PGMETA_OMAP |
+    bluestore_onode_t::FLAG_COMPACT_OMAP);
   txn = db->get_transaction();
   _record_onode(o, txn);
   db->submit_transaction_sync(txn);
@@ -12601,8 +13408,9 @@ BlueStore::CollectionRef BlueStore::_get_collection_by_oid(const ghobject_t& oid
 void BlueStore::_queue_reap_collection(CollectionRef& c)
 {
   dout(10) << __func__ << " " << c << " " << c->cid << dendl;
-  // _reap_collections and this in the same thread,
-  // so no need a lock.
+  // kv finalize workers queue here too, while _reap_collections only
+  // runs in kv_finalize_thread
+  std::lock_guard l(removed_collections_lock);
   removed_collections.push_back(c);
 }
 
@@ -12611,8 +13419,7 @@ void BlueStore::_reap_collections()
 
   list<CollectionRef> removed_colls;
   {
-    // _queue_reap_collection and this in the same thread.
-    // So no need a lock.
+    std::lock_guard l(removed_collections_lock);
     if (!removed_collections.empty())
       removed_colls.swap(removed_collections);
     else
@@ -12642,6 +13449,7 @@ void BlueStore::_reap_collections()
   if (removed_colls.empty()) {
     dout(10) << __func__ << " all reaped" << dendl;
   } else {
+    std::lock_guard l(removed_collections_lock);
     removed_collections.splice(removed_collections.begin(), removed_colls);
   }
 }
@@ -13076,6 +13884,11 @@ int BlueStore::_generate_read_result_bl(
   bool* csum_error,
   bufferlist& bl)
 {
+  // Everything but decompressed data and holes is handed out as
+  // substr_of() the aio buffers or cache Buffers, without a memcpy;
+  // track the split so the copy cost of a workload is visible.
+  uint64_t copied_bytes = 0;
+  uint64_t zero_bytes = 0;
  // enumerate and decompress desired blobs
   auto p = compressed_blob_bls.begin();
   blobs2read_t::iterator b2r_it = blobs2read.begin();
@@ -13107,6 +13920,7 @@ int BlueStore::_generate_read_result_bl(
         for (auto& r : req.regs) {
           ready_regions[r.logical_offset].substr_of(
             raw_bl, r.blob_xoffset, r.length);
+          copied_bytes += r.length;
         }
       }
     } else {
@@ -13154,12 +13968,16 @@ int BlueStore::_generate_read_result_bl(
                << ": zeros for 0x" << (pos + offset) << "~" << l
                << std::dec << dendl;
       bl.append_zero(l);
+      zero_bytes += l;
       pos += l;
     }
   }
   ceph_assert(bl.length() == length);
   ceph_assert(pos == length);
   ceph_assert(pr == pr_end);
+  logger->inc(l_bluestore_read_shared_bytes,
+              length - zero_bytes - copied_bytes);
+  logger->inc(l_bluestore_read_copied_bytes, zero_bytes + copied_bytes);
   return 0;
 }
 
@@ -13313,6 +14131,12 @@ int BlueStore::_do_read(
     _measure_runtime_frag(c, blobs2read);
   }
 
+  if (cct->_conf->bluestore_defrag_enable &&
+      !(op_flags & CEPH_OSD_OP_FLAG_SCRUB) &&
+      num_ios >= (int64_t)cct->_conf->bluestore_defrag_min_extents) {
+    _defrag_note(c, o);
+  }
+
   if ((op_flags & CEPH_OSD_OP_FLAG_SCRUB) && cct->_conf->bluestore_frag_static) {
     if (!o->extent_map.extent_map.empty()) {
       o->extent_map.fault_range(db, 0, OBJECT_MAX_SIZE);
@@ -13722,6 +14546,12 @@ int BlueStore::_do_readv(
     );
   }
 
+  if (cct->_conf->bluestore_defrag_enable &&
+      !(op_flags & CEPH_OSD_OP_FLAG_SCRUB) &&
+      num_ios >= cct->_conf->bluestore_defrag_min_extents) {
+    _defrag_note(c, o);
+  }
+
   if ((op_flags & CEPH_OSD_OP_FLAG_SCRUB) && cct->_conf->bluestore_frag_static) {
     if (!o->extent_map.extent_map.empty()) {
       o->extent_map.fault_range(db, 0, OBJECT_MAX_SIZE);
@@ -13772,6 +14602,147 @@ int BlueStore::_do_readv(
   return bl.length();
 }
 
+int BlueStore::read_batch(
+  CollectionHandle &c_,
+  std::vector<read_op_t>& ops,
+  uint32_t op_flags)
+{
+  auto start = mono_clock::now();
+  Collection *c = static_cast<Collection *>(c_.get());
+  dout(15) << __func__ << " " << c->get_cid() << " " << ops.size() << " ops"
+	   << dendl;
+  if (!c->exists)
+    return -ENOENT;
+
+  bool buffered = false;
+  if (op_flags & CEPH_OSD_OP_FLAG_FADVISE_WILLNEED) {
+    buffered = true;
+  } else if (cct->_conf->bluestore_default_buffered_read &&
+	     (op_flags & (CEPH_OSD_OP_FLAG_FADVISE_DONTNEED |
+			  CEPH_OSD_OP_FLAG_FADVISE_NOCACHE)) == 0) {
+    buffered = true;
+  }
+  int read_cache_policy = (op_flags & CEPH_OSD_OP_FLAG_SCRUB) ?
+    BufferSpace::BYPASS_CLEAN_CACHE : 0;
+
+  struct pending_t {
+    OnodeRef o;
+    uint64_t offset = 0;
+    uint64_t length = 0;
+    ready_regions_t ready_regions;
+    vector<bufferlist> compressed_blob_bls;
+    blobs2read_t blobs2read;
+  };
+  vector<pending_t> pending(ops.size());
+  logger->inc(l_bluestore_read_batch_ops, ops.size());
+  {
+    std::shared_lock l(c->lock);
+    // gather the device reads of all objects into a single submission
+    IOContext ioc(cct, NULL, !cct->_conf->bluestore_fail_eio);
+    for (size_t i = 0; i < ops.size(); ++i) {
+      auto& op = ops[i];
+      auto& p = pending[i];
+      op.bl.clear();
+      op.r = 0;
+      OnodeRef o = c->get_onode(op.oid, false);
+      if (!o || !o->exists) {
+	op.r = -ENOENT;
+	continue;
+      }
+      p.offset = op.offset;
+      p.length = op.len;
+      if (p.offset == p.length && p.offset == 0)
+	p.length = o->onode.size;
+      if (p.offset >= o->onode.size) {
+	continue;
+      }
+      if (p.offset + p.length > o->onode.size) {
+	p.length = o->onode.size - p.offset;
+      }
+      o->extent_map.fault_range(db, p.offset, p.length);
+      _read_cache(o, p.offset, p.length, read_cache_policy,
+		  p.ready_regions, p.blobs2read);
+      int r = _prepare_read_ioc(p.blobs2read, &p.compressed_blob_bls, &ioc);
+      if (r < 0) {
+	op.r = r;
+	continue;
+      }
+      if (cct->_conf->bluestore_frag_runtime) {
+	_measure_runtime_frag(c, p.blobs2read);
+      }
+      p.o = o;
+    }
+
+    bool io_error = false;
+    if (ioc.has_pending_aios()) {
+      auto num_ios = ioc.get_num_ios();
+#if defined(HAVE_LIBAIO) || defined(HAVE_POSIXAIO)
+      // submit in device order so neighbouring objects' reads can merge
+      ioc.pending_aios.sort([](const aio_t& a, const aio_t& b) {
+	return a.offset < b.offset;
+      });
+#endif
+      bdev->aio_submit(&ioc);
+      ioc.aio_wait();
+      io_error = ioc.get_return_value() < 0;
+      log_latency_fn(__func__,
+	l_bluestore_read_wait_aio_lat,
+	mono_clock::now() - start,
+	cct->_conf->bluestore_log_op_age,
+	[&](auto lat) { return ", num_ios = " + stringify(num_ios); },
+	l_bluestore_slow_read_wait_aio_count
+      );
+    }
+
+    for (size_t i = 0; i < ops.size(); ++i) {
+      auto& op = ops[i];
+      auto& p = pending[i];
+      if (!p.o) {
+	continue;
+      }
+      bool csum_error = false;
+      int r = 0;
+      if (!io_error) {
+	r = _generate_read_result_bl(p.o, p.offset, p.length,
+				     p.ready_regions, p.compressed_blob_bls,
+				     p.blobs2read,
+				     buffered && !ioc.skip_cache(),
+				     &csum_error, op.bl);
+      }
+      if (io_error || csum_error) {
+	// we can't tell which object failed: redo this one on its own,
+	// with the usual retry handling
+	op.bl.clear();
+	r = _do_read(c, p.o, p.offset, p.length, op.bl, op_flags,
+		     csum_error ? 1 : 0);
+      } else if (r >= 0) {
+	r = op.bl.length();
+      }
+      op.r = r;
+      if (r == -EIO) {
+	logger->inc(l_bluestore_read_eio);
+      }
+    }
+  }
+
+  for (auto& op : ops) {
+    if (op.r >= 0 && _debug_data_eio(op.oid)) {
+      op.r = -EIO;
+      op.bl.clear();
+      derr << __func__ << " " << c->cid << " " << op.oid << " INJECT EIO"
+	   << dendl;
+    }
+    dout(10) << __func__ << " " << c->cid << " " << op.oid
+	     << " 0x" << std::hex << op.offset << "~" << op.len << std::dec
+	     << " = " << op.r << dendl;
+  }
+  log_latency(__func__,
+    l_bluestore_read_lat,
+    mono_clock::now() - start,
+    cct->_conf->bluestore_log_op_age);
+  return 0;
+}
+
 int BlueStore::dump_onode(CollectionHandle &c_,
   const ghobject_t& oid,
   const string& section_name,
@@ -14210,14 +15181,25 @@ int BlueStore::omap_get_values(
     const string& prefix = o->get_omap_prefix();
     o->get_omap_key(string(), &final_key);
     size_t base_key_len = final_key.size();
-    for (set<string>::const_iterator p = keys.begin(); p != keys.end(); ++p) {
+    // look all keys up in one batch so that the kv store can probe
+    // block cache and SSTs for them in parallel
+    vector<pair<string, string>> db_keys;
+    db_keys.reserve(keys.size());
+    for (auto& k : keys) {
       final_key.resize(base_key_len); // keep prefix
-      final_key += *p;
-      bufferlist val;
-      if (db->get(prefix, final_key, &val) >= 0) {
-	dout(30) << __func__ << "  got " << pretty_binary_string(final_key)
+      final_key += k;
+      db_keys.emplace_back(prefix, final_key);
+    }
+    vector<bufferlist> vals;
+    vector<int> rs;
+    db->multi_get(db_keys, &vals, &rs);
+    size_t i = 0;
+    for (auto p = keys.begin(); p != keys.end(); ++p, ++i) {
+      if (rs[i] >= 0) {
+	dout(30) << __func__ << "  got "
+		 << pretty_binary_string(db_keys[i].second)
 		 << " -> " << *p << dendl;
-	out->insert(make_pair(*p, val));
+	out->emplace_hint(out->end(), *p, std::move(vals[i]));
       }
     }
   }
@@ -14260,16 +15242,26 @@ int BlueStore::omap_check_keys(
     const string& prefix = o->get_omap_prefix();
     o->get_omap_key(string(), &final_key);
     size_t base_key_len = final_key.size();
-    for (set<string>::const_iterator p = keys.begin(); p != keys.end(); ++p) {
+    vector<pair<string, string>> db_keys;
+    db_keys.reserve(keys.size());
+    for (auto& k : keys) {
       final_key.resize(base_key_len); // keep prefix
-      final_key += *p;
-      bufferlist val;
-      if (db->get(prefix, final_key, &val) >= 0) {
-	dout(30) << __func__ << "  have " << pretty_binary_string(final_key)
+      final_key += k;
+      db_keys.emplace_back(prefix, final_key);
+    }
+    vector<bufferlist> vals;
+    vector<int> rs;
+    db->multi_get(db_keys, &vals, &rs);
+    size_t i = 0;
+    for (auto p = keys.begin(); p != keys.end(); ++p, ++i) {
+      if (rs[i] >= 0) {
+	dout(30) << __func__ << "  have "
+		 << pretty_binary_string(db_keys[i].second)
 		 << " -> " << *p << dendl;
 	out->insert(*p);
       } else {
-	dout(30) << __func__ << "  miss " << pretty_binary_string(final_key)
+	dout(30) << __func__ << "  miss "
+		 << pretty_binary_string(db_keys[i].second)
 		 << " -> " << *p << dendl;
       }
     }
@@ -14399,7 +15391,8 @@ void BlueStore::_prepare_ondisk_format_super(KeyValueDB::Transaction& t)
   }
   {
     bufferlist bl;
-    encode(min_compat_ondisk_format, bl);
+    encode(compact_omap ? compact_omap_compat_ondisk_format :
+			  min_compat_ondisk_format, bl);
     t->set(PREFIX_SUPER, "min_compat_ondisk_format", bl);
   }
 }
@@ -14588,6 +15581,13 @@ int BlueStore::_upgrade_super()
       ceph_assert(r == 0);
       ondisk_format = 4;
     }
+    if (ondisk_format == 4) {
+      // changes:
+      // - onode may have FLAG_COMPACT_OMAP.  Only once bluestore_omap_compact_keys
+      //   is enabled, which also sets the compact_omap key in super and raises
+      //   min_compat_ondisk_format to 5.
+      ondisk_format = 5;
+    }
     // This to be the last operation
     _prepare_ondisk_format_super(t);
     int r = db->submit_transaction_sync(t);
@@ -15035,6 +16035,15 @@ void BlueStore::_txc_committed_kv(TransContext *txc)
     }
   }
   throttle.log_state_latency(*txc, logger, l_bluestore_state_kv_committing_lat);
+  if (txc->write_classes[DeferredPolicy::DIRECT] ||
+      txc->write_classes[DeferredPolicy::DEFERRED]) {
+    txc->kv_commit_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      mono_clock::now() - txc->start).count();
+    // direct writes are in place once the txc commits; deferred ones are
+    // noted when their deferred io completes
+    deferred_policy.note_mask(txc->write_classes[DeferredPolicy::DIRECT],
+			      false, txc->kv_commit_ns);
+  }
   log_latency_fn(
     __func__,
     l_bluestore_commit_lat,
@@ -15071,6 +16080,10 @@ void BlueStore::_txc_finish(TransContext *txc)
     _queue_reap_collection(txc->removed_collections.front());
     txc->removed_collections.pop_front();
   }
+  for (auto& [prefix, start, end] : txc->compact_ranges) {
+    db->compact_range_async(prefix, start, end);
+  }
+  logger->inc(l_bluestore_kv_range_compactions, txc->compact_ranges.size());
 
   OpSequencerRef osr = txc->osr;
   bool empty = false;
@@ -15323,6 +16336,13 @@ void BlueStore::_kv_start()
   finisher.start();
   kv_sync_thread.create("bstore_kv_sync");
   kv_finalize_thread.create("bstore_kv_final");
+  ceph_assert(kv_finalize_workers.empty());
+  for (unsigned i = 1; i < cct->_conf->bluestore_kv_finalize_threads; ++i) {
+    kv_finalize_workers.emplace_back(std::make_unique<KVFinalizeWorker>(this));
+    kv_finalize_workers.back()->create(
+      ("bstore_kv_fin" + stringify(i)).c_str());
+  }
+  _compress_start();
 }
 
 void BlueStore::_kv_stop()
@@ -15336,6 +16356,18 @@ void BlueStore::_kv_stop()
     kv_stop = true;
     kv_cond.notify_all();
   }
+  kv_sync_thread.join();
+  // the workers may still queue collections to reap; stop them first so
+  // kv_finalize_thread gets to reap those before it exits
+  for (auto& w : kv_finalize_workers) {
+    {
+      std::lock_guard l(w->lock);
+      w->stop = true;
+      w->cond.notify_all();
+    }
+    w->join();
+  }
+  kv_finalize_workers.clear();
   {
     std::unique_lock l{kv_finalize_lock};
     while (!kv_finalize_started) {
@@ -15344,8 +16376,8 @@ void BlueStore::_kv_stop()
     kv_finalize_stop = true;
     kv_finalize_cond.notify_all();
   }
-  kv_sync_thread.join();
   kv_finalize_thread.join();
+  _compress_stop();
   ceph_assert(removed_collections.empty());
   {
     std::lock_guard l(kv_lock);
@@ -15566,6 +16598,11 @@ void BlueStore::_kv_sync_thread()
       }
 #endif
 
+      logger->inc(l_bluestore_kv_sync_batch, committing_size);
+      logger->inc(l_bluestore_kv_final_queued, committing_size);
+      if (!kv_finalize_workers.empty()) {
+	_kv_queue_finalize(kv_committing);
+      }
       {
 	std::unique_lock m{kv_finalize_lock};
 	if (kv_committing_to_finalize.empty()) {
@@ -15649,8 +16686,13 @@ void BlueStore::_kv_finalize_thread()
     ceph_assert(deferred_stable.empty());
     if (kv_committing_to_finalize.empty() &&
 	deferred_stable_to_finalize.empty()) {
-      if (kv_finalize_stop)
+      if (kv_finalize_stop) {
+	// pick up what the (now joined) finalize workers queued
+	l.unlock();
+	_reap_collections();
+	l.lock();
 	break;
+      }
       dout(20) << __func__ << " sleep" << dendl;
       kv_finalize_in_progress = false;
       kv_finalize_cond.wait(l);
@@ -15664,6 +16706,7 @@ void BlueStore::_kv_finalize_thread()
 
       auto start = mono_clock::now();
 
+      logger->dec(l_bluestore_kv_final_queued, kv_committed.size());
       while (!kv_committed.empty()) {
 	TransContext *txc = kv_committed.front();
 	ceph_assert(txc->get_state() == TransContext::STATE_KV_SUBMITTED);
@@ -15703,6 +16746,162 @@ void BlueStore::_kv_finalize_thread()
   kv_finalize_started = false;
 }
 
+void BlueStore::_kv_queue_finalize(deque<TransContext*>& committed)
+{
+  // move the txcs of sequencers owned by a worker out of committed,
+  // leaving the rest (in order) for kv_finalize_thread
+  unsigned n = kv_finalize_workers.size() + 1;
+  std::vector<deque<TransContext*>> batches(n);
+  for (auto txc : committed) {
+    batches[txc->osr->get_sequencer_id() % n].push_back(txc);
+  }
+  committed.swap(batches[0]);
+  for (unsigned i = 1; i < n; ++i) {
+    if (batches[i].empty()) {
+      continue;
+    }
+    auto& w = kv_finalize_workers[i - 1];
+    std::lock_guard l(w->lock);
+    bool was_empty = w->committed.empty();
+    w->committed.insert(w->committed.end(),
+			batches[i].begin(), batches[i].end());
+    if (was_empty) {
+      w->cond.notify_one();
+    }
+  }
+}
+
+void BlueStore::_compress_start()
+{
+  ceph_assert(compress_workers.empty());
+  compress_stop = false;
+  for (unsigned i = 0; i < cct->_conf->bluestore_compression_threads; ++i) {
+    compress_workers.emplace_back(std::make_unique<CompressWorker>(this));
+    compress_workers.back()->create(("bstore_compr" + stringify(i)).c_str());
+  }
+}
+
+void BlueStore::_compress_stop()
+{
+  {
+    std::lock_guard l(compress_lock);
+    compress_stop = true;
+    compress_cond.notify_all();
+  }
+  for (auto& w : compress_workers) {
+    w->join();
+  }
+  compress_workers.clear();
+  ceph_assert(compress_queue.empty());
+}
+
+void BlueStore::_compress_worker()
+{
+  dout(10) << __func__ << " start" << dendl;
+  std::unique_lock l(compress_lock);
+  while (true) {
+    if (compress_queue.empty()) {
+      if (compress_stop)
+	break;
+      compress_cond.wait(l);
+      continue;
+    }
+    auto b = std::move(compress_queue.front());
+    compress_queue.pop_front();
+    logger->set(l_bluestore_compress_queue, compress_queue.size());
+    l.unlock();
+    _compress_batch_run(b.get(), true);
+    b.reset();
+    l.lock();
+  }
+  dout(10) << __func__ << " finish" << dendl;
+}
+
+void BlueStore::_compress_batch_run(CompressBatch *b, bool offloaded)
+{
+  size_t n = 0;
+  for (size_t i = b->next++; i < b->n; i = b->next++) {
+    auto& r = b->out[i];
+    auto start = mono_clock::now();
+    r.r = b->compressor->compress(*b->in[i], r.out, r.compressor_message);
+    r.lat = mono_clock::now() - start;
+    ++n;
+  }
+  if (n == 0) {
+    return;
+  }
+  if (offloaded) {
+    logger->inc(l_bluestore_compress_offloaded, n);
+  }
+  std::lock_guard l(b->lock);
+  b->done += n;
+  if (b->done == b->n) {
+    b->cond.notify_all();
+  }
+}
+
+void BlueStore::_compress_blobs(
+  Compressor *compressor,
+  const vector<bufferlist*>& in,
+  vector<compress_result_t> *out)
+{
+  out->clear();
+  out->resize(in.size());
+  auto b = std::make_shared<CompressBatch>(compressor, in, *out);
+  size_t helpers = 0;
+  if (in.size() > 1 && !compress_workers.empty()) {
+    std::lock_guard l(compress_lock);
+    // fall back to compressing inline rather than queueing behind a
+    // backlog; the submitter is always one of the hands on the batch
+    if (compress_queue.size() < compress_workers.size() * 2) {
+      helpers = std::min(in.size() - 1, compress_workers.size());
+      for (size_t i = 0; i < helpers; ++i) {
+	compress_queue.push_back(b);
+      }
+      logger->set(l_bluestore_compress_queue, compress_queue.size());
+      compress_cond.notify_all();
+    }
+  }
+  _compress_batch_run(b.get(), false);
+  if (helpers) {
+    auto start = mono_clock::now();
+    std::unique_lock l(b->lock);
+    b->cond.wait(l, [&] { return b->done == b->n; });
+    logger->tinc(l_bluestore_compress_wait_lat, mono_clock::now() - start);
+  }
+}
+
+void BlueStore::_kv_finalize_worker(KVFinalizeWorker *w)
+{
+  deque<TransContext*> kv_committed;
+  dout(10) << __func__ << " start" << dendl;
+  std::unique_lock l(w->lock);
+  while (true) {
+    if (w->committed.empty()) {
+      if (w->stop)
+	break;
+      w->cond.wait(l);
+      continue;
+    }
+    kv_committed.swap(w->committed);
+    l.unlock();
+    auto start = mono_clock::now();
+    logger->dec(l_bluestore_kv_final_queued, kv_committed.size());
+    while (!kv_committed.empty()) {
+      TransContext *txc = kv_committed.front();
+      ceph_assert(txc->get_state() == TransContext::STATE_KV_SUBMITTED);
+      _txc_state_proc(txc);
+      kv_committed.pop_front();
+    }
+    log_latency("kv_final",
+      l_bluestore_kv_final_lat,
+      mono_clock::now() - start,
+      cct->_conf->bluestore_log_op_age);
+    l.lock();
+  }
+  dout(10) << __func__ << " finish" << dendl;
+}
+
 
 bluestore_deferred_op_t *BlueStore::_get_deferred_op(
   TransContext *txc, uint64_t len)
@@ -15711,6 +16910,7 @@ bluestore_deferred_op_t *BlueStore::_get_deferred_op(
     txc->deferred_txn = new bluestore_deferred_transaction_t;
   }
   txc->deferred_txn->ops.push_back(bluestore_deferred_op_t());
+  _note_write_path(txc, len, true);
   logger->inc(l_bluestore_issued_deferred_writes);
   logger->inc(l_bluestore_issued_deferred_write_bytes, len);
   return &txc->deferred_txn->ops.back();
@@ -15895,9 +17095,18 @@ void BlueStore::_deferred_aio_finish(OpSequencer *osr)
   {
     uint64_t costs = 0;
     {
+      uint64_t n = b->txcs.size();
       for (auto& i : b->txcs) {
 	TransContext *txc = &i;
-	throttle.log_state_latency(*txc, logger, l_bluestore_state_deferred_aio_wait_lat);
+	auto lat = throttle.log_state_latency(
+	  *txc, logger, l_bluestore_state_deferred_aio_wait_lat);
+	if (txc->write_classes[DeferredPolicy::DEFERRED]) {
+	  // the batch io is shared by all of its txcs
+	  deferred_policy.note_mask(
+	    txc->write_classes[DeferredPolicy::DEFERRED], true,
+	    txc->kv_commit_ns +
+	    std::chrono::duration_cast<std::chrono::nanoseconds>(lat).count() / n);
+	}
 	txc->set_state(TransContext::STATE_DEFERRED_CLEANUP);
 	costs += txc->cost;
       }
@@ -16750,7 +17959,7 @@ void BlueStore::_do_write_small(
                    << tail_pad << std::dec << " of mutable " << *b << dendl;
 
           if (!g_conf()->bluestore_debug_omit_block_device_write) {
-          if (b_len < prefer_deferred_size) {
+          if (deferred_policy.use_deferred(b_len, prefer_deferred_size)) {
               dout(20) << __func__ << " deferring small 0x" << std::hex
 		       << b_len << std::dec << " unused write via deferred" << dendl;
               bluestore_deferred_op_t *op = _get_deferred_op(txc, bl.length());
@@ -16763,6 +17972,7 @@ void BlueStore::_do_write_small(
                                 });
               op->data = bl;
           } else {
+              _note_write_path(txc, b_len, false);
               b->get_blob().map_bl(
                   b_off, bl,
 		[&](uint64_t offset, bufferlist& t) {
@@ -17388,18 +18598,31 @@ int BlueStore::_do_alloc_write(
   // and the condition is : (data_size < deferred).
 
   auto max_bsize = std::max(wctx->target_blob_size, min_alloc_size);
+
+  // compress all eligible blobs up front so that they can be spread over
+  // the compression workers
+  vector<compress_result_t> compressed;
+  if (wctx->compressor) {
+    vector<bufferlist*> to_compress;
+    for (auto& wi : wctx->writes) {
+      if (wi.blob_length > min_alloc_size) {
+	ceph_assert(wi.b_off == 0);
+	ceph_assert(wi.blob_length == wi.bl.length());
+	to_compress.push_back(&wi.bl);
+      }
+    }
+    _compress_blobs(wctx->compressor.get(), to_compress, &compressed);
+  }
+  auto cres = compressed.begin();
   for (auto& wi : wctx->writes) {
     if (wctx->compressor && wi.blob_length > min_alloc_size) {
       auto start = mono_clock::now();
-
-      // compress
-      ceph_assert(wi.b_off == 0);
-      ceph_assert(wi.blob_length == wi.bl.length());
+      compress_result_t& cr = *cres++;
 
       // FIXME: memory alignment here is bad
-      bufferlist t;
-      std::optional<int32_t> compressor_message;
-      int r = wctx->compressor->compress(wi.bl, t, compressor_message);
+      bufferlist& t = cr.out;
+      std::optional<int32_t>& compressor_message = cr.compressor_message;
+      int r = cr.r;
       uint64_t want_len_raw = wi.blob_length * wctx->crr;
       uint64_t want_len = p2roundup(want_len_raw, min_alloc_size);
       bool rejected = false;
@@ -17465,7 +18688,7 @@ int BlueStore::_do_alloc_write(
       }
       log_latency("compress@_do_alloc_write",
 	l_bluestore_compress_lat,
-        mono_clock::now() - start,
+        cr.lat + (mono_clock::now() - start),
 	cct->_conf->bluestore_log_op_age );
     } else {
       need += wi.blob_length;
@@ -17502,6 +18725,10 @@ int BlueStore::_do_alloc_write(
   auto prealloc_pos = prealloc.begin();
   ceph_assert(prealloc_pos != prealloc.end());
 
+  auto prefer_deferred_size_snapshot = prefer_deferred_size.load();
+  // one decision for the whole write, not per blob
+  bool deferred = deferred_policy.use_deferred(data_size,
+					       prefer_deferred_size_snapshot);
   for (auto& wi : wctx->writes) {
     bluestore_blob_t& dblob = wi.b->dirty_blob();
     uint64_t b_off = wi.b_off;
@@ -17563,7 +18790,6 @@ int BlueStore::_do_alloc_write(
 
     PExtentVector extents;
     int64_t left = final_length;
-    auto prefer_deferred_size_snapshot = prefer_deferred_size.load();
     while (left > 0) {
       ceph_assert(prealloc_left > 0);
       if (prealloc_pos->length <= left) {
@@ -17619,7 +18845,7 @@ int BlueStore::_do_alloc_write(
 
     // queue io
     if (!g_conf()->bluestore_debug_omit_block_device_write) {
-      if (data_size < prefer_deferred_size_snapshot) {
+      if (deferred) {
 	dout(20) << __func__ << " deferring 0x" << std::hex
 		 << l->length()  << " write via deferred, pds=0x"
                  << prefer_deferred_size_snapshot
@@ -17635,6 +18861,7 @@ int BlueStore::_do_alloc_write(
         ceph_assert(r == 0);
         op->data = *l;
       } else {
+	_note_write_path(txc, l->length(), false);
 	wi.b->get_blob().map_bl(
 	  b_off, *l,
 	  [&](uint64_t offset, bufferlist& t) {
@@ -18565,7 +19792,21 @@ void BlueStore::_do_omap_clear(TransContext *txc, OnodeRef& o)
   string prefix, tail;
   o->get_omap_header(&prefix);
   o->get_omap_tail(&tail);
-  txc->t->rm_range_keys(omap_prefix, prefix, tail);
+  // Large omaps (bucket index shards, PG metadata) would leave one
+  // tombstone per key behind and slow down iteration over the range for
+  // a long time; drop them with a range tombstone and compact the range
+  // once the removal is committed.
+  uint64_t min_bytes = cct->_conf->bluestore_omap_range_delete_min_bytes;
+  if (min_bytes &&
+      (uint64_t)db->estimate_range_size(omap_prefix, prefix, tail) >= min_bytes) {
+    txc->t->rm_range_tombstone(omap_prefix, prefix, tail);
+    if (cct->_conf->bluestore_range_delete_compact) {
+      txc->compact_ranges.emplace_back(omap_prefix, prefix, tail);
+    }
+    logger->inc(l_bluestore_omap_range_deletes);
+  } else {
+    txc->t->rm_range_keys(omap_prefix, prefix, tail);
+  }
   txc->t->rmkey(omap_prefix, tail);
   o->onode.clear_omap_flag();
   dout(20) << __func__ << " remove range start: "
@@ -18605,7 +19846,7 @@ int BlueStore::_omap_setkeys(TransContext *txc,
     if (o->oid.is_pgmeta()) {
       o->onode.set_omap_flags_pgmeta();
     } else {
-      o->onode.set_omap_flags(per_pool_omap == OMAP_BULK);
+      o->onode.set_omap_flags(per_pool_omap == OMAP_BULK, use_compact_omap);
     }
     txc->write_onode(o);
 
@@ -18656,7 +19897,7 @@ int BlueStore::_omap_setheader(TransContext *txc,
     if (o->oid.is_pgmeta()) {
       o->onode.set_omap_flags_pgmeta();
     } else {
-      o->onode.set_omap_flags(per_pool_omap == OMAP_BULK);
+      o->onode.set_omap_flags(per_pool_omap == OMAP_BULK, use_compact_omap);
     }
     txc->write_onode(o);
 
@@ -18813,10 +20054,13 @@ int BlueStore::_clone(TransContext *txc,
     if (newo->oid.is_pgmeta()) {
       newo->onode.set_omap_flags_pgmeta();
     } else {
-      newo->onode.set_omap_flags(per_pool_omap == OMAP_BULK);
+      // keep the key format of the source, it may predate
+      // bluestore_omap_compact_keys
+      newo->onode.set_omap_flags(per_pool_omap == OMAP_BULK,
+				 oldo->onode.is_compact_omap());
     }
-    // check if prefix for omap key is exactly the same size for both objects
-    // otherwise rewrite_omap_key will corrupt data
+    // check if both objects use the same omap key layout, otherwise
+    // rewrite_omap_key will corrupt data
     ceph_assert(oldo->onode.flags == newo->onode.flags);
     const string& prefix = newo->get_omap_prefix();
     string head, tail;
@@ -18832,7 +20076,7 @@ int BlueStore::_clone(TransContext *txc,
 	dout(30) << __func__ << "  got header/data "
 		 << pretty_binary_string(it->key()) << dendl;
         string key;
-	newo->rewrite_omap_key(it->key(), &key);
+	newo->rewrite_omap_key(*oldo, it->key(), &key);
 	txc->t->set(prefix, key, it->value());
       }
       it->next();
@@ -19094,6 +20338,23 @@ void BlueStore::_do_remove_collection(TransContext *txc,
   (*c)->exists = false;
   _osr_register_zombie((*c)->osr.get());
   txc->t->rmkey(PREFIX_COLL, stringify((*c)->cid));
+  if (cct->_conf->bluestore_range_delete_compact) {
+    // the collection's onodes were removed one by one; compact their key
+    // range so the tombstones left behind don't slow down neighbouring
+    // collections' listings
+    ghobject_t temp_start, temp_end, start, end;
+    get_coll_range((*c)->cid, (*c)->cnode.bits, &temp_start, &temp_end,
+		   &start, &end, false);
+    string k_start, k_end;
+    get_object_key(cct, start, &k_start);
+    get_object_key(cct, end, &k_end);
+    txc->compact_ranges.emplace_back(PREFIX_OBJ, k_start, k_end);
+    if ((*c)->cid.is_pg()) {
+      get_object_key(cct, temp_start, &k_start);
+      get_object_key(cct, temp_end, &k_end);
+      txc->compact_ranges.emplace_back(PREFIX_OBJ, k_start, k_end);
+    }
+  }
   c->reset();
 }
 
@@ -125,7 +125,10 @@ enum {
   l_bluestore_csum_lat,
   l_bluestore_read_eio,
   l_bluestore_reads_with_retries,
+  l_bluestore_read_shared_bytes,
+  l_bluestore_read_copied_bytes,
   l_bluestore_read_lat,
+  l_bluestore_read_batch_ops,
   //****************************************
 
   // kv_thread latencies
@@ -134,6 +137,8 @@ enum {
   l_bluestore_kv_commit_lat,
   l_bluestore_kv_sync_lat,
   l_bluestore_kv_final_lat,
+  l_bluestore_kv_sync_batch,
+  l_bluestore_kv_final_queued,
   //****************************************
 
   // write op stats
@@ -157,6 +162,7 @@ enum {
   l_bluestore_issued_deferred_write_bytes,
   l_bluestore_submitted_deferred_writes,
   l_bluestore_submitted_deferred_write_bytes,
+  l_bluestore_prefer_deferred_size,
 
   l_bluestore_write_big_skipped_blobs,
   l_bluestore_write_big_skipped_bytes,
@@ -173,6 +179,9 @@ enum {
   l_bluestore_decompress_lat,
   l_bluestore_compress_success_count,
   l_bluestore_compress_rejected_count,
+  l_bluestore_compress_queue,
+  l_bluestore_compress_offloaded,
+  l_bluestore_compress_wait_lat,
   //****************************************
 
   // onode cache stats
@@ -183,6 +192,9 @@ enum {
   l_bluestore_onode_misses,
   l_bluestore_onode_shard_hits,
   l_bluestore_onode_shard_misses,
+  l_bluestore_onode_shard_packed,
+  l_bluestore_onode_shard_unpacked,
+  l_bluestore_warm_cache_onodes,
   l_bluestore_extents,
   l_bluestore_blobs,
   l_bluestore_spanning_blobs,
@@ -224,6 +236,8 @@ enum {
   l_bluestore_omap_get_keys_lat,
   l_bluestore_omap_get_values_lat,
   l_bluestore_omap_clear_lat,
+  l_bluestore_omap_range_deletes,
+  l_bluestore_kv_range_compactions,
   l_bluestore_clist_lat,
   l_bluestore_remove_lat,
   l_bluestore_truncate_lat,
@@ -249,6 +263,11 @@ enum {
   //****************************************
   l_bluestore_runtime_frag_lat,
   l_bluestore_static_frag_lat,
+  l_bluestore_defrag_queued,
+  l_bluestore_defrag_onodes,
+  l_bluestore_defrag_skipped,
+  l_bluestore_defrag_extents_merged,
+  l_bluestore_defrag_bytes,
   //****************************************
   l_bluestore_last
 };
@@ -275,6 +294,7 @@ public:
   void _set_compression();
   void _set_throttle_params();
   int _set_cache_sizes();
+  void _tune_deferred_policy();
   void _set_max_defer_interval() {
     max_defer_interval =
 	cct->_conf.get_val<double>("bluestore_max_defer_interval");
@@ -972,6 +992,7 @@ public:
       unsigned extents = 0;  ///< count extents in this shard
       bool loaded = false;   ///< true if shard is loaded
       bool dirty = false;    ///< true if shard is dirty and needs reencoding
+      ceph::buffer::list packed; ///< encoded extents of an unloaded shard, if kept in memory
     };
 
     mempool::bluestore_cache_meta::vector<Shard> shards;    ///< shards
@@ -1198,6 +1219,12 @@ public:
       int begin_shard,
       int end_shard);
 
+    /// release decoded Extents (and the Blobs only they reference) of all
+    /// clean loaded shards, keeping each shard in its encoded form; a later
+    /// fault_range() decodes it from memory instead of the DB.
+    /// returns number of extents released
+    unsigned pack_shards();
+
     /// ensure a range of the map is marked dirty
     void dirty_range(uint32_t offset, uint32_t length);
 
@@ -1492,7 +1519,10 @@ public:
       calc_omap_tail(onode.flags, this, out);
     }
 
-    void rewrite_omap_key(const std::string& old, std::string *out);
+    /// rebuild a key of @from's omap for this onode, which may use a
+    /// different nid and hence a prefix of a different length
+    void rewrite_omap_key(const Onode& from, const std::string& old,
+			  std::string *out);
     size_t calc_userkey_offset_in_omap_key() const;
     void decode_omap_key(const std::string& key, std::string *user_key);
 
@@ -1529,6 +1559,12 @@ public:
     std::atomic<uint64_t> num = {0};
     boost::circular_buffer<std::shared_ptr<int64_t>> age_bins;
 
+    /// per-shard lookup stats (onodes for onode shards, bytes for buffer
+    /// shards) and entries evicted by trimming
+    std::atomic<uint64_t> hits = {0};
+    std::atomic<uint64_t> misses = {0};
+    std::atomic<uint64_t> trimmed = {0};
+
     CacheShard(CephContext* cct) : cct(cct), logger(nullptr), age_bins(1) {
       shift_bins();
     }
@@ -1547,12 +1583,19 @@ public:
     }
 
     virtual void _trim_to(uint64_t new_size) = 0;
+    void _trim_to_and_count(uint64_t new_size) {
+      uint64_t before = num;
+      _trim_to(new_size);
+      if (before > num) {
+        trimmed.fetch_add(before - num, std::memory_order_relaxed);
+      }
+    }
     void _trim() {
       if (cct->_conf->objectstore_blackhole) {
 	// do not trim if we are throwing away IOs a layer down
 	return;
       }
-      _trim_to(max);
+      _trim_to_and_count(max);
     }
     void _trim_some() {
       int32_t max_steps = cct->_conf->bluestore_cache_meta_evict_limit;
@@ -1560,7 +1603,7 @@ public:
       if (max_steps >= 2) {
         new_level = std::max((int64_t)num.load() - max_steps, new_level);
       }
-      _trim_to(new_level);
+      _trim_to_and_count(new_level);
     }
     void trim() {
       std::lock_guard l(lock);
@@ -1581,6 +1624,13 @@ public:
       std::lock_guard l(lock);
       return age_bins.capacity();
     }
+    void dump_stats(ceph::Formatter *f) {
+      f->dump_unsigned("num", num);
+      f->dump_unsigned("max", max);
+      f->dump_unsigned("hits", hits.load(std::memory_order_relaxed));
+      f->dump_unsigned("misses", misses.load(std::memory_order_relaxed));
+      f->dump_unsigned("trimmed", trimmed.load(std::memory_order_relaxed));
+    }
     void set_bin_count(uint32_t count) {
       std::lock_guard l(lock);
       age_bins.set_capacity(count);
@@ -1623,6 +1673,13 @@ public:
 
     virtual void maybe_unpin(Onode* o) = 0;
     virtual void add_stats(uint64_t *onodes, uint64_t *pinned_onodes) = 0;
+    /// append up to max cached onode ids, most recently used first
+    virtual void collect_hot(
+      size_t max,
+      std::vector<std::pair<coll_t, ghobject_t>> *out) = 0;
+    /// pack the extent maps of some onodes that have gone cold
+    /// (bluestore_extent_map_pack_min_extents)
+    virtual void pack_cold() = 0;
     bool empty() {
       return _get_num() == 0;
     }
@@ -1981,6 +2038,9 @@ public:
     KeyValueDB::Transaction t; ///< then we will commit this
     std::list<Context*> oncommits;  ///< more commit completions
     std::list<CollectionRef> removed_collections; ///< colls we removed
+    /// (prefix, start, end) kv ranges to compact once this txc is done
+    std::vector<std::tuple<std::string, std::string, std::string>>
+      compact_ranges;
 
     boost::intrusive::list_member_hook<> deferred_queue_item;
     bluestore_deferred_transaction_t *deferred_txn = nullptr; ///< if any
@@ -1996,6 +2056,10 @@ public:
     ceph::mono_clock::time_point start;
     ceph::mono_clock::time_point last_stamp;
 
+    /// DeferredPolicy size classes of the writes sent down each path
+    uint16_t write_classes[2] = {0, 0};
+    uint64_t kv_commit_ns = 0;  ///< start to kv commit, if write_classes
+
     uint64_t last_nid = 0;     ///< if non-zero, highest new nid we allocated
     uint64_t last_blobid = 0;  ///< if non-zero, highest new blobid we allocated
 
@@ -2273,6 +2337,15 @@ public:
       ceph_assert(&q.back() == txc);
       q.pop_back();
     }
+    /// drop a txc that never left STATE_PREPARE, wherever it is queued
+    void unqueue_unused(TransContext* txc) {
+      std::lock_guard l(qlock);
+      ceph_assert(txc->get_state() == TransContext::STATE_PREPARE);
+      q.erase(q.iterator_to(*txc));
+      if (q.empty()) {
+	qcond.notify_all();
+      }
+    }
 
     void drain() {
       std::unique_lock l(qlock);
@@ -2382,6 +2455,75 @@ public:
       return NULL;
     }
   };
+  /// additional finalizer for committed txcs of a subset of sequencers;
+  /// the primary kv_finalize_thread keeps deferred cleanup and reaping
+  struct KVFinalizeWorker : public Thread {
+    BlueStore *store;
+    ceph::mutex lock = ceph::make_mutex("BlueStore::KVFinalizeWorker::lock");
+    ceph::condition_variable cond;
+    std::deque<TransContext*> committed;  ///< pending finalization
+    bool stop = false;
+    explicit KVFinalizeWorker(BlueStore *s) : store(s) {}
+    void *entry() override {
+      store->_kv_finalize_worker(this);
+      return NULL;
+    }
+  };
+
+  /// outcome of compressing one blob, see _compress_blobs()
+  struct compress_result_t {
+    int r = 0;
+    ceph::buffer::list out;
+    std::optional<int32_t> compressor_message;
+    ceph::timespan lat;
+  };
+
+  /// blobs compressed in parallel by the submitter and compress_workers;
+  /// items are claimed through 'next', and in/out are only touched for a
+  /// claimed item since the submitter owns them until done == n
+  struct CompressBatch {
+    Compressor *compressor;
+    const std::vector<ceph::buffer::list*>& in;
+    std::vector<compress_result_t>& out;
+    const size_t n;
+    std::atomic<size_t> next = {0};
+    ceph::mutex lock = ceph::make_mutex("BlueStore::CompressBatch::lock");
+    ceph::condition_variable cond;
+    size_t done = 0;  ///< protected by lock
+    CompressBatch(Compressor *c,
+		  const std::vector<ceph::buffer::list*>& i,
+		  std::vector<compress_result_t>& o)
+      : compressor(c), in(i), out(o), n(i.size()) {}
+  };
+
+  struct CompressWorker : public Thread {
+    BlueStore *store;
+    explicit CompressWorker(BlueStore *s) : store(s) {}
+    void *entry() override {
+      store->_compress_worker();
+      return NULL;
+    }
+  };
+
+  /// prefetches onodes recorded at the last clean shutdown
+  struct WarmCacheThread : public Thread {
+    BlueStore *store;
+    explicit WarmCacheThread(BlueStore *s) : store(s) {}
+    void *entry() override {
+      store->_warm_cache_prefetch();
+      return NULL;
+    }
+  };
+
+  /// rewrites fragmented onodes queued by reads, see _defrag_onode()
+  struct DefragThread : public Thread {
+    BlueStore *store;
+    explicit DefragThread(BlueStore *s) : store(s) {}
+    void *entry() override {
+      store->_defrag_thread_entry();
+      return NULL;
+    }
+  };
 
   struct BigDeferredWriteContext {
     uint64_t off = 0;     // original logical offset
@@ -2405,6 +2547,83 @@ public:
     bool apply_defer();
   };
 
+  /// Adaptive prefer_deferred_size (bluestore_deferred_adaptive).
+  /// Writes are sampled per power-of-two size class of the individual
+  /// write and per path.  A direct write costs the txc commit latency (which
+  /// waits for its aio); a deferred write costs the txc commit latency plus
+  /// its share of the deferred batch io.  A small fraction of the writes in
+  /// the two classes around the boundary are sent down the other path, so
+  /// both costs stay known there, and the tuner moves the boundary one class
+  /// at a time when one path is clearly cheaper for the same class, never
+  /// above the configured prefer_deferred_size.
+  struct DeferredPolicy {
+    static constexpr unsigned CLASSES = 16;
+    enum { DIRECT = 0, DEFERRED = 1 };
+    typedef uint16_t class_mask_t;  ///< one bit per size class
+
+    struct lat_t {
+      std::atomic<uint64_t> sum_ns = {0};
+      std::atomic<uint64_t> count = {0};
+    };
+    lat_t lat[CLASSES][2];
+
+    // below are only touched by the tuner (and the asok dump)
+    ceph::mutex lock = ceph::make_mutex("BlueStore::DeferredPolicy::lock");
+    uint64_t last_sum_ns[CLASSES][2] = {};
+    uint64_t last_count[CLASSES][2] = {};
+    double avg_ns[CLASSES][2] = {};   ///< last interval average, 0 if unknown
+    uint64_t interval_count[CLASSES][2] = {};
+
+    std::atomic<bool> enabled = {false};
+    std::atomic<uint64_t> base = {4096};     ///< upper bound of class 0
+    std::atomic<uint64_t> max_size = {0};    ///< configured prefer_deferred_size
+    std::atomic<uint64_t> probe_interval = {0}; ///< 1 in n boundary writes flips, 0 = never
+    std::atomic<uint64_t> probe_seq = {0};
+
+    /// class c holds lengths in [base << (c - 1), base << c)
+    unsigned size_class(uint64_t len) const {
+      uint64_t b = base;
+      unsigned c = 0;
+      while (c + 1 < CLASSES && len >= (b << c)) {
+	++c;
+      }
+      return c;
+    }
+    /// write path decision for a single write of len bytes
+    bool use_deferred(uint64_t len, uint64_t cur) {
+      bool deferred = len < cur;
+      uint64_t n = probe_interval;
+      if (!enabled || !n || cur < base) {
+	return deferred;
+      }
+      // classes 0..k are deferred, k+1.. are direct
+      unsigned k = size_class(cur - 1);
+      unsigned c = size_class(len);
+      if ((c == k || c == k + 1) && probe_seq++ % n == 0) {
+	// never defer more than the configured prefer_deferred_size
+	if (deferred || len < max_size) {
+	  deferred = !deferred;
+	}
+      }
+      return deferred;
+    }
+    void note(unsigned c, bool deferred, uint64_t ns) {
+      auto& l = lat[c][deferred ? DEFERRED : DIRECT];
+      l.sum_ns += ns;
+      ++l.count;
+    }
+    void note_mask(class_mask_t mask, bool deferred, uint64_t ns) {
+      for (unsigned c = 0; mask; ++c, mask >>= 1) {
+	if (mask & 1) {
+	  note(c, deferred, ns);
+	}
+      }
+    }
+    /// fold in samples since the last call and return the new threshold
+    uint64_t update(uint64_t cur, double ratio, uint64_t min_samples);
+    void dump(ceph::Formatter *f, uint64_t cur);
+  };
+
   class Writer;
   friend class Writer;
 
@@ -2483,9 +2702,32 @@ private:
   std::deque<TransContext*> kv_committing_to_finalize;   ///< pending finalization
   std::deque<DeferredBatch*> deferred_stable_to_finalize; ///< pending finalization
   bool kv_finalize_in_progress = false;
+  /// committed txcs are spread over kv_finalize_thread (index 0) and these
+  /// by sequencer, so each sequencer is still finalized in commit order
+  std::vector<std::unique_ptr<KVFinalizeWorker>> kv_finalize_workers;
+
+  std::vector<std::unique_ptr<CompressWorker>> compress_workers;
+  ceph::mutex compress_lock = ceph::make_mutex("BlueStore::compress_lock");
+  ceph::condition_variable compress_cond;
+  std::deque<std::shared_ptr<CompressBatch>> compress_queue;
+  bool compress_stop = false;
+
+  std::unique_ptr<WarmCacheThread> warm_cache_thread;
+  std::vector<std::pair<coll_t, ghobject_t>> warm_cache_keys; ///< to prefetch
+  std::atomic<bool> warm_cache_stop = {false};
+
+  std::unique_ptr<DefragThread> defrag_thread;
+  ceph::mutex defrag_lock = ceph::make_mutex("BlueStore::defrag_lock");
+  ceph::condition_variable defrag_cond;
+  bool defrag_stop = true;
+  bool defrag_paused = false;
+  std::deque<std::pair<coll_t, ghobject_t>> defrag_queue;
+  std::set<std::pair<coll_t, ghobject_t>> defrag_pending; ///< queued or running
 
   PerfCounters *logger = nullptr;
 
+  ceph::mutex removed_collections_lock =
+    ceph::make_mutex("BlueStore::removed_collections_lock");
   std::list<CollectionRef> removed_collections;
 
   ceph::shared_mutex debug_read_error_lock =
@@ -2516,6 +2758,8 @@ private:
     OMAP_PER_POOL = 1,
     OMAP_PER_PG = 2,
     } per_pool_omap = OMAP_BULK;
+  bool compact_omap = false;     ///< store may have compact (per-pg) omap keys
+  bool use_compact_omap = false; ///< new per-pg omaps get compact keys
 
   ///< maximum allocation unit (power of 2)
   std::atomic<uint64_t> max_alloc_size = {0};
@@ -2526,6 +2770,8 @@ private:
   ///< size threshold for forced deferred writes
   std::atomic<uint64_t> prefer_deferred_size = {0};
 
+  DeferredPolicy deferred_policy;
+
   ///< approx cost per io, in bytes
   std::atomic<uint64_t> throttle_cost_per_io = {0};
 
@@ -2837,6 +3083,20 @@ private:
   void _shutdown_logger();
   int _reload_logger();
 
+  int _warm_cache_save();
+  int _warm_cache_load();
+  void _warm_cache_prefetch();
+  void _warm_cache_stop();
+
+  void _defrag_start();
+  void _defrag_stop();
+  void _defrag_note(Collection *c, const OnodeRef& o);
+  void _defrag_thread_entry();
+  int _defrag_onode(const coll_t& cid, const ghobject_t& oid,
+		    uint64_t *rewritten);
+  void _defrag_set_paused(bool paused);
+  void _dump_defrag_status(ceph::Formatter *f);
+
   int _open_path();
   void _close_path();
   int _open_fsid(bool create);
@@ -2848,6 +3108,7 @@ private:
   void _set_blob_size();
   void _set_finisher_num();
   void _set_per_pool_omap();
+  void _enable_compact_omap();
   void _update_osd_memory_options();
   void _update_allocator_lookup_policy();
 
@@ -2985,8 +3246,25 @@ private:
   void _kv_stop();
   void _kv_sync_thread();
   void _kv_finalize_thread();
+  void _kv_finalize_worker(KVFinalizeWorker *w);
+  void _kv_queue_finalize(std::deque<TransContext*>& committed);
+
+  void _compress_start();
+  void _compress_stop();
+  void _compress_worker();
+  void _compress_batch_run(CompressBatch *b, bool offloaded);
+  void _compress_blobs(Compressor *compressor,
+		       const std::vector<ceph::buffer::list*>& in,
+		       std::vector<compress_result_t> *out);
 
   bluestore_deferred_op_t *_get_deferred_op(TransContext *txc, uint64_t len);
+  void _note_write_path(TransContext *txc, uint64_t len, bool deferred) {
+    if (deferred_policy.enabled) {
+      txc->write_classes[deferred ? DeferredPolicy::DEFERRED
+				  : DeferredPolicy::DIRECT] |=
+	1u << deferred_policy.size_class(len);
+    }
+  }
   void _deferred_queue(TransContext *txc);
 public:
   void deferred_try_submit();
@@ -3109,9 +3387,11 @@ private:
 
   // -- ondisk version ---
 public:
-  const int32_t latest_ondisk_format = 4;        ///< our version
+  const int32_t latest_ondisk_format = 5;        ///< our version
   const int32_t min_readable_ondisk_format = 1;  ///< what we can read
   const int32_t min_compat_ondisk_format = 3;    ///< who can read us
+  /// who can read us once compact omap keys have been enabled
+  const int32_t compact_omap_compat_ondisk_format = 5;
 
 private:
   int32_t ondisk_format = 0;  ///< value detected on mount
@@ -3264,6 +3544,8 @@ public:
   std::string get_device_path(unsigned id);
 
   bool get_db_sharding(std::string& res_sharding);
+  int db_reshard_online(const std::string& column_def, std::ostream& out);
+  int dump_db_reshard_status(ceph::Formatter *f);
 
   int dump_bluefs_sizes(std::ostream& out);
   void trim_free_space(const std::string& type, std::ostream& outss);
@@ -3415,6 +3697,11 @@ public:
     ceph::buffer::list& bl,
     uint32_t op_flags) override;
 
+  int read_batch(
+    CollectionHandle &c_,
+    std::vector<read_op_t>& ops,
+    uint32_t op_flags = 0) override;
+
   int dump_onode(CollectionHandle &c, const ghobject_t& oid,
     const std::string& section_name, ceph::Formatter *f) override;
 
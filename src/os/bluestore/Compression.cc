@@ -198,28 +198,37 @@ int32_t Estimator::split_and_compress(
   blob_sizes.back() = size - blob_size * (blobs - 1);
   int32_t disk_needed = 0;
   uint32_t bl_src_off = 0;
+  size_t first = bd.size();
   for (auto& i: blob_sizes) {
     bd.emplace_back();
     bd.back().real_length = i;
     bd.back().compressed_length = 0;
     bd.back().object_data.substr_of(data_bl, bl_src_off, i);
     bl_src_off += i;
+  }
+  std::vector<ceph::buffer::list*> to_compress;
+  to_compress.reserve(blobs);
+  for (size_t i = first; i < bd.size(); ++i) {
+    to_compress.push_back(&bd[i].object_data);
+  }
+  std::vector<compress_result_t> compressed;
+  bluestore->_compress_blobs(wctx->compressor.get(), to_compress, &compressed);
+  for (size_t i = 0; i < compressed.size(); ++i) {
+    auto& blob = bd[first + i];
+    auto& cr = compressed[i];
+    ceph_assert(cr.r == 0);
     // FIXME: memory alignment here is bad
-    bufferlist t;
-    std::optional<int32_t> compressor_message;
-    int r = wctx->compressor->compress(bd.back().object_data, t, compressor_message);
-    ceph_assert(r == 0);
     bluestore_compression_header_t chdr;
     chdr.type = wctx->compressor->get_type();
-    chdr.length = t.length();
-    chdr.compressor_message = compressor_message;
-    encode(chdr, bd.back().disk_data);
-    bd.back().disk_data.claim_append(t);
-    uint32_t len = bd.back().disk_data.length();
-    bd.back().compressed_length = len;
+    chdr.length = cr.out.length();
+    chdr.compressor_message = cr.compressor_message;
+    encode(chdr, blob.disk_data);
+    blob.disk_data.claim_append(cr.out);
+    uint32_t len = blob.disk_data.length();
+    blob.compressed_length = len;
     uint32_t rem = p2nphase(len, au_size);
     if (rem > 0) {
-      bd.back().disk_data.append_zero(rem);
+      blob.disk_data.append_zero(rem);
     }
     actual_compressed += len;
     actual_compressed_plus_pad += len + rem;
@@ -54,6 +54,10 @@ int64_t HybridBtree2Allocator::allocate(
 }
 void HybridBtree2Allocator::release(const release_set_t& release_set)
 {
+  if (has_cpu_cache()) {
+    HybridAllocatorBase<Btree2Allocator>::release(release_set);
+    return;
+  }
   if (!has_cache() || release_set.num_intervals() >= pextent_array_size) {
     HybridAllocatorBase<Btree2Allocator>::release(release_set);
     return;
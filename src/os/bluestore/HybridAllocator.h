@@ -12,6 +12,7 @@
 template <typename PrimaryAllocator>
 class HybridAllocatorBase : public PrimaryAllocator {
   std::unique_ptr<BitmapAllocator> bmap_alloc;
+  std::unique_ptr<AllocatorBase::PerCpuExtentCache> cpu_cache;
 public:
   HybridAllocatorBase(CephContext* cct, int64_t device_size, int64_t _block_size,
                       uint64_t max_mem,
@@ -19,6 +20,17 @@ public:
       PrimaryAllocator(cct, device_size, _block_size, max_mem, name) {
   }
   ~HybridAllocatorBase() = default;
+
+  // Serve allocations up to max_want bytes from per-CPU caches which are
+  // refilled refill bytes at a time. Must be called before first use.
+  void enable_cpu_cache(size_t shards, uint64_t max_want, uint64_t refill) {
+    auto bs = uint64_t(PrimaryAllocator::get_block_size());
+    max_want = p2align(max_want, bs);
+    if (shards && max_want) {
+      cpu_cache = std::make_unique<AllocatorBase::PerCpuExtentCache>(
+        shards, max_want, p2roundup(refill, bs));
+    }
+  }
   int64_t allocate(
     uint64_t want,
     uint64_t unit,
@@ -26,10 +38,12 @@ public:
     int64_t  hint,
     PExtentVector *extents) override;
   using PrimaryAllocator::release;
+  void release(const release_set_t& release_set) override;
   uint64_t get_free() override {
     std::lock_guard l(PrimaryAllocator::get_lock());
     return (bmap_alloc ? bmap_alloc->get_free() : 0) +
-      PrimaryAllocator::_get_free();
+      PrimaryAllocator::_get_free() +
+      (cpu_cache ? cpu_cache->get_cached_bytes() : 0);
   }
 
   double get_fragmentation() override {
@@ -49,6 +63,7 @@ public:
 
   void foreach(
       std::function<void(uint64_t, uint64_t)> notify) override {
+    _drain_cpu_cache();
     std::lock_guard l(PrimaryAllocator::get_lock());
     PrimaryAllocator::_foreach(notify);
     if (bmap_alloc) {
@@ -78,6 +93,7 @@ public:
     size_t max_count,
     free_extent_vector_t* out) override;
   void shutdown() override {
+    _drain_cpu_cache();
     std::lock_guard l(PrimaryAllocator::get_lock());
     PrimaryAllocator::_shutdown();
     if (bmap_alloc) {
@@ -86,6 +102,9 @@ public:
   }
 
 protected:
+  bool has_cpu_cache() const {
+    return !!cpu_cache;
+  }
   // intended primarily for UT
   BitmapAllocator* get_bmap() {
     return bmap_alloc.get();
@@ -94,6 +113,17 @@ protected:
     return bmap_alloc.get();
   }
 private:
+  int64_t _allocate_uncached(
+    uint64_t want,
+    uint64_t unit,
+    uint64_t max_alloc_size,
+    int64_t  hint,
+    PExtentVector* extents);
+  bool _try_allocate_from_cpu_cache(uint64_t want, PExtentVector* extents);
+  // return everything held by per-CPU caches to the allocator,
+  // must be called without the allocator lock held
+  void _drain_cpu_cache();
+
   void _spillover_range(uint64_t start, uint64_t end) override;
   uint64_t _spillover_allocate(uint64_t want,
     uint64_t unit,
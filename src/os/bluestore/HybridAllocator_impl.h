@@ -17,6 +17,144 @@ int64_t HybridAllocatorBase<T>::allocate(
   uint64_t max_alloc_size,
   int64_t  hint,
   PExtentVector* extents)
+{
+  if (cpu_cache &&
+      unit == uint64_t(T::get_block_size()) &&
+      want && want % unit == 0 &&
+      want <= cpu_cache->get_max_want() &&
+      (max_alloc_size == 0 || want <= max_alloc_size) &&
+      _try_allocate_from_cpu_cache(want, extents)) {
+    return want;
+  }
+  int64_t res = _allocate_uncached(want, unit, max_alloc_size, hint, extents);
+  if (cpu_cache && (res < 0 || uint64_t(res) < want)) {
+    // The rest may be parked in other CPUs' shards, where get_free() still
+    // counts it: hand that back and retry before reporting a short
+    // allocation or ENOSPC.
+    uint64_t got = res > 0 ? res : 0;
+    _drain_cpu_cache();
+    int64_t r = _allocate_uncached(want - got, unit, max_alloc_size, hint,
+                                   extents);
+    if (r > 0) {
+      got += r;
+    }
+    dout(10) << __func__ << std::hex << " after drain 0x" << got
+      << "/0x" << want << std::dec << dendl;
+    res = got ? got : -ENOSPC;
+  }
+  return res;
+}
+
+template <typename T>
+bool HybridAllocatorBase<T>::_try_allocate_from_cpu_cache(
+  uint64_t want,
+  PExtentVector* extents)
+{
+  auto fast_alloc_start = mono_clock::now();
+  auto* s = cpu_cache->try_lock_local();
+  if (!s) {
+    this->logger->inc(l_bluestore_allocator_cpu_cache_miss);
+    return false;
+  }
+  uint64_t offset = 0;
+  release_set_t to_release;
+  bool hit = cpu_cache->try_get(s, want, &offset);
+  if (!hit) {
+    // Leftovers too short for this request go back first so the shard
+    // doesn't fill up with fragments. A refill that can't be satisfied
+    // contiguously means free space is fragmented: shrink the refill so
+    // we don't keep chopping up the remaining large extents, and grow
+    // it back once contiguous refills succeed again.
+    cpu_cache->trim(s, want, &to_release);
+    uint64_t refill = std::max(s->refill_size, want);
+    PExtentVector got;
+    int64_t r = _allocate_uncached(refill, T::get_block_size(), refill, 0,
+                                   &got);
+    if (r > 0) {
+      this->logger->inc(l_bluestore_allocator_cpu_cache_refill);
+      if (got.size() > 1) {
+        s->refill_size = std::max(s->refill_size / 2,
+                                  cpu_cache->get_max_want());
+      } else if (uint64_t(r) == refill) {
+        s->refill_size = std::min(s->refill_size * 2,
+                                  cpu_cache->get_max_refill());
+      }
+      for (auto& e : got) {
+        if (!cpu_cache->try_put(s, e.offset, e.length)) {
+          to_release.insert(e.offset, e.length);
+        }
+      }
+      hit = cpu_cache->try_get(s, want, &offset);
+    }
+  }
+  cpu_cache->unlock(s);
+  if (!to_release.empty()) {
+    this->logger->inc(l_bluestore_allocator_cpu_cache_flush);
+    T::release(to_release);
+  }
+  if (!hit) {
+    this->logger->inc(l_bluestore_allocator_cpu_cache_miss);
+    return false;
+  }
+  dout(20) << __func__ << std::hex
+    << " 0x" << offset << "~" << want
+    << std::dec << dendl;
+  extents->emplace_back(offset, want);
+  this->logger->inc(l_bluestore_allocator_cpu_cache_hit);
+  this->logger->tinc_with_max(
+      l_bluestore_allocator_nolock_process_lat,
+      mono_clock::now() - fast_alloc_start);
+  return true;
+}
+
+template <typename T>
+void HybridAllocatorBase<T>::release(const release_set_t& release_set)
+{
+  if (!cpu_cache) {
+    T::release(release_set);
+    return;
+  }
+  release_set_t to_release;
+  auto* s = cpu_cache->try_lock_local();
+  for (auto p = release_set.begin(); p != release_set.end(); ++p) {
+    if (!s || !cpu_cache->try_put(s, p.get_start(), p.get_len())) {
+      to_release.insert(p.get_start(), p.get_len());
+    }
+  }
+  if (s) {
+    // return whatever exceeds the shard's budget in the same batch
+    cpu_cache->trim(s, 0, &to_release);
+    cpu_cache->unlock(s);
+  }
+  if (!to_release.empty()) {
+    if (s) {
+      this->logger->inc(l_bluestore_allocator_cpu_cache_flush);
+    }
+    T::release(to_release);
+  }
+}
+
+template <typename T>
+void HybridAllocatorBase<T>::_drain_cpu_cache()
+{
+  if (!cpu_cache) {
+    return;
+  }
+  release_set_t to_release;
+  cpu_cache->drain(&to_release);
+  if (!to_release.empty()) {
+    this->logger->inc(l_bluestore_allocator_cpu_cache_flush);
+    T::release(to_release);
+  }
+}
+
+template <typename T>
+int64_t HybridAllocatorBase<T>::_allocate_uncached(
+  uint64_t want,
+  uint64_t unit,
+  uint64_t max_alloc_size,
+  int64_t  hint,
+  PExtentVector* extents)
 {
   dout(10) << __func__ << std::hex
     << " 0x" << want
@@ -79,6 +217,7 @@ int64_t HybridAllocatorBase<T>::allocate(
 template <typename T>
 void HybridAllocatorBase<T>::dump()
 {
+  _drain_cpu_cache();
   std::lock_guard l(T::get_lock());
   T::_dump();
   if (bmap_alloc) {
@@ -95,6 +234,7 @@ void HybridAllocatorBase<T>::init_rm_free(uint64_t offset, uint64_t length)
 {
   if (!length)
     return;
+  _drain_cpu_cache();
   std::lock_guard l(T::get_lock());
   dout(10) << __func__ << std::hex
     << " offset 0x" << offset
@@ -160,6 +300,7 @@ uint64_t HybridAllocatorBase<T>::get_free_extents(
   size_t max_count,
   free_extent_vector_t* out)
 {
+  _drain_cpu_cache();
   if (!bmap_alloc) {
     return T::get_free_extents(range_begin, range_end, max_count, out);
   }
@@ -723,6 +723,7 @@ inline void BlueStore::Writer::_schedule_io_masked(
       bufferlist ddata;
       data.splice(0, chunk_size, &ddata);
       if (chunk_is_unused) {
+        bstore->_note_write_path(txc, ddata.length(), false);
         bstore->bdev->aio_write(disk_position, ddata, &txc->ioc, false);
         bstore->logger->inc(l_bluestore_write_small_unused);
       } else {
@@ -772,6 +773,7 @@ inline void BlueStore::Writer::_schedule_io(
       op->extents = disk_extents;
       op->data = data;
     } else {
+      bstore->_note_write_path(txc, data.length(), false);
       for (const auto& loc : disk_extents) {
         bufferlist data_chunk;
         data.splice(0, loc.length, &data_chunk);
@@ -1317,7 +1319,9 @@ void BlueStore::Writer::_defer_or_allocate(uint32_t need_size)
     released_size += r.length;
   }
   uint32_t au_size = bstore->min_alloc_size;
-  do_deferred = need_size <= released_size && released_size < bstore->prefer_deferred_size;
+  do_deferred = need_size <= released_size &&
+    bstore->deferred_policy.use_deferred(released_size,
+                                         bstore->prefer_deferred_size);
   dout(15) << __func__ << " released=0x" << std::hex << released_size
     << " need=0x" << need_size << std::dec
     << (do_deferred ? " deferred" : " direct") << dendl;
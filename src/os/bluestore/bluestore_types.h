@@ -1189,6 +1189,7 @@ struct bluestore_onode_t {
     FLAG_PGMETA_OMAP = 2,  ///< omap data is in meta omap prefix
     FLAG_PERPOOL_OMAP = 4, ///< omap data is in per-pool prefix; per-pool keys
     FLAG_PERPG_OMAP = 8,   ///< omap data is in per-pg prefix; per-pg keys
+    FLAG_COMPACT_OMAP = 16, ///< per-pg keys carry a variable length nid
   };
 
   std::string get_flags_string() const {
@@ -1205,6 +1206,9 @@ struct bluestore_onode_t {
     if (flags & FLAG_PERPG_OMAP) {
       s += "+per_pg_omap";
     }
+    if (flags & FLAG_COMPACT_OMAP) {
+      s += "+compact_omap";
+    }
     return s;
   }
 
@@ -1233,6 +1237,9 @@ struct bluestore_onode_t {
   static bool is_perpg_omap(uint8_t flags) {
     return flags & FLAG_PERPG_OMAP;
   }
+  static bool is_compact_omap(uint8_t flags) {
+    return flags & FLAG_COMPACT_OMAP;
+  }
   bool is_pgmeta_omap() const {
     return has_flag(FLAG_PGMETA_OMAP);
   }
@@ -1242,9 +1249,14 @@ struct bluestore_onode_t {
   bool is_perpg_omap() const {
     return has_flag(FLAG_PERPG_OMAP);
   }
+  bool is_compact_omap() const {
+    return has_flag(FLAG_COMPACT_OMAP);
+  }
 
-  void set_omap_flags(bool legacy) {
-    set_flag(FLAG_OMAP | (legacy ? 0 : (FLAG_PERPOOL_OMAP | FLAG_PERPG_OMAP)));
+  void set_omap_flags(bool legacy, bool compact = false) {
+    set_flag(FLAG_OMAP |
+	     (legacy ? 0 : (FLAG_PERPOOL_OMAP | FLAG_PERPG_OMAP |
+			    (compact ? FLAG_COMPACT_OMAP : 0))));
   }
   void set_omap_flags_pgmeta() {
     set_flag(FLAG_OMAP | FLAG_PGMETA_OMAP);
@@ -1254,7 +1266,8 @@ struct bluestore_onode_t {
     clear_flag(FLAG_OMAP |
 	       FLAG_PGMETA_OMAP |
 	       FLAG_PERPOOL_OMAP |
-	       FLAG_PERPG_OMAP);
+	       FLAG_PERPG_OMAP |
+	       FLAG_COMPACT_OMAP);
   }
 
   template<typename T, typename P>
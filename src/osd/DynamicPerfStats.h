@@ -6,11 +6,13 @@
 
 #include <list>
 #include <map>
+#include <optional>
 #include <string>
 #include <vector>
 
 #include "include/random.h"
 #include "include/stringify.h"
+#include "common/ceph_time.h"
 #include "messages/MOSDOp.h"
 #include "mgr/OSDPerfMetricTypes.h"
 
@@ -58,13 +60,15 @@ public:
     return !data.empty();
   }
 
+  /// @cpu is only known for ops sampled by the op profiler
   template <typename OpRequest>
   void add(int osd, const pg_info_t &pg_info, const OpRequest& op,
-           uint64_t inb, uint64_t outb, const utime_t &latency) {
+           uint64_t inb, uint64_t outb, const utime_t &latency,
+           std::optional<ceph::timespan> cpu = std::nullopt) {
 
     auto update_counter_fnc =
-        [&op, inb, outb, &latency](const PerformanceCounterDescriptor &d,
-                                   PerformanceCounter *c) {
+        [&op, inb, outb, &latency, &cpu](const PerformanceCounterDescriptor &d,
+                                         PerformanceCounter *c) {
           ceph_assert(d.is_supported());
 
           switch(d.type) {
@@ -110,6 +114,13 @@ public:
               c->second++;
             }
             return;
+          case PerformanceCounterType::CPU_TIME:
+            if (cpu) {
+              c->first += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                *cpu).count();
+              c->second++;
+            }
+            return;
           default:
             ceph_abort_msg("unknown counter type");
           }
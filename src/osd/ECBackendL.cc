@@ -1040,15 +1040,64 @@ void ECBackendL::handle_sub_read(
 {
   trace.event("handle sub read");
   shard_id_t shard = get_parent()->whoami_shard().shard;
+  auto whole_chunk = [&](const hobject_t &hoid) {
+    auto &subchunks = op.subchunks.find(hoid)->second;
+    return (subchunks.size() == 1) &&
+      (subchunks.front().second == ec_impl->get_sub_chunk_count());
+  };
+
+  // When several objects are read whole, hand them to the store in a
+  // single read_batch() so it can look them up and submit their I/O
+  // together.  This needs all of them to use the same op flags.
+  std::vector<ObjectStore::read_op_t> batch;
+  std::map<hobject_t, size_t> batch_start;
+  std::optional<uint32_t> batch_flags;
+  for (auto i = op.to_read.begin(); i != op.to_read.end(); ++i) {
+    if (!whole_chunk(i->first)) {
+      continue;
+    }
+    batch_start[i->first] = batch.size();
+    for (auto j = i->second.begin(); j != i->second.end(); ++j) {
+      if (!batch_flags) {
+	batch_flags = j->get<2>();
+      } else if (*batch_flags != j->get<2>()) {
+	batch_start.clear();
+	break;
+      }
+      batch.emplace_back(
+	ghobject_t(i->first, ghobject_t::NO_GEN, shard),
+	j->get<0>(), j->get<1>());
+    }
+    if (batch_start.empty()) {
+      break;
+    }
+  }
+  if (batch_start.size() > 1) {
+    dout(20) << __func__ << " batching " << batch.size() << " reads of "
+	     << batch_start.size() << " objects" << dendl;
+    int r = switcher->store->read_batch(switcher->ch, batch, *batch_flags);
+    if (r < 0) {
+      batch_start.clear();
+    }
+  } else {
+    batch_start.clear();
+  }
+
   for(auto i = op.to_read.begin();
       i != op.to_read.end();
       ++i) {
     int r = 0;
+    auto batched = batch_start.find(i->first);
+    size_t batch_idx =
+      batched == batch_start.end() ? 0 : batched->second;
     for (auto j = i->second.begin(); j != i->second.end(); ++j) {
       bufferlist bl;
-      if ((op.subchunks.find(i->first)->second.size() == 1) &&
-          (op.subchunks.find(i->first)->second.front().second ==
-                                            ec_impl->get_sub_chunk_count())) {
+      if (batched != batch_start.end()) {
+        dout(20) << __func__ << " case1: complete chunk/shard, batched." << dendl;
+	auto &bop = batch[batch_idx++];
+	r = bop.r; // Allow EIO return
+	bl = std::move(bop.bl);
+      } else if (whole_chunk(i->first)) {
         dout(20) << __func__ << " case1: reading the complete chunk/shard." << dendl;
         r = switcher->store->read(
 	  switcher->ch,
@@ -2920,6 +2920,13 @@ will start to track new ops received afterwards.";
     f->open_object_section("pq");
     op_shardedwq.dump(f);
     f->close_section();
+  } else if (prefix == "dump_op_profile") {
+    f->open_object_section("op_profile");
+    f->dump_unsigned("sample_rate", cct->_conf->osd_op_profile_sample_rate);
+    service.op_profiler.dump(f);
+    f->close_section();
+  } else if (prefix == "reset_op_profile") {
+    service.op_profiler.reset();
   } else if (prefix == "dump_blocklist") {
     list<pair<entity_addr_t,utime_t> > bl;
     list<pair<entity_addr_t,utime_t> > rbl;
@@ -3584,6 +3591,11 @@ int OSD::enable_disable_fuse(bool stop)
 
 size_t OSD::get_num_cache_shards()
 {
+  if (cct->_conf.get_val<bool>("osd_cache_shards_match_op_shards")) {
+    // ObjectStore maps a collection to a cache shard the same way we
+    // map a PG to an op shard (ps % n), so equal counts pair them 1:1
+    return get_num_op_shards();
+  }
   return cct->_conf.get_val<Option::size_t>("osd_num_cache_shards");
 }
 
@@ -4130,6 +4142,15 @@ void OSD::final_init()
 				     asok_hook,
 				     "dump op queue state");
   ceph_assert(r == 0);
+  r = admin_socket->register_command("dump_op_profile",
+				     asok_hook,
+				     "dump per-stage wall and cpu time histograms"
+				     " of sampled ops, by pool and op type");
+  ceph_assert(r == 0);
+  r = admin_socket->register_command("reset_op_profile",
+				     asok_hook,
+				     "clear the sampled op profile");
+  ceph_assert(r == 0);
   r = admin_socket->register_command("dump_blocklist",
 				     asok_hook,
 				     "dump blocklisted clients and times");
@@ -10024,6 +10045,23 @@ void OSD::dequeue_op(
   OID_EVENT_TRACE_WITH_MSG(m, "DEQUEUE_OP_END", false);
 }
 
+void OSD::dequeue_op_batch(
+  PGRef pg, std::vector<OpRequestRef>& ops,
+  ThreadPool::TPHandle &handle)
+{
+  dout(10) << __func__ << " " << ops.size() << " ops pg " << *pg << dendl;
+  logger->inc(l_osd_op_batch);
+  logger->inc(l_osd_op_batch_ops, ops.size());
+
+  pg->start_txn_batch();
+  for (auto& op : ops) {
+    dequeue_op(pg, op, handle);
+    handle.reset_tp_timeout();
+  }
+  pg->flush_txn_batch();
+  pg->unlock();
+}
+
 
 void OSD::dequeue_peering_evt(
   OSDShard *sdata,
@@ -11410,6 +11448,15 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, uint32_t shard_index, hea
       return;
     }
   }
+  // while we hold the pg lock, also take the client writes that other
+  // threads queued behind this one for the same pg
+  vector<OpRequestRef> batch;
+  if (std::optional<OpRequestRef> _op = qi.maybe_get_op();
+      _op && !slot->to_process.empty() &&
+      osd->cct->_conf->osd_op_batch_max_ops > 1 &&
+      pg->can_batch_ops()) {
+    _gather_op_batch(slot, *_op, &batch);
+  }
   sdata->shard_lock.unlock();
 
   if (!new_children.empty()) {
@@ -11441,7 +11488,11 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, uint32_t shard_index, hea
   delete f;
   *_dout << dendl;
 
-  qi.run(osd, sdata, pg, tp_handle);
+  if (batch.size() > 1) {
+    osd->dequeue_op_batch(pg, batch, tp_handle);
+  } else {
+    qi.run(osd, sdata, pg, tp_handle);
+  }
 
   {
 #ifdef WITH_LTTNG
@@ -11457,6 +11508,60 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, uint32_t shard_index, hea
   handle_oncommits(oncommits);
 }
 
+void OSD::ShardedOpWQ::_gather_op_batch(
+  OSDShardPGSlot *slot,
+  OpRequestRef first,
+  vector<OpRequestRef> *batch)
+{
+  OSD::gather_op_batch(slot->to_process, std::move(first),
+		       osd->cct->_conf->osd_op_batch_max_ops,
+		       osd->cct->_conf->osd_op_batch_max_bytes,
+		       batch);
+  if (batch->size() > 1) {
+    dout(20) << __func__ << " " << batch->size() << " ops for "
+	     << slot->pg->pg_id << dendl;
+  }
+}
+
+void OSD::gather_op_batch(
+  std::deque<OpSchedulerItem>& q,
+  OpRequestRef first,
+  uint64_t max_ops,
+  uint64_t max_bytes,
+  vector<OpRequestRef> *batch)
+{
+  auto is_client_write = [](const OpRequestRef& op) {
+    return op->get_req()->get_type() == CEPH_MSG_OSD_OP &&
+      op->get_req<MOSDOp>()->has_flag(CEPH_OSD_FLAG_WRITE);
+  };
+  if (!is_client_write(first)) {
+    return;
+  }
+
+  // A write may read what an earlier write in the batch left behind, which
+  // only reaches the store once the whole batch is queued, so stop at the
+  // first repeated object.  Only the hash is decoded at this point; a
+  // collision merely ends the batch early.
+  set<uint32_t> hashes;
+  uint64_t bytes = first->get_req()->get_data_len();
+  hashes.insert(first->get_req<MOSDOp>()->get_hobj().get_hash());
+  batch->push_back(std::move(first));
+  while (batch->size() < max_ops && !q.empty()) {
+    std::optional<OpRequestRef> op = q.front().maybe_get_op();
+    if (!op || !is_client_write(*op)) {
+      break;
+    }
+    auto m = (*op)->get_req<MOSDOp>();
+    if (bytes + m->get_data_len() > max_bytes ||
+	!hashes.insert(m->get_hobj().get_hash()).second) {
+      break;
+    }
+    bytes += m->get_data_len();
+    batch->push_back(std::move(*op));
+    q.pop_front();
+  }
+}
+
 void OSD::ShardedOpWQ::_enqueue(OpSchedulerItem&& item) {
   if (unlikely(m_fast_shutdown) ) {
     // stop enqueing when we are in the middle of a fast shutdown
@@ -118,6 +118,8 @@ public:
   md_config_cacher_t<Option::size_t> osd_max_object_size;
   md_config_cacher_t<bool> osd_skip_data_digest;
 
+  OpProfiler op_profiler;  ///< see osd_op_profile_sample_rate
+
   void enqueue_back(OpSchedulerItem&& qi);
   void enqueue_front(OpSchedulerItem&& qi);
   /// scheduler cost per io, only valid for mclock, asserts for wpq
@@ -1757,6 +1759,13 @@ protected:
       OSDShardPGSlot *slot,
       OpSchedulerItem&& qi);
 
+    /// take the client writes queued right behind @p first off @p slot,
+    /// see gather_op_batch(); shard_lock and the pg lock must be held
+    void _gather_op_batch(
+      OSDShardPGSlot *slot,
+      OpRequestRef first,
+      std::vector<OpRequestRef> *batch);
+
     /// try to do some work
     void _process(uint32_t thread_index,
                   uint32_t shard_index,
@@ -1832,6 +1841,24 @@ protected:
   void dequeue_op(
     PGRef pg, OpRequestRef op,
     ThreadPool::TPHandle &handle);
+  /// dequeue_op() each of @p ops, then queue their transactions together
+  /// and unlock @p pg
+  void dequeue_op_batch(
+    PGRef pg, std::vector<OpRequestRef>& ops,
+    ThreadPool::TPHandle &handle);
+public:
+  /// Start @p batch with @p first and move the client writes queued right
+  /// behind it in @p q there too.  Stops at the first op that is not a
+  /// client write, would exceed @p max_ops or @p max_bytes, or is for an
+  /// object hash already in the batch.  @p batch stays empty if @p first
+  /// is not a client write.
+  static void gather_op_batch(
+    std::deque<OpSchedulerItem>& q,
+    OpRequestRef first,
+    uint64_t max_ops,
+    uint64_t max_bytes,
+    std::vector<OpRequestRef> *batch);
+protected:
 
   void enqueue_peering_evt(
     spg_t pgid,
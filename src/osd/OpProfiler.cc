@@ -0,0 +1,106 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+#include "osd/OpProfiler.h"
+
+#include <time.h>
+
+#include <bit>
+
+ceph::timespan op_profile_thread_cpu()
+{
+  struct timespec ts;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) < 0) {
+    return ceph::timespan::zero();
+  }
+  return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+}
+
+void OpProfiler::histogram_t::add(ceph::timespan t)
+{
+  uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(t).count();
+  unsigned b = std::min<unsigned>(std::bit_width(us), NUM_BUCKETS - 1);
+  ++buckets[b];
+  ++count;
+  sum += t;
+  if (t > max) {
+    max = t;
+  }
+}
+
+void OpProfiler::histogram_t::dump(ceph::Formatter *f) const
+{
+  f->dump_unsigned("count", count);
+  f->dump_float("sum_us", std::chrono::duration<double, std::micro>(sum).count());
+  f->dump_float("avg_us", count ?
+    std::chrono::duration<double, std::micro>(sum).count() / count : 0.0);
+  f->dump_float("max_us", std::chrono::duration<double, std::micro>(max).count());
+  f->open_array_section("buckets");
+  for (auto n : buckets) {
+    f->dump_unsigned("n", n);
+  }
+  f->close_section();
+}
+
+void OpProfiler::record(
+  int64_t pool,
+  const std::string& op_type,
+  const op_profile_t& p)
+{
+  std::lock_guard l(lock);
+  auto& e = stats[std::make_pair(pool, op_type)];
+  ++e.count;
+  for (int s = 0; s < op_profile_t::STAGE_MAX; ++s) {
+    // skip stages the op never went through, e.g. repop_wait for reads
+    if (p.wall[s] == ceph::timespan::zero()) {
+      continue;
+    }
+    e.wall[s].add(p.wall[s]);
+    if (p.cpu[s] != ceph::timespan::zero()) {
+      e.cpu[s].add(p.cpu[s]);
+    }
+  }
+}
+
+void OpProfiler::dump(ceph::Formatter *f) const
+{
+  std::lock_guard l(lock);
+  f->dump_stream("since") << since;
+  f->open_array_section("bucket_upper_bounds_us");
+  for (unsigned b = 0; b + 1 < NUM_BUCKETS; ++b) {
+    f->dump_unsigned("us", 1ull << b);
+  }
+  f->close_section();
+  f->open_array_section("ops");
+  for (auto& [key, e] : stats) {
+    f->open_object_section("op");
+    f->dump_int("pool", key.first);
+    f->dump_string("type", key.second);
+    f->dump_unsigned("count", e.count);
+    f->open_array_section("stages");
+    for (int s = 0; s < op_profile_t::STAGE_MAX; ++s) {
+      if (e.wall[s].count == 0) {
+        continue;
+      }
+      f->open_object_section("stage");
+      f->dump_string("name", op_profile_t::get_stage_name(s));
+      f->open_object_section("wall");
+      e.wall[s].dump(f);
+      f->close_section();
+      f->open_object_section("cpu");
+      e.cpu[s].dump(f);
+      f->close_section();
+      f->close_section();
+    }
+    f->close_section();
+    f->close_section();
+  }
+  f->close_section();
+}
+
+void OpProfiler::reset()
+{
+  std::lock_guard l(lock);
+  stats.clear();
+  since = ceph::coarse_real_clock::now();
+}
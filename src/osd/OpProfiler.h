@@ -0,0 +1,121 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <map>
+#include <string>
+#include <utility>
+
+#include "common/ceph_mutex.h"
+#include "common/ceph_time.h"
+#include "common/Formatter.h"
+
+/**
+ * wall and thread cpu time spent by one sampled op in each stage
+ *
+ * Only ops picked by OpProfiler::should_sample() carry one of these, so
+ * the unsampled fast path costs a null pointer check per stage.
+ */
+struct op_profile_t {
+  enum stage_t {
+    STAGE_DEQUEUE,     ///< received -> dequeued by a shard (wall only)
+    STAGE_GET_OBC,     ///< find_object_context()
+    STAGE_DO_OSD_OPS,  ///< prepare_transaction(), i.e. running the op vector
+    STAGE_SUBMIT,      ///< issue_repop(), incl. ObjectStore queue_transaction
+    STAGE_REPOP_WAIT,  ///< submitted -> committed everywhere (wall only)
+    STAGE_MAX
+  };
+  static const char *get_stage_name(int s) {
+    switch (s) {
+    case STAGE_DEQUEUE: return "dequeue";
+    case STAGE_GET_OBC: return "get_object_context";
+    case STAGE_DO_OSD_OPS: return "do_osd_ops";
+    case STAGE_SUBMIT: return "submit_transaction";
+    case STAGE_REPOP_WAIT: return "repop_wait";
+    default: return "???";
+    }
+  }
+
+  std::array<ceph::timespan, STAGE_MAX> wall = {};
+  std::array<ceph::timespan, STAGE_MAX> cpu = {};
+  ceph::mono_time submitted;  ///< start of STAGE_REPOP_WAIT, if any
+
+  ceph::timespan total_cpu() const {
+    ceph::timespan t = ceph::timespan::zero();
+    for (auto& c : cpu) {
+      t += c;
+    }
+    return t;
+  }
+};
+
+/// cpu time consumed by the calling thread so far
+ceph::timespan op_profile_thread_cpu();
+
+/// adds the wall and cpu time of a scope to a stage of a sampled op
+class OpStageTimer {
+  op_profile_t *p;
+  int stage;
+  ceph::mono_time wall_start;
+  ceph::timespan cpu_start;
+public:
+  OpStageTimer(op_profile_t *p, int stage) : p(p), stage(stage) {
+    if (p) {
+      wall_start = ceph::mono_clock::now();
+      cpu_start = op_profile_thread_cpu();
+    }
+  }
+  ~OpStageTimer() {
+    if (p) {
+      p->cpu[stage] += op_profile_thread_cpu() - cpu_start;
+      p->wall[stage] += ceph::mono_clock::now() - wall_start;
+    }
+  }
+};
+
+/**
+ * aggregates sampled op profiles into per (pool, op type) histograms
+ *
+ * Dumped and reset through the dump_op_profile/reset_op_profile admin
+ * socket commands.
+ */
+class OpProfiler {
+public:
+  /// log2 buckets in usec: [0,1), [1,2), [2,4), ... the last one is open
+  static constexpr unsigned NUM_BUCKETS = 26;
+
+  struct histogram_t {
+    std::array<uint64_t, NUM_BUCKETS> buckets = {};
+    uint64_t count = 0;
+    ceph::timespan sum = ceph::timespan::zero();
+    ceph::timespan max = ceph::timespan::zero();
+
+    void add(ceph::timespan t);
+    void dump(ceph::Formatter *f) const;
+  };
+
+  struct entry_t {
+    uint64_t count = 0;
+    std::array<histogram_t, op_profile_t::STAGE_MAX> wall;
+    std::array<histogram_t, op_profile_t::STAGE_MAX> cpu;
+  };
+
+  /// true for every rate'th call; rate 0 disables sampling
+  bool should_sample(uint64_t rate) {
+    return rate && seq.fetch_add(1, std::memory_order_relaxed) % rate == 0;
+  }
+
+  void record(int64_t pool, const std::string& op_type,
+              const op_profile_t& p);
+  void dump(ceph::Formatter *f) const;
+  void reset();
+
+private:
+  std::atomic<uint64_t> seq = {0};
+  mutable ceph::mutex lock = ceph::make_mutex("OpProfiler::lock");
+  std::map<std::pair<int64_t, std::string>, entry_t> stats;
+  ceph::coarse_real_time since = ceph::coarse_real_clock::now();
+};
@@ -17,6 +17,7 @@
 
 #include "osd/osd_op_util.h"
 #include "osd/osd_types.h"
+#include "osd/OpProfiler.h"
 #include "common/TrackedOp.h"
 #include "common/tracer.h"
 #include "osd/Coroutines.h"
@@ -105,6 +106,7 @@ public:
 
   bool hitset_inserted;
   jspan_ptr osd_parent_span;
+  std::unique_ptr<op_profile_t> profile; ///< set if sampled by OpProfiler
 
   template<class T>
   const T* get_req() const { return static_cast<const T*>(request); }
@@ -728,6 +728,12 @@ public:
   virtual void clear_cache() = 0;
   virtual int get_cache_obj_count() = 0;
 
+  /// true if client ops may be run back to back with their local
+  /// transactions queued together, see OSD::dequeue_op_batch()
+  virtual bool can_batch_ops() const = 0;
+  virtual void start_txn_batch() = 0;
+  virtual void flush_txn_batch() = 0;
+
   virtual void snap_trimmer(epoch_t epoch_queued) = 0;
   virtual void do_command(
     std::string_view prefix,
@@ -450,6 +450,10 @@ void PrimaryLogPG::on_local_recover(
     }
   }
 
+  if (!is_delete) {
+    invalidate_negative_object_context(recovery_info.soid);
+  }
+
   // keep track of active pushes for scrub
   ++active_pushes;
 
@@ -2084,6 +2088,13 @@ void PrimaryLogPG::do_op_impl(OpRequestRef op)
     }
   }
 
+  if (!op->profile &&
+      osd->op_profiler.should_sample(cct->_conf->osd_op_profile_sample_rate)) {
+    op->profile = std::make_unique<op_profile_t>();
+    op->profile->wall[op_profile_t::STAGE_DEQUEUE] = std::chrono::nanoseconds(
+      (op->get_dequeued_time() - m->get_recv_stamp()).to_nsec());
+  }
+
   if (!is_primary()) {
     osd->logger->inc(l_osd_replica_read);
   }
@@ -2366,6 +2377,17 @@ void PrimaryLogPG::do_op_impl(OpRequestRef op)
   }
 
   if (!is_primary()) {
+    if (cct->_conf->osd_replica_read_require_lease &&
+	get_mnow() >= recovery_state.get_readable_until()) {
+      // the primary may have moved on (new interval, writes we have not
+      // seen) once the lease it granted us has run out
+      dout(20) << __func__ << ": read lease expired at "
+	       << recovery_state.get_readable_until()
+	       << ", bouncing to primary " << *m << dendl;
+      osd->logger->inc(l_osd_replica_read_redirect_lease);
+      osd->reply_op_error(op, -EAGAIN);
+      return;
+    }
     if (!recovery_state.can_serve_read(oid)) {
       std::string_view storage_object = "replica";
       if (pool.info.is_erasure()) {
@@ -2384,10 +2406,14 @@ void PrimaryLogPG::do_op_impl(OpRequestRef op)
     osd->logger->inc(l_osd_replica_read_served);
   }
 
-  int r = find_object_context(
-    oid, &obc, can_create,
-    m->has_flag(CEPH_OSD_FLAG_MAP_SNAP_CLONE),
-    &missing_oid);
+  int r;
+  {
+    OpStageTimer t(op->profile.get(), op_profile_t::STAGE_GET_OBC);
+    r = find_object_context(
+      oid, &obc, can_create,
+      m->has_flag(CEPH_OSD_FLAG_MAP_SNAP_CLONE),
+      &missing_oid);
+  }
 
   // LIST_SNAPS needs the ssc too
   if (obc &&
@@ -4366,7 +4392,11 @@ void PrimaryLogPG::execute_ctx(OpContext *ctx)
   }
 
 
-  int result = prepare_transaction(ctx);
+  int result;
+  {
+    OpStageTimer t(op->profile.get(), op_profile_t::STAGE_DO_OSD_OPS);
+    result = prepare_transaction(ctx);
+  }
 
   {
 #ifdef WITH_LTTNG
@@ -4517,7 +4547,13 @@ void PrimaryLogPG::execute_ctx(OpContext *ctx)
 
   RepGather *repop = new_repop(ctx, rep_tid);
 
-  issue_repop(repop, ctx);
+  {
+    OpStageTimer t(op->profile.get(), op_profile_t::STAGE_SUBMIT);
+    issue_repop(repop, ctx);
+  }
+  if (op->profile) {
+    op->profile->submitted = ceph::mono_clock::now();
+  }
   eval_repop(repop);
   repop->put();
 }
@@ -4592,8 +4628,23 @@ void PrimaryLogPG::log_op_stats(const OpRequest& op,
 	   << " outb " << outb
 	   << " lat " << latency << dendl;
 
+  std::optional<ceph::timespan> cpu;
+  if (op.profile) {
+    auto& p = *op.profile;
+    if (p.submitted != ceph::mono_time()) {
+      p.wall[op_profile_t::STAGE_REPOP_WAIT] =
+	ceph::mono_clock::now() - p.submitted;
+    }
+    osd->op_profiler.record(
+      info.pgid.pool(),
+      m->ops.empty() ? "none" : ceph_osd_op_name(m->ops.front().op.op),
+      p);
+    cpu = p.total_cpu();
+  }
+
   if (m_dynamic_perf_stats.is_enabled()) {
-    m_dynamic_perf_stats.add(osd->get_nodeid(), info, op, inb, outb, latency);
+    m_dynamic_perf_stats.add(osd->get_nodeid(), info, op, inb, outb, latency,
+			     cpu);
   }
 }
 
@@ -11735,6 +11786,7 @@ void PrimaryLogPG::issue_repop(RepGather *repop, OpContext *ctx)
   }
   for (auto &&entry: ctx->log) {
     projected_log.add(entry);
+    invalidate_negative_object_context(entry.soid);
   }
 
   recovery_state.pre_submit_op(
@@ -11948,8 +12000,14 @@ void PrimaryLogPG::submit_log_entries(
       };
       t.register_on_commit(
 	new OnComplete{this, rep_tid, get_osdmap_epoch()});
-      int r = osd->store->queue_transaction(ch, std::move(t), NULL);
-      ceph_assert(r == 0);
+      if (txn_batch_open) {
+	// keep it ordered behind the batched writes, flush_txn_batch()
+	// checks the result
+	queue_transaction(std::move(t), OpRequestRef());
+      } else {
+	int r = osd->store->queue_transaction(ch, std::move(t), NULL);
+	ceph_assert(r == 0);
+      }
       op_applied(info.last_update);
     });
 
@@ -12171,36 +12229,69 @@ ObjectContextRef PrimaryLogPG::get_object_context(
 	     << dendl;
   } else {
     dout(10) << __func__ << ": obc NOT found in cache: " << soid << dendl;
+    // only the primary sees every write to the object, see issue_repop()
+    uint64_t negative_max =
+      cct->_conf->osd_pg_object_context_negative_cache_count;
+    bool use_negative = !attrs && negative_max > 0 && is_primary() &&
+      soid.is_head();
+    bool missing = use_negative && negative_object_contexts.contains(soid);
+    if (missing) {
+      osd->logger->inc(l_osd_object_ctx_cache_negative_hit);
+      dout(10) << __func__ << ": " << soid << " known not to exist" << dendl;
+    }
     // check disk
     bufferlist bv;
+    map<string, bufferlist, less<>> all_attrs;
+    if (!attrs && !missing && pool.info.is_erasure()) {
+      // the obc caches every attr on EC pools anyway, so fetch them all in
+      // one store call rather than reading OI_ATTR, SS_ATTR and then the
+      // whole set separately
+      int r = pgbackend->objects_get_attrs(soid, &all_attrs);
+      if (r < 0 || !all_attrs.count(OI_ATTR)) {
+	missing = true;
+	if (r == -ENOENT && use_negative) {
+	  negative_object_contexts.insert(soid);
+	  negative_object_contexts.prune(negative_max);
+	}
+      } else {
+	attrs = &all_attrs;
+      }
+    }
     if (attrs) {
       auto it_oi = attrs->find(OI_ATTR);
       ceph_assert(it_oi != attrs->end());
       bv = it_oi->second;
-    } else {
+    } else if (!missing) {
       int r = pgbackend->objects_get_attr(soid, OI_ATTR, &bv);
       if (r < 0) {
-	if (!can_create) {
-	  dout(10) << __func__ << ": no obc for soid "
-		   << soid << " and !can_create"
-		   << dendl;
-	  return ObjectContextRef();   // -ENOENT!
+	missing = true;
+	if (r == -ENOENT && use_negative) {
+	  negative_object_contexts.insert(soid);
+	  negative_object_contexts.prune(negative_max);
 	}
-
+      }
+    }
+    if (missing) {
+      if (!can_create) {
 	dout(10) << __func__ << ": no obc for soid "
-		 << soid << " but can_create"
+		 << soid << " and !can_create"
 		 << dendl;
-	// new object.
-	object_info_t oi(soid);
-	SnapSetContext *ssc = get_snapset_context(
-	  soid, true, 0, false);
-        ceph_assert(ssc);
-	obc = create_object_context(oi, ssc);
-	dout(10) << __func__ << ": " << *obc
-		 << " oi: " << obc->obs.oi
-		 << " " << *obc->ssc << dendl;
-	return obc;
+	return ObjectContextRef();   // -ENOENT!
       }
+
+      dout(10) << __func__ << ": no obc for soid "
+	       << soid << " but can_create"
+	       << dendl;
+      // new object.
+      object_info_t oi(soid);
+      SnapSetContext *ssc = get_snapset_context(
+	soid, true, 0, false);
+      ceph_assert(ssc);
+      obc = create_object_context(oi, ssc);
+      dout(10) << __func__ << ": " << *obc
+	       << " oi: " << obc->obs.oi
+	       << " " << *obc->ssc << dendl;
+      return obc;
     }
 
     object_info_t oi;
@@ -13226,9 +13317,35 @@ void PrimaryLogPG::clear_async_reads()
   }
 }
 
+void PrimaryLogPG::start_txn_batch()
+{
+  ceph_assert(!txn_batch_open);
+  txn_batch_open = true;
+}
+
+void PrimaryLogPG::flush_txn_batch()
+{
+  ceph_assert(txn_batch_open);
+  txn_batch_open = false;
+  if (txn_batch.empty()) {
+    return;
+  }
+  dout(20) << __func__ << " " << txn_batch.size() << " transactions" << dendl;
+  osd->logger->inc(l_osd_op_batch_txns, txn_batch.size());
+  // the store tracks a single op per submission; only keep it when the
+  // batch ended up holding one transaction
+  int r = osd->store->queue_transactions(
+    ch, txn_batch,
+    txn_batch.size() == 1 ? txn_batch_op : OpRequestRef(), NULL);
+  ceph_assert(r == 0);
+  txn_batch.clear();
+  txn_batch_op.reset();
+}
+
 void PrimaryLogPG::clear_cache()
 {
   object_contexts.clear();
+  negative_object_contexts.clear();
 }
 
 void PrimaryLogPG::on_shutdown()
@@ -13261,6 +13378,7 @@ void PrimaryLogPG::on_shutdown()
 
   context_registry_on_change();
   object_contexts.clear();
+  negative_object_contexts.clear();
 
   clear_async_reads();
 
@@ -13469,6 +13587,7 @@ void PrimaryLogPG::on_change(ObjectStore::Transaction &t)
   // NOTE: we actually assert that all currently live references are dead
   // by the time the flush for the next interval completes.
   object_contexts.clear();
+  negative_object_contexts.clear();
 
   // should have been cleared above by finishing all of the degraded objects
   ceph_assert(objects_blocked_on_degraded_snap.empty());
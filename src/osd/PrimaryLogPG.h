@@ -31,6 +31,7 @@
 #include "common/intrusive_timer.h"
 #include "common/sharedptr_registry.hpp"
 #include "common/shared_cache.hpp"
+#include "common/LRUSet.h"
 #include "ReplicatedBackend.h"
 #include "PGTransaction.h"
 #include "cls/cas/cls_cas_ops.h"
@@ -379,10 +380,22 @@ public:
   }
   void queue_transaction(ObjectStore::Transaction&& t,
 			 OpRequestRef op) override {
+    if (txn_batch_open) {
+      txn_batch.push_back(std::move(t));
+      txn_batch_op = op;
+      return;
+    }
     osd->store->queue_transaction(ch, std::move(t), op);
   }
   void queue_transactions(std::vector<ObjectStore::Transaction>& tls,
 			  OpRequestRef op) override {
+    if (txn_batch_open) {
+      for (auto& t : tls) {
+	txn_batch.push_back(std::move(t));
+      }
+      txn_batch_op = op;
+      return;
+    }
     osd->store->queue_transactions(ch, tls, op, NULL);
   }
   epoch_t get_interval_start_epoch() const override {
@@ -973,6 +986,12 @@ protected:
   // [primary|tail]
   xlist<RepGather*> repop_queue;
 
+  // local transactions collected between start_txn_batch() and
+  // flush_txn_batch(), queued to the store in one call
+  bool txn_batch_open = false;
+  std::vector<ObjectStore::Transaction> txn_batch;
+  OpRequestRef txn_batch_op;
+
   friend class C_OSD_RepopCommit;
   void repop_all_committed(RepGather *repop);
   void eval_repop(RepGather*);
@@ -1066,6 +1085,11 @@ protected:
 
   // projected object info
   SharedLRU<hobject_t, ObjectContext> object_contexts;
+  // heads the primary found not to exist, so that repeated lookups of
+  // missing objects skip the OI_ATTR read; entries are dropped by any
+  // write or recovery of the object and the whole cache on clear_cache()
+  // and on_change()
+  LRUSet<hobject_t> negative_object_contexts;
   // std::map from oid.snapdir() to SnapSetContext *
   std::map<hobject_t, SnapSetContext*> snapset_contexts;
   ceph::mutex snapset_contexts_lock =
@@ -1090,6 +1114,9 @@ protected:
     const std::map<std::string, ceph::buffer::list, std::less<>> *attrs = 0
     );
 
+  void invalidate_negative_object_context(const hobject_t& soid) {
+    negative_object_contexts.erase(soid.get_head());
+  }
   void context_registry_on_change();
   void object_context_destructor_callback(ObjectContext *obc);
   class C_PG_ObjectContext;
@@ -1561,6 +1588,11 @@ public:
     asok_finisher on_finish) override;
 
   void clear_cache() override;
+  bool can_batch_ops() const override {
+    return is_primary() && is_active() && !pool.info.is_erasure();
+  }
+  void start_txn_batch() override;
+  void flush_txn_batch() override;
   int get_cache_obj_count() override {
     return object_contexts.get_count();
   }
@@ -133,6 +133,14 @@ PerfCounters *build_osd_logger(CephContext *cct) {
   osd_plb.add_time_avg(l_osd_op_before_dequeue_op_lat, "op_before_dequeue_op_lat",
     "Latency of IO before calling dequeue_op(already dequeued and get PG lock)"); // client io before dequeue_op latency
 
+  osd_plb.add_u64_counter(
+    l_osd_op_batch, "op_batch",
+    "Client op batches run under a single PG lock acquisition");
+  osd_plb.add_u64_counter(
+    l_osd_op_batch_ops, "op_batch_ops", "Client ops run as part of a batch");
+  osd_plb.add_u64_counter(
+    l_osd_op_batch_txns, "op_batch_txns",
+    "Transactions queued to the ObjectStore in combined batch submissions");
 
   osd_plb.add_u64_counter(
     l_osd_replica_read, "replica_read", "Count of replica reads received");
@@ -144,6 +152,10 @@ PerfCounters *build_osd_logger(CephContext *cct) {
     l_osd_replica_read_redirect_conflict,
     "replica_read_redirect_conflict",
     "Count of replica reads redirected to primary due to unstable write");
+  osd_plb.add_u64_counter(
+    l_osd_replica_read_redirect_lease,
+    "replica_read_redirect_lease",
+    "Count of replica reads redirected to primary due to an expired lease");
   osd_plb.add_u64_counter(
     l_osd_replica_read_served,
     "replica_read_served",
@@ -324,6 +336,9 @@ PerfCounters *build_osd_logger(CephContext *cct) {
     l_osd_object_ctx_cache_hit, "object_ctx_cache_hit", "Object context cache hits");
   osd_plb.add_u64_counter(
     l_osd_object_ctx_cache_total, "object_ctx_cache_total", "Object context cache lookups");
+  osd_plb.add_u64_counter(
+    l_osd_object_ctx_cache_negative_hit, "object_ctx_cache_negative_hit",
+    "Object context cache misses answered by the negative cache");
 
   osd_plb.add_u64_counter(l_osd_op_cache_hit, "op_cache_hit");
   osd_plb.add_time_avg(
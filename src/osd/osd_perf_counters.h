@@ -43,9 +43,14 @@ enum osd_counter_idx_t {
   l_osd_op_before_queue_op_lat,
   l_osd_op_before_dequeue_op_lat,
 
+  l_osd_op_batch,
+  l_osd_op_batch_ops,
+  l_osd_op_batch_txns,
+
   l_osd_replica_read,
   l_osd_replica_read_redirect_missing,
   l_osd_replica_read_redirect_conflict,
+  l_osd_replica_read_redirect_lease,
   l_osd_replica_read_served,
 
   l_osd_sop,
@@ -129,6 +134,7 @@ enum osd_counter_idx_t {
 
   l_osd_object_ctx_cache_hit,
   l_osd_object_ctx_cache_total,
+  l_osd_object_ctx_cache_negative_hit,
 
   l_osd_op_cache_hit,
   l_osd_tier_flush_lat,
@@ -259,11 +259,12 @@ void Objecter::handle_conf_change(const ConfigProxy& conf,
     auto read_policy = conf.get_val<std::string>("rados_replica_read_policy");
     if (read_policy == "localize") {
       extra_read_flags = CEPH_OSD_FLAG_LOCALIZE_READS;
-    } else if (read_policy == "balance") {
+    } else if (read_policy == "balance" || read_policy == "latency") {
       extra_read_flags = CEPH_OSD_FLAG_BALANCE_READS;
     } else {
       extra_read_flags = 0;
     }
+    balance_reads_by_latency = (read_policy == "latency");
   }
 }
 
@@ -3096,6 +3097,31 @@ void Objecter::_prune_snapc(
   }
 }
 
+// Power of two choices: of two random members of the acting set, take the
+// one whose balanced reads have been answered faster.  An osd we have no
+// samples for looks idle, so new and restarted osds get probed.
+unsigned Objecter::_pick_read_replica(const std::vector<int>& acting)
+{
+  // rwlock is locked
+  unsigned a = rand() % acting.size();
+  unsigned b = rand() % (acting.size() - 1);
+  if (b >= a) {
+    ++b;
+  }
+  auto lat = [this](int osd) -> uint64_t {
+    auto p = osd_sessions.find(osd);
+    if (p == osd_sessions.end()) {
+      return 0;
+    }
+    return p->second->read_lat_ewma_ns.load(std::memory_order_relaxed);
+  };
+  uint64_t la = lat(acting[a]);
+  uint64_t lb = lat(acting[b]);
+  ldout(cct, 20) << __func__ << " osd." << acting[a] << " " << la << "ns"
+		 << " vs osd." << acting[b] << " " << lb << "ns" << dendl;
+  return lb < la ? b : a;
+}
+
 int Objecter::_calc_target(op_target_t *t, bool any_change)
 {
   // rwlock is locked
@@ -3324,12 +3350,17 @@ int Objecter::_calc_target(op_target_t *t, bool any_change)
       int osd;
       ceph_assert(is_read && t->acting[0] == acting_primary);
       if (t->flags & CEPH_OSD_FLAG_BALANCE_READS) {
-	int p = rand() % t->acting.size();
+	int p;
+	if (balance_reads_by_latency) {
+	  p = _pick_read_replica(t->acting);
+	} else {
+	  p = rand() % t->acting.size();
+	}
 	if (p)
 	  t->used_replica = true;
 	osd = t->acting[p];
-	ldout(cct, 10) << " chose random osd." << osd << " of " << t->acting
-		       << dendl;
+	ldout(cct, 10) << " chose " << (balance_reads_by_latency ? "" : "random ")
+		       << "osd." << osd << " of " << t->acting << dendl;
       } else {
 	// look for a local replica.  prefer the primary if the
 	// distance is the same.
@@ -3569,6 +3600,7 @@ Objecter::MOSDOp *Objecter::_prepare_osd_op(Op *op)
 
   op->target.paused = false;
   op->stamp = ceph::coarse_mono_clock::now();
+  op->sent = ceph::mono_clock::now();
 
   hobject_t hobj = op->target.get_hobj();
   auto m = new MOSDOp(client_inc, op->tid,
@@ -3915,6 +3947,12 @@ void Objecter::handle_osd_op_reply(MOSDOpReply *m)
       logger->inc(l_osdc_replica_read_bounced);
     } else {
       logger->inc(l_osdc_replica_read_completed);
+      // feed the replica choice; a bounce says nothing about load
+      uint64_t lat = std::chrono::duration_cast<std::chrono::nanoseconds>(
+	ceph::mono_clock::now() - op->sent).count();
+      uint64_t old = s->read_lat_ewma_ns.load(std::memory_order_relaxed);
+      s->read_lat_ewma_ns.store(old ? (old * 7 + lat) / 8 : lat,
+				std::memory_order_relaxed);
     }
   }
 
@@ -5492,6 +5530,10 @@ Objecter::Objecter(CephContext *cct,
   } else if (read_policy == "balance") {
     ldout(cct, 20) << __func__ << ": read policy: balance" << dendl;
     extra_read_flags = CEPH_OSD_FLAG_BALANCE_READS;
+  } else if (read_policy == "latency") {
+    ldout(cct, 20) << __func__ << ": read policy: latency" << dendl;
+    extra_read_flags = CEPH_OSD_FLAG_BALANCE_READS;
+    balance_reads_by_latency = true;
   }
 }
 
@@ -1742,6 +1742,8 @@ private:
   bool honor_pool_full = true;
 
   std::atomic<int> extra_read_flags{0};
+  /// pick the balanced read target by latency feedback rather than randomly
+  std::atomic<bool> balance_reads_by_latency{false};
 
   // If this is true, accumulate a set of blocklisted entities
   // to be drained by consume_blocklist_events.
@@ -2043,6 +2045,7 @@ public:
     epoch_t *reply_epoch = nullptr;
 
     ceph::coarse_mono_time stamp;
+    ceph::mono_time sent; ///< precise send time, for read latency feedback
 
     epoch_t map_dne_bound = 0;
 
@@ -2512,6 +2515,8 @@ public:
     int incarnation;
     ConnectionRef con;
     int num_locks;
+    /// smoothed latency of balanced reads served by this osd
+    std::atomic<uint64_t> read_lat_ewma_ns = {0};
     std::unique_ptr<std::mutex[]> completion_locks;
 
     OSDSession(CephContext *cct, int o) :
@@ -2605,6 +2610,7 @@ public:
 
   bool target_should_be_paused(op_target_t *op);
   int _calc_target(op_target_t *t, bool any_change = false);
+  unsigned _pick_read_replica(const std::vector<int>& acting);
   int _map_session(op_target_t *op, OSDSession **s,
 		   ceph::shunique_lock<ceph::shared_mutex>& lc);
 
@@ -2719,7 +2719,8 @@ class MgrModule(ceph_module.BaseMgrModule, MgrModuleLoggingMixin):
            'pg_id', 'object_name', 'snap_id'
         Valid performance counter types:
            'ops', 'write_ops', 'read_ops', 'bytes', 'write_bytes', 'read_bytes',
-           'latency', 'write_latency', 'read_latency'
+           'latency', 'write_latency', 'read_latency', 'cpu_time'
+           ('cpu_time' only counts ops sampled by osd_op_profile_sample_rate)
 
         :param object query: query
         :rtype: int (query id)
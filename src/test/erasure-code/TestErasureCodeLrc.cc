@@ -450,6 +450,22 @@ TEST(ErasureCodeLrc, init_kml)
   EXPECT_EQ((unsigned int)(4 + 2 + (4 + 2) / 3), lrc.get_chunk_count());
 }
 
+TEST(ErasureCodeLrc, supported_optimizations)
+{
+  ErasureCodeLrc lrc(g_conf().get_val<std::string>("erasure_code_dir"));
+  ErasureCodeProfile profile;
+  profile["k"] = "4";
+  profile["m"] = "2";
+  profile["l"] = "3";
+  EXPECT_EQ(0, lrc.init(profile, &cerr));
+  uint64_t flags = lrc.get_supported_optimizations();
+  // every layer is jerasure, which supports the optimized backend and
+  // parity delta writes
+  EXPECT_NE(0u, flags & ErasureCodeLrc::FLAG_EC_PLUGIN_OPTIMIZED_SUPPORTED);
+  EXPECT_NE(0u, flags & ErasureCodeLrc::FLAG_EC_PLUGIN_PARITY_DELTA_OPTIMIZATION);
+  EXPECT_NE(0u, flags & ErasureCodeLrc::FLAG_EC_PLUGIN_DIRECT_READS);
+}
+
 TEST(ErasureCodeLrc, minimum_to_decode)
 {
   // trivial : no erasures, the minimum is want_to_read
@@ -63,6 +63,13 @@ public:
   {
     return erasure_code->get_chunk_count();
   }
+  // shard holding the raw chunk at position i of an encoded buffer, the
+  // first get_k() raw chunks are data and the others coding
+  shard_id_t get_shard(unsigned int i)
+  {
+    const std::vector<shard_id_t> &mapping = erasure_code->get_chunk_mapping();
+    return mapping.size() > i ? mapping[i] : shard_id_t(i);
+  }
   unsigned int get_w()
   {
     return std::stoul(profile["w"]);
@@ -119,6 +126,193 @@ public:
 
     return crc;
   }
+  // full stripe encode, then encode_delta()/apply_delta() of one data
+  // chunk into one parity chunk must match a second full stripe encode
+  void check_parity_delta_single()
+  {
+    initialize();
+    if (!(erasure_code->get_supported_optimizations() &
+        ErasureCodeInterface::FLAG_EC_PLUGIN_PARITY_DELTA_OPTIMIZATION)) {
+          GTEST_SKIP() << "Plugin does not support parity delta optimization";
+    }
+    shard_id_set want_to_encode;
+    for (shard_id_t i ; i < get_k_plus_m(); ++i) {
+      want_to_encode.insert(i);
+    }
+    bufferlist old_bl;
+    for (unsigned int i = 0; i < get_k(); ++i) {
+      generate_chunk(old_bl);
+    }
+    shard_id_map<bufferlist> old_encoded(get_k_plus_m());
+    erasure_code->encode(want_to_encode, old_bl, &old_encoded);
+
+    bufferlist new_chunk_bl;
+    generate_chunk(new_chunk_bl);
+
+    random_device rand;
+    mt19937 gen(rand());
+    uniform_int_distribution<> chunk_range(0, get_k()-1);
+    unsigned int random_raw_chunk = chunk_range(gen);
+    shard_id_t random_chunk = get_shard(random_raw_chunk);
+
+    ceph::bufferptr old_data = buffer::create_aligned(chunk_size, 4096);
+    old_bl.begin(random_raw_chunk * chunk_size).copy(chunk_size, old_data.c_str());
+    ceph::bufferptr new_data = new_chunk_bl.front();
+    ceph::bufferptr delta = buffer::create_aligned(chunk_size, 4096);
+    ceph::bufferptr expected_delta = buffer::create_aligned(chunk_size, 4096);
+
+    for (int i = 0; i < chunk_size; i++) {
+      expected_delta.c_str()[i] = old_data.c_str()[i] ^ new_data.c_str()[i];
+    }
+
+    erasure_code->encode_delta(old_data, new_data, &delta);
+
+    bool delta_matches = true;
+    for (int i = 0; i < chunk_size; i++) {
+      if (expected_delta.c_str()[i] != delta.c_str()[i]) {
+        delta_matches = false;
+      }
+    }
+    EXPECT_EQ(delta_matches, true);
+
+    uniform_int_distribution<> parity_range(get_k(), get_k_plus_m()-1);
+    shard_id_t random_parity = get_shard(parity_range(gen));
+    ceph::bufferptr old_parity = buffer::create_aligned(chunk_size, 4096);
+    old_encoded[random_parity].begin(0).copy(chunk_size, old_parity.c_str());
+
+    shard_id_map<bufferlist> new_encoded(get_k_plus_m());
+    bufferlist new_bl;
+    for (unsigned int i = 0; i < get_k(); i++) {
+      if (i == random_raw_chunk) {
+        new_bl.append(new_data);
+      } 
+      else {
+        new_bl.append(old_encoded[get_shard(i)]);
+      }
+    }
+
+    erasure_code->encode(want_to_encode, new_bl, &new_encoded);
+    ceph::bufferptr expected_parity = buffer::create_aligned(chunk_size, 4096);
+    new_encoded[random_parity].begin().copy_deep(chunk_size, expected_parity);
+
+    shard_id_map<bufferptr> in_map(get_k_plus_m());
+    in_map[random_chunk] = delta;
+    in_map[random_parity] = old_parity;
+    shard_id_map<bufferptr> out_map(get_k_plus_m());
+    out_map[random_parity] = old_parity;
+    erasure_code->apply_delta(in_map, out_map);
+
+    bool parity_matches = true;
+    for (int i = 0; i < chunk_size; i++) {
+      if (out_map[random_parity].c_str()[i] != expected_parity.c_str()[i]) {
+        parity_matches = false;
+      }
+    }
+    EXPECT_EQ(parity_matches, true);
+  }
+  // as above, with deltas for every data chunk applied to every parity
+  void check_parity_delta_multiple()
+  {
+    initialize();
+    if (!(erasure_code->get_supported_optimizations() &
+        ErasureCodeInterface::FLAG_EC_PLUGIN_PARITY_DELTA_OPTIMIZATION)) {
+          GTEST_SKIP() << "Plugin does not support parity delta optimization";
+    }
+    shard_id_set want_to_encode;
+    for (shard_id_t i ; i < get_k_plus_m(); ++i) {
+      want_to_encode.insert(i);
+    }
+
+    bufferlist old_bl;
+    for (unsigned int i = 0; i < get_k(); i++) {
+      generate_chunk(old_bl);
+    }
+    shard_id_map<bufferlist> old_encoded(get_k_plus_m());
+    erasure_code->encode(want_to_encode, old_bl, &old_encoded);
+
+    bufferlist new_bl;
+    for (unsigned int i = 0; i < get_k(); i++) {
+      generate_chunk(new_bl);
+    }
+    shard_id_map<bufferlist> new_encoded(get_k_plus_m());
+    erasure_code->encode(want_to_encode, new_bl, &new_encoded);
+
+    ceph::bufferptr old_data = buffer::create_aligned(chunk_size*get_k(), 4096);
+    ceph::bufferptr new_data = buffer::create_aligned(chunk_size*get_k(), 4096);
+    ceph::bufferptr delta = buffer::create_aligned(chunk_size*get_k(), 4096);
+    ceph::bufferptr expected_delta = buffer::create_aligned(chunk_size*get_k(), 4096);
+
+    old_bl.begin().copy(chunk_size*get_k(), old_data.c_str());
+    new_bl.begin().copy(chunk_size*get_k(), new_data.c_str());
+
+    for (unsigned int i = 0; i < chunk_size*get_k() ; i++) {
+      expected_delta.c_str()[i] = old_bl.c_str()[i] ^ new_bl.c_str()[i];
+    }
+
+    erasure_code->encode_delta(old_data, new_data, &delta);
+
+    bool delta_matches = true;
+    for (unsigned int i = 0; i < chunk_size * get_k(); i++) {
+      if (expected_delta.c_str()[i] != delta.c_str()[i]) {
+        delta_matches = false;
+      }
+    }
+    EXPECT_EQ(delta_matches, true);
+
+    shard_id_map<bufferptr> in_map(get_k_plus_m());
+    shard_id_map<bufferptr> out_map(get_k_plus_m());
+    for (unsigned int i = 0; i < get_k(); ++i) {
+      ceph::bufferptr tmp = buffer::create_aligned(chunk_size, 4096);
+      delta.copy_out(chunk_size * i, chunk_size, tmp.c_str());
+      in_map[get_shard(i)] = tmp;
+    }
+    for (unsigned int i = get_k(); i < get_k_plus_m(); ++i) {
+      shard_id_t shard = get_shard(i);
+      ceph::bufferptr tmp = buffer::create_aligned(chunk_size, 4096);
+      old_encoded[shard].begin().copy(chunk_size, tmp.c_str());
+      in_map[shard] = tmp;
+      out_map[shard] = tmp;
+    }
+
+    erasure_code->apply_delta(in_map, out_map);
+
+    bool parity_matches = true;
+
+    for (unsigned int i = get_k(); i < get_k_plus_m(); ++i) {
+      shard_id_t shard = get_shard(i);
+      for (int j = 0; j < chunk_size; j++) {
+        if (out_map[shard].c_str()[j] != new_encoded[shard].c_str()[j]) {
+          parity_matches = false;
+        }
+      }
+    }
+    EXPECT_EQ(parity_matches, true);
+  }
+  // a plugin reporting DIRECT_READS must store every data chunk unchanged
+  // in the shard given by get_chunk_mapping()
+  void check_direct_reads()
+  {
+    initialize();
+    if (!(erasure_code->get_supported_optimizations() &
+        ErasureCodeInterface::FLAG_EC_PLUGIN_DIRECT_READS)) {
+      GTEST_SKIP() << "Plugin does not support direct reads";
+    }
+    shard_id_set want_to_encode;
+    for (shard_id_t i; i < get_k_plus_m(); ++i) {
+      want_to_encode.insert(i);
+    }
+    bufferlist bl;
+    for (unsigned int i = 0; i < get_k(); i++) {
+      generate_chunk(bl);
+    }
+    shard_id_map<bufferlist> encoded(get_k_plus_m());
+    ASSERT_EQ(0, erasure_code->encode(want_to_encode, bl, &encoded));
+    for (unsigned int i = 0; i < get_k(); i++) {
+      bufferlist expects;
+      expects.substr_of(bl, i * chunk_size, chunk_size);
+      EXPECT_TRUE(expects == encoded[get_shard(i)]) << "data chunk " << i;
+    }
+  }
 };
 TEST_P(PluginTest,Initialize)
 {
@@ -309,87 +503,7 @@ TEST_P(PluginTest,ParityDelta_SingleDeltaSingleParity)
   // 4. Do a second full write with the new chunk.
   // 5. Test that ApplyDelta correctly applies the delta to the original parity
   //    chunk and returns the same new parity chunk as the second full write.
-  initialize();
-  if (!(erasure_code->get_supported_optimizations() &
-      ErasureCodeInterface::FLAG_EC_PLUGIN_PARITY_DELTA_OPTIMIZATION)) {
-        GTEST_SKIP() << "Plugin does not support parity delta optimization";
-  }
-  shard_id_set want_to_encode;
-  for (shard_id_t i ; i < get_k_plus_m(); ++i) {
-    want_to_encode.insert(i);
-  }
-  bufferlist old_bl;
-  for (unsigned int i = 0; i < get_k(); ++i) {
-    generate_chunk(old_bl);
-  }
-  shard_id_map<bufferlist> old_encoded(get_k_plus_m());
-  erasure_code->encode(want_to_encode, old_bl, &old_encoded);
-  
-  bufferlist new_chunk_bl;
-  generate_chunk(new_chunk_bl);
-
-  random_device rand;
-  mt19937 gen(rand());
-  uniform_int_distribution<> chunk_range(0, get_k()-1);
-  shard_id_t random_chunk(chunk_range(gen));
-
-  ceph::bufferptr old_data = buffer::create_aligned(chunk_size, 4096);
-  old_bl.begin(int(random_chunk) * chunk_size).copy(chunk_size, old_data.c_str());
-  ceph::bufferptr new_data = new_chunk_bl.front();
-  ceph::bufferptr delta = buffer::create_aligned(chunk_size, 4096);
-  ceph::bufferptr expected_delta = buffer::create_aligned(chunk_size, 4096);
-
-  for (int i = 0; i < chunk_size; i++) {
-    expected_delta.c_str()[i] = old_data.c_str()[i] ^ new_data.c_str()[i];
-  }
-
-  erasure_code->encode_delta(old_data, new_data, &delta);
-
-  bool delta_matches = true;
-  for (int i = 0; i < chunk_size; i++) {
-    if (expected_delta.c_str()[i] != delta.c_str()[i]) {
-      delta_matches = false;
-    }
-  }
-  EXPECT_EQ(delta_matches, true);
-
-  uniform_int_distribution<> parity_range(get_k(), get_k_plus_m()-1);
-  shard_id_t random_parity(parity_range(gen));
-  ceph::bufferptr old_parity = buffer::create_aligned(chunk_size, 4096);
-  old_encoded[random_parity].begin(0).copy(chunk_size, old_parity.c_str());
-
-  shard_id_map<bufferlist> new_encoded(get_k_plus_m());
-  bufferlist new_bl;
-  for (auto i = old_encoded.begin(); i != old_encoded.end(); i++) {
-    if ((unsigned int)i->first >= get_k()) {
-      continue;
-    }
-    if (i->first == random_chunk) {
-      new_bl.append(new_data);
-    } 
-    else {
-      new_bl.append(i->second);
-    }
-  }
-
-  erasure_code->encode(want_to_encode, new_bl, &new_encoded);
-  ceph::bufferptr expected_parity = buffer::create_aligned(chunk_size, 4096);
-  new_encoded[random_parity].begin().copy_deep(chunk_size, expected_parity);
-
-  shard_id_map<bufferptr> in_map(get_k_plus_m());
-  in_map[random_chunk] = delta;
-  in_map[random_parity] = old_parity;
-  shard_id_map<bufferptr> out_map(get_k_plus_m());
-  out_map[random_parity] = old_parity;
-  erasure_code->apply_delta(in_map, out_map);
-
-  bool parity_matches = true;
-  for (int i = 0; i < chunk_size; i++) {
-    if (out_map[random_parity].c_str()[i] != expected_parity.c_str()[i]) {
-      parity_matches = false;
-    }
-  }
-  EXPECT_EQ(parity_matches, true);
+  check_parity_delta_single();
 }
 TEST_P(PluginTest,ParityDelta_MultipleDeltaMultipleParity)
 {
@@ -405,78 +519,11 @@ TEST_P(PluginTest,ParityDelta_MultipleDeltaMultipleParity)
   //    from the first full write. Test that ApplyDelta applies every delta to
   //    every parity, and returns an out map containing the same parity 
   //    chunks that were generated by the second full stripe write.
-  initialize();
-  if (!(erasure_code->get_supported_optimizations() &
-      ErasureCodeInterface::FLAG_EC_PLUGIN_PARITY_DELTA_OPTIMIZATION)) {
-        GTEST_SKIP() << "Plugin does not support parity delta optimization";
-  }
-  shard_id_set want_to_encode;
-  for (shard_id_t i ; i < get_k_plus_m(); ++i) {
-    want_to_encode.insert(i);
-  }
-
-  bufferlist old_bl;
-  for (unsigned int i = 0; i < get_k(); i++) {
-    generate_chunk(old_bl);
-  }
-  shard_id_map<bufferlist> old_encoded(get_k_plus_m());
-  erasure_code->encode(want_to_encode, old_bl, &old_encoded);
-  
-  bufferlist new_bl;
-  for (unsigned int i = 0; i < get_k(); i++) {
-    generate_chunk(new_bl);
-  }
-  shard_id_map<bufferlist> new_encoded(get_k_plus_m());
-  erasure_code->encode(want_to_encode, new_bl, &new_encoded);
-
-  ceph::bufferptr old_data = buffer::create_aligned(chunk_size*get_k(), 4096);
-  ceph::bufferptr new_data = buffer::create_aligned(chunk_size*get_k(), 4096);
-  ceph::bufferptr delta = buffer::create_aligned(chunk_size*get_k(), 4096);
-  ceph::bufferptr expected_delta = buffer::create_aligned(chunk_size*get_k(), 4096);
-
-  old_bl.begin().copy(chunk_size*get_k(), old_data.c_str());
-  new_bl.begin().copy(chunk_size*get_k(), new_data.c_str());
-
-  for (unsigned int i = 0; i < chunk_size*get_k() ; i++) {
-    expected_delta.c_str()[i] = old_bl.c_str()[i] ^ new_bl.c_str()[i];
-  }
-
-  erasure_code->encode_delta(old_data, new_data, &delta);
-
-  bool delta_matches = true;
-  for (unsigned int i = 0; i < chunk_size * get_k(); i++) {
-    if (expected_delta.c_str()[i] != delta.c_str()[i]) {
-      delta_matches = false;
-    }
-  }
-  EXPECT_EQ(delta_matches, true);
-
-  shard_id_map<bufferptr> in_map(get_k_plus_m());
-  shard_id_map<bufferptr> out_map(get_k_plus_m());
-  for (shard_id_t i; i < get_k(); ++i) {
-    ceph::bufferptr tmp = buffer::create_aligned(chunk_size, 4096);
-    delta.copy_out(chunk_size * int(i), chunk_size, tmp.c_str());
-    in_map[i] = tmp;
-  }
-  for (shard_id_t i(get_k()); i < get_k_plus_m(); ++i) {
-    ceph::bufferptr tmp = buffer::create_aligned(chunk_size, 4096);
-    old_encoded[i].begin().copy(chunk_size, tmp.c_str());
-    in_map[i] = tmp;
-    out_map[i] = tmp;
-  }
-
-  erasure_code->apply_delta(in_map, out_map);
-
-  bool parity_matches = true;
-
-  for (shard_id_t i(get_k()); i < get_k_plus_m(); ++i) {
-    for (int j = 0; j < chunk_size; j++) {
-      if (out_map[i].c_str()[j] != new_encoded[i].c_str()[j]) {
-        parity_matches = false;
-      }
-    }
-  }
-  EXPECT_EQ(parity_matches, true);
+  check_parity_delta_multiple();
+}
+TEST_P(PluginTest,DirectReads)
+{
+  check_direct_reads();
 }
 TEST_P(PluginTest,MinimumGranularity)
 {
@@ -796,6 +843,8 @@ INSTANTIATE_TEST_SUITE_P(
     "plugin=lrc mapping=_D_D_DD layers=[[\"cDcDcDD\",\"\"]]",
     "plugin=lrc mapping=_D_D_DDD layers=[[\"cDcDcDDD\",\"\"]]",
     "plugin=lrc mapping=_D_D_DDDD layers=[[\"cDcDcDDDD\",\"\"]]",
+    "plugin=lrc k=4 m=2 l=3",
+    "plugin=lrc k=8 m=4 l=6",
     "plugin=jerasure technique=reed_sol_van k=6 m=3 w=16",
     "plugin=jerasure technique=reed_sol_van k=6 m=3 w=32",
     "plugin=jerasure technique=liberation k=6 m=2 packetsize=32 w=11",
@@ -805,6 +854,44 @@ INSTANTIATE_TEST_SUITE_P(
     "plugin=jerasure technique=liber8tion k=2 m=2 packetsize=92"
   )
 );
+
+// Clay is left out of PluginTests until it is validated with optimized EC,
+// but the parity delta and direct read support it reports is checked here.
+class ClayPluginTest: public PluginTest {};
+TEST_P(ClayPluginTest,ParityDelta_SingleDeltaSingleParity)
+{
+  check_parity_delta_single();
+}
+TEST_P(ClayPluginTest,ParityDelta_MultipleDeltaMultipleParity)
+{
+  check_parity_delta_multiple();
+}
+TEST_P(ClayPluginTest,DirectReads)
+{
+  check_direct_reads();
+}
+
+INSTANTIATE_TEST_SUITE_P(
+  ClayPluginTests,
+  ClayPluginTest,
+  ::testing::Values(
+    "plugin=clay k=2 m=1",
+    "plugin=clay k=3 m=1",
+    "plugin=clay k=4 m=1",
+    "plugin=clay k=5 m=1",
+    "plugin=clay k=6 m=1",
+    "plugin=clay k=2 m=2",
+    "plugin=clay k=3 m=2",
+    "plugin=clay k=4 m=2",
+    "plugin=clay k=5 m=2",
+    "plugin=clay k=6 m=2",
+    "plugin=clay k=2 m=3",
+    "plugin=clay k=3 m=3",
+    "plugin=clay k=4 m=3",
+    "plugin=clay k=5 m=3",
+    "plugin=clay k=6 m=3"
+  )
+);
 /*
  * Local Variables:
  * compile-command: "cd ../.. ; ninja &&
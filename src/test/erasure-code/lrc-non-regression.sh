@@ -0,0 +1,43 @@
+#!/usr/bin/env bash
+#
+# Encode and check a corpus for the LRC profiles that can be used by
+# pools with EC optimizations, including the parity delta path.  The
+# same command lines, run with --create only, produce the LRC entries of
+# the ceph-erasure-code-corpus for a release.
+#
+
+source $(dirname $0)/../detect-build-env-vars.sh
+
+set -e
+
+dir=$(mktemp -d)
+trap "rm -fr $dir" EXIT
+
+function non_regression() {
+    local stripe_width=$1
+    shift
+    ceph_erasure_code_non_regression \
+        --erasure_code_dir $CEPH_LIB \
+        --base $dir \
+        --plugin lrc \
+        --stripe-width $stripe_width \
+        "$@" \
+        --create --check
+}
+
+# generated layers, one stripe unit of 4K and 16K
+for stripe_unit in 4096 16384 ; do
+    non_regression $((4 * stripe_unit)) \
+        --parameter k=4 --parameter m=2 --parameter l=3
+    non_regression $((8 * stripe_unit)) \
+        --parameter k=8 --parameter m=4 --parameter l=3
+    non_regression $((6 * stripe_unit)) \
+        --parameter k=6 --parameter m=3 --parameter l=3
+done
+
+# explicit mapping and layers, with a local parity ahead of the data
+non_regression $((4 * 4096)) \
+    --parameter mapping=__DD__DD \
+    --parameter 'layers=[["_cDD_cDD",""],["cDDD____",""],["____cDDD",""]]'
+
+echo OK
@@ -5,6 +5,7 @@
  * In memory space allocator benchmarks.
  * Author: Igor Fedotov, ifedotov@suse.com
  */
+#include <deque>
 #include <iostream>
 #include <boost/scoped_ptr.hpp>
 #include <gtest/gtest.h>
@@ -50,6 +51,7 @@ public:
     uint64_t capacity, uint64_t prefill,
     uint64_t overwrite,
     float extra = 0.05);
+  void doContentionTest(size_t thread_count, size_t cache_shards);
 };
 
 const uint64_t _1m = 1024 * 1024;
@@ -817,6 +819,107 @@ TEST_P(AllocTest, test_alloc_bench2_75_500_x2)
   doOverwriteMPC2Test(2, capacity, prefill, overwrite, 0.05);
 }
 
+struct ContentionContext : public Thread {
+  size_t idx = 0;
+  Allocator* alloc = nullptr;
+  uint64_t how_many = 0;
+  uint64_t alloc_unit = 0;
+  size_t ops = 0;
+  size_t failed = 0;
+
+  ContentionContext(size_t _idx, Allocator* a, uint64_t n, uint64_t unit) :
+    idx(_idx), alloc(a), how_many(n), alloc_unit(unit)
+  {
+  }
+
+  void* entry() override {
+    gen_type rng(time(NULL) + idx);
+    boost::uniform_int<> u1(1, 16); // 4K-64K
+    std::deque<bluestore_pextent_t> live;
+    PExtentVector tmp, to_release;
+    for (uint64_t i = 0; i < how_many; i++) {
+      tmp.clear();
+      auto r = alloc->allocate(alloc_unit * u1(rng), alloc_unit, 0, -1, &tmp);
+      if (r <= 0) {
+	failed++;
+	break;
+      }
+      live.insert(live.end(), tmp.begin(), tmp.end());
+      // keep a bounded working set and release in small batches,
+      // like a stream of overwrites committed by an OpSequencer
+      if (live.size() > 256) {
+	to_release.clear();
+	for (size_t j = 0; j < 8; j++) {
+	  to_release.push_back(live.front());
+	  live.pop_front();
+	}
+	alloc->release(to_release);
+      }
+      ops++;
+    }
+    to_release.assign(live.begin(), live.end());
+    alloc->release(to_release);
+    return nullptr;
+  }
+};
+
+void AllocTest::doContentionTest(size_t thread_count, size_t cache_shards)
+{
+  uint64_t capacity = uint64_t(64) * 1024 * _1m;
+  uint64_t alloc_unit = 4096;
+  uint64_t ops_per_thread = 1000000;
+
+  g_ceph_context->_conf.set_val("bluestore_alloc_cpu_cache_shards",
+				stringify(cache_shards));
+  g_ceph_context->_conf.apply_changes(nullptr);
+  init_alloc(capacity, alloc_unit);
+  alloc->init_add_free(0, capacity);
+
+  std::vector<std::unique_ptr<ContentionContext>> ctx;
+  for (size_t i = 0; i < thread_count; i++) {
+    ctx.emplace_back(std::make_unique<ContentionContext>(
+      i, alloc.get(), ops_per_thread, alloc_unit));
+  }
+  auto start = mono_clock::now();
+  for (auto& c : ctx) {
+    c->create("alloc_bench");
+  }
+  size_t ops = 0;
+  for (auto& c : ctx) {
+    c->join();
+    ops += c->ops;
+    EXPECT_EQ(c->failed, 0u);
+  }
+  double secs = ceph::to_seconds<double>(mono_clock::now() - start);
+  std::cout << GetParam() << " threads " << thread_count
+	    << " cpu cache shards " << cache_shards
+	    << ": " << ops << " alloc+release in " << secs << "s, "
+	    << uint64_t(ops / secs) << " ops/s" << std::endl;
+  // nothing is outstanding, cached extents still count as free
+  EXPECT_EQ(alloc->get_free(), capacity);
+  alloc->shutdown();
+  init_close();
+
+  g_ceph_context->_conf.set_val("bluestore_alloc_cpu_cache_shards", "0");
+  g_ceph_context->_conf.apply_changes(nullptr);
+}
+
+/*
+* Many threads doing small allocations and batched releases against the
+* same allocator, with and without per-CPU extent caches. Compare ops/s
+* between the two runs for each thread count.
+*/
+TEST_P(AllocTest, test_alloc_bench_contention)
+{
+  if ((GetParam() == string("stupid"))) {
+    GTEST_SKIP() << "skipping for specific allocators";
+  }
+  for (size_t threads : {1, 4, 16}) {
+    doContentionTest(threads, 0);
+    doContentionTest(threads, threads);
+  }
+}
+
 TEST_P(AllocTest, mempoolAccounting)
 {
   uint64_t bytes = mempool::bluestore_alloc::allocated_bytes();
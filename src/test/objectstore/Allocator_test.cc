@@ -6,6 +6,7 @@
  * Author: Ramesh Chander, Ramesh.Chander@sandisk.com
  */
 #include <iostream>
+#include <thread>
 #include <boost/random/mersenne_twister.hpp> // for boost::mt11213b
 #include <boost/scoped_ptr.hpp>
 #include <gtest/gtest.h>
@@ -1321,6 +1322,80 @@ TEST_P(AllocTest, test_get_free_extents_needle_at_end)
   alloc->shutdown();
 }
 
+// With per-CPU extent caches a CPU whose shard runs dry has to pick up
+// the space parked in the other shards rather than fail: the device must
+// fill up completely, from several threads and with allocations that
+// bypass the cache.
+TEST_P(AllocTest, test_alloc_cpu_cache_full)
+{
+  if (GetParam() != string("hybrid") &&
+      GetParam() != string("hybrid_btree2")) {
+    GTEST_SKIP() << "only hybrid allocators have per-CPU caches";
+  }
+  int64_t block_size = 4096;
+  int64_t capacity = 64 * 1024 * 1024;
+  size_t threads = 8;
+
+  g_ceph_context->_conf.set_val("bluestore_alloc_cpu_cache_shards",
+				stringify(threads));
+  g_ceph_context->_conf.apply_changes(nullptr);
+  init_alloc(capacity, block_size);
+  g_ceph_context->_conf.set_val("bluestore_alloc_cpu_cache_shards", "0");
+  g_ceph_context->_conf.apply_changes(nullptr);
+  alloc->init_add_free(0, capacity);
+
+  // fill the device with small allocations, each thread until ENOSPC
+  std::vector<PExtentVector> allocated(threads);
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < threads; ++i) {
+    workers.emplace_back([&, i] {
+      while (alloc->allocate(block_size, block_size, 0, -1,
+			     &allocated[i]) > 0) {
+      }
+    });
+  }
+  for (auto& t : workers) {
+    t.join();
+  }
+  uint64_t total = 0;
+  interval_set<uint64_t> all;
+  for (auto& v : allocated) {
+    for (auto& e : v) {
+      total += e.length;
+      all.insert(e.offset, e.length);
+    }
+  }
+  EXPECT_EQ(uint64_t(capacity), total);
+  EXPECT_EQ(uint64_t(capacity), all.size());
+  EXPECT_EQ(0u, alloc->get_free());
+
+  // with the space back, let every thread take a block, leaving the rest
+  // of its refill in the cache, then ask for everything else in one go
+  for (auto& v : allocated) {
+    alloc->release(v);
+    v.clear();
+  }
+  EXPECT_EQ(uint64_t(capacity), alloc->get_free());
+  workers.clear();
+  for (size_t i = 0; i < threads; ++i) {
+    workers.emplace_back([&, i] {
+      EXPECT_EQ(block_size, alloc->allocate(block_size, block_size, 0, -1,
+					    &allocated[i]));
+    });
+  }
+  for (auto& t : workers) {
+    t.join();
+  }
+  uint64_t rest = capacity - threads * block_size;
+  PExtentVector big;
+  EXPECT_EQ(int64_t(rest),
+	    alloc->allocate(rest, block_size, 0, -1, &big));
+  EXPECT_EQ(0u, alloc->get_free());
+  PExtentVector none;
+  EXPECT_EQ(-ENOSPC, alloc->allocate(block_size, block_size, 0, -1, &none));
+  alloc->shutdown();
+}
+
 INSTANTIATE_TEST_SUITE_P(
   Allocator,
   AllocTest,
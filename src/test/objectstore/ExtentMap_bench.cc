@@ -0,0 +1,165 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+/*
+ * Compare the cost of the decoded and packed in-memory ExtentMap layouts:
+ * bytes per extent, lookup and insert time.
+ */
+#include <algorithm>
+#include <iostream>
+#include <gtest/gtest.h>
+
+#include "common/ceph_time.h"
+#include "global/global_context.h"
+#include "os/bluestore/BlueStore.h"
+
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int.hpp>
+typedef boost::mt11213b gen_type;
+
+using namespace std;
+
+static const uint32_t extent_len = 0x1000;
+static const unsigned extents_per_shard = 256;
+
+class ExtentMapBench : public ::testing::Test {
+public:
+  BlueStore store{g_ceph_context, "", 4096};
+  std::unique_ptr<BlueStore::OnodeCacheShard> oc{
+    BlueStore::OnodeCacheShard::create(g_ceph_context, "lru", NULL)};
+  std::unique_ptr<BlueStore::BufferCacheShard> bc{
+    BlueStore::BufferCacheShard::create(&store, "lru", NULL)};
+  BlueStore::CollectionRef coll{
+    ceph::make_ref<BlueStore::Collection>(&store, oc.get(), bc.get(), coll_t())};
+  std::unique_ptr<BlueStore::Onode> onode;
+  gen_type rng{0};
+
+  // 4K extents, each with its own blob, extents_per_shard per shard
+  void fill(unsigned num_extents) {
+    onode.reset(new BlueStore::Onode(coll.get(), ghobject_t(), ""));
+    auto& em = onode->extent_map;
+    for (unsigned i = 0; i < num_extents; i += extents_per_shard) {
+      onode->onode.extent_map_shards.emplace_back(i * extent_len, 0);
+    }
+    em.init_shards(true, false);
+    for (unsigned i = 0; i < num_extents; ++i) {
+      BlueStore::BlobRef b = new_blob(0x100000 + i * 2 * extent_len);
+      b->get_ref(coll.get(), 0, extent_len);
+      em.add(i * extent_len, 0, extent_len, b);
+    }
+    for (auto& s : em.shards) {
+      s.extents = extents_per_shard;
+    }
+  }
+  BlueStore::BlobRef new_blob(uint64_t poff) {
+    BlueStore::BlobRef b(coll->new_blob());
+    b->dirty_blob().allocated_test(bluestore_pextent_t(poff, extent_len));
+    return b;
+  }
+  // one random offset inside each shard, shards in random order
+  vector<uint32_t> shard_offsets() {
+    auto& em = onode->extent_map;
+    vector<uint32_t> r;
+    boost::uniform_int<uint32_t> u(0, extents_per_shard - 1);
+    for (auto& s : em.shards) {
+      r.push_back(s.shard_info->offset + u(rng) * extent_len);
+    }
+    std::shuffle(r.begin(), r.end(), rng);
+    return r;
+  }
+  void clean() {
+    for (auto& s : onode->extent_map.shards) {
+      s.dirty = false;
+    }
+  }
+  static void dispose(BlueStore::old_extent_map_t& old) {
+    auto p = old.begin();
+    while (p != old.end()) {
+      auto& oe = *p;
+      p = old.erase(p);
+      delete &oe;
+    }
+  }
+
+  // time the first lookup in every shard, averaged over rounds
+  double lookup(bool packed, unsigned rounds) {
+    auto& em = onode->extent_map;
+    ceph::timespan t = ceph::timespan::zero();
+    unsigned n = 0;
+    for (unsigned r = 0; r < rounds; ++r) {
+      if (packed) {
+        em.pack_shards();
+      }
+      auto offsets = shard_offsets();
+      auto t0 = ceph::mono_clock::now();
+      for (auto off : offsets) {
+        em.fault_range(nullptr, off, extent_len);
+        auto p = em.seek_lextent(off);
+        ceph_assert(p != em.extent_map.end() && p->logical_offset == off);
+      }
+      t += ceph::mono_clock::now() - t0;
+      n += offsets.size();
+    }
+    return std::chrono::duration<double, std::nano>(t).count() / n;
+  }
+
+  // time overwriting one extent in every shard, averaged over rounds
+  double insert(bool packed, unsigned rounds) {
+    auto& em = onode->extent_map;
+    ceph::timespan t = ceph::timespan::zero();
+    unsigned n = 0;
+    for (unsigned r = 0; r < rounds; ++r) {
+      if (packed) {
+        em.pack_shards();
+      }
+      auto offsets = shard_offsets();
+      vector<BlueStore::BlobRef> blobs;
+      for (auto off : offsets) {
+        blobs.push_back(new_blob(0x80000000ull + off));
+      }
+      BlueStore::old_extent_map_t old;
+      auto t0 = ceph::mono_clock::now();
+      for (size_t i = 0; i < offsets.size(); ++i) {
+        em.fault_range(nullptr, offsets[i], extent_len);
+        em.set_lextent(coll, offsets[i], 0, extent_len, blobs[i], &old);
+        em.dirty_range(offsets[i], extent_len);
+      }
+      t += ceph::mono_clock::now() - t0;
+      n += offsets.size();
+      dispose(old);
+      clean();
+    }
+    return std::chrono::duration<double, std::nano>(t).count() / n;
+  }
+};
+
+TEST_F(ExtentMapBench, layouts)
+{
+  const unsigned num_extents = 64 * 1024;
+  const unsigned rounds = 20;
+
+  uint64_t base = mempool::bluestore_cache_meta::allocated_bytes();
+  fill(num_extents);
+  auto& em = onode->extent_map;
+  ASSERT_EQ(em.extent_map.size(), num_extents);
+  uint64_t decoded = mempool::bluestore_cache_meta::allocated_bytes() - base;
+  ASSERT_EQ(em.pack_shards(), num_extents);
+  uint64_t packed = mempool::bluestore_cache_meta::allocated_bytes() - base;
+  em.fault_range(nullptr, 0, num_extents * extent_len);
+  ASSERT_EQ(em.extent_map.size(), num_extents);
+
+  double decoded_lookup = lookup(false, rounds);
+  double packed_lookup = lookup(true, rounds);
+  double decoded_insert = insert(false, rounds);
+  double packed_insert = insert(true, rounds);
+
+  cout << num_extents << " extents in " << em.shards.size() << " shards"
+       << std::endl;
+  cout << "bytes/extent: decoded " << (double)decoded / num_extents
+       << " packed " << (double)packed / num_extents << std::endl;
+  cout << "first lookup in a shard (ns): decoded " << decoded_lookup
+       << " packed " << packed_lookup << std::endl;
+  cout << "overwrite in a shard (ns): decoded " << decoded_insert
+       << " packed " << packed_insert << std::endl;
+  ASSERT_LT(packed, decoded);
+}
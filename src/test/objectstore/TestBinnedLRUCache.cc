@@ -0,0 +1,207 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include "common/ceph_context.h"
+#include "common/config_proxy.h"
+#include "global/global_context.h"
+#include "include/scope_guard.h"
+#include "kv/rocksdb_cache/BinnedLRUCache.h"
+
+using namespace std;
+using rocksdb_cache::BinnedLRUCache;
+using rocksdb_cache::BinnedLRUCacheShard;
+using rocksdb_cache::BinnedLRUHandle;
+
+class BinnedLRUCacheProbation : public ::testing::Test {
+public:
+  // every entry is charged 1, so sizes below are entry counts
+  static constexpr size_t capacity = 10;
+
+  std::shared_ptr<rocksdb::Cache> cache;
+  BinnedLRUCacheShard *shard = nullptr;
+
+  void SetUp() override {
+    g_ceph_context->_conf.set_val("rocksdb_cache_probation_ratio", "0.5");
+    auto reset_conf = make_scope_guard([] {
+      g_ceph_context->_conf.set_val("rocksdb_cache_probation_ratio", "0");
+    });
+    // a single shard without a high-pri pool: the protected part of the
+    // low-pri pool holds at most capacity * (1 - 0.5) = 5 entries
+    cache = rocksdb_cache::NewBinnedLRUCache(
+      g_ceph_context, "probation_test", capacity, 0);
+    auto binned = static_cast<BinnedLRUCache*>(cache.get());
+    shard = static_cast<BinnedLRUCacheShard*>(binned->GetShard(0));
+  }
+  void TearDown() override {
+    shard = nullptr;
+    cache.reset();
+  }
+
+  static uint32_t hash(const string& key) {
+    return std::hash<string>()(key);
+  }
+  void insert(const string& key) {
+    ASSERT_TRUE(shard->Insert(key, hash(key), nullptr, nullptr, 1, nullptr,
+                              rocksdb::Cache::Priority::LOW).ok());
+  }
+  // look the entry up and release it again, as a reader would
+  bool hit(const string& key) {
+    auto h = shard->Lookup(key, hash(key));
+    if (!h) {
+      return false;
+    }
+    shard->Release(h);
+    return true;
+  }
+  // the unpinned entries, oldest (next to be evicted) first, with a '*'
+  // appended to the ones on probation
+  vector<string> lru() {
+    BinnedLRUHandle *head, *low_pri;
+    shard->TEST_GetLRUList(&head, &low_pri);
+    vector<string> r;
+    for (auto e = head->next; e != head; e = e->next) {
+      r.push_back(e->key().ToString() + (e->InProbation() ? "*" : ""));
+    }
+    return r;
+  }
+  uint64_t stat(int idx) {
+    return shard->GetStats()[idx];
+  }
+  uint64_t binned() {
+    return shard->sum_bins(0, shard->get_bin_count());
+  }
+};
+
+TEST_F(BinnedLRUCacheProbation, insert)
+{
+  for (auto k : {"a", "b", "c"}) {
+    insert(k);
+  }
+  // new entries are not trusted yet: they go on probation and are not
+  // counted in the age bins
+  EXPECT_EQ(lru(), (vector<string>{"a*", "b*", "c*"}));
+  EXPECT_EQ(3u, shard->GetProbationUsage());
+  EXPECT_EQ(3u, stat(rocksdb_cache::l_probation));
+  EXPECT_EQ(3u, stat(rocksdb_cache::l_usage));
+  EXPECT_EQ(0u, stat(rocksdb_cache::l_pinned));
+  EXPECT_EQ(0u, binned());
+}
+
+TEST_F(BinnedLRUCacheProbation, promote)
+{
+  for (auto k : {"a", "b", "c"}) {
+    insert(k);
+  }
+  // a referenced entry is off the LRU: pinned, no longer on probation
+  auto h = shard->Lookup("b", hash("b"));
+  ASSERT_TRUE(h);
+  EXPECT_EQ(lru(), (vector<string>{"a*", "c*"}));
+  EXPECT_EQ(2u, shard->GetProbationUsage());
+  EXPECT_EQ(1u, stat(rocksdb_cache::l_pinned));
+  EXPECT_EQ(3u, stat(rocksdb_cache::l_usage));
+  EXPECT_EQ(1u, stat(rocksdb_cache::l_promotions));
+
+  // released after the hit, it joins the protected segment, which is
+  // newer than everything on probation and binned again
+  shard->Release(h);
+  EXPECT_EQ(lru(), (vector<string>{"a*", "c*", "b"}));
+  EXPECT_EQ(2u, shard->GetProbationUsage());
+  EXPECT_EQ(0u, stat(rocksdb_cache::l_pinned));
+  EXPECT_EQ(1u, binned());
+
+  // a hit on a protected entry moves it to the front, it is not a
+  // promotion
+  ASSERT_TRUE(hit("c"));
+  ASSERT_TRUE(hit("b"));
+  EXPECT_EQ(lru(), (vector<string>{"a*", "c", "b"}));
+  EXPECT_EQ(2u, stat(rocksdb_cache::l_promotions));
+  EXPECT_EQ(2u, binned());
+}
+
+TEST_F(BinnedLRUCacheProbation, demote)
+{
+  for (auto k : {"a", "b", "c", "d", "e", "f"}) {
+    insert(k);
+  }
+  for (auto k : {"a", "b", "c", "d", "e"}) {
+    ASSERT_TRUE(hit(k));
+  }
+  // the protected segment is full
+  EXPECT_EQ(lru(), (vector<string>{"f*", "a", "b", "c", "d", "e"}));
+  EXPECT_EQ(1u, shard->GetProbationUsage());
+  EXPECT_EQ(5u, binned());
+
+  // promoting one more pushes the oldest protected entry back onto
+  // probation, where it is again first in line to be evicted
+  ASSERT_TRUE(hit("f"));
+  EXPECT_EQ(lru(), (vector<string>{"a*", "b", "c", "d", "e", "f"}));
+  EXPECT_EQ(1u, shard->GetProbationUsage());
+  EXPECT_EQ(5u, binned());
+
+  // and needs a new hit to be protected again
+  ASSERT_TRUE(hit("a"));
+  EXPECT_EQ(lru(), (vector<string>{"b*", "c", "d", "e", "f", "a"}));
+  EXPECT_EQ(6u, stat(rocksdb_cache::l_usage));
+  EXPECT_EQ(6u, stat(rocksdb_cache::l_elems));
+}
+
+TEST_F(BinnedLRUCacheProbation, evict)
+{
+  for (auto k : {"a", "b", "c", "d", "e"}) {
+    insert(k);
+  }
+  for (auto k : {"a", "b", "c", "d", "e"}) {
+    ASSERT_TRUE(hit(k));
+  }
+  for (auto k : {"v", "w", "x", "y", "z"}) {
+    insert(k);
+  }
+  EXPECT_EQ(lru(), (vector<string>{"v*", "w*", "x*", "y*", "z*",
+                                   "a", "b", "c", "d", "e"}));
+  EXPECT_EQ(capacity, stat(rocksdb_cache::l_usage));
+
+  // a scan of new entries only ever evicts entries on probation, oldest
+  // first, and leaves the protected ones alone
+  for (int i = 0; i < 20; ++i) {
+    insert("scan" + std::to_string(i));
+  }
+  EXPECT_EQ(lru(), (vector<string>{"scan15*", "scan16*", "scan17*",
+                                   "scan18*", "scan19*",
+                                   "a", "b", "c", "d", "e"}));
+  EXPECT_FALSE(hit("v"));
+  EXPECT_FALSE(hit("scan14"));
+  EXPECT_EQ(capacity, stat(rocksdb_cache::l_usage));
+  EXPECT_EQ(5u, shard->GetProbationUsage());
+  EXPECT_EQ(5u, binned());
+
+  // a pinned entry can't be evicted, so the oldest unpinned one goes
+  auto h = shard->Lookup("scan15", hash("scan15"));
+  ASSERT_TRUE(h);
+  insert("new");
+  EXPECT_EQ(lru(), (vector<string>{"scan17*", "scan18*", "scan19*", "new*",
+                                   "a", "b", "c", "d", "e"}));
+  EXPECT_EQ(1u, stat(rocksdb_cache::l_pinned));
+  EXPECT_EQ(capacity, stat(rocksdb_cache::l_usage));
+  shard->Release(h);
+}
+
+TEST_F(BinnedLRUCacheProbation, disable)
+{
+  for (auto k : {"a", "b", "c"}) {
+    insert(k);
+  }
+  // with the ratio back at 0 the whole low-pri pool is protected: entries
+  // already on probation stay there until hit, new ones are binned
+  shard->SetProbationRatio(0);
+  insert("d");
+  EXPECT_EQ(lru(), (vector<string>{"a*", "b*", "c*", "d"}));
+  EXPECT_EQ(1u, binned());
+  ASSERT_TRUE(hit("a"));
+  EXPECT_EQ(lru(), (vector<string>{"b*", "c*", "d", "a"}));
+  EXPECT_EQ(2u, shard->GetProbationUsage());
+  EXPECT_EQ(2u, binned());
+}
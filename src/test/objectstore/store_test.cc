@@ -706,6 +706,30 @@ public:
       }
     }
   }
+
+#if defined(WITH_BLUESTORE)
+  // Count the per-pg omap keys (prefix "p") by nid format.  The nid follows
+  // the u64 pool and u32 hash; in the legacy form its first byte is 0, the
+  // compact form starts with a 0xf1..0xf8 marker.
+  void count_perpg_omap_keys(size_t *fixed, size_t *compact) {
+    BlueStore* bstore = dynamic_cast<BlueStore*>(store.get());
+    ceph_assert(bstore);
+    *fixed = *compact = 0;
+    auto it = bstore->get_kv()->get_iterator("p");
+    for (it->seek_to_first(); it->valid(); it->next()) {
+      std::string key = it->key();
+      ASSERT_GT(key.size(), 12u);
+      uint8_t marker = key[12];
+      if (marker == 0) {
+	++*fixed;
+      } else {
+	ASSERT_GT(marker, 0xf0);
+	ASSERT_LE(marker, 0xf8);
+	++*compact;
+      }
+    }
+  }
+#endif
 };
 
 TEST_P(StoreTest, collect_metadata) {
@@ -1573,6 +1597,65 @@ TEST_P(StoreTest, CompressionTest) {
   doCompressionTest();
 }
 
+TEST_P(StoreTest, CompressionWorkersTest) {
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  SetVal(g_conf(), "bluestore_write_v2", "false");
+  SetVal(g_conf(), "bluestore_compression_threads", "2");
+  SetVal(g_conf(), "bluestore_compression_algorithm", "snappy");
+  SetVal(g_conf(), "bluestore_compression_mode", "force");
+  SetVal(g_conf(), "bluestore_compression_max_blob_size", "65536");
+  g_ceph_context->_conf.apply_changes(nullptr);
+  EXPECT_EQ(store->umount(), 0);
+  EXPECT_EQ(store->mount(), 0);
+  doCompressionTest();
+
+  // a single write split into many blobs, compressed by the submitter
+  // and the workers together
+  int r;
+  coll_t cid;
+  ghobject_t hoid(hobject_t(sobject_t("Object 1", CEPH_NOSNAP)));
+  const PerfCounters* logger = store->get_perf_counters();
+  auto ch = store->create_new_collection(cid);
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  bufferlist bl;
+  for (unsigned i = 0; i < 16; ++i) {
+    bl.append(std::string(0x10000, 'a' + i));
+  }
+  auto success = logger->get(l_bluestore_compress_success_count);
+  {
+    ObjectStore::Transaction t;
+    t.write(cid, hoid, 0, bl.length(), bl);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  ASSERT_EQ(logger->get(l_bluestore_compress_success_count) - success, 16u);
+  {
+    bufferlist in;
+    r = store->read(ch, hoid, 0, bl.length(), in);
+    ASSERT_EQ((int)bl.length(), r);
+    ASSERT_TRUE(bl_eq(bl, in));
+  }
+  {
+    ObjectStore::Transaction t;
+    t.remove(cid, hoid);
+    t.remove_collection(cid);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  ch.reset();
+  SetVal(g_conf(), "bluestore_compression_threads", "0");
+  g_ceph_context->_conf.apply_changes(nullptr);
+  EXPECT_EQ(store->umount(), 0);
+  EXPECT_EQ(store->mount(), 0);
+}
+
 TEST_P(StoreTest, SimpleObjectTest) {
   int r;
   coll_t cid;
@@ -1886,6 +1969,201 @@ TEST_P(StoreTestSpecificAUSize, ReproBug41901Test) {
 }
 
 
+TEST_P(StoreTestSpecificAUSize, ReadSharedBytesTest) {
+  if(string(GetParam()) != "bluestore")
+    return;
+  StartDeferred(4096);
+
+  int r;
+  coll_t cid;
+  ghobject_t hoid(hobject_t(sobject_t("Object 1", CEPH_NOSNAP)));
+  const PerfCounters* logger = store->get_perf_counters();
+  auto ch = store->create_new_collection(cid);
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  bufferlist data;
+  data.append(std::string(0x10000, 'a'));
+  {
+    // 64K of data, a 64K hole, 64K of data
+    ObjectStore::Transaction t;
+    t.write(cid, hoid, 0, data.length(), data);
+    t.write(cid, hoid, 0x20000, data.length(), data);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  auto shared = logger->get(l_bluestore_read_shared_bytes);
+  auto copied = logger->get(l_bluestore_read_copied_bytes);
+  {
+    bufferlist bl;
+    r = store->read(ch, hoid, 0, 0x30000, bl);
+    ASSERT_EQ(r, 0x30000);
+  }
+  ASSERT_EQ(logger->get(l_bluestore_read_shared_bytes) - shared, 0x20000u);
+  ASSERT_EQ(logger->get(l_bluestore_read_copied_bytes) - copied, 0x10000u);
+  {
+    ObjectStore::Transaction t;
+    t.remove(cid, hoid);
+    t.remove_collection(cid);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+}
+
+TEST_P(StoreTestSpecificAUSize, BackgroundDefragTest) {
+  if(string(GetParam()) != "bluestore")
+    return;
+  SetVal(g_conf(), "bluestore_defrag_enable", "true");
+  SetVal(g_conf(), "bluestore_defrag_min_extents", "4");
+  SetVal(g_conf(), "bluestore_defrag_max_bytes_per_sec", "0");
+  g_conf().apply_changes(nullptr);
+  StartDeferred(4096);
+
+  int r;
+  coll_t cid(spg_t(pg_t(0, 1), shard_id_t::NO_SHARD));
+  ghobject_t hoid(hobject_t("frag", "", CEPH_NOSNAP, 0, 1, ""));
+  ghobject_t hoid2(hobject_t("filler", "", CEPH_NOSNAP, 0, 1, ""));
+  const PerfCounters* logger = store->get_perf_counters();
+  auto ch = store->create_new_collection(cid);
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  // interleave allocations of two objects so that each 4K block of
+  // hoid ends up in its own device extent
+  bufferlist expected;
+  for (unsigned i = 0; i < 16; ++i) {
+    bufferlist bl;
+    bl.append(std::string(4096, 'a' + i));
+    expected.append(bl);
+    for (auto& o : {hoid, hoid2}) {
+      ObjectStore::Transaction t;
+      t.write(cid, o, i * 4096, bl.length(), bl);
+      r = queue_transaction(store, ch, std::move(t));
+      ASSERT_EQ(r, 0);
+    }
+  }
+  {
+    bufferlist bl;
+    r = store->read(ch, hoid, 0, expected.length(), bl);
+    ASSERT_EQ(r, (int)expected.length());
+    ASSERT_TRUE(bl_eq(expected, bl));
+  }
+  for (int i = 0; i < 100 && logger->get(l_bluestore_defrag_onodes) == 0; ++i) {
+    usleep(100 * 1000);
+  }
+  ASSERT_EQ(logger->get(l_bluestore_defrag_onodes), 1u);
+  ASSERT_EQ(logger->get(l_bluestore_defrag_bytes), expected.length());
+  ASSERT_GT(logger->get(l_bluestore_defrag_extents_merged), 0u);
+  {
+    bufferlist bl;
+    r = store->read(ch, hoid, 0, expected.length(), bl);
+    ASSERT_EQ(r, (int)expected.length());
+    ASSERT_TRUE(bl_eq(expected, bl));
+  }
+  ch.reset();
+  store->umount();
+  ASSERT_EQ(store->fsck(false), 0);
+  store->mount();
+  ch = store->open_collection(cid);
+  {
+    bufferlist bl;
+    r = store->read(ch, hoid, 0, expected.length(), bl);
+    ASSERT_EQ(r, (int)expected.length());
+    ASSERT_TRUE(bl_eq(expected, bl));
+  }
+  {
+    ObjectStore::Transaction t;
+    t.remove(cid, hoid);
+    t.remove(cid, hoid2);
+    t.remove_collection(cid);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+}
+
+TEST_P(StoreTestSpecificAUSize, BackgroundDefragReadErrorTest) {
+  if(string(GetParam()) != "bluestore")
+    return;
+  SetVal(g_conf(), "bluestore_defrag_enable", "true");
+  SetVal(g_conf(), "bluestore_defrag_min_extents", "4");
+  SetVal(g_conf(), "bluestore_defrag_max_bytes_per_sec", "0");
+  g_conf().apply_changes(nullptr);
+  StartDeferred(4096);
+
+  int r;
+  coll_t cid(spg_t(pg_t(0, 1), shard_id_t::NO_SHARD));
+  ghobject_t hoid(hobject_t("frag", "", CEPH_NOSNAP, 0, 1, ""));
+  ghobject_t hoid2(hobject_t("filler", "", CEPH_NOSNAP, 0, 1, ""));
+  const PerfCounters* logger = store->get_perf_counters();
+  auto ch = store->create_new_collection(cid);
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  // fragmented, with holes between the blocks so that the defrag reads
+  // several ranges
+  bufferlist expected;
+  for (unsigned i = 0; i < 16; ++i) {
+    bufferlist bl;
+    if (i % 2) {
+      bl.append_zero(4096);
+      expected.append(bl);
+      continue;
+    }
+    bl.append(std::string(4096, 'a' + i));
+    expected.append(bl);
+    for (auto& o : {hoid, hoid2}) {
+      ObjectStore::Transaction t;
+      t.write(cid, o, i * 4096, bl.length(), bl);
+      r = queue_transaction(store, ch, std::move(t));
+      ASSERT_EQ(r, 0);
+    }
+  }
+  // the read queues the object, then it and the defrag read fail
+  SetVal(g_conf(), "bluestore_debug_inject_csum_err_probability", "1");
+  g_conf().apply_changes(nullptr);
+  uint64_t txcs = logger->get(l_bluestore_txc);
+  uint64_t skipped = logger->get(l_bluestore_defrag_skipped);
+  {
+    bufferlist bl;
+    r = store->read(ch, hoid, 0, expected.length() - 4096, bl);
+    ASSERT_EQ(r, -EIO);
+  }
+  for (int i = 0; i < 100 && logger->get(l_bluestore_defrag_skipped) == skipped; ++i) {
+    usleep(100 * 1000);
+  }
+  SetVal(g_conf(), "bluestore_debug_inject_csum_err_probability", "0");
+  g_conf().apply_changes(nullptr);
+  ASSERT_EQ(logger->get(l_bluestore_defrag_skipped), skipped + 1);
+  ASSERT_EQ(logger->get(l_bluestore_defrag_onodes), 0u);
+  // nothing was queued for the skipped object
+  ASSERT_EQ(logger->get(l_bluestore_txc), txcs);
+  {
+    bufferlist bl;
+    r = store->read(ch, hoid, 0, expected.length() - 4096, bl);
+    ASSERT_EQ(r, (int)expected.length() - 4096);
+    bufferlist e;
+    e.substr_of(expected, 0, expected.length() - 4096);
+    ASSERT_TRUE(bl_eq(e, bl));
+  }
+  {
+    ObjectStore::Transaction t;
+    t.remove(cid, hoid);
+    t.remove(cid, hoid2);
+    t.remove_collection(cid);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+}
+
 TEST_P(StoreTestSpecificAUSize, BluestoreStatFSTest) {
   if(string(GetParam()) != "bluestore")
     return;
@@ -2624,6 +2902,145 @@ TEST_P(StoreTestSpecificAUSize, BluestoreFragmentedBlobTest) {
     ASSERT_EQ( 0u, statfs.data_compressed_allocated);
   }
 }
+
+// to be inline with BlueStore.cc
+static const char *WARM_CACHE_DIR = "WARM_CACHE_DIR";
+static const char *WARM_CACHE_FILE = "WARM_CACHE_FILE";
+
+static void warm_cache_populate(ObjectStore *store,
+                                ObjectStore::CollectionHandle& ch,
+                                const coll_t& cid, unsigned num_objects)
+{
+  ObjectStore::Transaction t;
+  t.create_collection(cid, 0);
+  bufferlist bl;
+  bl.append(std::string(4096, 'w'));
+  for (unsigned i = 0; i < num_objects; ++i) {
+    ghobject_t hoid(hobject_t("warm" + stringify(i), "", CEPH_NOSNAP, i, 1, ""));
+    t.write(cid, hoid, 0, bl.length(), bl);
+  }
+  int r = queue_transaction(store, ch, std::move(t));
+  ASSERT_EQ(r, 0);
+}
+
+TEST_P(StoreTest, WarmCacheTest) {
+  if (string(GetParam()) != "bluestore")
+    return;
+  SetVal(g_conf(), "bluestore_warm_cache", "true");
+  g_conf().apply_changes(nullptr);
+
+  const unsigned num_objects = 16;
+  coll_t cid(spg_t(pg_t(0, 1), shard_id_t::NO_SHARD));
+  auto ch = store->create_new_collection(cid);
+  warm_cache_populate(store.get(), ch, cid, num_objects);
+  ch.reset();
+  ASSERT_EQ(store->umount(), 0);
+
+  // umount left a snapshot of the cached onode ids behind
+  {
+    auto bluestore = std::make_unique<BlueStore>(g_ceph_context, data_dir);
+    KeyValueDB* db_ptr;
+    ASSERT_EQ(bluestore->open_db_environment(&db_ptr, true, false), 0);
+    uint64_t size = 0;
+    ASSERT_EQ(bluestore->get_bluefs()->stat(WARM_CACHE_DIR, WARM_CACHE_FILE,
+                                            &size, nullptr), 0);
+    ASSERT_GT(size, 0u);
+    bluestore->close_db_environment();
+  }
+
+  ASSERT_EQ(store->mount(), 0);
+  BlueStore* bstore = dynamic_cast<BlueStore*>(store.get());
+  ASSERT_NE(bstore, nullptr);
+  // mount consumes the snapshot before prefetching from it
+  ASSERT_EQ(bstore->get_bluefs()->stat(WARM_CACHE_DIR, WARM_CACHE_FILE,
+                                       nullptr, nullptr), -ENOENT);
+  const PerfCounters* logger = store->get_perf_counters();
+  for (int i = 0; i < 100 && logger->get(l_bluestore_warm_cache_onodes) == 0; ++i) {
+    usleep(100 * 1000);
+  }
+  ASSERT_GT(logger->get(l_bluestore_warm_cache_onodes), 0u);
+  ASSERT_LE(logger->get(l_bluestore_warm_cache_onodes), num_objects);
+
+  ch = store->open_collection(cid);
+  {
+    ObjectStore::Transaction t;
+    for (unsigned i = 0; i < num_objects; ++i) {
+      t.remove(cid, ghobject_t(hobject_t("warm" + stringify(i), "",
+                                         CEPH_NOSNAP, i, 1, "")));
+    }
+    t.remove_collection(cid);
+    int r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+}
+
+TEST_P(StoreTest, WarmCacheCorruptTest) {
+  if (string(GetParam()) != "bluestore")
+    return;
+  SetVal(g_conf(), "bluestore_warm_cache", "true");
+  g_conf().apply_changes(nullptr);
+
+  const unsigned num_objects = 16;
+  coll_t cid(spg_t(pg_t(0, 1), shard_id_t::NO_SHARD));
+  auto ch = store->create_new_collection(cid);
+  warm_cache_populate(store.get(), ch, cid, num_objects);
+  ch.reset();
+  ASSERT_EQ(store->umount(), 0);
+
+  // replace the snapshot with a truncated copy of itself
+  {
+    auto bluestore = std::make_unique<BlueStore>(g_ceph_context, data_dir);
+    KeyValueDB* db_ptr;
+    ASSERT_EQ(bluestore->open_db_environment(&db_ptr, false, false), 0);
+    BlueFS* fs = bluestore->get_bluefs();
+    uint64_t size = 0;
+    ASSERT_EQ(fs->stat(WARM_CACHE_DIR, WARM_CACHE_FILE, &size, nullptr), 0);
+    ASSERT_GT(size, 8u);
+    bufferlist bl;
+    {
+      BlueFS::FileReader* h;
+      ASSERT_EQ(fs->open_for_read(WARM_CACHE_DIR, WARM_CACHE_FILE, &h), 0);
+      ASSERT_EQ(fs->read(h, 0, size, &bl, nullptr), (int64_t)size);
+      delete h;
+    }
+    bufferlist truncated;
+    truncated.substr_of(bl, 0, size - 3);
+    {
+      BlueFS::FileWriter* h;
+      ASSERT_EQ(fs->open_for_write(WARM_CACHE_DIR, WARM_CACHE_FILE, &h, false), 0);
+      h->append(truncated);
+      ASSERT_EQ(fs->fsync(h), 0);
+      fs->close_writer(h);
+    }
+    bluestore->close_db_environment();
+  }
+
+  // a damaged snapshot is dropped: mount succeeds and prefetches nothing
+  ASSERT_EQ(store->mount(), 0);
+  BlueStore* bstore = dynamic_cast<BlueStore*>(store.get());
+  ASSERT_NE(bstore, nullptr);
+  ASSERT_EQ(bstore->get_bluefs()->stat(WARM_CACHE_DIR, WARM_CACHE_FILE,
+                                       nullptr, nullptr), -ENOENT);
+  const PerfCounters* logger = store->get_perf_counters();
+  ASSERT_EQ(logger->get(l_bluestore_warm_cache_onodes), 0u);
+
+  ch = store->open_collection(cid);
+  {
+    bufferlist bl;
+    ghobject_t hoid(hobject_t("warm0", "", CEPH_NOSNAP, 0, 1, ""));
+    ASSERT_EQ(store->read(ch, hoid, 0, 4096, bl), 4096);
+  }
+  {
+    ObjectStore::Transaction t;
+    for (unsigned i = 0; i < num_objects; ++i) {
+      t.remove(cid, ghobject_t(hobject_t("warm" + stringify(i), "",
+                                         CEPH_NOSNAP, i, 1, "")));
+    }
+    t.remove_collection(cid);
+    int r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+}
 #endif
 
 TEST_P(StoreTest, ManySmallWrite) {
@@ -2666,6 +3083,61 @@ TEST_P(StoreTest, ManySmallWrite) {
   }
 }
 
+TEST_P(StoreTest, ReadBatch) {
+  int r;
+  coll_t cid;
+  auto ch = store->create_new_collection(cid);
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  const int num = 8;
+  std::vector<bufferlist> data(num);
+  {
+    ObjectStore::Transaction t;
+    for (int i = 0; i < num; ++i) {
+      ghobject_t hoid(hobject_t(sobject_t("Object " + stringify(i), CEPH_NOSNAP)));
+      data[i].append(std::string(8192 + i * 4096, 'a' + i));
+      t.write(cid, hoid, 0, data[i].length(), data[i]);
+    }
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  std::vector<ObjectStore::read_op_t> ops;
+  for (int i = 0; i < num; ++i) {
+    ghobject_t hoid(hobject_t(sobject_t("Object " + stringify(i), CEPH_NOSNAP)));
+    ops.emplace_back(hoid, 4096, 8192);
+  }
+  // whole object, past eof and a missing object
+  ops.emplace_back(ops[1].oid, 0, 0);
+  ops.emplace_back(ops[2].oid, 1 << 20, 4096);
+  ops.emplace_back(
+    ghobject_t(hobject_t(sobject_t("Missing", CEPH_NOSNAP))), 0, 4096);
+  r = store->read_batch(ch, ops);
+  ASSERT_EQ(r, 0);
+  for (int i = 0; i < num; ++i) {
+    bufferlist exp;
+    exp.substr_of(data[i], 4096, std::min<size_t>(8192, data[i].length() - 4096));
+    ASSERT_EQ((int)exp.length(), ops[i].r);
+    ASSERT_TRUE(bl_eq(exp, ops[i].bl));
+  }
+  ASSERT_EQ((int)data[1].length(), ops[num].r);
+  ASSERT_TRUE(bl_eq(data[1], ops[num].bl));
+  ASSERT_EQ(0, ops[num + 1].r);
+  ASSERT_EQ(-ENOENT, ops[num + 2].r);
+  {
+    ObjectStore::Transaction t;
+    for (int i = 0; i < num; ++i) {
+      t.remove(cid, ops[i].oid);
+    }
+    t.remove_collection(cid);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+}
+
 TEST_P(StoreTest, MultiSmallWriteSameBlock) {
   int r;
   coll_t cid;
@@ -6660,6 +7132,82 @@ TEST_P(StoreTest, OMapTest) {
   ASSERT_EQ(r, 0);
 }
 
+TEST_P(StoreTest, OMapClearRangeDelete) {
+  if (string(GetParam()) != "bluestore")
+    return;
+  // force omap clears of any measurable size onto the range tombstone path
+  SetVal(g_conf(), "bluestore_omap_range_delete_min_bytes", "1");
+  g_ceph_context->_conf.apply_changes(nullptr);
+
+  coll_t cid(spg_t(pg_t(0, 333), shard_id_t::NO_SHARD));
+  ghobject_t a(hobject_t("omap_a", "", CEPH_NOSNAP, 0, 333, ""));
+  ghobject_t b(hobject_t("omap_b", "", CEPH_NOSNAP, 0, 333, ""));
+  auto ch = store->create_new_collection(cid);
+  int r;
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  bufferlist v;
+  v.append(string(1024, 'v'));
+  for (auto& o : {a, b}) {
+    map<string, bufferlist> to_set;
+    for (int n = 0; n < 2000; ++n) {
+      to_set[stringify(n)] = v;
+    }
+    ObjectStore::Transaction t;
+    t.touch(cid, o);
+    t.omap_setkeys(cid, o, to_set);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  {
+    ObjectStore::Transaction t;
+    t.omap_clear(cid, a);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  {
+    bufferlist hdr;
+    map<string, bufferlist> m;
+    store->omap_get(ch, a, &hdr, &m);
+    ASSERT_EQ(0u, m.size());
+    m.clear();
+    store->omap_get(ch, b, &hdr, &m);
+    ASSERT_EQ(2000u, m.size());
+  }
+  {
+    // setting keys again after the range delete must work
+    map<string, bufferlist> to_set;
+    to_set["again"] = v;
+    ObjectStore::Transaction t;
+    t.omap_setkeys(cid, a, to_set);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+    bufferlist hdr;
+    map<string, bufferlist> m;
+    store->omap_get(ch, a, &hdr, &m);
+    ASSERT_EQ(1u, m.size());
+    ASSERT_TRUE(m.count("again"));
+  }
+  {
+    ObjectStore::Transaction t;
+    t.remove(cid, b);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+    bufferlist hdr;
+    map<string, bufferlist> m;
+    ASSERT_EQ(-ENOENT, store->omap_get(ch, b, &hdr, &m));
+  }
+  ObjectStore::Transaction t;
+  t.remove(cid, a);
+  t.remove_collection(cid);
+  r = queue_transaction(store, ch, std::move(t));
+  ASSERT_EQ(r, 0);
+}
+
 TEST_P(StoreTest, OMapIterator) {
   coll_t cid;
   ghobject_t hoid(hobject_t("tesomap", "", CEPH_NOSNAP, 0, 0, ""));
@@ -12727,6 +13275,118 @@ TEST_P(StoreTestOmapUpgrade, LargeLegacyToPG) {
   }
 }
 
+TEST_P(StoreTestOmapUpgrade, PerPGToCompact) {
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  StartDeferred();
+  int64_t poolid = 11;
+  coll_t cid(spg_t(pg_t(1, poolid), shard_id_t::NO_SHARD));
+  auto ch = store->create_new_collection(cid);
+  int r;
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  size_t object_count = 200;
+  make_omap_data(object_count, poolid, cid);
+  check_omap_data(object_count, poolid, cid);
+  size_t fixed, compact;
+  count_perpg_omap_keys(&fixed, &compact);
+  ASSERT_GT(fixed, object_count);
+  ASSERT_EQ(compact, 0u);
+  size_t key_count = fixed;
+
+  ch.reset(nullptr);
+  store->umount();
+  ASSERT_EQ(store->fsck(false), 0);
+  SetVal(g_conf(), "bluestore_omap_compact_keys", "true");
+  g_conf().apply_changes(nullptr);
+  // fixed size keys stay valid, conversion is up to repair
+  ASSERT_EQ(store->fsck(false), 0);
+  ASSERT_EQ(store->quick_fix(), 0);
+  ASSERT_EQ(store->fsck(false), 0);
+  store->mount();
+  ch = store->open_collection(cid);
+  check_omap_data(object_count, poolid, cid);
+  // every key was rewritten, none lost or left behind
+  count_perpg_omap_keys(&fixed, &compact);
+  ASSERT_EQ(fixed, 0u);
+  ASSERT_EQ(compact, key_count);
+
+  std::string oid = generate_monotonic_name(object_count, 0, 3.71, 0.5);
+  ghobject_t hoid(hobject_t(oid, "", CEPH_NOSNAP, 0, poolid, ""));
+  ghobject_t hoid_clone(hobject_t(oid + "clone", "", CEPH_NOSNAP, 0, poolid, ""));
+  ghobject_t hoid_new(hobject_t("new", "", CEPH_NOSNAP, 0, poolid, ""));
+  map<string, bufferlist> expected;
+  bufferlist expected_header;
+  ASSERT_EQ(store->omap_get(ch, hoid, &expected_header, &expected), 0);
+  ASSERT_FALSE(expected.empty());
+  {
+    ObjectStore::Transaction t;
+    t.clone(cid, hoid, hoid_clone);
+    t.touch(cid, hoid_new);
+    t.omap_setkeys(cid, hoid_new, expected);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  for (auto& o : {hoid_clone, hoid_new}) {
+    map<string, bufferlist> res;
+    bufferlist h;
+    ASSERT_EQ(store->omap_get(ch, o, &h, &res), 0);
+    ASSERT_EQ(res.size(), expected.size());
+    for (auto& [k, v] : expected) {
+      ASSERT_TRUE(res.count(k));
+      ASSERT_TRUE(bl_eq(v, res[k]));
+    }
+  }
+  {
+    ObjectStore::Transaction t;
+    t.omap_rmkeyrange(cid, hoid_clone, expected.begin()->first,
+		      expected.rbegin()->first);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+    set<string> keys;
+    ASSERT_EQ(store->omap_get_keys(ch, hoid_clone, &keys), 0);
+    ASSERT_EQ(keys.size(), 1u);
+    ASSERT_EQ(*keys.begin(), expected.rbegin()->first);
+  }
+  // the clone and the new object use compact keys as well
+  count_perpg_omap_keys(&fixed, &compact);
+  ASSERT_EQ(fixed, 0u);
+  ASSERT_GT(compact, key_count + expected.size());
+  key_count = compact;
+
+  ch.reset(nullptr);
+  store->umount();
+  ASSERT_EQ(store->fsck(false), 0);
+  // compact keys stay readable with the option off
+  SetVal(g_conf(), "bluestore_omap_compact_keys", "false");
+  g_conf().apply_changes(nullptr);
+  store->mount();
+  ch = store->open_collection(cid);
+  check_omap_data(object_count, poolid, cid);
+  count_perpg_omap_keys(&fixed, &compact);
+  ASSERT_EQ(fixed, 0u);
+  ASSERT_EQ(compact, key_count);
+  {
+    ObjectStore::Transaction t;
+    for (size_t o = 0; o < object_count; o++)
+    {
+      std::string oid = generate_monotonic_name(object_count, o, 3.71, 0.5);
+      ghobject_t hoid(hobject_t(oid, "", CEPH_NOSNAP, 0, poolid, ""));
+      t.remove(cid, hoid);
+    }
+    t.remove(cid, hoid_clone);
+    t.remove(cid, hoid_new);
+    t.remove_collection(cid);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+}
+
 TEST_P(StoreTestSpecificAUSize, BlueFSReservedTest) {
   if (string(GetParam()) != "bluestore")
     return;
@@ -11,6 +11,8 @@
 #include "common/ceph_argparse.h"
 #include "include/stringify.h"
 #include "common/errno.h"
+#include "common/buffer_instrumentation.h"
+#include "include/scope_guard.h"
 
 #include "blk/BlockDevice.h"
 
@@ -91,6 +93,123 @@ TEST(KernelDevice, Ticket45337) {
   b->close();
 }
 
+static bool is_registered(const bufferlist& bl)
+{
+  if (bl.get_num_buffers() != 1) {
+    return false;
+  }
+  const auto& ibp =
+    static_cast<const ceph::buffer_instrumentation::instrumented_bptr&>(
+      bl.front());
+  return ibp.is_raw_marked<BlockDevice::ioring_registered_raw_marker_t>();
+}
+
+TEST(KernelDevice, IoringRegisteredBuffers) {
+  constexpr uint64_t buf_size = 65536;
+  constexpr unsigned nr_bufs = 4;
+  g_ceph_context->_conf.set_val("bdev_ioring", "true");
+  g_ceph_context->_conf.set_val("bdev_ioring_fixed_buffers",
+				stringify(nr_bufs));
+  g_ceph_context->_conf.set_val("bdev_ioring_fixed_buffer_size",
+				stringify(buf_size));
+  g_ceph_context->_conf.apply_changes(nullptr);
+  auto reset_conf = make_scope_guard([] {
+    g_ceph_context->_conf.set_val("bdev_ioring", "false");
+    g_ceph_context->_conf.set_val("bdev_ioring_fixed_buffers", "0");
+    g_ceph_context->_conf.apply_changes(nullptr);
+  });
+
+  TempBdev bdev{1048576ull * 16};
+  std::unique_ptr<BlockDevice> b(
+    BlockDevice::create(g_ceph_context, bdev.path, NULL, NULL,
+      [](void* handle, void* aio) {}, NULL));
+  {
+    int r = b->open(bdev.path);
+    if (r < 0) {
+      std::cerr << "open " << bdev.path << " failed" << std::endl;
+      return;
+    }
+  }
+
+  auto write = [&](uint64_t off, bufferlist bl) {
+    IOContext ioc(g_ceph_context, NULL);
+    ASSERT_EQ(0, b->aio_write(off, bl, &ioc, false));
+    ASSERT_TRUE(ioc.has_pending_aios());
+    b->aio_submit(&ioc);
+    ioc.aio_wait();
+    ASSERT_EQ(0, ioc.get_return_value());
+  };
+  auto read = [&](uint64_t off, uint64_t len, bufferlist *bl) {
+    IOContext ioc(g_ceph_context, NULL);
+    ASSERT_EQ(0, b->aio_read(off, len, bl, &ioc));
+    ASSERT_TRUE(ioc.has_pending_aios());
+    b->aio_submit(&ioc);
+    ioc.aio_wait();
+    ASSERT_EQ(0, ioc.get_return_value());
+    // registered buffers must not end up in the buffer cache
+    ASSERT_EQ(is_registered(*bl), ioc.skip_cache());
+  };
+
+  bufferlist data;
+  {
+    bufferptr bp = buffer::create_small_page_aligned(buf_size * 2);
+    for (unsigned i = 0; i < bp.length(); ++i) {
+      bp.c_str()[i] = 'a' + i % 26;
+    }
+    data.push_back(std::move(bp));
+  }
+  write(0, data);
+
+  // a read that fits lands directly in a registered buffer
+  bufferlist small;
+  read(0, buf_size, &small);
+  ASSERT_EQ(0, memcmp(small.c_str(), data.c_str(), buf_size));
+  if (!is_registered(small)) {
+    GTEST_SKIP() << "io_uring buffer registration is not available";
+  }
+
+  // a larger one does not
+  {
+    bufferlist big;
+    read(0, buf_size * 2, &big);
+    ASSERT_FALSE(is_registered(big));
+    ASSERT_TRUE(big.contents_equal(data));
+  }
+
+  // writing a registered buffer back goes through write_fixed
+  ::memset(small.c_str(), 'z', buf_size);
+  write(buf_size * 4, small);
+  {
+    bufferlist bl;
+    read(buf_size * 4, buf_size, &bl);
+    ASSERT_TRUE(bl.contents_equal(small));
+  }
+
+  // once every slot is held reads fall back to ordinary buffers, and a
+  // released slot is handed out again
+  {
+    std::vector<bufferlist> held(nr_bufs);
+    held[0] = small;
+    for (unsigned i = 1; i < nr_bufs; ++i) {
+      read(buf_size, buf_size, &held[i]);
+      ASSERT_TRUE(is_registered(held[i]));
+    }
+    bufferlist bl;
+    read(buf_size, buf_size, &bl);
+    ASSERT_FALSE(is_registered(bl));
+    ASSERT_TRUE(bl.contents_equal(held[1]));
+    held.pop_back();
+    bl.clear();
+    read(buf_size, buf_size, &bl);
+    ASSERT_TRUE(is_registered(bl));
+  }
+
+  // buffers stay valid after the device (and its ring) is gone
+  b->close();
+  b.reset();
+  ASSERT_EQ('z', small.c_str()[buf_size - 1]);
+}
+
 int main(int argc, char **argv) {
   auto args = argv_to_vec(argc, argv);
   map<string,string> defaults = {
@@ -318,6 +318,62 @@ TEST(BlueFS, very_large_write2) {
   g_ceph_context->_conf.set_val("bluefs_buffered_io", stringify((int)old));
 }
 
+TEST(BlueFS, sequential_readahead) {
+  uint64_t size = 1048576 * 128;
+  TempBdev bdev{size};
+
+  ConfSaver conf(g_ceph_context->_conf);
+  conf.SetVal("bluefs_buffered_io", "false");
+  conf.SetVal("bluefs_max_prefetch", "262144");
+  conf.SetVal("bluefs_readahead_max_bytes", "4194304");
+  conf.SetVal("bluefs_readahead_trigger", "2");
+  conf.ApplyChanges();
+
+  BlueFS fs(g_ceph_context);
+  ASSERT_EQ(0, fs.add_block_device(BlueFS::BDEV_DB, bdev.path, false));
+  uuid_d fsid;
+  ASSERT_EQ(0, fs.mkfs(fsid, { BlueFS::BDEV_DB, false, false }));
+  ASSERT_EQ(0, fs.mount());
+  ASSERT_EQ(0, fs.maybe_verify_layout({ BlueFS::BDEV_DB, false, false }));
+
+  // every 4 bytes hold their own offset, so a chunk served from the wrong
+  // place shows up as a mismatch
+  const uint64_t file_size = 16 * 1048576;
+  std::unique_ptr<char[]> buf(new char[file_size]);
+  for (uint64_t i = 0; i < file_size; i += sizeof(uint32_t)) {
+    uint32_t v = i;
+    memcpy(buf.get() + i, &v, sizeof(v));
+  }
+  {
+    BlueFS::FileWriter *h;
+    ASSERT_EQ(0, fs.mkdir("dir"));
+    ASSERT_EQ(0, fs.open_for_write("dir", "seqfile", &h, false));
+    fs.append_try_flush(h, buf.get(), file_size);
+    fs.fsync(h);
+    fs.close_writer(h);
+  }
+  auto *logger = fs.get_perf_counters();
+  uint64_t hits = logger->get(l_bluefs_readahead_hit_count);
+  uint64_t ra_bytes = logger->get(l_bluefs_readahead_bytes);
+  {
+    BlueFS::FileReader *h;
+    ASSERT_EQ(0, fs.open_for_read("dir", "seqfile", &h));
+    ASSERT_FALSE(h->buffered);
+    const uint64_t step = 65536;
+    bufferlist bl;
+    for (uint64_t off = 0; off < file_size; off += step) {
+      bl.clear();
+      ASSERT_EQ((int64_t)step, fs.read(h, off, step, &bl, NULL));
+      ASSERT_EQ(0, memcmp(buf.get() + off, bl.c_str(), step))
+	<< "mismatch at 0x" << std::hex << off;
+    }
+    delete h;
+  }
+  EXPECT_GT(logger->get(l_bluefs_readahead_hit_count), hits);
+  EXPECT_GT(logger->get(l_bluefs_readahead_bytes), ra_bytes);
+  fs.umount();
+}
+
 #define ALLOC_SIZE 4096
 
 void write_data(BlueFS &fs, uint64_t rationed_bytes)
@@ -2148,6 +2204,56 @@ TEST(BlueFS, test_concurrent_dir_link_and_compact_log_56210) {
   }
 }
 
+TEST(BlueFS, test_log_group_commit_background_compact) {
+  uint64_t size = 1048576 * 128;
+  TempBdev bdev{size};
+  ConfSaver conf(g_ceph_context->_conf);
+
+  conf.SetVal("bluefs_alloc_size", "65536");
+  conf.SetVal("bluefs_compact_log_sync", "false");
+  conf.SetVal("bluefs_log_compact_background", "true");
+  // make sure fsync always wants a log compaction
+  conf.SetVal("bluefs_log_compact_min_ratio", "0");
+  conf.SetVal("bluefs_log_compact_min_size", "0");
+  conf.ApplyChanges();
+
+  BlueFS fs(g_ceph_context);
+  ASSERT_EQ(0, fs.add_block_device(BlueFS::BDEV_DB, bdev.path, false));
+  uuid_d fsid;
+  ASSERT_EQ(0, fs.mkfs(fsid, { BlueFS::BDEV_DB, false, false }));
+  ASSERT_EQ(0, fs.mount());
+  ASSERT_EQ(0, fs.mkdir("dir"));
+
+  constexpr int num_threads = 8;
+  constexpr int num_appends = 50;
+  std::vector<std::thread> writers;
+  for (int i = 0; i < num_threads; ++i) {
+    writers.emplace_back([&fs, i] {
+      BlueFS::FileWriter *h;
+      ASSERT_EQ(0, fs.open_for_write("dir", "file." + to_string(i), &h, false));
+      auto sg = make_scope_guard([&fs, h] { fs.close_writer(h); });
+      std::unique_ptr<char[]> buf = gen_buffer(4096);
+      for (int j = 0; j < num_appends; ++j) {
+	h->append(buf.get(), 4096);
+	ASSERT_EQ(0, fs.fsync(h));
+      }
+    });
+  }
+  join_all(writers);
+  // compaction was requested but never run on the fsync threads
+  ASSERT_GT(fs.get_perf_counters()->get(l_bluefs_log_compact_queued), 0u);
+
+  fs.umount();
+  ASSERT_EQ(0, fs.mount());
+  for (int i = 0; i < num_threads; ++i) {
+    uint64_t file_size;
+    utime_t mtime;
+    ASSERT_EQ(0, fs.stat("dir", "file." + to_string(i), &file_size, &mtime));
+    ASSERT_EQ(uint64_t(4096 * num_appends), file_size);
+  }
+  fs.umount();
+}
+
 TEST(BlueFS, truncate_drops_allocations) {
   constexpr uint64_t K = 1024;
   constexpr uint64_t M = 1024 * K;
@@ -15,6 +15,7 @@
 #include "perfglue/heap_profiler.h"
 #include "os/bluestore/Writer.h"
 #include "common/pretty_binary.h"
+#include "include/scope_guard.h"
 #include <bitset>
 #include <sstream>
 #include <boost/random/mersenne_twister.hpp>
@@ -420,6 +421,95 @@ TEST(bluestore_blob_t, csum_bench) {
   }
 }
 
+TEST(bluestore_blob_t, csum_segmented) {
+  // calc/verify hash whole blocks of a segment in one go and fall back to
+  // the iterator for blocks that straddle segments; both must agree.
+  bufferptr bp(0x40000 + 24);
+  for (unsigned i = 0; i < bp.length(); ++i)
+    bp.c_str()[i] = (i * 131 + 7) ^ (i >> 9);
+  bufferlist contig;
+  contig.append(bp);
+  bufferlist frag;
+  unsigned frag_lens[] = {1000, 4096, 33, 0x9000, 17, 0x3000};
+  for (unsigned off = 0, i = 0; off < contig.length(); ++i) {
+    unsigned l = std::min<unsigned>(frag_lens[i % std::size(frag_lens)],
+				    contig.length() - off);
+    bufferptr f(l);
+    memcpy(f.c_str(), contig.c_str() + off, l);
+    frag.append(f);
+    off += l;
+  }
+  ASSERT_TRUE(contig.contents_equal(frag));
+
+  for (unsigned csum_type = Checksummer::CSUM_NONE + 1;
+       csum_type < Checksummer::CSUM_MAX; ++csum_type) {
+    for (unsigned order : {3, 12, 16}) {
+      cout << "csum_type " << Checksummer::get_csum_type_string(csum_type)
+	   << " order " << order << std::endl;
+      unsigned len = p2align(contig.length(), 1u << order);
+      bufferlist c, f;
+      c.substr_of(contig, 0, len);
+      f.substr_of(frag, 0, len);
+      bluestore_blob_t a, b;
+      a.init_csum(csum_type, order, len);
+      b.init_csum(csum_type, order, len);
+      a.calc_csum(0, c);
+      b.calc_csum(0, f);
+      ASSERT_EQ(a.csum_data.length(), b.csum_data.length());
+      ASSERT_EQ(0, memcmp(a.csum_data.c_str(), b.csum_data.c_str(),
+			  a.csum_data.length()));
+
+      int bad_off;
+      uint64_t bad_csum;
+      ASSERT_EQ(0, a.verify_csum(0, f, &bad_off, &bad_csum));
+      ASSERT_EQ(-1, bad_off);
+
+      // a bad block in the middle of a batch is reported at its offset;
+      // skip the truncated crcs, which may well miss a single corrupt byte
+      if (Checksummer::get_csum_value_size(csum_type) < 4) {
+	continue;
+      }
+      unsigned bad = (len >> order) / 2 + 1;
+      bufferlist corrupt;
+      corrupt.append(c.c_str(), len);
+      corrupt.c_str()[(bad << order) + 1] ^= 0x5a;
+      ASSERT_EQ(-1, a.verify_csum(0, corrupt, &bad_off, &bad_csum));
+      ASSERT_EQ((int)(bad << order), bad_off);
+    }
+  }
+}
+
+TEST(bluestore_blob_t, csum_bench_segmented) {
+  // contiguous buffers go through the multi-block path, 3000 byte segments
+  // force most 4K blocks through the per-block iterator path.
+  bufferlist contig, frag;
+  bufferptr bp(10485760);
+  for (char *a = bp.c_str(); a < bp.c_str() + bp.length(); ++a)
+    *a = (unsigned long)a & 0xff;
+  contig.append(bp);
+  for (unsigned off = 0; off < bp.length(); off += 3000) {
+    frag.append(bufferptr(bp, off, std::min(3000u, bp.length() - off)));
+  }
+  int count = 256;
+  for (unsigned csum_type = 1; csum_type < Checksummer::CSUM_MAX; ++csum_type) {
+    for (auto* bl : {&contig, &frag}) {
+      bluestore_blob_t b;
+      b.init_csum(csum_type, 12, bl->length());
+      ceph::mono_clock::time_point start = ceph::mono_clock::now();
+      for (int i = 0; i < count; ++i) {
+	b.calc_csum(0, *bl);
+      }
+      ceph::mono_clock::time_point end = ceph::mono_clock::now();
+      auto dur = std::chrono::duration_cast<ceph::timespan>(end - start);
+      double mbsec = (double)count * (double)bl->length() / 1000000.0 /
+	(double)dur.count() * 1000000000.0;
+      cout << "csum_type " << Checksummer::get_csum_type_string(csum_type)
+	   << (bl == &contig ? " contiguous, " : " segmented, ")
+	   << dur << " seconds, " << mbsec << " MB/sec" << std::endl;
+    }
+  }
+}
+
 TEST(Blob, put_ref) {
   {
     BlueStore store(g_ceph_context, "", 4096);
@@ -1766,6 +1856,150 @@ TEST(ExtentMap, reshard_split_creates_empty_blob) {
   }
 }
 
+// 4K extents, each with its own blob, 256 extents per shard
+static void fill_sharded_extent_map(BlueStore::Onode& onode,
+                                    unsigned num_extents)
+{
+  const unsigned per_shard = 256;
+  const uint32_t len = 0x1000;
+  BlueStore::ExtentMap& em = onode.extent_map;
+  for (unsigned i = 0; i < num_extents; i += per_shard) {
+    onode.onode.extent_map_shards.emplace_back(i * len, 0);
+  }
+  em.init_shards(true, false);
+  for (unsigned i = 0; i < num_extents; ++i) {
+    BlueStore::BlobRef b(onode.c->new_blob());
+    b->dirty_blob().allocated_test(bluestore_pextent_t(0x100000 + i * 2 * len, len));
+    b->get_ref(onode.c, 0, len);
+    em.add(i * len, 0, len, b);
+  }
+  for (auto& s : em.shards) {
+    s.extents = per_shard;
+  }
+}
+
+TEST(ExtentMap, pack_shards) {
+  BlueStore store(g_ceph_context, "", 4096);
+  std::unique_ptr<BlueStore::OnodeCacheShard> oc(
+    BlueStore::OnodeCacheShard::create(g_ceph_context, "lru", NULL));
+  std::unique_ptr<BlueStore::BufferCacheShard> bc(
+    BlueStore::BufferCacheShard::create(&store, "lru", NULL));
+
+  auto coll = ceph::make_ref<BlueStore::Collection>(&store, oc.get(), bc.get(), coll_t());
+  BlueStore::Onode onode(coll.get(), ghobject_t(), "");
+  BlueStore::ExtentMap& em = onode.extent_map;
+
+  const unsigned num_extents = 16384;
+  const uint32_t len = 0x1000;
+  fill_sharded_extent_map(onode, num_extents);
+  ASSERT_EQ(em.extent_map.size(), num_extents);
+
+  uint64_t decoded_bytes = mempool::bluestore_cache_meta::allocated_bytes();
+  ASSERT_EQ(em.pack_shards(), num_extents);
+  ASSERT_EQ(em.extent_map.size(), 0u);
+  uint64_t packed_bytes = mempool::bluestore_cache_meta::allocated_bytes();
+  uint64_t packed_len = 0;
+  for (auto& s : em.shards) {
+    ASSERT_FALSE(s.loaded);
+    ASSERT_GT(s.packed.length(), 0u);
+    packed_len += s.packed.length();
+  }
+  // the packed form is accounted to the meta cache and is a fraction of
+  // what the decoded extents and blobs took
+  ASSERT_LT(packed_bytes, decoded_bytes);
+  ASSERT_LT(packed_len * 4, decoded_bytes - packed_bytes + packed_len);
+
+  // nothing loaded, nothing to pack
+  ASSERT_EQ(em.pack_shards(), 0u);
+
+  // packed shards are decoded from memory, no DB needed
+  em.fault_range(nullptr, 0, num_extents * len);
+  ASSERT_EQ(em.extent_map.size(), num_extents);
+  for (auto& s : em.shards) {
+    ASSERT_TRUE(s.loaded);
+    ASSERT_EQ(s.packed.length(), 0u);
+  }
+  auto p = em.extent_map.begin();
+  for (unsigned i = 0; i < num_extents; ++i, ++p) {
+    ASSERT_EQ(p->logical_offset, i * len);
+    ASSERT_EQ(p->length, len);
+    ASSERT_EQ(p->blob->get_blob().get_extents()[0].offset,
+              0x100000 + i * 2 * len);
+    ASSERT_EQ(em.seek_lextent(i * len + 1), p);
+  }
+  ASSERT_LT(packed_bytes, mempool::bluestore_cache_meta::allocated_bytes());
+
+  // a partially faulted map packs just the loaded shards
+  ASSERT_EQ(em.pack_shards(), num_extents);
+  em.fault_range(nullptr, 0, 256 * len);
+  ASSERT_EQ(em.extent_map.size(), 256u);
+  ASSERT_EQ(em.pack_shards(), 256u);
+
+  // a dirty shard holds an update in flight: leave the map alone
+  em.fault_range(nullptr, 0, num_extents * len);
+  em.dirty_range(0, len);
+  ASSERT_EQ(em.pack_shards(), 0u);
+  ASSERT_EQ(em.extent_map.size(), num_extents);
+}
+
+TEST(LruOnodeCacheShard, pack_cold) {
+  BlueStore store(g_ceph_context, "", 4096);
+  std::unique_ptr<BlueStore::OnodeCacheShard> oc(
+    BlueStore::OnodeCacheShard::create(g_ceph_context, "lru", NULL));
+  std::unique_ptr<BlueStore::BufferCacheShard> bc(
+    BlueStore::BufferCacheShard::create(&store, "lru", NULL));
+  oc->set_max(100);
+  g_ceph_context->_conf.set_val("bluestore_extent_map_pack_min_extents", "512");
+  auto reset_conf = make_scope_guard([] {
+    g_ceph_context->_conf.set_val("bluestore_extent_map_pack_min_extents", "0");
+  });
+
+  auto coll = ceph::make_ref<BlueStore::Collection>(&store, oc.get(), bc.get(), coll_t());
+  const unsigned num_extents = 1024;
+  auto add = [&](const char *name, unsigned extents) {
+    ghobject_t oid(hobject_t(name, "", CEPH_NOSNAP, 0, 0, ""));
+    BlueStore::OnodeRef o(new BlueStore::Onode(coll.get(), oid, ""));
+    o->exists = true;
+    fill_sharded_extent_map(*o, extents);
+    return coll->onode_space.add_onode(oid, o).get();
+  };
+  BlueStore::Onode *big = add("big", num_extents);
+  BlueStore::Onode *small = add("small", 256);
+  // both are now unpinned and only referenced by the cache
+
+  // a recently used onode is left alone
+  oc->pack_cold();
+  ASSERT_EQ(big->extent_map.extent_map.size(), num_extents);
+
+  // once it has aged it is packed, but only if it is large enough
+  oc->shift_bins();
+  oc->pack_cold();
+  ASSERT_EQ(big->extent_map.extent_map.size(), 0u);
+  ASSERT_EQ(small->extent_map.extent_map.size(), 256u);
+
+  // using it again decodes it from memory and makes it hot
+  {
+    BlueStore::OnodeRef o(big);
+    o->extent_map.fault_range(nullptr, 0, num_extents * 0x1000);
+  }
+  ASSERT_EQ(big->extent_map.extent_map.size(), num_extents);
+  oc->pack_cold();
+  ASSERT_EQ(big->extent_map.extent_map.size(), num_extents);
+
+  // a referenced onode is left alone even when it is cold
+  BlueStore::Onode *pinned = add("pinned", num_extents);
+  {
+    BlueStore::OnodeRef o(pinned);
+    oc->shift_bins();
+    oc->pack_cold();
+    ASSERT_EQ(big->extent_map.extent_map.size(), 0u);
+    ASSERT_EQ(pinned->extent_map.extent_map.size(), num_extents);
+  }
+  oc->shift_bins();
+  oc->pack_cold();
+  ASSERT_EQ(pinned->extent_map.extent_map.size(), 0u);
+  ASSERT_EQ(oc->_get_num(), 3u);
+}
 
 class BlueStoreFixture :
   virtual public ::testing::Test,
@@ -3176,6 +3410,72 @@ TEST(ExtentMap, dup_extent_map)
   }
 }
 
+// Drive DeferredPolicy with a synthetic device where a direct write costs
+// 1ms whatever its size and a deferred write 100us plus 100us per 4k, so
+// deferring pays off up to 36k: with 4k * [1..256] writes the boundary must
+// settle at 32k whichever side it starts from.
+static uint64_t run_deferred_policy(uint64_t cur, uint64_t probe_interval)
+{
+  BlueStore::DeferredPolicy p;
+  p.base = 4096;
+  p.max_size = 1 << 20;
+  p.probe_interval = probe_interval;
+  p.enabled = true;
+  boost::random::mt19937 rng(0);
+  boost::random::uniform_int_distribution<uint64_t> blocks(1, 256);
+  for (unsigned interval = 0; interval < 20; ++interval) {
+    for (unsigned i = 0; i < 40000; ++i) {
+      uint64_t len = blocks(rng) * 4096;
+      bool deferred = p.use_deferred(len, cur);
+      if (deferred) {
+	EXPECT_LT(len, p.max_size);
+      }
+      p.note(p.size_class(len), deferred,
+	     deferred ? 100000 * (1 + len / 4096) : 1000000);
+    }
+    cur = p.update(cur, 1.1, 16);
+  }
+  return cur;
+}
+
+TEST(DeferredPolicy, update_converges)
+{
+  ASSERT_EQ(32768u, run_deferred_policy(4096, 4));
+  ASSERT_EQ(32768u, run_deferred_policy(1 << 20, 4));
+  ASSERT_EQ(32768u, run_deferred_policy(32768, 4));
+  // without probing a path is never sampled next to the boundary
+  ASSERT_EQ(4096u, run_deferred_policy(4096, 0));
+  ASSERT_EQ(1u << 20, run_deferred_policy(1 << 20, 0));
+}
+
+TEST(DeferredPolicy, use_deferred)
+{
+  BlueStore::DeferredPolicy p;
+  p.base = 4096;
+  p.max_size = 65536;
+  p.probe_interval = 2;
+  // disabled: a plain threshold
+  ASSERT_TRUE(p.use_deferred(16384, 32768));
+  ASSERT_FALSE(p.use_deferred(32768, 32768));
+  p.enabled = true;
+  // away from the boundary classes nothing is flipped
+  for (unsigned i = 0; i < 4; ++i) {
+    ASSERT_TRUE(p.use_deferred(4096, 32768));
+    ASSERT_FALSE(p.use_deferred(262144, 32768));
+  }
+  // one in two writes in the boundary classes takes the other path
+  unsigned flipped = 0;
+  for (unsigned i = 0; i < 8; ++i) {
+    flipped += !p.use_deferred(16384, 32768);
+    flipped += p.use_deferred(32768, 32768);
+  }
+  ASSERT_EQ(8u, flipped);
+  // but nothing at or above max_size is ever deferred
+  for (unsigned i = 0; i < 4; ++i) {
+    ASSERT_FALSE(p.use_deferred(65536, 65536));
+  }
+}
+
 void clear_and_dispose(BlueStore::old_extent_map_t &old_em) {
   auto oep = old_em.begin();
   while (oep != old_em.end()) {
@@ -29,6 +29,7 @@
 #include "global/global_init.h"
 #include "common/Cond.h"
 #include "common/errno.h"
+#include "common/Formatter.h"
 #include "include/stringify.h"
 #include <gtest/gtest.h>
 #include <fmt/format.h>
@@ -420,6 +421,102 @@ TEST_P(KVTest, ShardingRMRange) {
 }
 
 
+TEST_P(KVTest, RMRangeTombstone) {
+  if(string(GetParam()) != "rocksdb")
+    return;
+  ASSERT_EQ(0, db->create_and_open(cout, "O(7)="));
+  {
+    KeyValueDB::Transaction t = db->get_transaction();
+    for (size_t i = 0; i < 1000; i++) {
+      bufferlist value;
+      string key = fmt::format("key{:03}", i);
+      value.append(key);
+      t->set("O", key, value);
+      t->set("prefix", key, value);
+    }
+    db->submit_transaction_sync(t);
+  }
+  {
+    KeyValueDB::Transaction t = db->get_transaction();
+    t->rm_range_tombstone("O", "key277", "key467");
+    t->rm_range_tombstone("prefix", "key500", "key600");
+    db->submit_transaction_sync(t);
+  }
+  for (size_t i = 0; i < 1000; i++) {
+    string key = fmt::format("key{:03}", i);
+    bufferlist value;
+    ASSERT_EQ(db->get("O", key, &value),
+	      (i >= 277 && i < 467 ? -ENOENT : 0));
+    value.clear();
+    ASSERT_EQ(db->get("prefix", key, &value),
+	      (i >= 500 && i < 600 ? -ENOENT : 0));
+  }
+  // the tombstones must go away with compaction without touching
+  // anything outside of the range
+  db->compact_range("O", "key277", "key467");
+  db->compact_range("prefix", "key500", "key600");
+  auto it = db->get_iterator("prefix");
+  size_t n = 0;
+  for (it->seek_to_first(); it->valid(); it->next()) {
+    ++n;
+  }
+  ASSERT_EQ(900u, n);
+  fini();
+}
+
+TEST_P(KVTest, MultiGet) {
+  if (string(GetParam()) == "rocksdb") {
+    // keys of "O" spread over sharded CFs, "a" lives in the default CF
+    ASSERT_EQ(0, db->create_and_open(cout, "O(3)="));
+  } else {
+    ASSERT_EQ(0, db->create_and_open(cout));
+  }
+  {
+    KeyValueDB::Transaction t = db->get_transaction();
+    for (size_t i = 0; i < 100; i += 2) {
+      bufferlist value;
+      value.append(stringify(i));
+      t->set("O", fmt::format("key{:03}", i), value);
+      t->set("a", fmt::format("key{:03}", i), value);
+    }
+    db->submit_transaction_sync(t);
+  }
+
+  vector<pair<string, string>> keys;
+  for (size_t i = 0; i < 100; ++i) {
+    keys.emplace_back(i % 3 ? "O" : "a", fmt::format("key{:03}", i));
+  }
+  keys.emplace_back("nosuchprefix", "key000");
+  vector<bufferlist> values;
+  vector<int> rs;
+  ASSERT_EQ(0, db->multi_get(keys, &values, &rs));
+  ASSERT_EQ(keys.size(), values.size());
+  ASSERT_EQ(keys.size(), rs.size());
+  for (size_t i = 0; i < 100; ++i) {
+    if (i % 2) {
+      ASSERT_EQ(-ENOENT, rs[i]);
+      ASSERT_EQ(0u, values[i].length());
+    } else {
+      ASSERT_EQ(0, rs[i]);
+      ASSERT_EQ(stringify(i), _bl_to_str(values[i]));
+    }
+  }
+  ASSERT_EQ(-ENOENT, rs.back());
+
+  // the set based get() is served by the same batched lookup
+  set<string> ks;
+  for (size_t i = 0; i < 10; ++i) {
+    ks.insert(fmt::format("key{:03}", i));
+  }
+  map<string, bufferlist> out;
+  ASSERT_EQ(0, db->get("O", ks, &out));
+  ASSERT_EQ(5u, out.size());
+  for (auto& [k, v] : out) {
+    ASSERT_EQ(k.substr(3), fmt::format("{:03}", std::stoi(_bl_to_str(v))));
+  }
+  fini();
+}
+
 TEST_P(KVTest, RocksDBColumnFamilyTest) {
   if(string(GetParam()) != "rocksdb")
     return;
@@ -713,6 +810,19 @@ TEST_P(KVTest, RocksDB_parse_sharding_def) {
   ASSERT_EQ(sharding_def[2].shard_cnt, 1);
 
 
+  text_def = "A@2(4,0-8) B";
+  result = RocksDBStore::parse_sharding_def(text_def,
+					    sharding_def,
+					    &error_position,
+					    &error_msg);
+  ASSERT_EQ(result, true);
+  ASSERT_EQ(sharding_def.size(), 2);
+  ASSERT_EQ(sharding_def[0].name, "A");
+  ASSERT_EQ(sharding_def[0].gen, 2);
+  ASSERT_EQ(sharding_def[0].shard_cnt, 4);
+  ASSERT_EQ(sharding_def[1].name, "B");
+  ASSERT_EQ(sharding_def[1].gen, 0);
+
   text_def = "A(10 B(6)=option C";
   result = RocksDBStore::parse_sharding_def(text_def,
 					    sharding_def,
@@ -1179,6 +1289,52 @@ public:
     ASSERT_EQ(it->valid(), false);
   }
 
+  void modify_data(const std::string& prefix) {
+    ASSERT_EQ(db->submit_transaction_sync(build_modification(prefix)), 0);
+  }
+
+  // updates @data as if the returned transaction were submitted
+  KeyValueDB::Transaction build_modification(const std::string& prefix) {
+    KeyValueDB::Transaction t = db->get_transaction();
+    size_t i = 0;
+    for (auto dit = data.begin(); dit != data.end();) {
+      string p;
+      string key;
+      RocksDBStore::split_key(dit->first, &p, &key);
+      if (p != prefix) {
+	++dit;
+	continue;
+      }
+      if ((i % 5) == 0) {
+	t->rmkey(p, key);
+	dit = data.erase(dit);
+      } else {
+	if ((i % 3) == 0) {
+	  dit->second += "-new";
+	  bufferlist v;
+	  v.append(dit->second);
+	  t->set(p, key, v);
+	}
+	++dit;
+      }
+      i++;
+    }
+    return t;
+  }
+
+  void wait_for_online_reshard() {
+    for (int i = 0; i < 600; i++) {
+      JSONFormatter f;
+      db->dump_reshard_status(&f);
+      std::stringstream ss;
+      f.flush(ss);
+      if (ss.str().find("\"done\":false") == std::string::npos)
+	return;
+      usleep(100000);
+    }
+    FAIL() << "online reshard did not complete";
+  }
+
   void check_db() {
     KeyValueDB::WholeSpaceIterator it = db->get_wholespace_iterator();
     //move forward
@@ -1345,6 +1501,98 @@ TEST_F(RocksDBResharding, change_reshard) {
   }
 }
 
+TEST_F(RocksDBResharding, online) {
+  ASSERT_EQ(0, db->create_and_open(cout, "Evade(2)"));
+  generate_data();
+  data_to_db();
+  check_db();
+  std::stringstream ss;
+  ASSERT_EQ(db->reshard_online("Evade(4)", ss), 0);
+  ASSERT_EQ(db->reshard_online("Evade(8)", ss), -EBUSY);
+  // writes and reads race with the migration thread
+  modify_data("Evade");
+  check_db();
+  wait_for_online_reshard();
+  check_db();
+  std::string sharding;
+  ASSERT_TRUE(db->get_sharding(sharding));
+  ASSERT_EQ(sharding, "Evade@1(4)");
+  db->close();
+  ASSERT_EQ(db->open(cout), 0);
+  check_db();
+  db->close();
+}
+
+TEST_F(RocksDBResharding, online_block_cache) {
+  ASSERT_EQ(0, db->create_and_open(cout, "Evade(2)=block_cache={type=binned_lru}"));
+  generate_data();
+  data_to_db();
+  auto cache = db->get_priority_cache("Evade");
+  ASSERT_TRUE(cache);
+  std::stringstream ss;
+  // a cache of its own can only be set up offline
+  ASSERT_EQ(db->reshard_online("Evade(4)=block_cache={type=lru_cache}", ss),
+	    -ENOTSUP);
+  ASSERT_EQ(db->reshard_online("Evade(4)=block_cache_size=1024", ss),
+	    -ENOTSUP);
+  // the new columns keep using the one the prefix has
+  ASSERT_EQ(db->reshard_online("Evade(4)", ss), 0);
+  wait_for_online_reshard();
+  check_db();
+  ASSERT_EQ(db->get_priority_cache("Evade"), cache);
+  std::string sharding;
+  ASSERT_TRUE(db->get_sharding(sharding));
+  ASSERT_EQ(sharding, "Evade@1(4)=block_cache={type=binned_lru}");
+  db->close();
+  ASSERT_EQ(db->open(cout), 0);
+  ASSERT_TRUE(db->get_priority_cache("Evade"));
+  check_db();
+  db->close();
+}
+
+TEST_F(RocksDBResharding, online_resume_after_close) {
+  ASSERT_EQ(0, db->create_and_open(cout, "D(3) Evade(2)"));
+  generate_data();
+  data_to_db();
+  std::stringstream ss;
+  ASSERT_EQ(db->reshard_online("Evade(3)", ss), 0);
+  modify_data("Evade");
+  db->close();
+  ASSERT_EQ(db->open(cout), 0);
+  check_db();
+  wait_for_online_reshard();
+  check_db();
+  ASSERT_EQ(db->reshard_online("Evade(1)", ss), 0);
+  wait_for_online_reshard();
+  std::string sharding;
+  ASSERT_TRUE(db->get_sharding(sharding));
+  ASSERT_EQ(sharding, "D(3) Evade@2(1)");
+  db->close();
+  ASSERT_EQ(db->open(cout), 0);
+  check_db();
+  db->close();
+}
+
+TEST_F(RocksDBResharding, online_stale_transactions) {
+  ASSERT_EQ(0, db->create_and_open(cout, "Evade(2)"));
+  generate_data();
+  data_to_db();
+  // resolved against the old layout, submitted once it is dropped
+  KeyValueDB::Transaction before = build_modification("Evade");
+  std::stringstream ss;
+  ASSERT_EQ(db->reshard_online("Evade(4)", ss), 0);
+  // carries deletes for the old layout, unless the move is already done
+  KeyValueDB::Transaction during = build_modification("Evade");
+  wait_for_online_reshard();
+  ASSERT_EQ(db->submit_transaction_sync(before), 0);
+  ASSERT_EQ(db->submit_transaction_sync(during), 0);
+  check_db();
+  db->close();
+  ASSERT_EQ(db->open(cout), 0);
+  check_db();
+  db->close();
+}
+
 typedef std::mt19937 gen_type;
 
 class RocksDBSplitRange : public ::testing::Test {
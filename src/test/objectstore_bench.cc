@@ -3,18 +3,24 @@
 
 #include <dirent.h>
 
+#include <array>
 #include <chrono>
+#include <cinttypes>
 #include <cassert>
 #include <condition_variable>
 #include <memory>
 #include <mutex>
+#include <random>
 #include <thread>
 
 #include "os/ObjectStore.h"
 
 #include "global/global_init.h"
 
+#include "common/ceph_time.h"
 #include "common/debug.h"
+#include "common/JSONFormatter.h"
+#include "common/perf_counters.h"
 #include "common/strtol.h"
 #include "common/ceph_argparse.h"
 
@@ -35,7 +41,25 @@ static void usage()
       "	 --threads\n"
       "	       number of threads to carry out this workload\n"
       "	 --multi-object\n"
-    "	       have each thread write to a separate object\n" << std::endl;
+      "	       have each thread write to a separate object\n"
+      "	 --workload write|rbd|rgw|cephfs|omap\n"
+      "	       write: sequential writes as described by the flags above\n"
+      "	       rbd: random block-size overwrites of preallocated objects\n"
+      "	       rgw: small object puts with a bucket index omap update\n"
+      "	       cephfs: file create/setxattr/unlink with dentry omap updates\n"
+      "	       omap: batches of small omap keys, iterated back afterwards\n"
+      "	 --ops\n"
+      "	       number of transactions per thread (rbd, rgw, cephfs)\n"
+      "	 --objects\n"
+      "	       objects per thread (rbd) or live files per thread (cephfs)\n"
+      "	 --object-size\n"
+      "	       object size in bytes (rbd)\n"
+      "	 --queue-depth\n"
+      "	       transactions each thread keeps in flight (rbd, rgw, cephfs)\n"
+      "	 --seed\n"
+      "	       random seed\n"
+      "	 --format plain|json\n"
+      "	       report format, json adds the objectstore perf counters\n" << std::endl;
   generic_server_usage();
 }
 
@@ -79,10 +103,96 @@ struct Config {
   int repeats;
   int threads;
   bool multi_object;
+  std::string workload;
+  int ops;
+  int objects;
+  byte_units object_size;
+  int queue_depth;
+  uint64_t seed;
+  std::string format;
   Config()
     : size(1048576), block_size(4096),
       repeats(1), threads(1),
-      multi_object(false) {}
+      multi_object(false),
+      workload("write"), ops(10000), objects(64),
+      object_size(4194304), queue_depth(16),
+      seed(0), format("plain") {}
+};
+
+/// commit latency histogram with power of two microsecond buckets
+struct LatencyHistogram {
+  static constexpr size_t num_buckets = 32;
+  std::array<uint64_t, num_buckets> buckets = {};
+  uint64_t count = 0;
+  uint64_t sum_us = 0;
+  uint64_t min_us = UINT64_MAX;
+  uint64_t max_us = 0;
+
+  /// bucket i holds latencies below 2^i us
+  static size_t bucket_of(uint64_t us) {
+    size_t b = us ? 64 - __builtin_clzll(us) : 0;
+    return std::min(b, num_buckets - 1);
+  }
+  void add(uint64_t us) {
+    ++buckets[bucket_of(us)];
+    ++count;
+    sum_us += us;
+    min_us = std::min(min_us, us);
+    max_us = std::max(max_us, us);
+  }
+  void merge(const LatencyHistogram& o) {
+    for (size_t i = 0; i < num_buckets; ++i) {
+      buckets[i] += o.buckets[i];
+    }
+    count += o.count;
+    sum_us += o.sum_us;
+    min_us = std::min(min_us, o.min_us);
+    max_us = std::max(max_us, o.max_us);
+  }
+  /// upper bound of the bucket holding the given quantile
+  uint64_t percentile(double q) const {
+    uint64_t want = q * count;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < num_buckets; ++i) {
+      seen += buckets[i];
+      if (seen > want) {
+        return std::min<uint64_t>(1ull << i, max_us);
+      }
+    }
+    return max_us;
+  }
+  void dump(ceph::Formatter *f) const {
+    f->dump_unsigned("count", count);
+    f->dump_unsigned("avg_us", count ? sum_us / count : 0);
+    f->dump_unsigned("min_us", count ? min_us : 0);
+    f->dump_unsigned("max_us", max_us);
+    f->dump_unsigned("p50_us", percentile(0.5));
+    f->dump_unsigned("p90_us", percentile(0.9));
+    f->dump_unsigned("p99_us", percentile(0.99));
+    f->dump_unsigned("p999_us", percentile(0.999));
+    f->open_array_section("histogram");
+    for (size_t i = 0; i < num_buckets; ++i) {
+      if (buckets[i]) {
+        f->open_object_section("bucket");
+        f->dump_unsigned("lt_us", 1ull << i);
+        f->dump_unsigned("count", buckets[i]);
+        f->close_section();
+      }
+    }
+    f->close_section();
+  }
+};
+
+struct WorkloadStats {
+  LatencyHistogram lat;
+  uint64_t ops = 0;
+  uint64_t bytes = 0;
+
+  void merge(const WorkloadStats& o) {
+    lat.merge(o.lat);
+    ops += o.ops;
+    bytes += o.bytes;
+  }
 };
 
 class C_NotifyCond : public Context {
@@ -150,6 +260,400 @@ void osbench_worker(ObjectStore *os, const Config &cfg,
   }
 }
 
+/// generates the transactions of one thread for a workload profile
+class Workload {
+protected:
+  const Config &cfg;
+  const coll_t cid;
+  const int thread;
+  std::mt19937_64 rng;
+
+  ghobject_t make_oid(const std::string& name) const {
+    return ghobject_t(hobject_t(sobject_t(name, CEPH_NOSNAP)));
+  }
+  static bufferlist make_payload(size_t len) {
+    bufferlist bl;
+    bl.append(buffer::create(len, 'x'));
+    return bl;
+  }
+public:
+  Workload(const Config &cfg, const coll_t& cid, int thread)
+    : cfg(cfg), cid(cid), thread(thread), rng(cfg.seed + thread) {}
+  virtual ~Workload() = default;
+
+  /// create the objects the timed phase operates on
+  virtual void prepare(ObjectStore::Transaction *t) = 0;
+  /// build the next transaction, returns the number of data bytes written
+  virtual uint64_t next(ObjectStore::Transaction *t) = 0;
+  /// remove everything the workload created
+  virtual void cleanup(ObjectStore::Transaction *t) = 0;
+  /// read back what the timed phase wrote, returns the number of items
+  /// read; 0 if the workload has no read phase
+  virtual uint64_t read(ObjectStore *os, ObjectStore::CollectionHandle& ch) {
+    return 0;
+  }
+};
+
+/// RBD: 4K random overwrites of fully allocated image objects
+class RBDWorkload : public Workload {
+  std::vector<ghobject_t> oids;
+  bufferlist data;
+public:
+  RBDWorkload(const Config &cfg, const coll_t& cid, int thread)
+    : Workload(cfg, cid, thread), data(make_payload(cfg.block_size)) {
+    for (int i = 0; i < cfg.objects; ++i) {
+      oids.push_back(make_oid(
+        "rbd_data." + std::to_string(thread) + "." + std::to_string(i)));
+    }
+  }
+  void prepare(ObjectStore::Transaction *t) override {
+    bufferlist full = make_payload(cfg.object_size);
+    for (auto& oid : oids) {
+      t->write(cid, oid, 0, cfg.object_size, full);
+    }
+  }
+  uint64_t next(ObjectStore::Transaction *t) override {
+    const auto& oid = oids[rng() % oids.size()];
+    uint64_t blocks = std::max<uint64_t>(cfg.object_size / cfg.block_size, 1);
+    uint64_t off = (rng() % blocks) * cfg.block_size;
+    t->write(cid, oid, off, cfg.block_size, data);
+    return cfg.block_size;
+  }
+  void cleanup(ObjectStore::Transaction *t) override {
+    for (auto& oid : oids) {
+      t->remove(cid, oid);
+    }
+  }
+};
+
+/// RGW: small object put with object_info sized attrs and a bucket index
+/// entry in omap
+class RGWWorkload : public Workload {
+  ghobject_t index;
+  uint64_t seq = 0;
+  bufferlist data;
+  bufferlist oi;
+  bufferlist etag;
+  bufferlist entry;
+
+  std::string name(uint64_t i) const {
+    return "rgw_obj." + std::to_string(thread) + "." + std::to_string(i);
+  }
+public:
+  RGWWorkload(const Config &cfg, const coll_t& cid, int thread)
+    : Workload(cfg, cid, thread),
+      index(make_oid(".dir.bucket." + std::to_string(thread))),
+      data(make_payload(cfg.block_size)),
+      oi(make_payload(256)),
+      etag(make_payload(32)),
+      entry(make_payload(200)) {}
+  void prepare(ObjectStore::Transaction *t) override {
+    t->touch(cid, index);
+  }
+  uint64_t next(ObjectStore::Transaction *t) override {
+    std::string n = name(seq++);
+    ghobject_t oid = make_oid(n);
+    t->touch(cid, oid);
+    t->write(cid, oid, 0, cfg.block_size, data);
+    t->setattr(cid, oid, "_", oi);
+    t->setattr(cid, oid, "user.rgw.etag", etag);
+    std::map<std::string, bufferlist> keys;
+    keys[n] = entry;
+    t->omap_setkeys(cid, index, keys);
+    return cfg.block_size;
+  }
+  void cleanup(ObjectStore::Transaction *t) override {
+    for (uint64_t i = 0; i < seq; ++i) {
+      t->remove(cid, make_oid(name(i)));
+    }
+    t->remove(cid, index);
+  }
+};
+
+/// CephFS: file create with backtrace/layout xattrs and a dentry in the
+/// directory omap, unlinking the oldest file once --objects are live
+class CephFSWorkload : public Workload {
+  ghobject_t dir;
+  uint64_t seq = 0;
+  uint64_t first = 0;
+  bufferlist parent;
+  bufferlist layout;
+  bufferlist dentry;
+
+  std::string name(uint64_t i) const {
+    return "10000000000." + std::to_string(thread) + "." + std::to_string(i);
+  }
+public:
+  CephFSWorkload(const Config &cfg, const coll_t& cid, int thread)
+    : Workload(cfg, cid, thread),
+      dir(make_oid("1.00000000." + std::to_string(thread))),
+      parent(make_payload(128)),
+      layout(make_payload(32)),
+      dentry(make_payload(512)) {}
+  void prepare(ObjectStore::Transaction *t) override {
+    t->touch(cid, dir);
+  }
+  uint64_t next(ObjectStore::Transaction *t) override {
+    std::string n = name(seq++);
+    ghobject_t oid = make_oid(n);
+    t->touch(cid, oid);
+    t->setattr(cid, oid, "parent", parent);
+    t->setattr(cid, oid, "layout", layout);
+    std::map<std::string, bufferlist> keys;
+    keys[n + "_head"] = dentry;
+    t->omap_setkeys(cid, dir, keys);
+    if (seq - first > (uint64_t)cfg.objects) {
+      std::string victim = name(first++);
+      t->remove(cid, make_oid(victim));
+      std::set<std::string> rm;
+      rm.insert(victim + "_head");
+      t->omap_rmkeys(cid, dir, rm);
+    }
+    return 0;
+  }
+  void cleanup(ObjectStore::Transaction *t) override {
+    for (uint64_t i = first; i < seq; ++i) {
+      t->remove(cid, make_oid(name(i)));
+    }
+    t->remove(cid, dir);
+  }
+};
+
+/// omap: batches of small keys set on one object per thread, read back
+/// with an omap iterator after the timed phase.  Compare omap key formats
+/// by running it with --bluestore_omap_compact_keys true and false.
+class OmapWorkload : public Workload {
+  static constexpr size_t keys_per_op = 500;
+  ghobject_t oid;
+  uint64_t seq = 0;
+  bufferlist val;
+public:
+  OmapWorkload(const Config &cfg, const coll_t& cid, int thread)
+    : Workload(cfg, cid, thread),
+      oid(make_oid("omap." + std::to_string(thread))),
+      val(make_payload(40)) {}
+  void prepare(ObjectStore::Transaction *t) override {
+    t->touch(cid, oid);
+  }
+  uint64_t next(ObjectStore::Transaction *t) override {
+    std::map<std::string, bufferlist> keys;
+    for (size_t i = 0; i < keys_per_op; ++i) {
+      char key[32];
+      snprintf(key, sizeof(key), "%016" PRIu64, seq++);
+      keys.emplace(key, val);
+    }
+    t->omap_setkeys(cid, oid, keys);
+    return 0;
+  }
+  uint64_t read(ObjectStore *os, ObjectStore::CollectionHandle& ch) override {
+    uint64_t n = 0;
+    auto it = os->get_omap_iterator(ch, oid);
+    for (it->seek_to_first(); it->valid(); it->next()) {
+      ++n;
+    }
+    ceph_assert(n == seq);
+    return n;
+  }
+  void cleanup(ObjectStore::Transaction *t) override {
+    t->remove(cid, oid);
+  }
+};
+
+static std::unique_ptr<Workload> make_workload(
+  const Config &cfg, const coll_t& cid, int thread)
+{
+  if (cfg.workload == "rbd") {
+    return std::make_unique<RBDWorkload>(cfg, cid, thread);
+  } else if (cfg.workload == "rgw") {
+    return std::make_unique<RGWWorkload>(cfg, cid, thread);
+  } else if (cfg.workload == "cephfs") {
+    return std::make_unique<CephFSWorkload>(cfg, cid, thread);
+  } else if (cfg.workload == "omap") {
+    return std::make_unique<OmapWorkload>(cfg, cid, thread);
+  }
+  return nullptr;
+}
+
+/// records the commit latency of one transaction and releases its
+/// queue depth slot
+class C_OpCommitted : public Context {
+  std::mutex *mutex;
+  std::condition_variable *cond;
+  int *in_flight;
+  WorkloadStats *stats;
+  ceph::mono_time start;
+public:
+  C_OpCommitted(std::mutex *mutex, std::condition_variable *cond,
+                int *in_flight, WorkloadStats *stats)
+    : mutex(mutex), cond(cond), in_flight(in_flight), stats(stats),
+      start(ceph::mono_clock::now()) {}
+  void finish(int r) override {
+    auto lat = std::chrono::duration_cast<std::chrono::microseconds>(
+      ceph::mono_clock::now() - start);
+    std::lock_guard<std::mutex> lock(*mutex);
+    stats->lat.add(lat.count());
+    --(*in_flight);
+    cond->notify_one();
+  }
+};
+
+static void queue_and_wait(ObjectStore *os, ObjectStore::CollectionHandle& ch,
+                           ObjectStore::Transaction&& t)
+{
+  std::mutex mutex;
+  std::condition_variable cond;
+  bool done = false;
+  t.register_on_commit(new C_NotifyCond(&mutex, &cond, &done));
+  os->queue_transaction(ch, std::move(t));
+  std::unique_lock<std::mutex> lock(mutex);
+  cond.wait(lock, [&done](){ return done; });
+}
+
+void workload_worker(ObjectStore *os, const Config &cfg, Workload *w,
+                     const coll_t cid, WorkloadStats *stats)
+{
+  ObjectStore::CollectionHandle ch = os->open_collection(cid);
+  ceph_assert(ch);
+
+  std::mutex mutex;
+  std::condition_variable cond;
+  int in_flight = 0;
+  for (int i = 0; i < cfg.ops; ++i) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      cond.wait(lock, [&] { return in_flight < cfg.queue_depth; });
+      ++in_flight;
+    }
+    ObjectStore::Transaction t;
+    uint64_t bytes = w->next(&t);
+    t.register_on_commit(
+      new C_OpCommitted(&mutex, &cond, &in_flight, stats));
+    os->queue_transaction(ch, std::move(t));
+    stats->ops++;
+    stats->bytes += bytes;
+  }
+  std::unique_lock<std::mutex> lock(mutex);
+  cond.wait(lock, [&] { return in_flight == 0; });
+}
+
+static void dump_perf_counters(ObjectStore *os, ceph::Formatter *f)
+{
+  f->open_object_section("objectstore_perf_stat");
+  os->get_cur_stats().dump(f);
+  f->close_section();
+  // per stage latencies (state_*_lat for bluestore) are in here
+  f->open_object_section("perf_counters");
+  if (auto logger = os->get_perf_counters(); logger) {
+    f->open_object_section(logger->get_name().c_str());
+    logger->dump_formatted(f, false, select_labeled_t::unlabeled);
+    f->close_section();
+  }
+  f->close_section();
+}
+
+static int run_workload(ObjectStore *os, const Config &cfg)
+{
+  std::vector<coll_t> cids;
+  std::vector<std::unique_ptr<Workload>> workloads;
+  // one collection per thread, like a pg per client
+  for (int i = 0; i < cfg.threads; i++) {
+    coll_t cid(spg_t(pg_t(i, 1), shard_id_t::NO_SHARD));
+    auto w = make_workload(cfg, cid, i);
+    if (!w) {
+      derr << "unknown workload " << cfg.workload << dendl;
+      return -EINVAL;
+    }
+    ObjectStore::CollectionHandle ch = os->create_new_collection(cid);
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    w->prepare(&t);
+    queue_and_wait(os, ch, std::move(t));
+    cids.push_back(cid);
+    workloads.push_back(std::move(w));
+  }
+  dout(0) << "prepared " << cfg.workload << " workload" << dendl;
+
+  std::vector<WorkloadStats> stats(cfg.threads);
+  std::vector<std::thread> workers;
+  workers.reserve(cfg.threads);
+  auto t1 = ceph::mono_clock::now();
+  for (int i = 0; i < cfg.threads; i++) {
+    workers.emplace_back(workload_worker, os, std::ref(cfg),
+                         workloads[i].get(), cids[i], &stats[i]);
+  }
+  for (auto &worker : workers)
+    worker.join();
+  auto t2 = ceph::mono_clock::now();
+
+  WorkloadStats total;
+  for (auto& s : stats) {
+    total.merge(s);
+  }
+  auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
+    t2 - t1).count();
+  duration = std::max<int64_t>(duration, 1);
+  uint64_t iops = 1000000ull * total.ops / duration;
+  byte_units rate = 1000000ull * total.bytes / duration;
+
+  uint64_t read_items = 0;
+  t1 = ceph::mono_clock::now();
+  for (int i = 0; i < cfg.threads; i++) {
+    ObjectStore::CollectionHandle ch = os->open_collection(cids[i]);
+    read_items += workloads[i]->read(os, ch);
+  }
+  t2 = ceph::mono_clock::now();
+  auto read_duration = std::chrono::duration_cast<std::chrono::microseconds>(
+    t2 - t1).count();
+
+  if (cfg.format == "json") {
+    ceph::JSONFormatter f(true);
+    f.open_object_section("objectstore_bench");
+    f.dump_string("objectstore", g_conf()->osd_objectstore);
+    f.dump_string("workload", cfg.workload);
+    f.dump_int("threads", cfg.threads);
+    f.dump_int("queue_depth", cfg.queue_depth);
+    f.dump_unsigned("block_size", cfg.block_size);
+    f.dump_unsigned("ops", total.ops);
+    f.dump_unsigned("bytes", total.bytes);
+    f.dump_int("duration_us", duration);
+    f.dump_unsigned("iops", iops);
+    f.dump_unsigned("bytes_per_sec", rate);
+    f.open_object_section("commit_latency");
+    total.lat.dump(&f);
+    f.close_section();
+    if (read_items) {
+      f.dump_unsigned("read_items", read_items);
+      f.dump_int("read_duration_us", read_duration);
+    }
+    dump_perf_counters(os, &f);
+    f.close_section();
+    f.flush(std::cout);
+    std::cout << std::endl;
+  } else {
+    dout(0) << cfg.workload << ": " << total.ops << " ops in "
+            << duration << "us, " << iops << " iops, " << rate << "/s"
+            << dendl;
+    dout(0) << "commit latency avg " << total.lat.sum_us / std::max<uint64_t>(total.lat.count, 1)
+            << "us p50 " << total.lat.percentile(0.5)
+            << "us p99 " << total.lat.percentile(0.99)
+            << "us p99.9 " << total.lat.percentile(0.999)
+            << "us max " << total.lat.max_us << "us" << dendl;
+    if (read_items) {
+      dout(0) << "read back " << read_items << " items in "
+              << read_duration << "us" << dendl;
+    }
+  }
+
+  for (int i = 0; i < cfg.threads; i++) {
+    ObjectStore::CollectionHandle ch = os->open_collection(cids[i]);
+    ObjectStore::Transaction t;
+    workloads[i]->cleanup(&t);
+    t.remove_collection(cids[i]);
+    queue_and_wait(os, ch, std::move(t));
+  }
+  return 0;
+}
+
 int main(int argc, const char *argv[])
 {
   // command-line arguments
@@ -193,6 +697,24 @@ int main(int argc, const char *argv[])
       cfg.threads = atoi(val.c_str());
     } else if (ceph_argparse_flag(args, i, "--multi-object", (char*)nullptr)) {
       cfg.multi_object = true;
+    } else if (ceph_argparse_witharg(args, i, &val, "--workload", (char*)nullptr)) {
+      cfg.workload = val;
+    } else if (ceph_argparse_witharg(args, i, &val, "--ops", (char*)nullptr)) {
+      cfg.ops = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--objects", (char*)nullptr)) {
+      cfg.objects = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--object-size", (char*)nullptr)) {
+      std::string err;
+      if (!cfg.object_size.parse(val, &err)) {
+        derr << "error parsing object-size: " << err << dendl;
+        exit(1);
+      }
+    } else if (ceph_argparse_witharg(args, i, &val, "--queue-depth", (char*)nullptr)) {
+      cfg.queue_depth = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--seed", (char*)nullptr)) {
+      cfg.seed = strtoull(val.c_str(), nullptr, 10);
+    } else if (ceph_argparse_witharg(args, i, &val, "--format", (char*)nullptr)) {
+      cfg.format = val;
     } else {
       derr << "Error: can't understand argument: " << *i << "\n" << dendl;
       exit(1);
@@ -209,6 +731,24 @@ int main(int argc, const char *argv[])
   dout(0) << "block-size " << cfg.block_size << dendl;
   dout(0) << "repeats " << cfg.repeats << dendl;
   dout(0) << "threads " << cfg.threads << dendl;
+  dout(0) << "workload " << cfg.workload << dendl;
+
+  if (cfg.workload != "write" && cfg.workload != "rbd" &&
+      cfg.workload != "rgw" && cfg.workload != "cephfs" &&
+      cfg.workload != "omap") {
+    derr << "unknown workload " << cfg.workload << dendl;
+    return 1;
+  }
+  if (cfg.format != "plain" && cfg.format != "json") {
+    derr << "unknown format " << cfg.format << dendl;
+    return 1;
+  }
+  if (cfg.threads < 1 || cfg.queue_depth < 1 || cfg.objects < 1 ||
+      cfg.block_size == 0) {
+    derr << "threads, queue-depth, objects and block-size must be positive"
+         << dendl;
+    return 1;
+  }
 
   auto os =
       ObjectStore::create(g_ceph_context,
@@ -264,6 +804,12 @@ int main(int argc, const char *argv[])
 
   dout(10) << "created objectstore " << os.get() << dendl;
 
+  if (cfg.workload != "write") {
+    int r = run_workload(os.get(), cfg);
+    os->umount();
+    return r < 0 ? 1 : 0;
+  }
+
   // create a collection
   spg_t pg;
   const coll_t cid(pg);
@@ -320,6 +866,22 @@ int main(int argc, const char *argv[])
   dout(0) << "Wrote " << total << " in "
       << duration.count() << "us, at a rate of " << rate << "/s and "
       << iops << " iops" << dendl;
+  if (cfg.format == "json") {
+    ceph::JSONFormatter f(true);
+    f.open_object_section("objectstore_bench");
+    f.dump_string("objectstore", g_conf()->osd_objectstore);
+    f.dump_string("workload", cfg.workload);
+    f.dump_int("threads", cfg.threads);
+    f.dump_unsigned("block_size", cfg.block_size);
+    f.dump_unsigned("bytes", total);
+    f.dump_int("duration_us", duration.count());
+    f.dump_unsigned("iops", iops);
+    f.dump_unsigned("bytes_per_sec", rate);
+    dump_perf_counters(os.get(), &f);
+    f.close_section();
+    f.flush(std::cout);
+    std::cout << std::endl;
+  }
 
   // remove the objects
   ObjectStore::Transaction t;
@@ -178,7 +178,8 @@ public:
     int k,
     int m,
     uint64_t stripe_width,
-    uint64_t flags)
+    uint64_t flags,
+    const std::vector<shard_id_t>& chunk_mapping = {})
   {
     pg_pool_t pool;
     pool.type = pg_pool_t::TYPE_ERASURE;
@@ -195,10 +196,12 @@ public:
     
     // Only set nonprimary_shards if OPTIMIZATIONS flag is set
     if (flags & pg_pool_t::FLAG_EC_OPTIMIZATIONS) {
-      // Mark shards 1 to k-1 (inclusive) as nonprimary
-      // Shard 0 can be primary, shards k to k+m-1 (coding shards) can be primary
+      // Mark the shards of data chunks 1 to k-1 (inclusive) as nonprimary,
+      // as OSDMonitor does. The first data chunk and the coding chunks can
+      // be primary.
       for (int i = 1; i < k; i++) {
-        pool.nonprimary_shards.insert(shard_id_t(i));
+        pool.nonprimary_shards.insert(
+          int(chunk_mapping.size()) > i ? chunk_mapping[i] : shard_id_t(i));
       }
     }
     
@@ -35,6 +35,45 @@ void PGBackendTestFixture::setup_ec_pool()
 {
   CephContext *cct = g_ceph_context;
 
+  if (ec_plugin == "mock") {
+    ec_impl = std::make_shared<MockErasureCode>(k, k + m);
+  } else {
+    ErasureCodeProfile profile;
+    profile["k"] = std::to_string(k);
+    profile["m"] = std::to_string(m);
+    profile["plugin"] = ec_plugin;
+
+    if (!ec_technique.empty()) {
+      profile["technique"] = ec_technique;
+    }
+
+    profile["stripe_unit"] = std::to_string(stripe_unit);
+    for (const auto& [key, value] : ec_profile) {
+      profile[key] = value;
+    }
+
+    std::stringstream ss;
+    // Tests are run from the build directory, so "./lib" points to the
+    // erasure code plugins in the build tree rather than /usr/local/lib64/ceph/erasure-code/
+    int ret = ceph::ErasureCodePluginRegistry::instance().factory(
+      ec_plugin,
+      "./lib",
+      profile,
+      &ec_impl,
+      &ss);
+
+    if (ret != 0) {
+      FAIL() << "Failed to create EC plugin '" << ec_plugin << "': " << ss.str();
+      return;
+    }
+  }
+
+  // Plugins such as LRC add local parity chunks on top of k+m: count those
+  // as coding chunks, like get_coding_chunk_count() does, so that there is
+  // one OSD and one backend per chunk.
+  k = ec_impl->get_data_chunk_count();
+  m = ec_impl->get_chunk_count() - k;
+
   int num_osds = k + m;
 
   osdmap = std::make_shared<OSDMap>();
@@ -69,7 +108,8 @@ void PGBackendTestFixture::setup_ec_pool()
   // This will properly calculate up_osd_features
   osdmap->apply_incremental(inc);
 
-  pg_pool_t pool = OSDMapTestHelpers::create_ec_pool(k, m, stripe_unit * k, pool_flags);
+  pg_pool_t pool = OSDMapTestHelpers::create_ec_pool(
+    k, m, stripe_unit * k, pool_flags, ec_impl->get_chunk_mapping());
   OSDMapTestHelpers::add_pool(osdmap, pool_id, pool);
 
   pgid = pg_t(0, pool_id);
@@ -85,36 +125,6 @@ void PGBackendTestFixture::setup_ec_pool()
   // This is required for crush_init_workspace() to work correctly
   osdmap->crush->finalize();
 
-  if (ec_plugin == "mock") {
-    ec_impl = std::make_shared<MockErasureCode>(k, k + m);
-  } else {
-    ErasureCodeProfile profile;
-    profile["k"] = std::to_string(k);
-    profile["m"] = std::to_string(m);
-    profile["plugin"] = ec_plugin;
-
-    if (!ec_technique.empty()) {
-      profile["technique"] = ec_technique;
-    }
-
-    profile["stripe_unit"] = std::to_string(stripe_unit);
-
-    std::stringstream ss;
-    // Tests are run from the build directory, so "./lib" points to the
-    // erasure code plugins in the build tree rather than /usr/local/lib64/ceph/erasure-code/
-    int ret = ceph::ErasureCodePluginRegistry::instance().factory(
-      ec_plugin,
-      "./lib",
-      profile,
-      &ec_impl,
-      &ss);
-
-    if (ret != 0) {
-      FAIL() << "Failed to create EC plugin '" << ec_plugin << "': " << ss.str();
-      return;
-    }
-  }
-
   ObjectStore::Transaction t;
   for (int i = 0; i < num_osds; i++) {
     spg_t shard_spgid(pgid, shard_id_t(i));
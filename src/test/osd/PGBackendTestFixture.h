@@ -99,6 +99,8 @@ protected:
   uint64_t stripe_unit = 4096;  // aka chunk_size
   std::string ec_plugin = "isa";
   std::string ec_technique = "reed_sol_van";
+  // additional profile entries, e.g. "l" for the lrc plugin
+  ceph::ErasureCodeProfile ec_profile;
 
   int num_replicas = 3;
   int min_size = 2;
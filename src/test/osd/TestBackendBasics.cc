@@ -22,7 +22,7 @@
  *
  * TestBackendBasics
  *   Parameterized over BackendWriteReadParam (BackendConfig × WriteReadParam).
- *   13 backends × 8 data sizes = 104 instances per test body.
+ *   17 backends × 8 data sizes = 136 instances per test body.
  *
  *   WriteThenRead  – write data, verify protocol messages, read back, verify
  *                    data integrity.
@@ -30,7 +30,7 @@
  *                    offset, read back and verify all three regions.
  *
  * TestECFailover
- *   Parameterized over BackendConfig (EC configs only, 12 instances).
+ *   Parameterized over BackendConfig (EC configs only, 16 instances).
  *   Failover is an EC-specific concept (shard-based primary election).
  *
  *   BasicOSDMapUpdate – write, update OSDMap epoch, verify read still works.
@@ -71,6 +71,9 @@ public:
       ec_plugin = config.ec_plugin;
       ec_technique = config.ec_technique;
       pool_flags = config.pool_flags;
+      if (config.l) {
+        ec_profile["l"] = std::to_string(config.l);
+      }
     } else {
       num_replicas = 3;
       min_size = 2;
@@ -329,12 +332,13 @@ TEST_P(TestBackendBasics, DirectRead) {
 
   hobject_t hoid = make_test_object(obj_name);
 
-  // Perform direct reads to each data shard (skip coding shards)
-  for (auto& [shard_id, backend] : backends) {
-    // Skip coding shards - only test data shards
-    if (shard_id >= k) {
-      continue;
-    }
+  // Perform direct reads to each data shard (skip coding shards). Plugins
+  // such as LRC interleave data and coding chunks, the chunk mapping gives
+  // the shard each data chunk is stored on.
+  const std::vector<shard_id_t>& mapping = ec_impl->get_chunk_mapping();
+  for (int raw = 0; raw < k; raw++) {
+    int shard_id = int(mapping.size()) > raw ? int(mapping[raw]) : raw;
+    auto& backend = backends[shard_id];
 
     ASSERT_TRUE(backend != nullptr) << "Backend for shard " << shard_id << " should not be null";
     
@@ -368,7 +372,7 @@ TEST_P(TestBackendBasics, DirectRead) {
 
     // Verify data integrity: this shard should contain the expected pattern
     const char* buf = shard_data.c_str();
-    char expected_char = 'A' + (shard_id % 26);
+    char expected_char = 'A' + (raw % 26);
     
     for (size_t i = 0; i < stripe_unit; i++) {
       ASSERT_EQ(buf[i], expected_char)
@@ -743,6 +747,12 @@ const std::vector<BackendConfig> kBackendConfigs = {
   {PGBackendTestFixture::EC, "jerasure", "reed_sol_van", pg_pool_t::FLAG_EC_OVERWRITES | pg_pool_t::FLAG_EC_OPTIMIZATIONS,  4096,  2, 1, "EC_Jerasure_Opt_k2m1_su4k"},
   {PGBackendTestFixture::EC, "jerasure", "reed_sol_van", pg_pool_t::FLAG_EC_OVERWRITES | pg_pool_t::FLAG_EC_OPTIMIZATIONS,  4096,  8, 3, "EC_Jerasure_Opt_k8m3_su4k"},
   {PGBackendTestFixture::EC, "jerasure", "reed_sol_van", pg_pool_t::FLAG_EC_OVERWRITES, 4096,  4, 2, "EC_Jerasure_NonOpt_k4m2_su4k"},
+  // lrc: k=4 m=2 l=3 stores 8 chunks as DD__DD__, a global parity and a
+  // local one per group of three
+  {PGBackendTestFixture::EC, "lrc", "", pg_pool_t::FLAG_EC_OVERWRITES | pg_pool_t::FLAG_EC_OPTIMIZATIONS,  4096,  4, 2, "EC_LRC_Opt_k4m2l3_su4k", 3},
+  {PGBackendTestFixture::EC, "lrc", "", pg_pool_t::FLAG_EC_OVERWRITES | pg_pool_t::FLAG_EC_OPTIMIZATIONS,  16384, 4, 2, "EC_LRC_Opt_k4m2l3_su16k", 3},
+  {PGBackendTestFixture::EC, "lrc", "", pg_pool_t::FLAG_EC_OVERWRITES | pg_pool_t::FLAG_EC_OPTIMIZATIONS,  4096,  8, 4, "EC_LRC_Opt_k8m4l3_su4k", 3},
+  {PGBackendTestFixture::EC, "lrc", "", pg_pool_t::FLAG_EC_OVERWRITES, 4096,  4, 2, "EC_LRC_NonOpt_k4m2l3_su4k", 3},
 };
 
 const std::vector<WriteReadParam> kSizeParams = {
@@ -808,6 +818,9 @@ public:
     ec_plugin = config.ec_plugin;
     ec_technique = config.ec_technique;
     pool_flags = config.pool_flags;
+    if (config.l) {
+      ec_profile["l"] = std::to_string(config.l);
+    }
   }
 
   void SetUp() override {
@@ -891,15 +904,24 @@ TEST_P(TestECFailover, PrimaryFailover) {
 
   EXPECT_TRUE(listeners[0]->pgb_is_primary())
     << "Instance 0 should be primary before failover";
-  EXPECT_FALSE(listeners[k]->pgb_is_primary())
-    << "Instance " << k << " should not be primary before failover";
+  for (int i = 1; i < k + m; i++) {
+    EXPECT_FALSE(listeners[i]->pgb_is_primary())
+      << "Instance " << i << " should not be primary before failover";
+  }
 
   // Determine expected new primary based on pool optimization
-  // For optimized EC: shards 1 to k-1 are nonprimary, so new primary will be shard k
+  // For optimized EC: the shards of data chunks 1 to k-1 are nonprimary, so
+  // the new primary is the first other shard (shard k unless the plugin
+  // remaps chunks, as LRC does)
   // For non-optimized EC: any shard can be primary, so new primary will be shard 1
   const pg_pool_t& pool = get_pool();
   bool is_optimized = pool.has_flag(pg_pool_t::FLAG_EC_OPTIMIZATIONS);
-  int expected_new_primary = is_optimized ? k : 1;
+  int expected_new_primary = 1;
+  if (is_optimized) {
+    while (pool.nonprimary_shards.contains(shard_id_t(expected_new_primary))) {
+      expected_new_primary++;
+    }
+  }
   
   simulate_osd_failure(0, expected_new_primary);
 
@@ -49,6 +49,7 @@ struct BackendConfig {
   int m = 2;  // coding chunks (EC only)
   // Label for test naming
   std::string label;
+  int l = 0;  // locality of the lrc plugin, which adds (k+m)/l local parity chunks
 };
 
 /**
@@ -0,0 +1,155 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:nil -*-
+// vim: ts=8 sw=2 sts=2 expandtab
+
+#include "gtest/gtest.h"
+
+#include "common/TrackedOp.h"
+#include "global/global_context.h"
+#include "global/global_init.h"
+#include "common/common_init.h"
+#include "messages/MOSDOp.h"
+
+#include "osd/OSD.h"
+#include "osd/OpRequest.h"
+#include "osd/scheduler/OpSchedulerItem.h"
+
+using namespace ceph::osd::scheduler;
+
+int main(int argc, char **argv) {
+  std::vector<const char*> args(argv, argv+argc);
+  auto cct = global_init(nullptr, args, CEPH_ENTITY_TYPE_OSD,
+			 CODE_ENVIRONMENT_UTILITY,
+			 CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+  common_init_finish(g_ceph_context);
+
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
+
+class OSDOpBatchTest : public testing::Test {
+public:
+  static constexpr uint64_t max_ops = 16;
+  static constexpr uint64_t max_bytes = 1 << 20;
+
+  spg_t pgid{pg_t(0, 1)};
+  std::shared_ptr<OpTracker> op_tracker;
+  ceph_tid_t last_tid = 0;
+
+  // the shard's queue of ops waiting for the pg
+  std::deque<OpSchedulerItem> q;
+  std::vector<OpRequestRef> batch;
+
+  void SetUp() override {
+    op_tracker = std::make_shared<OpTracker>(g_ceph_context, true, 1);
+  }
+  void TearDown() override {
+    batch.clear();
+    q.clear();
+    op_tracker->on_shutdown();
+    op_tracker.reset();
+  }
+
+  OpRequestRef make_op(uint32_t hash, int flags, unsigned len = 0) {
+    hobject_t hoid(object_t("obj" + std::to_string(hash)), "", CEPH_NOSNAP,
+		   hash, pgid.pool(), "");
+    ceph::ref_t<MOSDOp> m = ceph::make_message<MOSDOp>(
+      0, ++last_tid, hoid, pgid, 1, flags, CEPH_FEATURES_ALL);
+    if (flags & CEPH_OSD_FLAG_WRITE) {
+      ceph::buffer::list bl;
+      bl.append_zero(len);
+      m->write(0, len, bl);
+    } else {
+      m->read(0, len);
+    }
+    return op_tracker->create_request<OpRequest, Message*>(m.detach());
+  }
+  OpRequestRef write(uint32_t hash, unsigned len = 4096) {
+    return make_op(hash, CEPH_OSD_FLAG_WRITE, len);
+  }
+  OpRequestRef read(uint32_t hash) {
+    return make_op(hash, CEPH_OSD_FLAG_READ, 4096);
+  }
+  void queue(OpRequestRef op) {
+    q.emplace_back(std::make_unique<PGOpItem>(pgid, std::move(op)),
+		   4096, 63, utime_t(), 1, 1);
+  }
+  // the object hashes of the ops still queued
+  std::vector<uint32_t> queued() {
+    std::vector<uint32_t> r;
+    for (auto& i : q) {
+      r.push_back((*i.maybe_get_op())->get_req<MOSDOp>()->get_hobj().get_hash());
+    }
+    return r;
+  }
+  std::vector<uint32_t> batched() {
+    std::vector<uint32_t> r;
+    for (auto& op : batch) {
+      r.push_back(op->get_req<MOSDOp>()->get_hobj().get_hash());
+    }
+    return r;
+  }
+};
+
+TEST_F(OSDOpBatchTest, writes)
+{
+  for (uint32_t h : {2, 3, 4}) {
+    queue(write(h));
+  }
+  OSD::gather_op_batch(q, write(1), max_ops, max_bytes, &batch);
+  EXPECT_EQ(batched(), (std::vector<uint32_t>{1, 2, 3, 4}));
+  EXPECT_TRUE(q.empty());
+}
+
+TEST_F(OSDOpBatchTest, same_object)
+{
+  // a second write to an object already in the batch has to see the first
+  // one applied, so it ends the batch and stays queued with what follows
+  for (uint32_t h : {2, 3, 2, 4}) {
+    queue(write(h));
+  }
+  OSD::gather_op_batch(q, write(1), max_ops, max_bytes, &batch);
+  EXPECT_EQ(batched(), (std::vector<uint32_t>{1, 2, 3}));
+  EXPECT_EQ(queued(), (std::vector<uint32_t>{2, 4}));
+
+  batch.clear();
+  queue(write(5));
+  OSD::gather_op_batch(q, write(1), max_ops, max_bytes, &batch);
+  EXPECT_EQ(batched(), (std::vector<uint32_t>{1}));
+  EXPECT_EQ(queued(), (std::vector<uint32_t>{2, 4, 5}));
+}
+
+TEST_F(OSDOpBatchTest, read)
+{
+  queue(write(2));
+  queue(read(3));
+  queue(write(4));
+  OSD::gather_op_batch(q, write(1), max_ops, max_bytes, &batch);
+  EXPECT_EQ(batched(), (std::vector<uint32_t>{1, 2}));
+  EXPECT_EQ(queued(), (std::vector<uint32_t>{3, 4}));
+
+  // nor does a read start one
+  batch.clear();
+  OSD::gather_op_batch(q, read(1), max_ops, max_bytes, &batch);
+  EXPECT_TRUE(batch.empty());
+  EXPECT_EQ(queued(), (std::vector<uint32_t>{3, 4}));
+}
+
+TEST_F(OSDOpBatchTest, max_ops)
+{
+  for (uint32_t h = 2; h < 10; ++h) {
+    queue(write(h));
+  }
+  OSD::gather_op_batch(q, write(1), 4, max_bytes, &batch);
+  EXPECT_EQ(batched(), (std::vector<uint32_t>{1, 2, 3, 4}));
+  EXPECT_EQ(q.size(), 5u);
+}
+
+TEST_F(OSDOpBatchTest, max_bytes)
+{
+  for (uint32_t h : {2, 3, 4}) {
+    queue(write(h, 4096));
+  }
+  OSD::gather_op_batch(q, write(1, 4096), max_ops, 3 * 4096, &batch);
+  EXPECT_EQ(batched(), (std::vector<uint32_t>{1, 2, 3}));
+  EXPECT_EQ(queued(), (std::vector<uint32_t>{4}));
+}